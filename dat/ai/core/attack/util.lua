@@ -140,8 +140,11 @@ function atk.decide_zz( target, dist )
    local range  = atk.primary_range()
    local dir    = ai.idir(target)
 
-   local _m1, d1 = vec2.polar( pilot:vel() )
-   local _m2, d2 = vec2.polar( target:pos() - pilot:pos() )
+   local vx, vy = pilot:velxy()
+   local px, py = pilot:posxy()
+   local tx, ty = target:posxy()
+   local d1 = math.atan2( vy, vx )
+   local d2 = math.atan2( ty-py, tx-px )
    local d = d1-d2
 
    return ( (dist > range) and (ai.hasprojectile())
@@ -452,10 +455,11 @@ local function ___atk_g_ranged_kite( target, dist )
    local range = atk.seekers_range()
 
    -- Try to keep velocity vector away from enemy
-   local targetpos = target:pos()
-   local selfpos = p:pos()
-   local _unused, targetdir = (selfpos-targetpos):polar()
-   local velmod, veldir = p:vel():polar()
+   local tx, ty = target:posxy()
+   local sx, sy = p:posxy()
+   local targetdir = math.atan2( sy-ty, sx-tx )
+   local vx, vy = p:velxy()
+   local velmod, veldir = math.sqrt( vx*vx + vy*vy ), math.atan2( vy, vx )
    if velmod < 0.8*p:speed() or math.abs(targetdir-veldir) > math.rad(30) then
       local dir = ai.face( target, true )
       if math.abs(math.pi-dir) < math.rad(30) then
@@ -486,9 +490,9 @@ function atk.ranged( target, dist )
          or range < atk.primary_range()*1.5 then
       ___atk_g_ranged_dogfight( target, dist )
    elseif target:target()==ai.pilot() and dist < range and ai.hasprojectile() then
-      local tvel = target:vel()
-      local pvel = ai.pilot():vel()
-      local vel = (tvel-pvel):polar()
+      local tvx, tvy = target:velxy()
+      local pvx, pvy = ai.pilot():velxy()
+      local vel = math.sqrt( (tvx-pvx)^2 + (tvy-pvy)^2 )
       -- If will make contact soon, try to engage
       if dist < wrange+8*vel then
          ___atk_g_ranged_dogfight( target, dist )
@@ -505,9 +509,16 @@ function atk.ranged( target, dist )
    atk.fb_and_pd()
 end
 
+-- Squared distance between two pilots, without creating vectors
+local function pilot_dist2( p, h )
+   local px, py = p:posxy()
+   local hx, hy = h:posxy()
+   return (px-hx)^2 + (py-hy)^2
+end
+
 function atk.prefer_similar( p, h, v )
    local w = math.abs( p:points() - h:points() ) -- Similar in points
-   w = w + 50 / math.pow( mem.atk_pref_range, 2 ) * p:pos():dist2( h:pos() ) -- Squared distance normalized to 1
+   w = w + 50 / math.pow( mem.atk_pref_range, 2 ) * pilot_dist2( p, h ) -- Squared distance normalized to 1
    -- Bring down vulnerability a bit
    if not v then
       w = w + 100
@@ -518,7 +529,7 @@ end
 function atk.prefer_capship( p, h, v )
    local w = -math.min( 100, h:points() ) -- Random threshold
    -- distance is less important to capships
-   w = w + 10 / math.pow( mem.atk_pref_range, 2 ) * p:pos():dist2( h:pos() )
+   w = w + 10 / math.pow( mem.atk_pref_range, 2 ) * pilot_dist2( p, h )
    -- Bring down vulnerability a bit
    if not v then
       w = w + 100
@@ -528,7 +539,7 @@ end
 
 function atk.prefer_weaker( p, h, v )
    local w = math.max( 0, h:points() - p:points() ) -- penalize if h has more points
-   w = w + 50 / math.pow( mem.atk_pref_range, 2 ) * p:pos():dist2( h:pos() ) -- Squared distance normalized to 1
+   w = w + 50 / math.pow( mem.atk_pref_range, 2 ) * pilot_dist2( p, h ) -- Squared distance normalized to 1
    -- Bring down vulnerability a bit
    if not v then
       w = w + 100
@@ -1,22 +1,27 @@
 #include "lib/math.glsl"
 
-uniform float m;
 uniform vec4 colour;
 uniform vec4 outline_colour;
 uniform sampler2D sampler;
 
 in vec2 tex_coord_out;
+flat in float m_out;
+flat in vec4 glyph_colour_out;
 out vec4 colour_out;
 
 void main(void)
 {
+   // Glyphs coloured by an escape sequence keep the alpha of the base colour.
+   vec4 c = mix( colour, vec4( glyph_colour_out.rgb, colour.a ), glyph_colour_out.a );
+   // Without an outline, fade the edges to the glyph's own colour.
+   vec4 oc = (outline_colour.a > 0.0) ? outline_colour : vec4( c.rgb, 0.0 );
    // d is the signed distance to the glyph; m is the distance value corresponding to 1 "pixel".
    float t = texture(sampler, tex_coord_out).r;
-   float d = (t-0.5)*m;
+   float d = (t-0.5)*m_out;
    // Map the signed distance to mixing parameters for outline..foreground, transparent..opaque.
    float alpha = smoothstep(-0.5    , +0.5, d);
    float beta  = smoothstep(-M_SQRT2, -1.0, d);
-   vec4 fg_c   = mix( outline_colour, colour, alpha );
+   vec4 fg_c   = mix( oc, c, alpha );
    colour_out   = vec4( fg_c.rgb, beta*fg_c.a );
    gl_FragDepth = -t+1.0;
 }
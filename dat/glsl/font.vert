@@ -2,9 +2,15 @@ uniform mat4 projection;
 
 in vec4 vertex;
 in vec2 tex_coord;
+in float m;
+in vec4 glyph_colour;
 out vec2 tex_coord_out;
+flat out float m_out;
+flat out vec4 glyph_colour_out;
 
 void main(void) {
-   tex_coord_out = tex_coord;
+   tex_coord_out    = tex_coord;
+   m_out            = m;
+   glyph_colour_out = glyph_colour;
    gl_Position = projection * vertex;
 }
@@ -0,0 +1,22 @@
+/* Each instance is a sprite, drawn as a rotated and scaled square. */
+uniform mat4 projection;
+in vec4 vertex;
+in vec4 pos;    // Screen position and size
+in vec4 tex;    // Sprite cell within the texture
+in vec4 colour;
+in vec2 params; // Rotation angle and interpolation
+out vec2 tex_coord;
+flat out vec4 col;
+flat out float inter;
+
+void main(void) {
+   float c = cos( params.x );
+   float s = sin( params.x );
+   vec2 p = (vertex.xy - 0.5) * pos.zw;
+   p = vec2( c*p.x - s*p.y, s*p.x + c*p.y ) + pos.xy + 0.5 * pos.zw;
+
+   tex_coord   = tex.xy + vertex.xy * tex.zw;
+   col         = colour;
+   inter       = params.y;
+   gl_Position = projection * vec4( p, 0.0, 1.0 );
+}
@@ -1,12 +1,37 @@
-/* Same as project_pos.vert */
+/* Each instance is a segment of the trail, drawn as a stretched square. */
 uniform mat4 projection;
 in vec4 vertex;
+in vec4 segment; // Start and end position of the segment
+in vec4 col1;
+in vec4 col2;
+in vec4 times;   // Start and end time, then start and end depth
+in vec4 lengths; // End then start position along the trail
+in vec3 params;  // Width, unique value and current time
 out vec2 pos;
 
-uniform vec2 z; // Depth
+/* Passed as is to the trail shader, see trail/common.glsl. */
+flat out vec4 c1;
+flat out vec4 c2;
+flat out vec2 t;
+flat out vec2 pos1;
+flat out vec2 pos2;
+flat out float r;
+flat out float dt;
 
 void main(void) {
+   vec2 d = segment.zw - segment.xy;
+   vec2 n = vec2( -d.y, d.x ) / length( d );
+   vec2 p = segment.xy + vertex.x * d + (vertex.y - 0.5) * params.x * n;
+
    pos = vertex.xy;
-   gl_Position = projection * vertex;
-   gl_Position.z = mix( z.x, z.y, vertex.x ); // Use the "trail" depth
+   gl_Position = projection * vec4( p, 0.0, 1.0 );
+   gl_Position.z = mix( times.z, times.w, vertex.x ); // Use the "trail" depth
+
+   c1   = col1;
+   c2   = col2;
+   t    = times.xy;
+   pos1 = lengths.xy;
+   pos2 = lengths.zw;
+   r    = params.y;
+   dt   = params.z;
 }
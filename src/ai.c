@@ -1492,30 +1492,15 @@ static int aiL_getrndpilot( lua_State *L )
  */
 static int aiL_getnearestpilot( lua_State *L )
 {
-   /* dist will be initialized to a number */
-   /* this will only seek out pilots closer than dist */
-   Pilot *const *pilot_stack  = pilot_getAll();
-   int           dist         = 1e6;
-   int           candidate_id = -1;
-
-   /*cycle through all the pilots and find the closest one that is not the pilot
-    */
-   for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
-      if ( pilot_stack[i]->id == cur_pilot->id )
-         continue;
-      if ( vec2_dist( &pilot_stack[i]->solid.pos, &cur_pilot->solid.pos ) >
-           dist )
-         continue;
-      dist = vec2_dist( &pilot_stack[i]->solid.pos, &cur_pilot->solid.pos );
-      candidate_id = i;
-   }
+   /* Only seeks out pilots closer than 1e6. */
+   unsigned int id = pilot_thinkNearestPilot( cur_pilot, 1e6 );
 
    /* Last check. */
-   if ( candidate_id == -1 )
+   if ( id == 0 )
       return 0;
 
    /* Actually found a pilot. */
-   lua_pushpilot( L, pilot_stack[candidate_id]->id );
+   lua_pushpilot( L, id );
    return 1;
 }
 
@@ -3126,43 +3111,12 @@ static int aiL_hasafterburner( lua_State *L )
  */
 static int aiL_getenemy( lua_State *L )
 {
-   if ( lua_isnoneornil( L, 1 ) ) {
-      unsigned int id = pilot_getNearestEnemy( cur_pilot );
-      if ( id == 0 ) /* No enemy found */
-         return 0;
-      lua_pushpilot( L, id );
-      return 1;
-   } else {
-      double        range = luaL_checknumber( L, 1 );
-      double        r2    = pow2( range );
-      unsigned int  tp    = 0;
-      double        d     = 0.;
-      int           x, y, r;
-      Pilot *const *pilot_stack = pilot_getAll();
-
-      r = ceil( range );
-      x = round( cur_pilot->solid.pos.x );
-      y = round( cur_pilot->solid.pos.y );
-      pilot_collideQueryIL( &ai_qtquery, x - r, y - r, x + r, y + r );
-      for ( int i = 0; i < il_size( &ai_qtquery ); i++ ) {
-         const Pilot *p = pilot_stack[il_get( &ai_qtquery, i, 0 )];
-         double       td;
-
-         if ( vec2_dist2( &p->solid.pos, &cur_pilot->solid.pos ) > r2 )
-            continue;
-
-         if ( !pilot_validEnemy( cur_pilot, p ) )
-            continue;
-
-         /* Check distance. */
-         td = vec2_dist2( &p->solid.pos, &cur_pilot->solid.pos );
-         if ( !tp || ( td < d ) ) {
-            d  = td;
-            tp = p->id;
-         }
-      }
-      return tp;
-   }
+   double       range = luaL_optnumber( L, 1, -1. );
+   unsigned int id    = pilot_thinkNearestEnemy( cur_pilot, range );
+   if ( id == 0 ) /* No enemy found */
+      return 0;
+   lua_pushpilot( L, id );
+   return 1;
 }
 
 /**
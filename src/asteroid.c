@@ -68,10 +68,11 @@ static int asteroid_creating = 0;
 
 /* Prototypes. */
 static int asttype_cmp( const void *p1, const void *p2 );
-static int asttype_parse( AsteroidType *at, const char *file );
+static int asttype_parse( AsteroidType *at, const char *file, xmlDocPtr doc );
 static int asteroid_loadPLG( AsteroidType *temp, const char *buf );
 static int astgroup_cmp( const void *p1, const void *p2 );
-static int astgroup_parse( AsteroidTypeGroup *ag, const char *file );
+static int astgroup_parse( AsteroidTypeGroup *ag, const char *file,
+                           xmlDocPtr doc );
 static int asttype_load( void );
 
 static int  asteroid_updateSingle( Asteroid *a );
@@ -580,18 +581,21 @@ static int astgroup_cmp( const void *p1, const void *p2 )
  */
 static int asttype_load( void )
 {
-   char **asteroid_files = ndata_listRecursive( ASTEROID_TYPES_DATA_PATH );
-   asteroid_types        = array_create( AsteroidType );
+   char     **asteroid_files = ndata_listRecursive( ASTEROID_TYPES_DATA_PATH );
+   xmlDocPtr *asteroid_docs  = xml_parsePhysFSAll( asteroid_files );
+   asteroid_types            = array_create( AsteroidType );
 
    for ( int i = 0; i < array_size( asteroid_files ); i++ ) {
       if ( ndata_matchExt( asteroid_files[i], "xml" ) ) {
          AsteroidType at;
-         int          ret = asttype_parse( &at, asteroid_files[i] );
+         xmlDocPtr    doc = asteroid_docs[i];
+         int          ret = asttype_parse( &at, asteroid_files[i], doc );
          if ( ret == 0 )
             array_push_back( &asteroid_types, at );
       }
       free( asteroid_files[i] );
    }
+   xml_freeAll( asteroid_docs );
    array_free( asteroid_files );
    array_shrink( &asteroid_types );
    qsort( asteroid_types, array_size( asteroid_types ), sizeof( AsteroidType ),
@@ -606,15 +610,18 @@ static int asttype_load( void )
    /* Load the asteroid groups from XML definitions. */
    asteroid_groups = array_create( AsteroidTypeGroup );
    asteroid_files  = ndata_listRecursive( ASTEROID_GROUPS_DATA_PATH );
+   asteroid_docs   = xml_parsePhysFSAll( asteroid_files );
    for ( int i = 0; i < array_size( asteroid_files ); i++ ) {
       if ( ndata_matchExt( asteroid_files[i], "xml" ) ) {
          AsteroidTypeGroup atg;
-         int               ret = astgroup_parse( &atg, asteroid_files[i] );
+         xmlDocPtr         doc = asteroid_docs[i];
+         int               ret = astgroup_parse( &atg, asteroid_files[i], doc );
          if ( ret == 0 )
             array_push_back( &asteroid_groups, atg );
       }
       free( asteroid_files[i] );
    }
+   xml_freeAll( asteroid_docs );
    array_free( asteroid_files );
    /* Add asteroid types as individual groups. */
    for ( int i = 0; i < array_size( asteroid_types ); i++ ) {
@@ -645,14 +652,12 @@ static int asttype_load( void )
  *
  *    @param[out] at Outfit asteroid type.
  *    @param file File containing the XML information.
+ *    @param doc Parsed document of the file.
  */
-static int asttype_parse( AsteroidType *at, const char *file )
+static int asttype_parse( AsteroidType *at, const char *file, xmlDocPtr doc )
 {
    xmlNodePtr parent, node;
-   xmlDocPtr  doc;
 
-   /* Load the data. */
-   doc = xml_parsePhysFS( file );
    if ( doc == NULL )
       return -1;
 
@@ -739,9 +744,6 @@ static int asttype_parse( AsteroidType *at, const char *file )
             node->name );
    } while ( xml_nextNode( node ) );
 
-   /* Clean up. */
-   xmlFreeDoc( doc );
-
    /* Some post-process. */
    at->absorb      = CLAMP( 0., 1., at->absorb / 100. );
    at->penetration = CLAMP( 0., 1., at->penetration / 100. );
@@ -772,14 +774,13 @@ static int asttype_parse( AsteroidType *at, const char *file )
  */
 static int asteroid_loadPLG( AsteroidType *temp, const char *buf )
 {
-   char       file[PATH_MAX];
-   xmlDocPtr  doc;
-   xmlNodePtr node;
+   char      file[PATH_MAX];
+   CollPoly *polygons;
 
    snprintf( file, sizeof( file ), "%s%s.xml", ASTEROID_POLYGON_PATH, buf );
 
    /* See if the file does exist. */
-   if ( !PHYSFS_exists( file ) ) {
+   if ( poly_loadFile( &polygons, file ) ) {
       WARN( _( "%s xml collision polygon does not exist!\n \
                Please use the script 'polygon_from_sprite.py'\n \
                This file can be found in Naev's artwork repo." ),
@@ -787,27 +788,9 @@ static int asteroid_loadPLG( AsteroidType *temp, const char *buf )
       return 0;
    }
 
-   /* Load the XML. */
-   doc = xml_parsePhysFS( file );
-   if ( doc == NULL )
-      return 0;
-
-   node = doc->xmlChildrenNode; /* First polygon node */
-   if ( node == NULL ) {
-      xmlFreeDoc( doc );
-      WARN( _( "Malformed %s file: does not contain elements" ), file );
-      return 0;
-   }
-
-   do { /* load the polygon data */
-      if ( xml_isNode( node, "polygons" ) ) {
-         CollPoly plg;
-         poly_load( &plg, node, file );
-         array_push_back( &temp->polygon, plg );
-      }
-   } while ( xml_nextNode( node ) );
-
-   xmlFreeDoc( doc );
+   for ( int i = 0; i < array_size( polygons ); i++ )
+      array_push_back( &temp->polygon, polygons[i] );
+   array_free( polygons );
    return 0;
 }
 
@@ -816,15 +799,14 @@ static int asteroid_loadPLG( AsteroidType *temp, const char *buf )
  *
  *    @param[out] ag Asteroid type group to load.
  *    @param file File to load from.
+ *    @param doc Parsed document of the file.
  *    @return 0 on success.
  */
-static int astgroup_parse( AsteroidTypeGroup *ag, const char *file )
+static int astgroup_parse( AsteroidTypeGroup *ag, const char *file,
+                           xmlDocPtr doc )
 {
    xmlNodePtr parent, node;
-   xmlDocPtr  doc;
 
-   /* Load the data. */
-   doc = xml_parsePhysFS( file );
    if ( doc == NULL )
       return -1;
 
@@ -863,9 +845,6 @@ static int astgroup_parse( AsteroidTypeGroup *ag, const char *file )
             node->name );
    } while ( xml_nextNode( node ) );
 
-   /* Clean up. */
-   xmlFreeDoc( doc );
-
    return 0;
 }
 
@@ -887,6 +866,7 @@ void asteroids_renderOverlay( void )
       if ( d->height > 1. )
          debris_renderSingle( d, cx, cy );
    }
+   gl_batchFlushSorted();
 
    NTracingZoneEnd( _ctx );
 }
@@ -920,6 +900,7 @@ void asteroids_render( void )
       for ( int j = 0; j < array_size( ast->asteroids ); j++ )
          asteroid_renderSingle( &ast->asteroids[j] );
    }
+   gl_batchFlushSorted();
 
    /* Render the debris. */
    for ( int j = 0; j < array_size( debris_stack ); j++ ) {
@@ -927,6 +908,7 @@ void asteroids_render( void )
       if ( d->height <= 1. )
          debris_renderSingle( d, cx, cy );
    }
+   gl_batchFlushSorted();
 
    /* Render gatherable stuff. */
    gatherable_render();
@@ -978,12 +960,13 @@ static void asteroid_renderSingle( const Asteroid *a )
    }
 
    at = a->type;
-   gl_renderSpriteRotate( a->gfx, a->sol.pos.x, a->sol.pos.y, a->ang, 0, 0,
-                          &col );
+   gl_batchSprite( a->gfx, a->sol.pos.x, a->sol.pos.y, 1., 1., a->ang, 0, 0,
+                   &col );
 
    /* Add the commodities if scanned. */
    if ( !a->scanned )
       return;
+   gl_batchFlushSorted(); /* Text goes on top. */
    col   = cFontWhite;
    col.a = a->scan_alpha;
    gl_gameToScreenCoords( &nx, &ny, a->sol.pos.x, a->sol.pos.y );
@@ -1009,8 +992,8 @@ static void debris_renderSingle( const Debris *d, double cx, double cy )
    const double   scale = 0.5;
    const glColour col   = COL_ALPHA( cInert, d->alpha );
 
-   gl_renderSpriteScaleRotate( d->gfx, d->pos.x + cx, d->pos.y + cy, scale,
-                               scale, d->ang, 0, 0, &col );
+   gl_batchSprite( d->gfx, d->pos.x + cx, d->pos.y + cy, scale, scale, d->ang,
+                   0, 0, &col );
 }
 
 /**
@@ -1296,3 +1279,12 @@ void asteroid_collideQueryIL( AsteroidAnchor *anc, IntList *il, int x1, int y1,
 {
    qt_query( &anc->qt, il, x1, y1, x2, y2 );
 }
+
+/**
+ * @brief Like asteroid_collideQueryIL, but safe to run from multiple threads.
+ */
+void asteroid_collideQueryConstIL( const AsteroidAnchor *anc, IntList *il,
+                                   int x1, int y1, int x2, int y2 )
+{
+   qt_queryConst( &anc->qt, il, x1, y1, x2, y2 );
+}
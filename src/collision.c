@@ -11,12 +11,14 @@
 #include "naev.h"
 
 #include "SDL.h"
+#include "physfs.h"
 /** @endcond */
 
 #include "collision.h"
 
 #include "array.h"
 #include "log.h"
+#include "ndata_bundle.h"
 #include "physics.h"
 
 /*
@@ -117,6 +119,64 @@ void poly_load( CollPoly *polygon, xmlNodePtr base, const char *name )
    }
 }
 
+/**
+ * @brief Loads all the polygons of a collision polygon document.
+ *
+ *    @param doc Document to load.
+ *    @param name Name to give the polygons for debugging purposes.
+ *    @return Array of polygons (array.h), one per polygons node.
+ */
+CollPoly *poly_loadDoc( xmlDocPtr doc, const char *name )
+{
+   CollPoly  *polygons = array_create( CollPoly );
+   xmlNodePtr node     = doc->xmlChildrenNode; /* First polygon node */
+   if ( node == NULL ) {
+      WARN( _( "Malformed %s file: does not contain elements" ), name );
+      return polygons;
+   }
+
+   do { /* load the polygon data */
+      if ( xml_isNode( node, "polygons" ) )
+         poly_load( &array_grow( &polygons ), node, name );
+   } while ( xml_nextNode( node ) );
+   return polygons;
+}
+
+/**
+ * @brief Loads the polygons of a collision polygon file.
+ *
+ * Uses the pre-parsed polygons in the ndata bundle when available.
+ *
+ *    @param[out] polygons Array of polygons (array.h), one per polygons node.
+ *    @param file Path of the file.
+ *    @return 0 on success, -1 if the file does not exist.
+ */
+int poly_loadFile( CollPoly **polygons, const char *file )
+{
+   const char *packed;
+   size_t      size;
+   xmlDocPtr   doc;
+
+   packed = ndata_bundlePolygons( file, &size );
+   if ( packed != NULL ) {
+      *polygons = poly_unpack( packed, size );
+      if ( *polygons != NULL )
+         return 0;
+   }
+
+   if ( !PHYSFS_exists( file ) )
+      return -1;
+
+   doc = xml_parsePhysFS( file );
+   if ( doc == NULL ) {
+      *polygons = array_create( CollPoly );
+      return 0;
+   }
+   *polygons = poly_loadDoc( doc, file );
+   xmlFreeDoc( doc );
+   return 0;
+}
+
 void poly_free( CollPoly *poly )
 {
    for ( int i = 0; i < array_size( poly->views ); i++ ) {
@@ -127,6 +187,133 @@ void poly_free( CollPoly *poly )
    array_free( poly->views );
 }
 
+/**
+ * @brief Packs polygons into a binary blob for the ndata bundle.
+ *
+ * The layout is native, the bundle is only used by the same build. It is the
+ * polygon count, then for each polygon its view count, dir_inc and dir_off,
+ * then for each view the number of x and y coordinates, the bounds and the
+ * coordinates.
+ *
+ *    @param polygons Array of polygons (array.h) to pack.
+ *    @param[out] size Size of the blob.
+ *    @return The blob, to be freed.
+ */
+char *poly_pack( const CollPoly *polygons, size_t *size )
+{
+   char    *data, *p;
+   uint32_t n;
+
+   /* Count. */
+   *size = sizeof( uint32_t );
+   for ( int i = 0; i < array_size( polygons ); i++ ) {
+      const CollPoly *poly = &polygons[i];
+      *size += sizeof( uint32_t ) + 2 * sizeof( double );
+      for ( int j = 0; j < array_size( poly->views ); j++ )
+         *size += 2 * sizeof( uint32_t ) + 4 * sizeof( float ) +
+                  ( array_size( poly->views[j].x ) +
+                    array_size( poly->views[j].y ) ) *
+                     sizeof( float );
+   }
+
+   /* Fill. */
+   data = malloc( *size );
+   p    = data;
+#define POLY_PUT( src, sz )                                                    \
+   do {                                                                        \
+      memcpy( p, src, sz );                                                    \
+      p += sz;                                                                 \
+   } while ( 0 )
+   n = array_size( polygons );
+   POLY_PUT( &n, sizeof( n ) );
+   for ( int i = 0; i < array_size( polygons ); i++ ) {
+      const CollPoly *poly = &polygons[i];
+      n                    = array_size( poly->views );
+      POLY_PUT( &n, sizeof( n ) );
+      POLY_PUT( &poly->dir_inc, sizeof( double ) );
+      POLY_PUT( &poly->dir_off, sizeof( double ) );
+      for ( int j = 0; j < array_size( poly->views ); j++ ) {
+         const CollPolyView *view = &poly->views[j];
+         uint32_t            nx   = array_size( view->x );
+         uint32_t            ny   = array_size( view->y );
+         POLY_PUT( &nx, sizeof( nx ) );
+         POLY_PUT( &ny, sizeof( ny ) );
+         POLY_PUT( &view->xmin, sizeof( float ) );
+         POLY_PUT( &view->xmax, sizeof( float ) );
+         POLY_PUT( &view->ymin, sizeof( float ) );
+         POLY_PUT( &view->ymax, sizeof( float ) );
+         POLY_PUT( view->x, nx * sizeof( float ) );
+         POLY_PUT( view->y, ny * sizeof( float ) );
+      }
+   }
+#undef POLY_PUT
+   return data;
+}
+
+/**
+ * @brief Unpacks polygons packed with poly_pack.
+ *
+ *    @param data Packed polygons, does not have to be aligned.
+ *    @param size Size of the packed polygons.
+ *    @return Array of polygons (array.h), or NULL if the data is malformed.
+ */
+CollPoly *poly_unpack( const char *data, size_t size )
+{
+   const char *p   = data;
+   const char *end = data + size;
+   CollPoly   *polygons;
+   uint32_t    npoly;
+
+#define POLY_GET( dst, sz )                                                    \
+   do {                                                                        \
+      if ( (size_t)( end - p ) < (size_t)( sz ) )                              \
+         goto err;                                                             \
+      memcpy( dst, p, sz );                                                    \
+      p += sz;                                                                 \
+   } while ( 0 )
+   polygons = array_create( CollPoly );
+   POLY_GET( &npoly, sizeof( npoly ) );
+   for ( uint32_t i = 0; i < npoly; i++ ) {
+      CollPoly *poly = &array_grow( &polygons );
+      uint32_t  nviews;
+      poly->views = NULL;
+      POLY_GET( &nviews, sizeof( nviews ) );
+      POLY_GET( &poly->dir_inc, sizeof( double ) );
+      POLY_GET( &poly->dir_off, sizeof( double ) );
+      poly->views = array_create_size( CollPolyView, nviews );
+      for ( uint32_t j = 0; j < nviews; j++ ) {
+         CollPolyView *view = &array_grow( &poly->views );
+         uint32_t      nx, ny;
+         view->x = NULL;
+         view->y = NULL;
+         POLY_GET( &nx, sizeof( nx ) );
+         POLY_GET( &ny, sizeof( ny ) );
+         POLY_GET( &view->xmin, sizeof( float ) );
+         POLY_GET( &view->xmax, sizeof( float ) );
+         POLY_GET( &view->ymin, sizeof( float ) );
+         POLY_GET( &view->ymax, sizeof( float ) );
+         if ( ( nx > size ) || ( ny > size ) )
+            goto err;
+         view->x = array_create_size( float, MAX( nx, 1 ) );
+         array_resize( &view->x, nx );
+         POLY_GET( view->x, nx * sizeof( float ) );
+         view->y = array_create_size( float, MAX( ny, 1 ) );
+         array_resize( &view->y, ny );
+         POLY_GET( view->y, ny * sizeof( float ) );
+         view->npt = nx;
+      }
+   }
+#undef POLY_GET
+   return polygons;
+
+err:
+   WARN( _( "Malformed packed collision polygons." ) );
+   for ( int i = 0; i < array_size( polygons ); i++ )
+      poly_free( &polygons[i] );
+   array_free( polygons );
+   return NULL;
+}
+
 /**
  * @brief Checks whether or not two sprites collide.
  *
@@ -27,8 +27,14 @@ typedef struct CollPoly_ {
 } CollPoly;
 
 /* Loads a polygon data from xml. */
-void poly_load( CollPoly *polygon, xmlNodePtr node, const char *name );
-void poly_free( CollPoly *polygon );
+void      poly_load( CollPoly *polygon, xmlNodePtr node, const char *name );
+CollPoly *poly_loadDoc( xmlDocPtr doc, const char *name );
+int       poly_loadFile( CollPoly **polygons, const char *file );
+void      poly_free( CollPoly *polygon );
+
+/* Binary form for the ndata bundle. */
+char     *poly_pack( const CollPoly *polygons, size_t *size );
+CollPoly *poly_unpack( const char *data, size_t size );
 
 /* Rotates a polygon. */
 void poly_rotate( CollPolyView *rpolygon, const CollPolyView *ipolygon,
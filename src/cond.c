@@ -111,8 +111,8 @@ int cond_check( const char *cond )
       lua_pushstring( naevL, cond );
       lua_concat( naevL, 2 );
    }
-   ret = nlua_dobufenv( cond_env, lua_tostring( naevL, -1 ),
-                        lua_strlen( naevL, -1 ), "Lua Conditional" );
+   ret = nlua_dostringenv( cond_env, lua_tostring( naevL, -1 ),
+                           "Lua Conditional" );
    switch ( ret ) {
    case LUA_ERRSYNTAX:
       snprintf( buf, sizeof( buf ), _( "Lua conditional syntax error: %s" ),
@@ -153,6 +153,7 @@ void conf_setDefaults( void )
    conf.devautosave              = 0;
    conf.lua_enet                 = 0;
    conf.lua_repl                 = 0;
+   conf.lua_cache                = 1;
    conf.lastversion              = strdup( "" );
    conf.translation_warning_seen = 0;
    memset( &conf.last_played, 0, sizeof( time_t ) );
@@ -438,6 +439,7 @@ int conf_loadConfig( const char *file )
       conf_loadBool( lEnv, "devautosave", conf.devautosave );
       conf_loadBool( lEnv, "lua_enet", conf.lua_enet );
       conf_loadBool( lEnv, "lua_repl", conf.lua_repl );
+      conf_loadBool( lEnv, "lua_cache", conf.lua_cache );
       conf_loadBool( lEnv, "conf_nosave", conf.nosave );
       conf_loadString( lEnv, "lastversion", conf.lastversion );
       conf_loadBool( lEnv, "translation_warning_seen",
@@ -1175,6 +1177,9 @@ int conf_saveConfig( const char *file )
    conf_saveBool( "lua_enet", conf.lua_enet );
    conf_saveComment( _( "Enable the experimental CLI based on lua-repl." ) );
    conf_saveBool( "lua_repl", conf.lua_repl );
+   conf_saveComment(
+      _( "Keep compiled Lua scripts in the cache directory to load faster." ) );
+   conf_saveBool( "lua_cache", conf.lua_cache );
    conf_saveEmptyLine();
 
    conf_saveComment(
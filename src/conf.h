@@ -199,6 +199,7 @@ typedef struct PlayerConf_s {
    int   devautosave;           /**< Developer mode autosave. */
    int   lua_enet;              /**< Enable the lua-enet library. */
    int   lua_repl;    /**< Enable the experimental CLI based on lua-repl. */
+   int   lua_cache;   /**< Keep compiled Lua scripts on disk. */
    int   nosave;      /**< Disables conf saving. */
    char *lastversion; /**< The last version the game was ran in. */
    int   translation_warning_seen; /**< No need to warn about incomplete game
@@ -12,6 +12,7 @@ void debug_enableLeakSanitizer( void );
 enum {
    DEBUG_MARK_EMITTER,   /**< Mark the trail emitters with a cross. */
    DEBUG_MARK_COLLISION, /**< Mark collisions. */
+   DEBUG_LUA_GC,         /**< Show Lua heap size and collection pauses. */
    /* Sentinel. */
    DEBUG_FLAGS_MAX /**< Maximum number of flags. */
 };
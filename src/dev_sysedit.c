@@ -24,6 +24,7 @@
 #include "dev_uniedit.h"
 #include "dialogue.h"
 #include "economy.h"
+#include "map.h"
 #include "ndata.h"
 #include "nstring.h"
 #include "opengl.h"
@@ -1937,6 +1938,7 @@ static void sysedit_editJumpClose( unsigned int wid, const char *unused )
       jp_rmFlag( j, JP_EXITONLY );
    }
    j->hide = atof( window_getInput( sysedit_widEdit, "inpHide" ) );
+   map_jumpDistInvalidate();
 
    window_close( wid, unused );
 }
@@ -13,11 +13,11 @@
 /** @cond */
 #include <stdio.h>
 
-#if HAVE_SUITESPARSE_CS_H
-#include <suitesparse/cs.h>
-#else /* HAVE_SUITESPARSE_CS_H */
-#include <cs.h>
-#endif /* HAVE_SUITESPARSE_CS_H */
+#if HAVE_SUITESPARSE_CHOLMOD_H
+#include <suitesparse/cholmod.h>
+#else /* HAVE_SUITESPARSE_CHOLMOD_H */
+#include <cholmod.h>
+#endif /* HAVE_SUITESPARSE_CHOLMOD_H */
 
 #include "naev.h"
 /** @endcond */
@@ -25,10 +25,13 @@
 #include "economy.h"
 
 #include "array.h"
+#include "faction.h"
 #include "log.h"
 #include "ndata.h"
 #include "ntime.h"
+#include "ntracing.h"
 #include "nxml.h"
+#include "rng.h"
 #include "space.h"
 
 /*
@@ -39,7 +42,14 @@
 #define ECON_FACTION_MOD 0.1 /**< Modifier on Base for faction standings. */
 #define ECON_PROD_MODIFIER                                                     \
    500000. /**< Production modifier, divide production by this amount. */
-#define ECON_PROD_VAR 0.01 /**< Defines the variability of production. */
+#define ECON_PROD_VAR 0.01 /**< Standard deviation of the production factor. */
+#define ECON_PROD_REVERT                                                       \
+   0.05 /**< Rate per period at which production returns to its base. */
+#define ECON_PRICE_MOD 0.5 /**< How much production deviations move prices. */
+#define ECON_PRICE_MIN 0.5 /**< Minimum dynamic price modifier. */
+#define ECON_PRICE_MAX 1.5 /**< Maximum dynamic price modifier. */
+#define ECON_STEP                                                              \
+   ( NT_PERIOD_SECONDS ) /**< Game seconds between production steps. */
 
 /* systems stack. */
 extern StarSystem *systems_stack; /**< Star system stack. */
@@ -49,19 +59,37 @@ extern Commodity *commodity_stack;
 
 /*
  * Nodal analysis simulation for dynamic economies.
+ *
+ * Dense matrices are system x commodity, so all the commodities are solved at
+ * once as a single multi-column right hand side.
  */
-static int econ_initialized = 0; /**< Is economy system initialized? */
-static int econ_queued      = 0; /**< Whether there are any queued updates. */
-static cs *econ_G           = NULL; /**< Admittance matrix. */
-int       *econ_comm        = NULL; /**< Commodities to calculate. */
+static int      econ_initialized = 0; /**< Is economy system initialized? */
+static int      econ_queued = 0; /**< Whether there are any queued updates. */
+static uint64_t econ_G_hash = 0; /**< Hash of econ_G's entries. */
+static double  *econ_prod   = NULL; /**< Production factor per intensity. */
+static double   econ_dt     = 0.; /**< Game seconds since the last step. */
+static cholmod_common  econ_C;         /**< CHOLMOD state. */
+static cholmod_sparse *econ_G  = NULL; /**< Admittance matrix. */
+static cholmod_factor *econ_L  = NULL; /**< Factorization of econ_G. */
+static cholmod_dense  *econ_I0 = NULL; /**< Base intensities. */
+static cholmod_dense  *econ_X0 = NULL; /**< Base potentials. */
+static cholmod_dense  *econ_D  = NULL; /**< Deviation of the intensities. */
+static cholmod_dense  *econ_Y  = NULL; /**< Deviation of the potentials. */
+static cholmod_dense  *econ_Yw = NULL; /**< Solver workspace. */
+static cholmod_dense  *econ_Ew = NULL; /**< Solver workspace. */
+int                   *econ_comm = NULL; /**< Commodities to calculate. */
 
 /*
  * Prototypes.
  */
 /* Economy. */
-// static double econ_calcJumpR( StarSystem *A, StarSystem *B );
-// static double econ_calcSysI( unsigned int dt, StarSystem *sys, int price );
-// static int econ_createGMatrix (void);
+static double econ_calcJumpR( const StarSystem *A, const StarSystem *B );
+static double econ_calcSysI( const StarSystem *sys, int comm );
+static int    econ_createGMatrix( void );
+static void   econ_createIntensities( void );
+static void   econ_freeMatrices( void );
+static void   econ_loadProduction( xmlNodePtr node );
+static int    econ_saveProduction( xmlTextWriterPtr writer );
 
 /*
  * Externed prototypes.
@@ -96,8 +124,7 @@ credits_t economy_getPrice( const Commodity *com, const StarSystem *sys,
 credits_t economy_getPriceAtTime( const Commodity *com, const StarSystem *sys,
                                   const Spob *p, ntime_t tme )
 {
-   (void)sys;
-   int             i, k;
+   int             i, k, c;
    double          price;
    double          t;
    CommodityPrice *commPrice;
@@ -134,6 +161,7 @@ credits_t economy_getPriceAtTime( const Commodity *com, const StarSystem *sys,
       WARN( _( "Price for commodity '%s' not known." ), com->name );
       return 0;
    }
+   c = i;
 
    /* and get the index on this spob */
    for ( i = 0; i < array_size( p->commodities ); i++ ) {
@@ -147,13 +175,15 @@ credits_t economy_getPriceAtTime( const Commodity *com, const StarSystem *sys,
    }
    commPrice = &p->commodityPrice[i];
    /* Calculate price. */
-   /* price  = (double) com->price; */
-   /* price *= sys->prices[i]; */
    price =
       ( commPrice->price +
         commPrice->sysVariation * sin( 2. * M_PI * t / commPrice->sysPeriod ) +
         commPrice->spobVariation *
            sin( 2. * M_PI * t / commPrice->spobPeriod ) );
+   /* Modify by the state of the dynamic economy, which is only known for the
+    * current time. */
+   if ( ( sys != NULL ) && ( sys->prices != NULL ) && ( tme == ntime_get() ) )
+      price *= sys->prices[c];
    return (credits_t)( price + 0.5 ); /* +0.5 to round */
 }
 
@@ -299,7 +329,6 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean,
    return 0;
 }
 
-#if 0
 /**
  * @brief Calculates the resistance between two star systems.
  *
@@ -307,7 +336,7 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean,
  *    @param B Star system to calculate the resistance between.
  *    @return Resistance between A and B.
  */
-static double econ_calcJumpR( StarSystem *A, StarSystem *B )
+static double econ_calcJumpR( const StarSystem *A, const StarSystem *B )
 {
    double R;
 
@@ -315,14 +344,16 @@ static double econ_calcJumpR( StarSystem *A, StarSystem *B )
    R = ECON_BASE_RES;
 
    /* Modify based on system conditions. */
-   R += (A->nebu_density + B->nebu_density) / 1000.; /* Density shouldn't affect much. */
-   R += (A->nebu_volatility + B->nebu_volatility) / 100.; /* Volatility should. */
+   R += ( A->nebu_density + B->nebu_density ) /
+        1000.; /* Density shouldn't affect much. */
+   R += ( A->nebu_volatility + B->nebu_volatility ) /
+        100.; /* Volatility should. */
 
    /* Modify based on global faction. */
-   if ((A->faction != -1) && (B->faction != -1)) {
-      if (areEnemies(A->faction, B->faction))
+   if ( ( A->faction != -1 ) && ( B->faction != -1 ) ) {
+      if ( areEnemies( A->faction, B->faction ) )
          R += ECON_FACTION_MOD * ECON_BASE_RES;
-      else if (areAllies(A->faction, B->faction))
+      else if ( areAllies( A->faction, B->faction ) )
          R -= ECON_FACTION_MOD * ECON_BASE_RES;
    }
 
@@ -332,103 +363,186 @@ static double econ_calcJumpR( StarSystem *A, StarSystem *B )
 }
 
 /**
- * @brief Calculates the intensity in a system node.
+ * @brief Calculates the base intensity of a commodity in a system node.
+ *
+ * The actual intensity is this times the production factor, which drifts over
+ * time in economy_update.
  *
- * @todo Make it time/item dependent.
+ *    @param sys System to calculate intensity of.
+ *    @param comm Index of the commodity in econ_comm.
+ *    @return The base intensity.
  */
-static double econ_calcSysI( unsigned int dt, StarSystem *sys, int price )
+static double econ_calcSysI( const StarSystem *sys, int comm )
 {
-   int i;
-   double I;
-   double prodfactor, p;
-   double ddt;
-   Spob *spob;
-
-   ddt = (double)(dt / NTIME_UNIT_LENGTH);
-
-   /* Calculate production level. */
-   p = 0.;
-   for (i=0; i<sys->nspobs; i++) {
-      spob = sys->spobs[i];
-      if (spob_hasService(spob, SPOB_SERVICE_INHABITED)) {
-         /*
-          * Calculate production.
-          */
-         /* We base off the current production. */
-         prodfactor  = spob->cur_prodfactor;
-         /* Add a variability factor based on the Gaussian distribution. */
-         prodfactor += ECON_PROD_VAR * RNG_2SIGMA() * ddt;
-         /* Add a tendency to return to the spob's base production. */
-         prodfactor -= ECON_PROD_VAR *
-               (spob->cur_prodfactor - prodfactor)*ddt;
-         /* Save for next iteration. */
-         spob->cur_prodfactor = prodfactor;
-         /* We base off the sqrt of the population otherwise it changes too fast. */
-         p += prodfactor * sqrt(spob->population);
+   const Commodity *com = &commodity_stack[econ_comm[comm]];
+   double           p   = 0.;
+
+   for ( int i = 0; i < array_size( sys->spobs ); i++ ) {
+      const Spob *spob = sys->spobs[i];
+      if ( !spob_hasService( spob, SPOB_SERVICE_INHABITED ) )
+         continue;
+      for ( int j = 0; j < array_size( spob->commodities ); j++ ) {
+         if ( spob->commodities[j] != com )
+            continue;
+         /* We base off the sqrt of the population otherwise it changes too
+          * fast. */
+         p += sqrt( spob->population );
+         break;
       }
    }
 
    /* The intensity is basically the modified production. */
-   I = p / ECON_PROD_MODIFIER;
+   return p / ECON_PROD_MODIFIER;
+}
 
-   return I;
+/**
+ * @brief Adds an entry to a triplet matrix and hashes it (FNV-1a).
+ */
+static void econ_tripletEntry( cholmod_triplet *m, int i, int j, double x,
+                               uint64_t *h )
+{
+   const unsigned char *p;
+   const size_t         n = m->nnz++;
+   ( (int *)m->i )[n]    = i;
+   ( (int *)m->j )[n]    = j;
+   ( (double *)m->x )[n] = x;
+
+   p = (const unsigned char *)&x;
+   for ( size_t k = 0; k < sizeof( x ); k++ )
+      *h = ( *h ^ p[k] ) * 1099511628211ULL;
+   *h = ( *h ^ (uint64_t)i ) * 1099511628211ULL;
+   *h = ( *h ^ (uint64_t)j ) * 1099511628211ULL;
 }
 
 /**
- * @brief Creates the admittance matrix.
+ * @brief Creates the admittance matrix and factorizes it.
+ *
+ * The factorization is only redone when the matrix actually changed, which
+ * for unidiffs means when jumps were added or removed.
  *
  *    @return 0 on success.
  */
-static int econ_createGMatrix (void)
+static int econ_createGMatrix( void )
 {
-   int ret;
-   double R, Rsum;
-   cs *M;
-
-   /* Create the matrix. */
-   M = cs_spalloc( array_size(systems_stack), array_size(systems_stack), 1, 1, 1 );
-   if (M == NULL)
-      WARN(_("Unable to create CSparse Matrix."));
+   int              nsys = array_size( systems_stack );
+   int              nnz  = nsys;
+   uint64_t         h    = 14695981039346656037ULL;
+   cholmod_triplet *M;
+
+   /* Every jump adds an off-diagonal entry and to both diagonals. */
+   for ( int i = 0; i < nsys; i++ )
+      nnz += 3 * array_size( systems_stack[i].jumps );
+
+   /* Create the matrix, only the upper triangle is stored. */
+   M = cholmod_allocate_triplet( nsys, nsys, nnz, 1, CHOLMOD_REAL, &econ_C );
+   if ( M == NULL ) {
+      WARN( _( "Unable to create CHOLMOD Matrix." ) );
+      return -1;
+   }
 
    /* Fill the matrix. */
-   for (int i=0; i < array_size(systems_stack); i++) {
-      StarSystem *sys   = &systems_stack[i];
-      Rsum = 0.;
-
-      /* Set some values. */
-      for (int j=0; j < array_size(sys->jumps); j++) {
-
-         /* Get the resistances. */
-         R     = econ_calcJumpR( sys, sys->jumps[j].target );
-         R     = 1./R; /* Must be inverted. */
-         Rsum += R;
-
-         /* Matrix is symmetrical and non-diagonal is negative. */
-         ret = cs_entry( M, i, sys->jumps[j].target->id, -R );
-         if (ret != 1)
-            WARN(_("Unable to enter CSparse Matrix Cell."));
-         ret = cs_entry( M, sys->jumps[j].target->id, i, -R );
-         if (ret != 1)
-            WARN(_("Unable to enter CSparse Matrix Cell."));
+   for ( int i = 0; i < nsys; i++ ) {
+      const StarSystem *sys = &systems_stack[i];
+
+      for ( int j = 0; j < array_size( sys->jumps ); j++ ) {
+         int t = sys->jumps[j].targetid;
+         /* Each direction carries half the conductance, so the matrix stays
+          * symmetric even with one-way jumps. */
+         double R = 0.5 / econ_calcJumpR( sys, sys->jumps[j].target );
+         if ( t == i )
+            continue;
+         econ_tripletEntry( M, MIN( i, t ), MAX( i, t ), -R, &h );
+         econ_tripletEntry( M, i, i, R, &h );
+         econ_tripletEntry( M, t, t, R, &h );
       }
 
-      /* Set the diagonal. */
-      Rsum += 1./ECON_SELF_RES; /* We add a resistance for dampening. */
-      cs_entry( M, i, i, Rsum );
+      /* We add a resistance for dampening. */
+      econ_tripletEntry( M, i, i, 1. / ECON_SELF_RES, &h );
+   }
+
+   /* Nothing changed, keep the factorization. */
+   if ( ( econ_L != NULL ) && ( h == econ_G_hash ) ) {
+      cholmod_free_triplet( &M, &econ_C );
+      return 0;
    }
 
    /* Compress M matrix and put into G. */
-   cs_spfree( econ_G );
-   econ_G = cs_compress( M );
-   if (econ_G == NULL)
-      WARN(_("Unable to create economy G Matrix."));
+   econ_freeMatrices();
+   econ_G = cholmod_triplet_to_sparse( M, nnz, &econ_C );
+   cholmod_free_triplet( &M, &econ_C );
+   if ( econ_G == NULL ) {
+      WARN( _( "Unable to create economy G Matrix." ) );
+      return -1;
+   }
 
-   /* Clean up. */
-   cs_spfree(M);
+   /* The self resistance makes it strictly diagonally dominant, so Cholesky
+    * always works. */
+   econ_L = cholmod_analyze( econ_G, &econ_C );
+   if ( ( econ_L == NULL ) || !cholmod_factorize( econ_G, econ_L, &econ_C ) ||
+        ( econ_C.status != CHOLMOD_OK ) ) {
+      WARN( _( "Unable to factorize economy G Matrix." ) );
+      econ_freeMatrices();
+      return -1;
+   }
+   econ_G_hash = h;
 
    return 0;
 }
-#endif
+
+/**
+ * @brief Computes the base intensities and the potentials they create.
+ */
+static void econ_createIntensities( void )
+{
+   int     nsys  = array_size( systems_stack );
+   int     ncomm = array_size( econ_comm );
+   double *I0;
+
+   /* New systems need prices too. */
+   for ( int i = 0; i < nsys; i++ ) {
+      if ( systems_stack[i].prices != NULL )
+         continue;
+      systems_stack[i].prices = malloc( MAX( ncomm, 1 ) * sizeof( double ) );
+      for ( int j = 0; j < ncomm; j++ )
+         systems_stack[i].prices[j] = 1.;
+   }
+
+   if ( ( econ_L == NULL ) || ( ncomm == 0 ) )
+      return;
+
+   /* Production state only survives if the universe keeps its shape. */
+   if ( ( econ_I0 == NULL ) || ( (int)econ_I0->nrow != nsys ) ) {
+      cholmod_free_dense( &econ_I0, &econ_C );
+      cholmod_free_dense( &econ_D, &econ_C );
+      econ_I0 = cholmod_zeros( nsys, ncomm, CHOLMOD_REAL, &econ_C );
+      econ_D  = cholmod_zeros( nsys, ncomm, CHOLMOD_REAL, &econ_C );
+      free( econ_prod );
+      econ_prod = malloc( nsys * ncomm * sizeof( double ) );
+      for ( int k = 0; k < nsys * ncomm; k++ )
+         econ_prod[k] = 1.;
+   }
+
+   /* Column-major, one column per commodity. */
+   I0 = econ_I0->x;
+   for ( int j = 0; j < ncomm; j++ )
+      for ( int i = 0; i < nsys; i++ )
+         I0[i + j * nsys] = econ_calcSysI( &systems_stack[i], j );
+
+   cholmod_solve2( CHOLMOD_A, econ_L, econ_I0, NULL, &econ_X0, NULL, &econ_Yw,
+                   &econ_Ew, &econ_C );
+}
+
+/**
+ * @brief Frees the matrices that depend on the universe topology.
+ */
+static void econ_freeMatrices( void )
+{
+   cholmod_free_factor( &econ_L, &econ_C );
+   cholmod_free_sparse( &econ_G, &econ_C );
+   cholmod_free_dense( &econ_X0, &econ_C );
+   cholmod_free_dense( &econ_Y, &econ_C );
+   econ_G_hash = 0;
+}
 
 /**
  * @brief Initializes the economy.
@@ -441,11 +555,12 @@ int economy_init( void )
    if ( econ_initialized )
       return 0;
 
-   /* Allocate price space. */
+   cholmod_start( &econ_C );
+
+   /* Prices get allocated when refreshing. */
    for ( int i = 0; i < array_size( systems_stack ); i++ ) {
       free( systems_stack[i].prices );
-      systems_stack[i].prices =
-         calloc( array_size( econ_comm ), sizeof( double ) );
+      systems_stack[i].prices = NULL;
    }
 
    /* Mark economy as initialized. */
@@ -489,8 +604,9 @@ int economy_refresh( void )
       return 0;
 
    /* Create the resistance matrix. */
-   // if (econ_createGMatrix())
-   //    return -1;
+   if ( econ_createGMatrix() )
+      return -1;
+   econ_createIntensities();
 
    /* Initialize the prices. */
    economy_update( 0 );
@@ -501,79 +617,79 @@ int economy_refresh( void )
 /**
  * @brief Updates the economy.
  *
+ * Production drifts randomly around its base, and the resulting deviation of
+ * the intensities is solved for all commodities at once with the cached
+ * factorization. Prices go down where the potential is above its base, and up
+ * where it is below.
+ *
+ * Time is accumulated and production only steps every ECON_STEP game seconds,
+ * the step being exact for the whole accumulated time. A dt of 0 recomputes
+ * the prices without stepping.
+ *
  *    @param dt Deltatick in NTIME.
  */
 int economy_update( unsigned int dt )
 {
-   (void)dt;
-#if 0
-   int i, j;
-   double *X;
-   double scale, offset;
-   /*double min, max;*/
+   int     nsys, ncomm;
+   double  decay, noise, step;
+   double *I0, *D, *X0, *Y;
 
    /* Economy must be initialized. */
-   if (econ_initialized == 0)
+   if ( ( econ_initialized == 0 ) || ( econ_L == NULL ) ||
+        ( econ_I0 == NULL ) ) {
+      econ_queued = 0;
       return 0;
-
-   /* Create the vector to solve the system. */
-   X = malloc(sizeof(double)*array_size(systems_stack));
-   if (X == NULL) {
-      WARN(_("Out of Memory"));
-      return -1;
    }
 
-   /* Calculate the results for each price set. */
-   for (j=0; j<array_size(econ_comm); j++) {
-
-      /* First we must load the vector with intensities. */
-      for (i=0; i<array_size(systems_stack); i++)
-         X[i] = econ_calcSysI( dt, &systems_stack[i], j );
-
-      /* Solve the system. */
-      /** @TODO This should be improved to try to use better factorizations (LU/Cholesky)
-       * if possible or just outright try to use some other library that does fancy stuff
-       * like UMFPACK. Would be also interesting to see if it could be optimized so we
-       * store the factorization or update that instead of handling it individually. Another
-       * point of interest would be to split loops out to make the solving faster, however,
-       * this may be trickier to do (although it would surely let us use cholesky always if we
-       * enforce that condition). */
-      ret = cs_qrsol( 3, econ_G, X );
-      if (ret != 1)
-         WARN(_("Failed to solve the Economy System."));
-
-      /*
-       * Get the minimum and maximum to scale.
-       */
-      /*
-      min = +HUGE_VALF;
-      max = -HUGE_VALF;
-      for (i=0; i<array_size(systems_stack); i++) {
-         if (X[i] < min)
-            min = X[i];
-         if (X[i] > max)
-            max = X[i];
+   /* Wait until enough time has passed. */
+   econ_dt += ntime_convertSeconds( dt );
+   if ( ( dt > 0 ) && ( econ_dt < ECON_STEP ) )
+      return 0;
+   step    = ( dt > 0 ) ? econ_dt : 0.;
+   econ_dt = ( dt > 0 ) ? 0. : econ_dt;
+
+   NTracingZone( _ctx, 1 );
+
+   /* Let production drift back towards its base, exactly for any step. */
+   nsys  = econ_I0->nrow;
+   ncomm = econ_I0->ncol;
+   decay = exp( -ECON_PROD_REVERT * step / NT_PERIOD_SECONDS );
+   noise = ECON_PROD_VAR * sqrt( 1. - decay * decay );
+   I0    = econ_I0->x;
+   D     = econ_D->x;
+   for ( int k = 0; k < nsys * ncomm; k++ ) {
+      if ( I0[k] <= 0. )
+         continue;
+      if ( step > 0. ) {
+         double p     = 1. + ( econ_prod[k] - 1. ) * decay;
+         econ_prod[k] = MAX( 0., p + noise * RNG_2SIGMA() );
       }
-      scale = 1. / (max - min);
-      offset = 0.5 - min * scale;
-      */
-
-      /*
-       * I'm not sure I like the filtering of the results, but it would take
-       * much more work to get a good system working without the need of post
-       * filtering.
-       */
-      scale    = 1.;
-      offset   = 1.;
-      for (i=0; i<array_size(systems_stack); i++)
-         systems_stack[i].prices[j] = X[i] * scale + offset;
+      D[k] = I0[k] * ( econ_prod[k] - 1. );
    }
 
-   /* Clean up. */
-   free(X);
+   /* Solve the system, reusing the workspaces. */
+   if ( !cholmod_solve2( CHOLMOD_A, econ_L, econ_D, NULL, &econ_Y, NULL,
+                         &econ_Yw, &econ_Ew, &econ_C ) ) {
+      WARN( _( "Failed to solve the Economy System." ) );
+      NTracingZoneEnd( _ctx );
+      return -1;
+   }
+
+   /* Relative deviation from the base gives the price modifier. */
+   X0 = econ_X0->x;
+   Y  = econ_Y->x;
+   for ( int j = 0; j < ncomm; j++ )
+      for ( int i = 0; i < nsys; i++ ) {
+         int k = i + j * nsys;
+         systems_stack[i].prices[j] =
+            ( X0[k] > DOUBLE_TOL )
+               ? CLAMP( ECON_PRICE_MIN, ECON_PRICE_MAX,
+                        1. - ECON_PRICE_MOD * Y[k] / X0[k] )
+               : 1.;
+      }
 
-#endif
    econ_queued = 0;
+   NTracingZoneEnd( _ctx );
    return 0;
 }
 
@@ -592,9 +708,15 @@ void economy_destroy( void )
       systems_stack[i].prices = NULL;
    }
 
-   /* Destroy the economy matrix. */
-   cs_spfree( econ_G );
-   econ_G = NULL;
+   /* Destroy the economy matrices. */
+   econ_freeMatrices();
+   cholmod_free_dense( &econ_I0, &econ_C );
+   cholmod_free_dense( &econ_D, &econ_C );
+   cholmod_free_dense( &econ_Yw, &econ_C );
+   cholmod_free_dense( &econ_Ew, &econ_C );
+   free( econ_prod );
+   econ_prod = NULL;
+   cholmod_finish( &econ_C );
 
    /* Economy is now deinitialized. */
    econ_initialized = 0;
@@ -1022,6 +1144,12 @@ int economy_sysLoad( xmlNodePtr parent )
 
    economy_clearKnown();
 
+   /* Production not in the save is at its base. */
+   econ_dt = 0.;
+   if ( ( econ_prod != NULL ) && ( econ_I0 != NULL ) )
+      for ( size_t k = 0; k < econ_I0->nrow * econ_I0->ncol; k++ )
+         econ_prod[k] = 1.;
+
    do {
       if ( xml_isNode( node, "economy" ) ) {
          xmlNodePtr cur = node->xmlChildrenNode;
@@ -1078,10 +1206,101 @@ int economy_sysLoad( xmlNodePtr parent )
                   c->lastPurchasePrice = xml_getLong( cur );
                   free( str );
                }
-            }
+            } else if ( xml_isNode( cur, "production" ) )
+               econ_loadProduction( cur );
          } while ( xml_nextNode( cur ) );
       }
    } while ( xml_nextNode( node ) );
+
+   /* Prices follow from the loaded production. */
+   economy_update( 0 );
+   return 0;
+}
+
+/**
+ * @brief Loads the production state of a system.
+ *
+ *    @param node Production node of the system.
+ */
+static void econ_loadProduction( xmlNodePtr node )
+{
+   StarSystem *sys;
+   xmlNodePtr  cur;
+   char       *str;
+   int         nsys;
+
+   if ( ( econ_prod == NULL ) || ( econ_I0 == NULL ) )
+      return;
+   nsys = econ_I0->nrow;
+
+   xmlr_attr_strd( node, "system", str );
+   sys = system_get( str );
+   free( str );
+   if ( ( sys == NULL ) || ( sys - systems_stack >= nsys ) )
+      return;
+
+   cur = node->xmlChildrenNode;
+   do {
+      const Commodity *c;
+      int              j;
+
+      xml_onlyNodes( cur );
+      if ( !xml_isNode( cur, "commodity" ) )
+         continue;
+      xmlr_attr_strd( cur, "name", str );
+      c = ( str == NULL ) ? NULL : commodity_getW( str );
+      free( str );
+      if ( c == NULL )
+         continue;
+      for ( j = 0; j < (int)econ_I0->ncol; j++ )
+         if ( econ_comm[j] == c - commodity_stack )
+            break;
+      if ( j >= (int)econ_I0->ncol )
+         continue;
+      econ_prod[( sys - systems_stack ) + j * nsys] =
+         MAX( 0., xml_getFloat( cur ) );
+   } while ( xml_nextNode( cur ) );
+}
+
+/**
+ * @brief Saves the production state of the dynamic economy.
+ *
+ * Only production that is away from its base is saved.
+ *
+ *    @param writer XML writer to use.
+ *    @return 0 on success.
+ */
+static int econ_saveProduction( xmlTextWriterPtr writer )
+{
+   const double *I0;
+   int           nsys, ncomm;
+
+   if ( ( econ_prod == NULL ) || ( econ_I0 == NULL ) )
+      return 0;
+   nsys  = econ_I0->nrow;
+   ncomm = econ_I0->ncol;
+   I0    = econ_I0->x;
+
+   for ( int i = 0; i < nsys; i++ ) {
+      int done = 0;
+      for ( int j = 0; j < ncomm; j++ ) {
+         int k = i + j * nsys;
+         if ( ( I0[k] <= 0. ) || ( econ_prod[k] == 1. ) )
+            continue;
+         if ( !done ) {
+            done = 1;
+            xmlw_startElem( writer, "production" );
+            xmlw_attr( writer, "system", "%s", systems_stack[i].name );
+         }
+         xmlw_startElem( writer, "commodity" );
+         xmlw_attr( writer, "name", "%s",
+                    commodity_stack[econ_comm[j]].name );
+         xmlw_str( writer, "%.17g", econ_prod[k] );
+         xmlw_endElem( writer ); /* commodity */
+      }
+      if ( done )
+         xmlw_endElem( writer ); /* production */
+   }
    return 0;
 }
 
@@ -1103,6 +1322,8 @@ int economy_sysSave( xmlTextWriterPtr writer )
          xmlw_endElem( writer );
       }
    }
+   if ( econ_saveProduction( writer ) < 0 )
+      return -1;
    for ( int i = 0; i < array_size( systems_stack ); i++ ) {
       int         doneSys = 0;
       StarSystem *sys     = &systems_stack[i];
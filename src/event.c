@@ -41,6 +41,7 @@
 #include "nxml_lua.h"
 #include "player.h"
 #include "rng.h"
+#include "threadpool.h"
 
 #define XML_EVENT_ID "Events" /**< XML document identifier */
 #define XML_EVENT_TAG "event" /**< XML event tag. */
@@ -74,6 +75,15 @@ typedef struct EventData_ {
    char **tags; /**< Tags. */
 } EventData;
 
+/**
+ * @brief An event file that has been read and had its XML header parsed.
+ */
+typedef struct EventFile_ {
+   const char *file;    /**< Source file path. */
+   char       *filebuf; /**< Contents of the file. */
+   xmlDocPtr   doc;     /**< Parsed XML header, NULL if not an event. */
+} EventFile;
+
 /*
  * Event data.
  */
@@ -91,6 +101,9 @@ static Event_t     *event_active = NULL; /**< Active events. */
 static unsigned int event_genID( void );
 static int          event_cmp( const void *a, const void *b );
 static int          event_parseFile( const char *file, EventData *temp );
+static int          event_readFile( EventFile *ef );
+static void         event_readRange( int start, int end, void *data );
+static int          event_loadFile( EventFile *ef, EventData *temp );
 static int          event_parseXML( EventData *temp, const xmlNodePtr parent );
 static void         event_freeData( EventData *event );
 static int          event_create( int dataid, unsigned int *id );
@@ -580,14 +593,22 @@ int events_load( void )
 #if DEBUGGING
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
-   char **event_files = ndata_listRecursive( EVENT_DATA_PATH );
+   char     **event_files = ndata_listRecursive( EVENT_DATA_PATH );
+   EventFile *efs = calloc( array_size( event_files ), sizeof( EventFile ) );
 
-   /* Run over events. */
+   /* Read and parse the headers in parallel. */
+   for ( int i = 0; i < array_size( event_files ); i++ )
+      efs[i].file = event_files[i];
+   job_parallelFor( array_size( event_files ), 1, event_readRange, efs );
+
+   /* Run over events, Lua has to be done in order. */
    event_data = array_create_size( EventData, array_size( event_files ) );
    for ( int i = 0; i < array_size( event_files ); i++ ) {
-      event_parseFile( event_files[i], NULL );
+      if ( efs[i].doc != NULL )
+         event_loadFile( &efs[i], NULL );
       free( event_files[i] );
    }
+   free( efs );
    array_free( event_files );
    array_shrink( &event_data );
 
@@ -627,62 +648,105 @@ int events_load( void )
  *    @param temp Data to load into, or NULL for initial load.
  */
 static int event_parseFile( const char *file, EventData *temp )
+{
+   EventFile ef = { .file = file };
+   if ( event_readFile( &ef ) )
+      return -1;
+   return event_loadFile( &ef, temp );
+}
+
+/**
+ * @brief Reads an event file and parses its XML header.
+ *
+ * Doesn't touch any global state, so it can be run from other threads.
+ *
+ *    @param ef Event file to read, only file has to be set.
+ *    @return 0 on success.
+ */
+static int event_readFile( EventFile *ef )
 {
    size_t      bufsize;
-   xmlNodePtr  node;
-   xmlDocPtr   doc;
-   char       *filebuf;
    const char *pos, *start_pos;
-   int         ret;
+   const char *file = ef->file;
 
    /* Load string. */
-   filebuf = ndata_read( file, &bufsize );
-   if ( filebuf == NULL ) {
+   ef->filebuf = ndata_read( file, &bufsize );
+   if ( ef->filebuf == NULL ) {
       WARN( _( "Unable to read data from '%s'" ), file );
       return -1;
    }
-   if ( bufsize == 0 ) {
-      free( filebuf );
-      return -1;
-   }
+   if ( bufsize == 0 )
+      goto err;
 
    /* Skip if no XML. */
-   pos = strnstr( filebuf, "</event>", bufsize );
+   pos = strnstr( ef->filebuf, "</event>", bufsize );
    if ( pos == NULL ) {
-      pos = strnstr( filebuf, "function create", bufsize );
+      pos = strnstr( ef->filebuf, "function create", bufsize );
       if ( ( pos != NULL ) && !strncmp( pos, "--common", bufsize ) )
          WARN( _( "Event '%s' has create function but no XML header!" ), file );
-      free( filebuf );
-      return 0;
+      goto err;
    }
 
    /* Separate XML header and Lua. */
-   start_pos = strnstr( filebuf, "<?xml ", bufsize );
-   pos       = strnstr( filebuf, "--]]", bufsize );
+   start_pos = strnstr( ef->filebuf, "<?xml ", bufsize );
+   pos       = strnstr( ef->filebuf, "--]]", bufsize );
    if ( pos == NULL || start_pos == NULL ) {
       WARN( _( "Event file '%s' has missing XML header!" ), file );
-      return -1;
+      goto err;
    }
 
    /* Parse the header. */
-   doc = xmlParseMemory( start_pos, pos - start_pos );
-   if ( doc == NULL ) {
+   ef->doc = xmlParseMemory( start_pos, pos - start_pos );
+   if ( ef->doc == NULL ) {
       WARN( _( "Unable to parse document XML header for Event '%s'" ), file );
-      return -1;
+      goto err;
    }
 
+   return 0;
+
+err:
+   free( ef->filebuf );
+   ef->filebuf = NULL;
+   return -1;
+}
+
+/**
+ * @brief Reads a range of event files for job_parallelFor.
+ */
+static void event_readRange( int start, int end, void *data )
+{
+   EventFile *efs = data;
+   for ( int i = start; i < end; i++ )
+      event_readFile( &efs[i] );
+}
+
+/**
+ * @brief Sets up an event from a read event file.
+ *
+ *    @param ef Event file that was read, gets cleaned up.
+ *    @param temp Data to load into, or NULL for initial load.
+ *    @return 0 on success.
+ */
+static int event_loadFile( EventFile *ef, EventData *temp )
+{
+   xmlNodePtr  node;
+   const char *file = ef->file;
+   int         ret;
+
    /* Get the root node. */
-   node = doc->xmlChildrenNode;
+   node = ef->doc->xmlChildrenNode;
    if ( !xml_isNode( node, XML_EVENT_TAG ) ) {
       WARN( _( "Malformed '%s' file: missing root element '%s'" ), file,
             XML_EVENT_TAG );
+      xmlFreeDoc( ef->doc );
+      free( ef->filebuf );
       return -1;
    }
 
    if ( temp == NULL )
       temp = &array_grow( &event_data );
    event_parseXML( temp, node );
-   temp->lua        = strdup( filebuf );
+   temp->lua        = ef->filebuf;
    temp->sourcefile = strdup( file );
 
    /* Clear chunk if already loaded. */
@@ -692,7 +756,7 @@ static int event_parseFile( const char *file, EventData *temp )
    }
 
    /* Check to see if syntax is valid. */
-   ret = luaL_loadbuffer( naevL, temp->lua, strlen( temp->lua ), temp->name );
+   ret = nlua_loadbuffer( naevL, temp->lua, strlen( temp->lua ), temp->name );
    if ( ret == LUA_ERRSYNTAX )
       WARN( _( "Event Lua '%s' syntax error: %s" ), file,
             lua_tostring( naevL, -1 ) );
@@ -700,8 +764,7 @@ static int event_parseFile( const char *file, EventData *temp )
       temp->chunk = luaL_ref( naevL, LUA_REGISTRYINDEX );
 
    /* Clean up. */
-   xmlFreeDoc( doc );
-   free( filebuf );
+   xmlFreeDoc( ef->doc );
 
    return 0;
 }
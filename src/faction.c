@@ -140,8 +140,8 @@ static void   faction_sanitizePlayer( Faction *faction );
 static double faction_hitLua( int f, const StarSystem *sys, double mod,
                               const char *source, int secondary,
                               int primary_faction );
-static int    faction_parse( Faction *temp, const char *file );
-static int    faction_parseSocial( const char *file );
+static int    faction_parse( Faction *temp, const char *file, xmlDocPtr doc );
+static int    faction_parseSocial( const char *file, xmlDocPtr doc );
 static void faction_addStandingScript( Faction *temp, const char *scriptname );
 static void faction_computeGrid( void );
 /* externed */
@@ -1550,14 +1550,14 @@ int faction_isFaction( int f )
  *
  *    @param temp Faction to load data into.
  *    @param file File to parse.
+ *    @param doc Parsed document of the file.
  *    @return Faction created from parent node.
  */
-static int faction_parse( Faction *temp, const char *file )
+static int faction_parse( Faction *temp, const char *file, xmlDocPtr doc )
 {
    xmlNodePtr node, parent;
    int        saw_player;
 
-   xmlDocPtr doc = xml_parsePhysFS( file );
    if ( doc == NULL )
       return -1;
 
@@ -1700,8 +1700,6 @@ static int faction_parse( Faction *temp, const char *file )
       WARN( _( "Faction '%s' is known but missing 'description' tag." ),
             temp->name );
 
-   xmlFreeDoc( doc );
-
    return 0;
 }
 
@@ -1754,15 +1752,15 @@ static void faction_addStandingScript( Faction *temp, const char *scriptname )
  * @brief Parses the social tidbits of a faction: allies and enemies.
  *
  *    @param file File to parse.
+ *    @param doc Parsed document of the file.
  *    @return 0 on success.
  */
-static int faction_parseSocial( const char *file )
+static int faction_parseSocial( const char *file, xmlDocPtr doc )
 {
    char      *name;
    xmlNodePtr node, parent;
    Faction   *base;
 
-   xmlDocPtr doc = xml_parsePhysFS( file );
    if ( doc == NULL )
       return -1;
 
@@ -1850,7 +1848,6 @@ static int faction_parseSocial( const char *file )
       }
    } while ( xml_nextNode( node ) );
 
-   xmlFreeDoc( doc );
    return 0;
 }
 
@@ -1998,8 +1995,9 @@ int factions_load( void )
 #if DEBUGGING
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
-   Faction *f;
-   char   **faction_files = ndata_listRecursive( FACTION_DATA_PATH );
+   Faction   *f;
+   char     **faction_files = ndata_listRecursive( FACTION_DATA_PATH );
+   xmlDocPtr *faction_docs  = xml_parsePhysFSAll( faction_files );
 
    /* player faction is hard-coded */
    faction_stack = array_create( Faction );
@@ -2021,8 +2019,9 @@ int factions_load( void )
    /* Add the base factions. */
    for ( int i = 0; i < array_size( faction_files ); i++ ) {
       if ( ndata_matchExt( faction_files[i], "xml" ) ) {
-         Faction nf;
-         int     ret = faction_parse( &nf, faction_files[i] );
+         Faction   nf;
+         xmlDocPtr doc = faction_docs[i];
+         int       ret = faction_parse( &nf, faction_files[i], doc );
          if ( ret == 0 ) {
             nf.oflags = nf.flags;
             array_push_back( &faction_stack, nf );
@@ -2041,7 +2040,7 @@ int factions_load( void )
    /* Second pass - sets allies and enemies */
    for ( int i = 0; i < array_size( faction_files ); i++ ) {
       if ( ndata_matchExt( faction_files[i], "xml" ) ) {
-         faction_parseSocial( faction_files[i] );
+         faction_parseSocial( faction_files[i], faction_docs[i] );
       }
    }
 
@@ -2080,6 +2079,7 @@ int factions_load( void )
    }
 
    /* Clean up stuff. */
+   xml_freeAll( faction_docs );
    for ( int i = 0; i < array_size( faction_files ); i++ )
       free( faction_files[i] );
    array_free( faction_files );
@@ -9,6 +9,14 @@
  * We use distance fields [1] to render high quality fonts with the help of
  * some shaders. Characters are generated on demand using a texture atlas.
  *
+ * Text is laid out into runs of glyph quads with the kerning and colour
+ * escapes already resolved. Runs are kept in a small LRU cache, so text that
+ * is drawn every frame only costs one draw call per atlas texture.
+ *
+ * Generated glyphs are also kept in a cache file per font stash, so they only
+ * have to be computed once. Text can be prefetched ahead of drawing, in which
+ * case the distance fields of all the missing glyphs are computed in parallel.
+ *
  * [1]:
  * https://steamcdn-a.akamaihd.net/apps/valve/2007/SIGGRAPH2007_AlphaTestedMagnification.pdf
  */
@@ -29,8 +37,11 @@
 #include "array.h"
 #include "distance_field.h"
 #include "log.h"
+#include "md5.h"
 #include "ndata.h"
+#include "nfile.h"
 #include "ntracing.h"
+#include "threadpool.h"
 #include "utf8.h"
 
 #define MAX_EFFECT_RADIUS                                                      \
@@ -40,12 +51,15 @@
 #define DEFAULT_TEXTURE_SIZE                                                   \
    1024             /**< Default size of texture caches for glyphs. */
 #define MAX_ROWS 64 /**< Max number of rows per texture cache. */
+#define FONT_RUN_CACHE_SIZE 512 /**< Maximum number of cached text runs. */
+#define FONT_RUN_LUT_SIZE 1024  /**< Size of text run look up table. */
+#define FONT_CACHE_MAGIC "NAEVSDF" /**< Magic of the glyph cache files. */
+#define FONT_CACHE_VERSION 1       /**< Bump when glyph generation changes. */
 
 /**
  * OpenGL rendering stuff. Since we can't actually render with multiple threads
  * we can be lazy and use global variables.
  */
-static mat4       font_projection_mat; /**< Projection matrix. */
 static FT_Library font_library = NULL; /**< Global FreeType library. */
 static FT_UInt
    prev_glyph_index; /**< Index of last character drawn (for kerning). */
@@ -87,6 +101,7 @@ typedef struct glFontGlyph_s {
 typedef struct font_char_s {
    GLubyte *data;     /**< Data of the character. */
    GLfloat *dataf;    /**< Float data of the character. */
+   GLubyte *raster;   /**< Bordered glyph waiting for its distance field. */
    int      w;        /**< Width. */
    int      h;        /**< Height. */
    int      ft_index; /**< HACK: Index into the array of fallback fonts. */
@@ -107,10 +122,35 @@ typedef struct font_char_s {
 typedef struct glFontFile_s {
    char    *name;     /**< Font file name. */
    int      refcount; /**< Reference counting. */
-   FT_Byte *data;     /**< Font data buffer. */
-   size_t   datasize; /**< Font data size. */
+   FT_Byte   *data;       /**< Font data buffer. */
+   size_t     datasize;   /**< Font data size. */
+   md5_byte_t digest[16]; /**< Hash of the font data. */
 } glFontFile;
 
+/**
+ * @brief Glyph record in a glyph cache file, followed by its data padded to 4
+ * bytes.
+ */
+typedef struct glFontCacheRecord_s {
+   uint32_t codepoint; /**< Real character. */
+   int32_t  ft_index;  /**< Index into the array of fallback fonts. */
+   int32_t  w;         /**< Width. */
+   int32_t  h;         /**< Height. */
+   int32_t  off_x;     /**< X offset when rendering. */
+   int32_t  off_y;     /**< Y offset when rendering. */
+   float    adv_x;     /**< X advancement on the screen. */
+   float    m;         /**< Distance units corresponding to 1 "pixel". */
+   int32_t  isfloat;   /**< Whether the data is float instead of byte. */
+} glFontCacheRecord;
+
+/**
+ * @brief Glyph found in a glyph cache file.
+ */
+typedef struct glFontCached_s {
+   uint32_t codepoint; /**< Real character. */
+   size_t   offset;    /**< Offset of the record in the cache file. */
+} glFontCached;
+
 /**
  * @brief Freetype Font structure.
  */
@@ -133,10 +173,8 @@ typedef struct glFontStash_s {
    int          tw;            /**< Width of textures. */
    int          th;            /**< Height of textures. */
    glFontTex   *tex;           /**< Textures. */
-   gl_vbo      *vbo_tex;       /**< VBO associated to texture coordinates. */
-   gl_vbo      *vbo_vert;      /**< VBO associated to vertex coordinates. */
-   GLfloat     *vbo_tex_data;  /**< Copy of texture coordinate data. */
-   GLshort     *vbo_vert_data; /**< Copy of vertex coordinate data. */
+   GLfloat     *vbo_tex_data;  /**< Texture coordinates of the glyphs. */
+   GLshort     *vbo_vert_data; /**< Vertex coordinates of the glyphs. */
    int          nvbo;          /**< Amount of vbo data. */
    int          mvbo;          /**< Amount of vbo memory. */
    glFontGlyph *glyphs;        /**< Unicode glyphs. */
@@ -145,9 +183,56 @@ typedef struct glFontStash_s {
    /* Freetype stuff. */
    glFontStashFreetype *ft;
 
+   /* Glyph disk cache. */
+   int           cache_loaded; /**< Whether the cache file was looked up. */
+   char         *cache_path;   /**< Cache file, NULL if unavailable. */
+   char         *cache_data;   /**< Contents of the cache file. */
+   glFontCached *cache_glyphs; /**< Cached glyphs, sorted by codepoint. */
+
    int refcount; /**< Reference counting. */
 } glFontStash;
 
+/**
+ * @brief Vertex of a laid out text run.
+ */
+typedef struct glFontVertex_s {
+   GLfloat x;      /**< X position in distance field units. */
+   GLfloat y;      /**< Y position in distance field units. */
+   GLfloat tx;     /**< X texture coordinate. */
+   GLfloat ty;     /**< Y texture coordinate. */
+   GLfloat m;      /**< Distance units corresponding to 1 "pixel". */
+   GLfloat col[4]; /**< Escape colour, alpha is 0 to use the base colour. */
+} glFontVertex;
+
+/**
+ * @brief Glyphs of a text run that are on the same texture.
+ */
+typedef struct glFontRunDraw_s {
+   int tex_index; /**< Texture of the glyphs. */
+   int first;     /**< First vertex. */
+   int count;     /**< Number of vertices. */
+} glFontRunDraw;
+
+/**
+ * @brief A piece of text laid out with a font, cached until it gets evicted.
+ */
+typedef struct glFontRun_s {
+   int             stsh;    /**< Font stash id. */
+   char           *text;    /**< Text that was laid out. */
+   size_t          len;     /**< Length of the text in bytes. */
+   const glColour *start;   /**< Restored colour at start, NULL if base. */
+   uint32_t        hash;    /**< Hash of the font, text and colour. */
+   glFontVertex   *verts;   /**< Vertices, grouped by texture. */
+   gl_vbo         *vbo;     /**< Own VBO once drawn on more than one frame. */
+   unsigned int    frame;   /**< Frame the run was last drawn on. */
+   glFontRunDraw  *draws;   /**< One draw per texture. */
+   int             escaped; /**< Whether the text has colour escapes. */
+   const glColour *last;    /**< Colour of the last escape. */
+   int             next;    /**< Next run in the look up table. */
+   int             newer;   /**< Next more recently used run. */
+   int             older;   /**< Next less recently used run. */
+} glFontRun;
+
 /**
  * Available fonts stashes.
  */
@@ -164,6 +249,20 @@ static const glColour *font_lastCol =
    NULL; /**< Stores last colour used (activated by FONT_COLOUR_CODE). */
 static int font_restoreLast = 0; /**< Restore last colour. */
 
+/* Text run cache. */
+static glFontRun font_runs[FONT_RUN_CACHE_SIZE]; /**< Cached text runs. */
+static int       font_runLut[FONT_RUN_LUT_SIZE]; /**< Look up table of runs. */
+static int       font_nruns     = 0;             /**< Run slots used so far. */
+static int       font_runNewest = -1;            /**< Most recently used run. */
+static int       font_runOldest = -1;            /**< Least recently used. */
+static int       font_runUnused = -1;            /**< Freed run slots. */
+
+static glFontVertex *font_runVerts  = NULL; /**< Layout scratch vertices. */
+static glFontVertex *font_runSorted = NULL; /**< Vertices grouped by texture. */
+static int          *font_runTex    = NULL; /**< Texture of each quad. */
+static gl_vbo       *font_runVBO    = NULL; /**< Shared VBO of one-off runs. */
+static unsigned int  font_frame     = 1;    /**< Current frame, 0 is never. */
+
 /*
  * prototypes
  */
@@ -174,20 +273,39 @@ static size_t font_limitSize( glFontStash *stsh, int *width, const char *text,
 static const glColour *gl_fontGetColour( uint32_t ch );
 static uint32_t        font_nextChar( const char *s, size_t *i );
 /* Get unicode glyphs from cache. */
+static glFontGlyph *gl_fontFindGlyph( glFontStash *stsh, uint32_t ch );
+static glFontGlyph *gl_fontAddGlyph( glFontStash *stsh, uint32_t ch,
+                                     const font_char_t *ft_char );
 static glFontGlyph *gl_fontGetGlyph( glFontStash *stsh, uint32_t ch );
-/* Render.
- * TODO this should be changed to be more like font-stash
- * (https://github.com/akrinke/Font-Stash) In particular, instead of writing
- * char by char, they should be batched up by textures and rendered when
- * gl_fontRenderEnd() is called, saving lots of opengl calls.
- */
-static void gl_fontRenderStart( const glFontStash *stsh, double x, double y,
-                                const glColour *c, double outlineR );
-static void gl_fontRenderStartH( const glFontStash *stsh, const mat4 *H,
-                                 const glColour *c, double outlineR );
-static int  gl_fontRenderGlyph( glFontStash *stsh, uint32_t ch,
-                                const glColour *c, int state );
-static void gl_fontRenderEnd( void );
+static void         gl_fontPrefetchStash( glFontStash *stsh, const char *text );
+/* Glyph generation. */
+static int  font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch );
+static int  font_rasterChar( glFontStash *stsh, font_char_t *c, uint32_t ch );
+static void font_sdfChar( font_char_t *c, int h );
+/* Glyph disk cache. */
+static int  font_cacheCmp( const void *p1, const void *p2 );
+static void font_cacheLoad( glFontStash *stsh );
+static void font_cacheFree( glFontStash *stsh );
+static int  font_cacheGet( glFontStash *stsh, uint32_t ch, font_char_t *c );
+static void font_cacheWrite( glFontStash *stsh, const uint32_t *chs,
+                             const font_char_t *chars, int n );
+/* Text runs. */
+static uint32_t   gl_fontRunHash( int id, const char *text, size_t len,
+                                  const glColour *start );
+static void       gl_fontRunTouch( int idx );
+static void       gl_fontRunFree( int idx );
+static void       gl_fontRunLayout( glFontStash *stsh, glFontRun *run );
+static gl_vbo    *gl_fontRunVBO( glFontRun *run );
+static glFontRun *gl_fontGetRun( glFontStash *stsh, const char *text,
+                                 size_t len, const glColour *start );
+static void       gl_fontFlushRuns( int id );
+/* Render. */
+static void gl_fontRender( glFontStash *stsh, double x, double y,
+                           const glColour *c, double outlineR,
+                           const char *text, size_t len );
+static void gl_fontRenderH( glFontStash *stsh, const mat4 *H,
+                            const glColour *c, double outlineR,
+                            const char *text, size_t len );
 /* Fussy layout concerns. */
 static void gl_fontKernStart( void );
 static int  gl_fontKernGlyph( glFontStash *stsh, uint32_t ch,
@@ -372,9 +490,6 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch,
    vbo_vert[5] = vy;
    vbo_vert[6] = vx + vw; /* Bottom right. */
    vbo_vert[7] = vy;
-   /* Update vbos. */
-   gl_vboData( stsh->vbo_tex, sizeof( GLfloat ) * n, stsh->vbo_tex_data );
-   gl_vboData( stsh->vbo_vert, sizeof( GLshort ) * n, stsh->vbo_vert_data );
 
    /* Add space for the new character. */
    gr->x += ch->w;
@@ -383,12 +498,6 @@ static int gl_fontAddGlyphTex( glFontStash *stsh, font_char_t *ch,
    glyph->vbo_id    = ( n - 8 ) / 2;
    glyph->tex_index = tex - stsh->tex;
 
-   /* Since the VBOs have possibly changed, we have to reset the data. */
-   gl_vboActivateAttribOffset( stsh->vbo_vert, shaders.font.vertex, 0, 2,
-                               GL_SHORT, 0 );
-   gl_vboActivateAttribOffset( stsh->vbo_tex, shaders.font.tex_coord, 0, 2,
-                               GL_FLOAT, 0 );
-
    return 0;
 }
 
@@ -532,6 +641,9 @@ void gl_printLineIteratorInit( glPrintLineIterator *iter, const glFont *ft_font,
    iter->text    = text;
    iter->ft_font = ( ft_font == NULL ? &gl_defFont : ft_font );
    iter->width   = width;
+
+   /* Line breaking needs all the glyphs, so generate them together. */
+   gl_fontPrefetchStash( gl_fontGetStash( iter->ft_font ), text );
 }
 
 typedef struct _linepos_t_ {
@@ -646,9 +758,6 @@ static uint32_t font_nextChar( const char *s, size_t *i )
 void gl_printRaw( const glFont *ft_font, double x, double y, const glColour *c,
                   double outlineR, const char *text )
 {
-   int      s;
-   size_t   i;
-   uint32_t ch;
    NTracingZone( _ctx, 1 );
 
    if ( ft_font == NULL )
@@ -656,12 +765,7 @@ void gl_printRaw( const glFont *ft_font, double x, double y, const glColour *c,
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
    /* Render it. */
-   s = 0;
-   i = 0;
-   gl_fontRenderStart( stsh, x, y, c, outlineR );
-   while ( ( ch = u8_nextchar( text, &i ) ) )
-      s = gl_fontRenderGlyph( stsh, ch, c, s );
-   gl_fontRenderEnd();
+   gl_fontRender( stsh, x, y, c, outlineR, text, strlen( text ) );
 
    NTracingZoneEnd( _ctx );
 }
@@ -680,9 +784,6 @@ void gl_printRaw( const glFont *ft_font, double x, double y, const glColour *c,
 void gl_printRawH( const glFont *ft_font, const mat4 *H, const glColour *c,
                    const double outlineR, const char *text )
 {
-   int      s;
-   size_t   i;
-   uint32_t ch;
    NTracingZone( _ctx, 1 );
 
    if ( ft_font == NULL )
@@ -690,12 +791,7 @@ void gl_printRawH( const glFont *ft_font, const mat4 *H, const glColour *c,
    glFontStash *stsh = gl_fontGetStash( ft_font );
 
    /* Render it. */
-   s = 0;
-   i = 0;
-   gl_fontRenderStartH( stsh, H, c, outlineR );
-   while ( ( ch = u8_nextchar( text, &i ) ) )
-      s = gl_fontRenderGlyph( stsh, ch, c, s );
-   gl_fontRenderEnd();
+   gl_fontRenderH( stsh, H, c, outlineR, text, strlen( text ) );
 
    NTracingZoneEnd( _ctx );
 }
@@ -753,9 +849,7 @@ void gl_print( const glFont *ft_font, const double x, const double y,
 int gl_printMaxRaw( const glFont *ft_font, const int max, double x, double y,
                     const glColour *c, double outlineR, const char *text )
 {
-   int      s;
-   size_t   ret, i;
-   uint32_t ch;
+   size_t ret;
    NTracingZone( _ctx, 1 );
 
    if ( ft_font == NULL )
@@ -766,12 +860,7 @@ int gl_printMaxRaw( const glFont *ft_font, const int max, double x, double y,
    ret = font_limitSize( stsh, NULL, text, max );
 
    /* Render it. */
-   s = 0;
-   gl_fontRenderStart( stsh, x, y, c, outlineR );
-   i = 0;
-   while ( ( ch = u8_nextchar( text, &i ) ) && ( i <= ret ) )
-      s = gl_fontRenderGlyph( stsh, ch, c, s );
-   gl_fontRenderEnd();
+   gl_fontRender( stsh, x, y, c, outlineR, text, ret );
 
    NTracingZoneEnd( _ctx );
    return ret;
@@ -821,9 +910,8 @@ int gl_printMax( const glFont *ft_font, const int max, double x, double y,
 int gl_printMidRaw( const glFont *ft_font, int width, double x, double y,
                     const glColour *c, double outlineR, const char *text )
 {
-   int      n, s;
-   size_t   ret, i;
-   uint32_t ch;
+   int    n;
+   size_t ret;
    NTracingZone( _ctx, 1 );
 
    if ( ft_font == NULL )
@@ -836,12 +924,7 @@ int gl_printMidRaw( const glFont *ft_font, int width, double x, double y,
    x += (double)( width - n ) / 2.;
 
    /* Render it. */
-   s = 0;
-   gl_fontRenderStart( stsh, x, y, c, outlineR );
-   i = 0;
-   while ( ( ch = u8_nextchar( text, &i ) ) && ( i <= ret ) )
-      s = gl_fontRenderGlyph( stsh, ch, c, s );
-   gl_fontRenderEnd();
+   gl_fontRender( stsh, x, y, c, outlineR, text, ret );
 
    NTracingZoneEnd( _ctx );
    return ret;
@@ -897,9 +980,7 @@ int gl_printTextRaw( const glFont *ft_font, const int width, const int height,
                      double outlineR, const char *text )
 {
    glPrintLineIterator iter;
-   int                 s;
    double              x, y;
-   uint32_t            ch;
    NTracingZone( _ctx, 1 );
 
    if ( ft_font == NULL )
@@ -916,19 +997,14 @@ int gl_printTextRaw( const glFont *ft_font, const int width, const int height,
    /* Clears restoration. */
    gl_printRestoreClear();
 
-   s = 0;
    gl_printLineIteratorInit( &iter, ft_font, text, width );
    while ( ( y - by > -DOUBLE_TOL ) && gl_printLineIteratorNext( &iter ) ) {
       /* Must restore stuff. */
       gl_printRestoreLast();
 
       /* Render it. */
-      gl_fontRenderStart( stsh, x, y, c, outlineR );
-      for ( size_t i = iter.l_begin; i < iter.l_end; ) {
-         ch = u8_nextchar( text, &i );
-         s  = gl_fontRenderGlyph( stsh, ch, c, s );
-      }
-      gl_fontRenderEnd();
+      gl_fontRender( stsh, x, y, c, outlineR, &text[iter.l_begin],
+                     iter.l_end - iter.l_begin );
 
       y -= line_height; /* move position down */
    }
@@ -1252,12 +1328,26 @@ int gl_printLines( const glFont *ft_font, const int width, const char *fmt,
 /**
  */
 static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
+{
+   if ( font_rasterChar( stsh, c, ch ) )
+      return -1;
+   font_sdfChar( c, stsh->h );
+   return 0;
+}
+
+/**
+ * @brief Renders a character with FreeType, leaving the distance field to
+ * font_sdfChar.
+ *
+ * FreeType is not thread safe, so this has to be run from the main thread.
+ */
+static int font_rasterChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
 {
    int len = array_size( stsh->ft );
+   memset( c, 0, sizeof( font_char_t ) );
    for ( int i = 0; i < len; i++ ) {
       FT_UInt              glyph_index;
       int                  w, h, rw, rh, b;
-      double               vmax;
       FT_Bitmap            bitmap;
       FT_GlyphSlot         slot;
       glFontStashFreetype *ft = &stsh->ft[i];
@@ -1293,34 +1383,27 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
       h = bitmap.rows;
 
       /* Store data. */
-      c->data  = NULL;
-      c->dataf = NULL;
       if ( bitmap.buffer == NULL ) {
          /* Space characters tend to have no buffer. */
          b       = 0;
          rw      = w;
          rh      = h;
-         c->data = malloc( sizeof( GLubyte ) * w * h );
-         memset( c->data, 0, sizeof( GLubyte ) * w * h );
-         vmax = 1.0; /* arbitrary */
+         c->data = calloc( w * h, sizeof( GLubyte ) );
+         c->m    = 2. * stsh->h / FONT_DISTANCE_FIELD_SIZE; /* arbitrary */
       } else {
-         GLubyte *buffer;
          /* Create a larger image using an extra border and center glyph. */
          b = 1 + ( ( MAX_EFFECT_RADIUS + 1 ) * FONT_DISTANCE_FIELD_SIZE - 1 ) /
                     stsh->h;
-         rw     = w + b * 2;
-         rh     = h + b * 2;
-         buffer = calloc( rw * rh, sizeof( GLubyte ) );
+         rw        = w + b * 2;
+         rh        = h + b * 2;
+         c->raster = calloc( rw * rh, sizeof( GLubyte ) );
          for ( int v = 0; v < h; v++ )
             for ( int u = 0; u < w; u++ )
-               buffer[( b + v ) * rw + ( b + u )] = bitmap.buffer[v * w + u];
-         /* Compute signed fdistance field with buffered glyph. */
-         c->dataf = make_distance_mapbf( buffer, rw, rh, &vmax );
-         free( buffer );
+               c->raster[( b + v ) * rw + ( b + u )] =
+                  bitmap.buffer[v * w + u];
       }
       c->w        = rw;
       c->h        = rh;
-      c->m        = ( 2. * vmax * stsh->h ) / FONT_DISTANCE_FIELD_SIZE;
       c->off_x    = slot->bitmap_left - b;
       c->off_y    = slot->bitmap_top + b;
       c->adv_x    = (GLfloat)slot->metrics.horiAdvance / 64.;
@@ -1333,59 +1416,639 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
 }
 
 /**
- * @brief Starts the rendering engine.
+ * @brief Computes the signed distance field of a rasterized character.
+ *
+ * Does not touch FreeType or the font stash, so it is safe to run in parallel.
+ *
+ *    @param c Character rasterized by font_rasterChar.
+ *    @param h Height of the font.
+ */
+static void font_sdfChar( font_char_t *c, int h )
+{
+   double vmax;
+   if ( c->raster == NULL )
+      return;
+   c->dataf = make_distance_mapbf( c->raster, c->w, c->h, &vmax );
+   c->m     = ( 2. * vmax * h ) / FONT_DISTANCE_FIELD_SIZE;
+   free( c->raster );
+   c->raster = NULL;
+}
+
+/**
+ * @brief Sets up the glyph cache file of a font stash.
+ *
+ * The file is named after the hash of the font files, the size and everything
+ * else that changes the generated glyphs, so it never has to be invalidated.
+ */
+static void font_cacheLoad( glFontStash *stsh )
+{
+   md5_state_t md5;
+   md5_byte_t  digest[16];
+   char        hex[33], dirpath[PATH_MAX];
+   size_t      size, pos;
+   int32_t     key[4] = { FONT_CACHE_VERSION, stsh->h, FONT_DISTANCE_FIELD_SIZE,
+                          MAX_EFFECT_RADIUS };
+
+   stsh->cache_loaded = 1;
+
+   md5_init( &md5 );
+   md5_append( &md5, (const md5_byte_t *)key, sizeof( key ) );
+   for ( int i = 0; i < array_size( stsh->ft ); i++ ) {
+      const glFontFile *file     = stsh->ft[i].file;
+      uint64_t          datasize = file->datasize;
+      md5_append( &md5, file->digest, sizeof( file->digest ) );
+      md5_append( &md5, (const md5_byte_t *)&datasize, sizeof( datasize ) );
+   }
+   md5_finish( &md5, digest );
+   for ( int i = 0; i < 16; i++ )
+      snprintf( &hex[2 * i], 3, "%02x", digest[i] );
+
+   snprintf( dirpath, sizeof( dirpath ), "%sglyphs/", nfile_cachePath() );
+   if ( nfile_dirMakeExist( dirpath ) )
+      return;
+   SDL_asprintf( &stsh->cache_path, "%s%s", dirpath, hex );
+   stsh->cache_glyphs = array_create( glFontCached );
+
+   if ( !nfile_fileExists( stsh->cache_path ) )
+      return;
+   stsh->cache_data = nfile_readFile( &size, stsh->cache_path );
+   if ( stsh->cache_data == NULL )
+      return;
+   if ( ( size < sizeof( FONT_CACHE_MAGIC ) ) ||
+        memcmp( stsh->cache_data, FONT_CACHE_MAGIC,
+                sizeof( FONT_CACHE_MAGIC ) ) ) {
+      WARN( _( "Glyph cache '%s' is corrupt, regenerating." ),
+            stsh->cache_path );
+      remove( stsh->cache_path );
+      return;
+   }
+
+   /* Index the glyphs, stopping at anything that was only partially written. */
+   pos = sizeof( FONT_CACHE_MAGIC );
+   while ( pos + sizeof( glFontCacheRecord ) <= size ) {
+      glFontCacheRecord rec;
+      glFontCached     *cached;
+      size_t            len;
+      memcpy( &rec, &stsh->cache_data[pos], sizeof( glFontCacheRecord ) );
+      if ( ( rec.w < 0 ) || ( rec.h < 0 ) || ( rec.w > stsh->tw ) ||
+           ( rec.h > stsh->th ) )
+         break;
+      len = (size_t)rec.w * rec.h * ( rec.isfloat ? sizeof( float ) : 1 );
+      len = ( len + 3 ) & ~(size_t)3;
+      if ( len > size - pos - sizeof( glFontCacheRecord ) )
+         break;
+      cached            = &array_grow( &stsh->cache_glyphs );
+      cached->codepoint = rec.codepoint;
+      cached->offset    = pos;
+      pos += sizeof( glFontCacheRecord ) + len;
+   }
+   if ( pos < size ) {
+      /* Drop the broken tail so new glyphs can be appended. */
+      WARN( _( "Glyph cache '%s' is truncated, regenerating the tail." ),
+            stsh->cache_path );
+      nfile_writeFile( stsh->cache_data, pos, stsh->cache_path );
+   }
+   qsort( stsh->cache_glyphs, array_size( stsh->cache_glyphs ),
+          sizeof( glFontCached ), font_cacheCmp );
+}
+
+/**
+ * @brief Frees the glyph cache of a font stash, it will be looked up again when
+ * needed.
+ */
+static void font_cacheFree( glFontStash *stsh )
+{
+   free( stsh->cache_path );
+   free( stsh->cache_data );
+   array_free( stsh->cache_glyphs );
+   stsh->cache_loaded = 0;
+   stsh->cache_path   = NULL;
+   stsh->cache_data   = NULL;
+   stsh->cache_glyphs = NULL;
+}
+
+/**
+ * @brief Gets a character from the glyph cache.
+ *
+ * The data of the character points into the cache and must not be freed.
+ *
+ *    @return 0 if the character was found.
+ */
+static int font_cacheGet( glFontStash *stsh, uint32_t ch, font_char_t *c )
+{
+   glFontCacheRecord   rec;
+   const glFontCached *cached;
+   const glFontCached  key = { .codepoint = ch };
+
+   if ( !stsh->cache_loaded )
+      font_cacheLoad( stsh );
+   if ( stsh->cache_data == NULL )
+      return -1;
+
+   cached = bsearch( &key, stsh->cache_glyphs, array_size( stsh->cache_glyphs ),
+                     sizeof( glFontCached ), font_cacheCmp );
+   if ( cached == NULL )
+      return -1;
+   memcpy( &rec, &stsh->cache_data[cached->offset],
+           sizeof( glFontCacheRecord ) );
+   if ( ( rec.ft_index < 0 ) || ( rec.ft_index >= array_size( stsh->ft ) ) )
+      return -1;
+
+   memset( c, 0, sizeof( font_char_t ) );
+   c->w        = rec.w;
+   c->h        = rec.h;
+   c->ft_index = rec.ft_index;
+   c->off_x    = rec.off_x;
+   c->off_y    = rec.off_y;
+   c->adv_x    = rec.adv_x;
+   c->m        = rec.m;
+   /* Records are 4 byte aligned, so the float data can be used in place. */
+   if ( rec.isfloat )
+      c->dataf = (GLfloat *)&stsh->cache_data[cached->offset +
+                                              sizeof( glFontCacheRecord )];
+   else
+      c->data = (GLubyte *)&stsh->cache_data[cached->offset +
+                                             sizeof( glFontCacheRecord )];
+   return 0;
+}
+
+/**
+ * @brief Appends generated characters to the glyph cache file.
+ *
+ *    @param stsh Font stash the characters belong to.
+ *    @param chs Codepoints of the characters, 0 to skip.
+ *    @param chars Generated characters.
+ *    @param n Number of characters.
+ */
+static void font_cacheWrite( glFontStash *stsh, const uint32_t *chs,
+                             const font_char_t *chars, int n )
+{
+   static const char pad[4] = { 0 };
+   FILE             *f;
+   int               exists;
+
+   if ( !stsh->cache_loaded )
+      font_cacheLoad( stsh );
+   if ( stsh->cache_path == NULL )
+      return;
+
+   exists = nfile_fileExists( stsh->cache_path );
+   f      = fopen( stsh->cache_path, "ab" );
+   if ( f == NULL ) {
+      WARN( _( "Unable to open glyph cache '%s'!" ), stsh->cache_path );
+      /* Don't try again. */
+      free( stsh->cache_path );
+      stsh->cache_path = NULL;
+      return;
+   }
+   if ( !exists )
+      fwrite( FONT_CACHE_MAGIC, 1, sizeof( FONT_CACHE_MAGIC ), f );
+
+   for ( int i = 0; i < n; i++ ) {
+      const font_char_t *c = &chars[i];
+      glFontCacheRecord  rec;
+      const void        *data;
+      size_t             len;
+      if ( chs[i] == 0 )
+         continue;
+      memset( &rec, 0, sizeof( glFontCacheRecord ) );
+      rec.codepoint = chs[i];
+      rec.ft_index  = c->ft_index;
+      rec.w         = c->w;
+      rec.h         = c->h;
+      rec.off_x     = c->off_x;
+      rec.off_y     = c->off_y;
+      rec.adv_x     = c->adv_x;
+      rec.m         = c->m;
+      rec.isfloat   = ( c->dataf != NULL );
+      data          = rec.isfloat ? (const void *)c->dataf : c->data;
+      len = (size_t)c->w * c->h * ( rec.isfloat ? sizeof( float ) : 1 );
+      fwrite( &rec, sizeof( glFontCacheRecord ), 1, f );
+      fwrite( data, 1, len, f );
+      fwrite( pad, 1, ( 4 - len % 4 ) % 4, f );
+   }
+   fclose( f );
+}
+
+/**
+ * @brief Compares two cached glyphs by codepoint.
+ */
+static int font_cacheCmp( const void *p1, const void *p2 )
+{
+   const glFontCached *c1 = p1;
+   const glFontCached *c2 = p2;
+   return ( c1->codepoint > c2->codepoint ) - ( c1->codepoint < c2->codepoint );
+}
+
+/**
+ * @brief Hashes the key of a text run (FNV-1a).
+ */
+static uint32_t gl_fontRunHash( int id, const char *text, size_t len,
+                                const glColour *start )
+{
+   uint32_t h = 2166136261u;
+   for ( size_t i = 0; i < len; i++ )
+      h = ( h ^ (uint8_t)text[i] ) * 16777619u;
+   h = ( h ^ (uint32_t)id ) * 16777619u;
+   h = ( h ^ (uint32_t)(uintptr_t)start ) * 16777619u;
+   return h;
+}
+
+/**
+ * @brief Marks a text run as the most recently used.
+ */
+static void gl_fontRunTouch( int idx )
+{
+   glFontRun *run = &font_runs[idx];
+
+   if ( font_runNewest == idx )
+      return;
+
+   /* Unlink, new runs aren't linked yet. */
+   if ( run->older != -1 )
+      font_runs[run->older].newer = run->newer;
+   else if ( font_runOldest == idx )
+      font_runOldest = run->newer;
+   if ( run->newer != -1 )
+      font_runs[run->newer].older = run->older;
+
+   /* Put in front. */
+   run->older = font_runNewest;
+   run->newer = -1;
+   if ( font_runNewest != -1 )
+      font_runs[font_runNewest].newer = idx;
+   font_runNewest = idx;
+   if ( font_runOldest == -1 )
+      font_runOldest = idx;
+}
+
+/**
+ * @brief Frees a cached text run, leaving its slot for reuse.
+ */
+static void gl_fontRunFree( int idx )
+{
+   glFontRun *run = &font_runs[idx];
+   int       *p;
+
+   /* Unlink from the look up table. */
+   p = &font_runLut[run->hash & ( FONT_RUN_LUT_SIZE - 1 )];
+   while ( *p != idx )
+      p = &font_runs[*p].next;
+   *p = run->next;
+
+   /* Unlink from the recently used list. */
+   if ( run->older != -1 )
+      font_runs[run->older].newer = run->newer;
+   else
+      font_runOldest = run->newer;
+   if ( run->newer != -1 )
+      font_runs[run->newer].older = run->older;
+   else
+      font_runNewest = run->older;
+
+   free( run->text );
+   array_free( run->verts );
+   gl_vboDestroy( run->vbo );
+   array_free( run->draws );
+   memset( run, 0, sizeof( glFontRun ) );
+
+   /* Slots are reused before growing. */
+   run->next      = font_runUnused;
+   font_runUnused = idx;
+}
+
+/**
+ * @brief Lays out a text run into glyph quads grouped by texture.
+ */
+static void gl_fontRunLayout( glFontStash *stsh, glFontRun *run )
+{
+   const glColour *col = run->start;
+   GLfloat         scale, x;
+   size_t          i;
+   uint32_t        ch;
+   int             s, n;
+
+   /* Quads are drawn as two triangles following the glyph's strip. */
+   static const int strip[6] = { 0, 1, 2, 1, 2, 3 };
+
+   if ( font_runVerts == NULL ) {
+      font_runVerts  = array_create( glFontVertex );
+      font_runSorted = array_create( glFontVertex );
+      font_runTex    = array_create( int );
+   }
+   array_resize( &font_runVerts, 0 );
+   array_resize( &font_runTex, 0 );
+   run->draws = array_create( glFontRunDraw );
+
+   gl_fontPrefetchStash( stsh, run->text );
+
+   scale = (GLfloat)stsh->h / FONT_DISTANCE_FIELD_SIZE;
+   x     = 0.;
+   s     = 0;
+   i     = 0;
+   gl_fontKernStart();
+   while ( ( ch = u8_nextchar( run->text, &i ) ) ) {
+      glFontGlyph   *glyph;
+      const GLshort *v;
+      const GLfloat *t;
+
+      /* Handle escape sequences. */
+      if ( ( ch == FONT_COLOUR_CODE ) && ( s == 0 ) ) { /* Start sequence. */
+         s = 1;
+         continue;
+      }
+      if ( ( s == 1 ) && ( ch != FONT_COLOUR_CODE ) ) {
+         col          = gl_fontGetColour( ch );
+         run->escaped = 1;
+         run->last    = col;
+         s            = 0;
+         continue;
+      }
+      s = 0;
+
+      /* Unicode goes here.
+       * First try to find the glyph. */
+      glyph = gl_fontGetGlyph( stsh, ch );
+      if ( glyph == NULL ) {
+         WARN( _( "Unable to find glyph '%d'!" ), ch );
+         continue;
+      }
+
+      /* Kern if possible. */
+      x += gl_fontKernGlyph( stsh, ch, glyph ) / scale;
+
+      /* Add the quad. */
+      v = &stsh->vbo_vert_data[2 * glyph->vbo_id];
+      t = &stsh->vbo_tex_data[2 * glyph->vbo_id];
+      for ( int k = 0; k < 6; k++ ) {
+         glFontVertex *vert = &array_grow( &font_runVerts );
+         int           j    = strip[k];
+         vert->x            = x + v[2 * j];
+         vert->y            = v[2 * j + 1];
+         vert->tx           = t[2 * j];
+         vert->ty           = t[2 * j + 1];
+         vert->m            = glyph->m;
+         if ( col == NULL )
+            memset( vert->col, 0, sizeof( vert->col ) );
+         else {
+            vert->col[0] = col->r;
+            vert->col[1] = col->g;
+            vert->col[2] = col->b;
+            vert->col[3] = 1.;
+         }
+      }
+      array_push_back( &font_runTex, glyph->tex_index );
+
+      /* Advance. */
+      x += glyph->adv_x / scale;
+   }
+
+   /* Group the quads by texture, so each texture is a single draw. */
+   n = array_size( font_runTex );
+   if ( n == 0 )
+      return;
+   array_resize( &font_runSorted, 0 );
+   for ( int tex = 0; tex < array_size( stsh->tex ); tex++ ) {
+      glFontRunDraw *d;
+      int            first = array_size( font_runSorted );
+      for ( int q = 0; q < n; q++ ) {
+         if ( font_runTex[q] != tex )
+            continue;
+         for ( int k = 0; k < 6; k++ )
+            array_push_back( &font_runSorted, font_runVerts[6 * q + k] );
+      }
+      if ( array_size( font_runSorted ) == first )
+         continue;
+      d            = &array_grow( &run->draws );
+      d->tex_index = tex;
+      d->first     = first;
+      d->count     = array_size( font_runSorted ) - first;
+   }
+   run->verts = array_copy( glFontVertex, font_runSorted );
+}
+
+/**
+ * @brief Gets the VBO to draw a text run from.
+ *
+ * Text that changes every frame would otherwise create and delete a buffer
+ * every frame, so runs are streamed through a shared VBO and only get their
+ * own static VBO once they are drawn again on a later frame.
+ *
+ *    @param run Text run to draw.
+ *    @return The VBO with the run's vertices.
+ */
+static gl_vbo *gl_fontRunVBO( glFontRun *run )
+{
+   GLsizei size;
+
+   if ( ( run->vbo == NULL ) && ( run->frame != 0 ) &&
+        ( run->frame != font_frame ) ) {
+      run->vbo = gl_vboCreateStatic(
+         sizeof( glFontVertex ) * array_size( run->verts ), run->verts );
+      array_free( run->verts );
+      run->verts = NULL;
+   }
+   run->frame = font_frame;
+   if ( run->vbo != NULL )
+      return run->vbo;
+
+   size = sizeof( glFontVertex ) * array_size( run->verts );
+   if ( font_runVBO == NULL )
+      font_runVBO = gl_vboCreateStream( size, run->verts );
+   else
+      gl_vboData( font_runVBO, size, run->verts );
+   return font_runVBO;
+}
+
+/**
+ * @brief Marks the end of a frame for the text run cache.
+ */
+void gl_fontEndFrame( void )
+{
+   font_frame++;
+   if ( font_frame == 0 )
+      font_frame = 1;
+}
+
+/**
+ * @brief Gets a laid out text run, laying it out if not cached.
+ *
+ *    @param stsh Font stash to lay out with.
+ *    @param text Text to lay out, does not have to be NUL-terminated.
+ *    @param len Length of the text in bytes.
+ *    @param start Colour restored at the start, NULL for the base colour.
+ *    @return The text run.
  */
-static void gl_fontRenderStart( const glFontStash *stsh, double x, double y,
-                                const glColour *c, double outlineR )
+static glFontRun *gl_fontGetRun( glFontStash *stsh, const char *text,
+                                 size_t len, const glColour *start )
+{
+   int        id = stsh - avail_fonts;
+   uint32_t   h  = gl_fontRunHash( id, text, len, start );
+   int        idx;
+   glFontRun *run;
+
+   /* Initialize the look up table. */
+   if ( font_nruns == 0 )
+      for ( int i = 0; i < FONT_RUN_LUT_SIZE; i++ )
+         font_runLut[i] = -1;
+
+   /* See if it's cached. */
+   for ( idx = font_runLut[h & ( FONT_RUN_LUT_SIZE - 1 )]; idx != -1;
+         idx = font_runs[idx].next ) {
+      run = &font_runs[idx];
+      if ( ( run->hash == h ) && ( run->stsh == id ) && ( run->len == len ) &&
+           ( run->start == start ) &&
+           ( memcmp( run->text, text, len ) == 0 ) ) {
+         gl_fontRunTouch( idx );
+         return run;
+      }
+   }
+
+   /* Get a slot, evicting the least recently used run if full. */
+   if ( font_runUnused == -1 ) {
+      if ( font_nruns < FONT_RUN_CACHE_SIZE )
+         idx = font_nruns++;
+      else {
+         gl_fontRunFree( font_runOldest );
+         idx = font_runUnused;
+      }
+   } else
+      idx = font_runUnused;
+   if ( idx == font_runUnused )
+      font_runUnused = font_runs[idx].next;
+
+   /* Create the run. */
+   run        = &font_runs[idx];
+   run->stsh  = id;
+   run->text  = strndup( text, len );
+   run->len   = len;
+   run->start = start;
+   run->hash  = h;
+   run->older = -1;
+   run->newer = -1;
+   run->next  = font_runLut[h & ( FONT_RUN_LUT_SIZE - 1 )];
+   font_runLut[h & ( FONT_RUN_LUT_SIZE - 1 )] = idx;
+   gl_fontRunTouch( idx );
+   gl_fontRunLayout( stsh, run );
+   return run;
+}
+
+/**
+ * @brief Frees the cached text runs of a font stash.
+ *
+ *    @param id Font stash id, or -1 for all.
+ */
+static void gl_fontFlushRuns( int id )
+{
+   for ( int i = 0; i < font_nruns; i++ )
+      if ( ( font_runs[i].text != NULL ) &&
+           ( ( id < 0 ) || ( font_runs[i].stsh == id ) ) )
+         gl_fontRunFree( i );
+}
+
+/**
+ * @brief Renders text at a position.
+ */
+static void gl_fontRender( glFontStash *stsh, double x, double y,
+                           const glColour *c, double outlineR,
+                           const char *text, size_t len )
 {
    /* OpenGL has pixel centers at 0.5 offset. */
    mat4 H = gl_view_matrix;
    mat4_translate_xy( &H, x + 0.5 * gl_screen.wscale,
                       y + 0.5 * gl_screen.hscale );
-   gl_fontRenderStartH( stsh, &H, c, outlineR );
+   gl_fontRenderH( stsh, &H, c, outlineR, text, len );
 }
-static void gl_fontRenderStartH( const glFontStash *stsh, const mat4 *H,
-                                 const glColour *c, double outlineR )
+
+/**
+ * @brief Renders text with a transformation matrix.
+ *
+ *    @param stsh Font stash to render with.
+ *    @param H Transformation matrix to use.
+ *    @param c Colour to use (uses white if NULL)
+ *    @param outlineR Radius in px of outline (-1 for default, 0 for none)
+ *    @param text Text to render, does not have to be NUL-terminated.
+ *    @param len Length of the text in bytes.
+ */
+static void gl_fontRenderH( glFontStash *stsh, const mat4 *H,
+                            const glColour *c, double outlineR,
+                            const char *text, size_t len )
 {
    double          a, scale;
-   const glColour *col;
+   const glColour *base, *start;
+   glFontRun      *run;
+   gl_vbo         *vbo;
+   mat4            projection;
 
    outlineR = ( outlineR == -1 ) ? 1 : MAX( outlineR, 0 );
 
-   /* Handle colour. */
-   a = ( c == NULL ) ? 1. : c->a;
+   /* Handle colour, a restored colour is part of the run. */
+   a     = ( c == NULL ) ? 1. : c->a;
+   base  = ( c == NULL ) ? &cWhite : c;
+   start = NULL;
    if ( font_restoreLast )
-      col = ( font_lastCol == NULL ) ? &cWhite : font_lastCol;
-   else if ( c == NULL )
-      col = &cWhite;
-   else
-      col = c;
+      start = ( font_lastCol == NULL ) ? &cWhite : font_lastCol;
+   font_restoreLast = 0;
+
+   /* Colour escapes carry over to the next restore. */
+   run = gl_fontGetRun( stsh, text, len, start );
+   if ( run->escaped )
+      font_lastCol = run->last;
+   if ( array_size( run->draws ) == 0 )
+      return;
 
    glUseProgram( shaders.font.program );
-   gl_uniformAColour( shaders.font.colour, col, a );
+   gl_uniformAColour( shaders.font.colour, base, a );
    if ( outlineR == 0. )
-      gl_uniformAColour( shaders.font.outline_colour, col, 0. );
+      gl_uniformAColour( shaders.font.outline_colour, base, 0. );
    else
       gl_uniformAColour( shaders.font.outline_colour, &cGrey10, a );
 
-   scale               = (double)stsh->h / FONT_DISTANCE_FIELD_SIZE;
-   font_projection_mat = *H;
-   mat4_scale( &font_projection_mat, scale, scale, 1 );
-
-   font_restoreLast = 0;
-   gl_fontKernStart();
+   scale      = (double)stsh->h / FONT_DISTANCE_FIELD_SIZE;
+   projection = *H;
+   mat4_scale( &projection, scale, scale, 1 );
+   gl_uniformMat4( shaders.font.projection, &projection );
 
-   /* Activate the appropriate VBOs. */
+   /* Activate the run's vertices. */
+   vbo = gl_fontRunVBO( run );
    glEnableVertexAttribArray( shaders.font.vertex );
-   gl_vboActivateAttribOffset( stsh->vbo_vert, shaders.font.vertex, 0, 2,
-                               GL_SHORT, 0 );
+   gl_vboActivateAttribOffset( vbo, shaders.font.vertex,
+                               offsetof( glFontVertex, x ), 2, GL_FLOAT,
+                               sizeof( glFontVertex ) );
    glEnableVertexAttribArray( shaders.font.tex_coord );
-   gl_vboActivateAttribOffset( stsh->vbo_tex, shaders.font.tex_coord, 0, 2,
-                               GL_FLOAT, 0 );
+   gl_vboActivateAttribOffset( vbo, shaders.font.tex_coord,
+                               offsetof( glFontVertex, tx ), 2, GL_FLOAT,
+                               sizeof( glFontVertex ) );
+   glEnableVertexAttribArray( shaders.font.m );
+   gl_vboActivateAttribOffset( vbo, shaders.font.m,
+                               offsetof( glFontVertex, m ), 1, GL_FLOAT,
+                               sizeof( glFontVertex ) );
+   glEnableVertexAttribArray( shaders.font.glyph_colour );
+   gl_vboActivateAttribOffset( vbo, shaders.font.glyph_colour,
+                               offsetof( glFontVertex, col ), 4, GL_FLOAT,
+                               sizeof( glFontVertex ) );
 
    /* Depth testing is used to draw the outline under the glyph. */
    if ( outlineR > 0. )
       glEnable( GL_DEPTH_TEST );
+
+   /* Draw the element, once per texture. */
+   for ( int i = 0; i < array_size( run->draws ); i++ ) {
+      const glFontRunDraw *d = &run->draws[i];
+      glBindTexture( GL_TEXTURE_2D, stsh->tex[d->tex_index].id );
+      glDrawArrays( GL_TRIANGLES, d->first, d->count );
+   }
+
+   glDisableVertexAttribArray( shaders.font.vertex );
+   glDisableVertexAttribArray( shaders.font.tex_coord );
+   glDisableVertexAttribArray( shaders.font.m );
+   glDisableVertexAttribArray( shaders.font.glyph_colour );
+   glUseProgram( 0 );
+
+   glDisable( GL_DEPTH_TEST );
+
+   /* Check for errors. */
+   gl_checkErr();
 }
 
 /**
@@ -1475,41 +2138,44 @@ static uint32_t hashint( uint32_t a )
 }
 
 /**
- * @brief Gets or caches a glyph to render.
+ * @brief Finds a glyph that was already generated.
+ *
+ *    @return The glyph or NULL if it has to be generated.
  */
-static glFontGlyph *gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
+static glFontGlyph *gl_fontFindGlyph( glFontStash *stsh, uint32_t ch )
 {
-   int          i;
-   unsigned int h;
-
    /* Use hash table and linked lists to find the glyph. */
-   h = hashint( ch ) & ( HASH_LUT_SIZE - 1 );
-   i = stsh->lut[h];
+   int i = stsh->lut[hashint( ch ) & ( HASH_LUT_SIZE - 1 )];
    while ( i != -1 ) {
       if ( stsh->glyphs[i].codepoint == ch )
          return &stsh->glyphs[i];
       i = stsh->glyphs[i].next;
    }
+   return NULL;
+}
 
-   /* Glyph not found, have to generate. */
+/**
+ * @brief Adds a generated character to the glyphs of a font stash.
+ */
+static glFontGlyph *gl_fontAddGlyph( glFontStash *stsh, uint32_t ch,
+                                     const font_char_t *ft_char )
+{
    glFontGlyph *glyph;
-   font_char_t  ft_char;
-   int          idx;
-
-   /* Load data from freetype. */
-   if ( font_makeChar( stsh, &ft_char, ch ) )
-      return NULL;
+   font_char_t  c;
+   int          i, idx;
+   unsigned int h;
 
    /* Create new character. */
    glyph            = &array_grow( &stsh->glyphs );
    glyph->codepoint = ch;
-   glyph->adv_x     = ft_char.adv_x;
-   glyph->m         = ft_char.m;
-   glyph->ft_index  = ft_char.ft_index;
+   glyph->adv_x     = ft_char->adv_x;
+   glyph->m         = ft_char->m;
+   glyph->ft_index  = ft_char->ft_index;
    glyph->next      = -1;
    idx              = glyph - stsh->glyphs;
 
    /* Insert in linked list. */
+   h = hashint( ch ) & ( HASH_LUT_SIZE - 1 );
    i = stsh->lut[h];
    if ( i == -1 ) {
       stsh->lut[h] = idx;
@@ -1524,7 +2190,33 @@ static glFontGlyph *gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
    }
 
    /* Find empty texture and render char. */
-   gl_fontAddGlyphTex( stsh, &ft_char, glyph );
+   c = *ft_char;
+   gl_fontAddGlyphTex( stsh, &c, glyph );
+
+   return glyph;
+}
+
+/**
+ * @brief Gets or caches a glyph to render.
+ */
+static glFontGlyph *gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
+{
+   glFontGlyph *glyph;
+   font_char_t  ft_char;
+
+   glyph = gl_fontFindGlyph( stsh, ch );
+   if ( glyph != NULL )
+      return glyph;
+
+   /* Glyph not found, see if it was generated before. */
+   if ( font_cacheGet( stsh, ch, &ft_char ) == 0 )
+      return gl_fontAddGlyph( stsh, ch, &ft_char );
+
+   /* Have to generate. */
+   if ( font_makeChar( stsh, &ft_char, ch ) )
+      return NULL;
+   font_cacheWrite( stsh, &ch, &ft_char, 1 );
+   glyph = gl_fontAddGlyph( stsh, ch, &ft_char );
 
    free( ft_char.data );
    free( ft_char.dataf );
@@ -1532,6 +2224,116 @@ static glFontGlyph *gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
    return glyph;
 }
 
+/**
+ * @brief Characters whose distance fields are being computed in parallel.
+ */
+typedef struct FontPrefetch_s {
+   font_char_t *chars; /**< Rasterized characters. */
+   int          h;     /**< Height of the font. */
+} FontPrefetch;
+
+/**
+ * @brief Computes the distance fields of a range of prefetched characters.
+ */
+static void font_prefetchRange( int start, int end, void *data )
+{
+   FontPrefetch *pf = data;
+   for ( int i = start; i < end; i++ )
+      font_sdfChar( &pf->chars[i], pf->h );
+}
+
+/**
+ * @brief Compares two codepoints.
+ */
+static int font_codepointCmp( const void *p1, const void *p2 )
+{
+   uint32_t c1 = *(const uint32_t *)p1;
+   uint32_t c2 = *(const uint32_t *)p2;
+   return ( c1 > c2 ) - ( c1 < c2 );
+}
+
+/**
+ * @brief Generates all the glyphs of a text that are missing from a font stash.
+ *
+ * Glyphs in the disk cache are loaded directly, the rest are rasterized one by
+ * one and get their distance fields computed in parallel.
+ */
+static void gl_fontPrefetchStash( glFontStash *stsh, const char *text )
+{
+   uint32_t    *missing = NULL;
+   font_char_t *chars;
+   FontPrefetch pf;
+   font_char_t  c;
+   uint32_t     ch;
+   size_t       i = 0;
+   int          n;
+
+   if ( text == NULL )
+      return;
+
+   /* Find the glyphs that have to be generated. */
+   while ( ( ch = font_nextChar( text, &i ) ) ) {
+      if ( gl_fontFindGlyph( stsh, ch ) != NULL )
+         continue;
+      if ( font_cacheGet( stsh, ch, &c ) == 0 ) {
+         gl_fontAddGlyph( stsh, ch, &c );
+         continue;
+      }
+      if ( missing == NULL )
+         missing = array_create( uint32_t );
+      array_push_back( &missing, ch );
+   }
+   if ( missing == NULL )
+      return;
+
+   NTracingZone( _ctx, 1 );
+
+   /* Remove repeated characters. */
+   qsort( missing, array_size( missing ), sizeof( uint32_t ),
+          font_codepointCmp );
+   n = 0;
+   for ( int j = 0; j < array_size( missing ); j++ )
+      if ( ( n == 0 ) || ( missing[n - 1] != missing[j] ) )
+         missing[n++] = missing[j];
+
+   /* FreeType is not thread safe, only the distance fields go in parallel. */
+   chars = calloc( n, sizeof( font_char_t ) );
+   for ( int j = 0; j < n; j++ )
+      if ( font_rasterChar( stsh, &chars[j], missing[j] ) )
+         missing[j] = 0;
+   pf.chars = chars;
+   pf.h     = stsh->h;
+   job_parallelFor( n, 1, font_prefetchRange, &pf );
+
+   font_cacheWrite( stsh, missing, chars, n );
+   for ( int j = 0; j < n; j++ ) {
+      if ( missing[j] != 0 )
+         gl_fontAddGlyph( stsh, missing[j], &chars[j] );
+      free( chars[j].data );
+      free( chars[j].dataf );
+   }
+   free( chars );
+   array_free( missing );
+
+   NTracingZoneEnd( _ctx );
+}
+
+/**
+ * @brief Generates the glyphs a text needs ahead of drawing it.
+ *
+ * Useful when creating windows, so the glyphs are not generated one by one
+ * while drawing the first frame.
+ *
+ *    @param ft_font Font to use (NULL defaults to gl_defFont).
+ *    @param text Text that will be drawn.
+ */
+void gl_fontPrefetch( const glFont *ft_font, const char *text )
+{
+   if ( ft_font == NULL )
+      ft_font = &gl_defFont;
+   gl_fontPrefetchStash( gl_fontGetStash( ft_font ), text );
+}
+
 /**
  * @brief Call at the start of a string/line.
  */
@@ -1564,77 +2366,6 @@ static int gl_fontKernGlyph( glFontStash *stsh, uint32_t ch,
    return kern_adv_x;
 }
 
-/**
- * @brief Renders a character.
- */
-static int gl_fontRenderGlyph( glFontStash *stsh, uint32_t ch,
-                               const glColour *c, int state )
-{
-   double       scale;
-   int          kern_adv_x;
-   glFontGlyph *glyph;
-
-   /* Handle escape sequences. */
-   if ( ( ch == FONT_COLOUR_CODE ) && ( state == 0 ) ) { /* Start sequence. */
-      return 1;
-   }
-   if ( ( state == 1 ) && ( ch != FONT_COLOUR_CODE ) ) {
-      const glColour *col = gl_fontGetColour( ch );
-      double          a   = ( c == NULL ) ? 1. : c->a;
-      if ( col != NULL )
-         gl_uniformAColour( shaders.font.colour, col, a );
-      else if ( c == NULL )
-         gl_uniformColour( shaders.font.colour, &cWhite );
-      else
-         gl_uniformColour( shaders.font.colour, c );
-      font_lastCol = col;
-      return 0;
-   }
-
-   /* Unicode goes here.
-    * First try to find the glyph. */
-   glyph = gl_fontGetGlyph( stsh, ch );
-   if ( glyph == NULL ) {
-      WARN( _( "Unable to find glyph '%d'!" ), ch );
-      return -1;
-   }
-
-   /* Kern if possible. */
-   scale      = (double)stsh->h / FONT_DISTANCE_FIELD_SIZE;
-   kern_adv_x = gl_fontKernGlyph( stsh, ch, glyph );
-   if ( kern_adv_x )
-      mat4_translate_x( &font_projection_mat, kern_adv_x / scale );
-
-   /* Activate texture. */
-   glBindTexture( GL_TEXTURE_2D, stsh->tex[glyph->tex_index].id );
-
-   glUniform1f( shaders.font.m, glyph->m );
-   gl_uniformMat4( shaders.font.projection, &font_projection_mat );
-
-   /* Draw the element. */
-   glDrawArrays( GL_TRIANGLE_STRIP, glyph->vbo_id, 4 );
-
-   /* Translate matrix. */
-   mat4_translate_x( &font_projection_mat, glyph->adv_x / scale );
-
-   return 0;
-}
-
-/**
- * @brief Ends the rendering engine.
- */
-static void gl_fontRenderEnd( void )
-{
-   glDisableVertexAttribArray( shaders.font.vertex );
-   glDisableVertexAttribArray( shaders.font.tex_coord );
-   glUseProgram( 0 );
-
-   glDisable( GL_DEPTH_TEST );
-
-   /* Check for errors. */
-   gl_checkErr();
-}
-
 /**
  * @brief Sets the minification and magnification filters for a font.
  *
@@ -1753,14 +2484,10 @@ int gl_fontInit( glFont *font, const char *fname, const unsigned int h,
    stsh->glyphs = array_create( glFontGlyph );
    stsh->tex    = array_create( glFontTex );
 
-   /* Set up VBOs. */
+   /* Set up glyph quads, text runs get built from these. */
    stsh->mvbo          = 256;
    stsh->vbo_tex_data  = calloc( 8 * stsh->mvbo, sizeof( GLfloat ) );
    stsh->vbo_vert_data = calloc( 8 * stsh->mvbo, sizeof( GLshort ) );
-   stsh->vbo_tex       = gl_vboCreateStatic( sizeof( GLfloat ) * 8 * stsh->mvbo,
-                                             stsh->vbo_tex_data );
-   stsh->vbo_vert      = gl_vboCreateStatic( sizeof( GLshort ) * 8 * stsh->mvbo,
-                                             stsh->vbo_vert_data );
 
    return 0;
 }
@@ -1811,6 +2538,7 @@ static int gl_fontstashAddFallback( glFontStash *stsh, const char *fname,
                                     unsigned int h )
 {
    glFontStashFreetype ft = { .file = NULL, .face = NULL };
+   md5_state_t         md5;
 
    /* Set up file data. Reference a loaded copy if we have one. */
    for ( int i = 0; i < array_size( avail_fonts ); i++ ) {
@@ -1836,6 +2564,9 @@ static int gl_fontstashAddFallback( glFontStash *stsh, const char *fname,
          gl_fontstashftDestroy( &ft );
          return -1;
       }
+      md5_init( &md5 );
+      md5_append( &md5, ft.file->data, ft.file->datasize );
+      md5_finish( &md5, ft.file->digest );
    }
 
    /* Object which freetype uses to store font info. */
@@ -1866,6 +2597,9 @@ static int gl_fontstashAddFallback( glFontStash *stsh, const char *fname,
    /* Save stuff. */
    array_push_back( &stsh->ft, ft );
 
+   /* Glyphs now depend on the new fallback, so use a different cache. */
+   font_cacheFree( stsh );
+
    /* Success. */
    return 0;
 }
@@ -1889,6 +2623,7 @@ void gl_freeFont( glFont *font )
    if ( stsh->refcount > 0 )
       return;
    /* Not references and must eliminate. */
+   gl_fontFlushRuns( stsh - avail_fonts );
 
    for ( int i = 0; i < array_size( stsh->ft ); i++ )
       gl_fontstashftDestroy( &stsh->ft[i] );
@@ -1900,10 +2635,9 @@ void gl_freeFont( glFont *font )
    array_free( stsh->tex );
 
    array_free( stsh->glyphs );
-   gl_vboDestroy( stsh->vbo_tex );
-   gl_vboDestroy( stsh->vbo_vert );
    free( stsh->vbo_tex_data );
    free( stsh->vbo_vert_data );
+   font_cacheFree( stsh );
 
    memset( stsh, 0, sizeof( glFontStash ) );
    /* Font stash will get reused when possible, and we can't erase because IDs
@@ -1929,6 +2663,16 @@ static void gl_fontstashftDestroy( glFontStashFreetype *ft )
  */
 void gl_fontExit( void )
 {
+   gl_fontFlushRuns( -1 );
+   array_free( font_runVerts );
+   array_free( font_runSorted );
+   array_free( font_runTex );
+   font_runVerts  = NULL;
+   font_runSorted = NULL;
+   font_runTex    = NULL;
+   gl_vboDestroy( font_runVBO );
+   font_runVBO = NULL;
+
    FT_Done_FreeType( font_library );
    font_library = NULL;
    array_free( avail_fonts );
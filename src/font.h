@@ -66,6 +66,8 @@ int  gl_fontAddFallback( glFont *font, const char *fname, const char *prefix );
 int  gl_fontAddFallbackFont( glFont *font, const glFont *f );
 void gl_freeFont( glFont *font );
 void gl_fontExit( void );
+void gl_fontPrefetch( const glFont *ft_font, const char *text );
+void gl_fontEndFrame( void );
 
 /*
  * const char printing
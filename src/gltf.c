@@ -290,12 +290,18 @@ static int gltf_loadTexture( const GltfObject *obj, Texture *otex,
    rw = PHYSFSRWOPS_openRead( filepath );
    if ( rw == NULL ) {
       WARN( _( "Unable to open '%s': %s" ), filepath, SDL_GetError() );
+#ifdef HAVE_NAEV
+      gl_texReady( otex->gtex );
+#endif /* HAVE_NAEV */
       *otex = *def;
       return 0;
    }
    surface = IMG_Load_RW( rw, 1 );
    if ( surface == NULL ) {
       WARN( _( "Unable to load surface '%s': %s" ), filepath, SDL_GetError() );
+#ifdef HAVE_NAEV
+      gl_texReady( otex->gtex );
+#endif /* HAVE_NAEV */
       *otex = *def;
       return 0;
    }
@@ -437,7 +443,8 @@ static int gltf_loadTexture( const GltfObject *obj, Texture *otex,
    otex->tex = tex;
 #ifdef HAVE_NAEV
    otex->gtex->texture = tex; /* Update the texture. */
-#endif                        /* HAVE_NAEV */
+   gl_texReady( otex->gtex );
+#endif /* HAVE_NAEV */
    return 0;
 }
 
@@ -22,6 +22,7 @@
  * Therefore we must tread carefully. Hooks are serious business.
  */
 /** @cond */
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "naev.h"
@@ -76,7 +77,7 @@ typedef struct Hook_ {
    struct Hook_ *next; /**< Linked list. */
 
    unsigned int id;      /**< unique id */
-   char        *stack;   /**< stack it's a part of */
+   char        *stack;   /**< stack it's a part of, owned by the HookStack */
    int          created; /**< Hook has just been created. */
    int delete;           /**< indicates it should be deleted when possible */
    int ran_once; /**< Indicates if the hook already ran, useful when iterating.
@@ -109,6 +110,17 @@ typedef struct Hook_ {
    } u; /**< Type specific data. */
 } Hook;
 
+/**
+ * @brief All the hooks of a stack.
+ *
+ * Stack names are interned, so each one has a single HookStack that is never
+ * freed, and hooks point to its name instead of having their own copy.
+ */
+typedef struct HookStack_ {
+   char  *name;  /**< Name of the stack. */
+   Hook **hooks; /**< Hooks of the stack in order of creation (array.h). */
+} HookStack;
+
 /*
  * the stack
  */
@@ -117,6 +129,17 @@ static Hook        *hook_list         = NULL; /**< Stack of hooks. */
 static int          hook_runningstack = 0;    /**< Check if stack is running. */
 static int hook_loadingstack = 0; /**< Check if the hooks are being loaded. */
 
+/*
+ * Indices. Both hash tables use open addressing with linear probing and have
+ * a power of two size.
+ */
+static HookStack *hook_stacks         = NULL; /**< Stacks (array.h). */
+static int       *hook_stackTable     = NULL; /**< Hash table of stacks. */
+static int        hook_stackTableSize = 0;    /**< Size of hook_stackTable. */
+static Hook     **hook_idTable        = NULL; /**< Hash table of hooks by ID. */
+static int        hook_idTableSize    = 0;    /**< Size of hook_idTable. */
+static int        hook_idTableCount   = 0;    /**< Hooks in hook_idTable. */
+
 /*
  * prototypes
  */
@@ -127,6 +150,11 @@ static void hooks_updateDateExecute( ntime_t change );
 static void         hook_rmRaw( Hook *h );
 static void         hooks_purgeList( void );
 static Hook        *hook_get( unsigned int id );
+static int          hook_stackFind( const char *stack );
+static int          hook_stackGet( const char *stack );
+static void         hook_stackTableInsert( int s );
+static void         hook_idInsert( Hook *h );
+static void         hook_idRemove( const Hook *h );
 static unsigned int hook_genID( void );
 static Hook        *hook_new( HookType_t type, const char *stack );
 static int          hook_parseParam( const HookParam *param );
@@ -479,13 +507,175 @@ static unsigned int hook_genID( void )
       return id;
 
    /* Must check ids for collisions. */
-   for ( Hook *h = hook_list; h != NULL; h = h->next )
-      if ( id == h->id )      /* Check for collision. */
-         return hook_genID(); /* recursively try again */
+   while ( hook_get( id ) != NULL )
+      id = ++hook_id;
 
    return id;
 }
 
+/**
+ * @brief Hashes a stack name (FNV-1a).
+ */
+static uint32_t hook_hashStack( const char *stack )
+{
+   uint32_t hash = 2166136261u;
+   for ( const unsigned char *c = (const unsigned char *)stack; *c != '\0';
+         c++ ) {
+      hash ^= *c;
+      hash *= 16777619u;
+   }
+   return hash;
+}
+
+/**
+ * @brief Hashes a hook ID.
+ */
+static uint32_t hook_hashID( unsigned int id )
+{
+   return (uint32_t)id * 2654435761u;
+}
+
+/**
+ * @brief Finds the index of a stack in hook_stacks.
+ *
+ *    @param stack Name of the stack to find.
+ *    @return Index of the stack or -1 if no hook ever used it.
+ */
+static int hook_stackFind( const char *stack )
+{
+   int mask, i;
+
+   if ( hook_stackTableSize == 0 )
+      return -1;
+
+   mask = hook_stackTableSize - 1;
+   i    = hook_hashStack( stack ) & mask;
+   while ( hook_stackTable[i] >= 0 ) {
+      if ( strcmp( hook_stacks[hook_stackTable[i]].name, stack ) == 0 )
+         return hook_stackTable[i];
+      i = ( i + 1 ) & mask;
+   }
+
+   return -1;
+}
+
+/**
+ * @brief Adds a stack to the stack hash table.
+ *
+ *    @param s Index of the stack in hook_stacks.
+ */
+static void hook_stackTableInsert( int s )
+{
+   int mask = hook_stackTableSize - 1;
+   int i    = hook_hashStack( hook_stacks[s].name ) & mask;
+   while ( hook_stackTable[i] >= 0 )
+      i = ( i + 1 ) & mask;
+   hook_stackTable[i] = s;
+}
+
+/**
+ * @brief Gets the index of a stack in hook_stacks, creating it if necessary.
+ *
+ *    @param stack Name of the stack to get.
+ *    @return Index of the stack.
+ */
+static int hook_stackGet( const char *stack )
+{
+   int        s = hook_stackFind( stack );
+   HookStack *hs;
+
+   if ( s >= 0 )
+      return s;
+
+   /* Add the new stack. */
+   if ( hook_stacks == NULL )
+      hook_stacks = array_create( HookStack );
+   s         = array_size( hook_stacks );
+   hs        = &array_grow( &hook_stacks );
+   hs->name  = strdup( stack );
+   hs->hooks = array_create( Hook * );
+
+   /* Grow and rehash the table to keep it at most half full. */
+   if ( 2 * array_size( hook_stacks ) > hook_stackTableSize ) {
+      free( hook_stackTable );
+      hook_stackTableSize = MAX( 64, 2 * hook_stackTableSize );
+      hook_stackTable     = malloc( hook_stackTableSize * sizeof( int ) );
+      for ( int i = 0; i < hook_stackTableSize; i++ )
+         hook_stackTable[i] = -1;
+      for ( int i = 0; i < array_size( hook_stacks ); i++ )
+         hook_stackTableInsert( i );
+   } else
+      hook_stackTableInsert( s );
+
+   return s;
+}
+
+/**
+ * @brief Adds a hook to the ID hash table.
+ */
+static void hook_idInsert( Hook *h )
+{
+   int mask, i;
+
+   /* Grow and rehash the table to keep it at most half full. */
+   if ( 2 * ( hook_idTableCount + 1 ) > hook_idTableSize ) {
+      Hook **old        = hook_idTable;
+      int    oldsize    = hook_idTableSize;
+      hook_idTableSize  = MAX( 256, 2 * hook_idTableSize );
+      hook_idTable      = calloc( hook_idTableSize, sizeof( Hook * ) );
+      hook_idTableCount = 0;
+      for ( int j = 0; j < oldsize; j++ )
+         if ( old[j] != NULL )
+            hook_idInsert( old[j] );
+      free( old );
+   }
+
+   mask = hook_idTableSize - 1;
+   i    = hook_hashID( h->id ) & mask;
+   while ( hook_idTable[i] != NULL )
+      i = ( i + 1 ) & mask;
+   hook_idTable[i] = h;
+   hook_idTableCount++;
+}
+
+/**
+ * @brief Removes a hook from the ID hash table.
+ */
+static void hook_idRemove( const Hook *h )
+{
+   int mask, i, j;
+
+   if ( hook_idTableSize == 0 )
+      return;
+
+   /* Find the hook itself, there may be hooks with duplicate IDs. */
+   mask = hook_idTableSize - 1;
+   i    = hook_hashID( h->id ) & mask;
+   while ( ( hook_idTable[i] != NULL ) && ( hook_idTable[i] != h ) )
+      i = ( i + 1 ) & mask;
+   if ( hook_idTable[i] == NULL )
+      return;
+   hook_idTable[i] = NULL;
+   hook_idTableCount--;
+
+   /* Shift back the following entries so lookups don't stop early. */
+   j = i;
+   while ( 1 ) {
+      int k;
+      j = ( j + 1 ) & mask;
+      if ( hook_idTable[j] == NULL )
+         break;
+      k = hook_hashID( hook_idTable[j]->id ) & mask;
+      /* Entry can stay if its home is cyclically in (i,j]. */
+      if ( ( i <= j ) ? ( ( i < k ) && ( k <= j ) )
+                      : ( ( i < k ) || ( k <= j ) ) )
+         continue;
+      hook_idTable[i] = hook_idTable[j];
+      hook_idTable[j] = NULL;
+      i               = j;
+   }
+}
+
 /**
  * @brief Generates and allocates a new hook.
  *
@@ -497,6 +687,7 @@ static Hook *hook_new( HookType_t type, const char *stack )
 {
    /* Get and create new hook. */
    Hook *new_hook = calloc( 1, sizeof( Hook ) );
+   int   s        = hook_stackGet( stack );
    if ( hook_list == NULL )
       hook_list = new_hook;
    else {
@@ -508,9 +699,13 @@ static Hook *hook_new( HookType_t type, const char *stack )
    /* Fill out generic details. */
    new_hook->type    = type;
    new_hook->id      = hook_genID();
-   new_hook->stack   = strdup( stack );
+   new_hook->stack   = hook_stacks[s].name;
    new_hook->created = 1;
 
+   /* Index it. */
+   array_push_back( &hook_stacks[s].hooks, new_hook );
+   hook_idInsert( new_hook );
+
    /** @TODO fix this hack. */
    if ( strcmp( stack, "safe" ) == 0 )
       new_hook->once = 1;
@@ -648,15 +843,16 @@ unsigned int hook_addFunc( int ( *func )( void * ), void *data,
  */
 static void hooks_purgeList( void )
 {
-   Hook *h, *hl;
+   Hook *h, *hl, *dead;
 
    /* Do not run while stack is being run. */
    if ( hook_runningstack )
       return;
 
    /* Second pass to delete. */
-   hl = NULL;
-   h  = hook_list;
+   dead = NULL;
+   hl   = NULL;
+   h    = hook_list;
    while ( h != NULL ) {
       /* Find valid timer hooks. */
       if ( h->delete ) {
@@ -666,9 +862,9 @@ static void hooks_purgeList( void )
          else
             hl->next = h->next;
 
-         /* Free. */
-         h->next = NULL;
-         hook_free( h );
+         /* Free later, once it is no longer indexed. */
+         h->next = dead;
+         dead    = h;
 
          /* Last. */
          h = hl;
@@ -680,6 +876,27 @@ static void hooks_purgeList( void )
       else
          h = h->next;
    }
+
+   /* Nothing to do. */
+   if ( dead == NULL )
+      return;
+
+   /* Remove the deleted hooks from the stacks, keeping the order. */
+   for ( int i = 0; i < array_size( hook_stacks ); i++ ) {
+      Hook **hooks = hook_stacks[i].hooks;
+      int    n     = 0;
+      for ( int j = 0; j < array_size( hooks ); j++ )
+         if ( !hooks[j]->delete )
+            hooks[n++] = hooks[j];
+      array_resize( &hook_stacks[i].hooks, n );
+   }
+
+   /* Free. */
+   while ( dead != NULL ) {
+      h    = dead;
+      dead = h->next;
+      hook_free( h );
+   }
 }
 
 /**
@@ -916,48 +1133,56 @@ int hook_hasEventParent( unsigned int parent )
 
 static int hooks_executeParam( const char *stack, const HookParam *param )
 {
-   int run;
+   int run, s;
 
    /* Don't update if player is dead. */
    if ( ( player.p == NULL ) || player_isFlag( PLAYER_DESTROYED ) )
       return 0;
 
-   /* Reset the current stack's ran and creation flags. */
-   for ( Hook *h = hook_list; h != NULL; h = h->next )
-      if ( strcmp( stack, h->stack ) == 0 ) {
+   run = 0;
+   s   = hook_stackFind( stack );
+   if ( s >= 0 ) {
+      /* Reset the current stack's ran and creation flags. */
+      for ( int i = 0; i < array_size( hook_stacks[s].hooks ); i++ ) {
+         Hook *h     = hook_stacks[s].hooks[i];
          h->ran_once = 0;
          h->created  = 0;
       }
 
-   run = 0;
-   hook_runningstack++; /* running hooks */
-   for ( int j = 1; j >= 0; j-- ) {
-      for ( Hook *h = hook_list; h != NULL; h = h->next ) {
-         /* Should be deleted. */
-         if ( h->delete )
-            continue;
-         /* Don't run again. */
-         if ( h->ran_once )
-            continue;
-         /* Don't update newly created hooks. */
-         if ( h->created != 0 )
-            continue;
-         /* Doesn't match stack. */
-         if ( strcmp( stack, h->stack ) != 0 )
-            continue;
+      /* Newest hooks run first. Hooks created while running get appended, and
+       * the stacks are only compacted when not running, so going backwards is
+       * safe. hook_stacks may be reallocated, so it is indexed every time. */
+      hook_runningstack++; /* running hooks */
+      for ( int j = 1; j >= 0; j-- ) {
+         for ( int i = array_size( hook_stacks[s].hooks ) - 1; i >= 0; i-- ) {
+            Hook *h;
+            /* Stack was emptied by hook_cleanup. */
+            if ( i >= array_size( hook_stacks[s].hooks ) )
+               continue;
+            h = hook_stacks[s].hooks[i];
+            /* Should be deleted. */
+            if ( h->delete )
+               continue;
+            /* Don't run again. */
+            if ( h->ran_once )
+               continue;
+            /* Don't update newly created hooks. */
+            if ( h->created != 0 )
+               continue;
 
-         /* Run hook. */
-         hook_run( h, param, j );
-         run++;
+            /* Run hook. */
+            hook_run( h, param, j );
+            run++;
 
-         /* If hook_cleanup was run, hook_list will be NULL */
+            /* If hook_cleanup was run, hook_list will be NULL */
+            if ( hook_list == NULL )
+               break;
+         }
          if ( hook_list == NULL )
             break;
       }
-      if ( hook_list == NULL )
-         break;
+      hook_runningstack--; /* not running hooks anymore */
    }
-   hook_runningstack--; /* not running hooks anymore */
 
    /* Free reference parameters. */
    if ( param != NULL ) {
@@ -1053,9 +1278,18 @@ int hooks_run( const char *stack )
  */
 static Hook *hook_get( unsigned int id )
 {
-   for ( Hook *h = hook_list; h != NULL; h = h->next )
-      if ( h->id == id )
-         return h;
+   int mask, i;
+
+   if ( hook_idTableSize == 0 )
+      return NULL;
+
+   mask = hook_idTableSize - 1;
+   i    = hook_hashID( id ) & mask;
+   while ( hook_idTable[i] != NULL ) {
+      if ( hook_idTable[i]->id == id )
+         return hook_idTable[i];
+      i = ( i + 1 ) & mask;
+   }
 
    return NULL;
 }
@@ -1138,8 +1372,8 @@ static void hook_free( Hook *h )
    /* Remove from all the pilots. */
    pilots_rmHook( h->id );
 
-   /* Generic freeing. */
-   free( h->stack );
+   /* Stack name is owned by the HookStack. */
+   hook_idRemove( h );
 
    /* Free type specific. */
    switch ( h->type ) {
@@ -1176,6 +1410,15 @@ void hook_cleanup( void )
    }
    /* safe defaults just in case */
    hook_list = NULL;
+
+   /* Empty the indices. The stacks themselves are kept, as they may be in
+    * the middle of being run. */
+   for ( int i = 0; i < array_size( hook_stacks ); i++ )
+      array_resize( &hook_stacks[i].hooks, 0 );
+   free( hook_idTable );
+   hook_idTable      = NULL;
+   hook_idTableSize  = 0;
+   hook_idTableCount = 0;
 }
 
 /**
@@ -1423,8 +1666,10 @@ static int hook_parse( xmlNodePtr base )
 
          /* Set the id. */
          if ( id != 0 ) {
-            h     = hook_get( new_id );
+            h = hook_get( new_id );
+            hook_idRemove( h );
             h->id = id;
+            hook_idInsert( h );
 
             /* Additional info. */
             if ( is_date ) {
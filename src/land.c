@@ -1495,7 +1495,7 @@ void land( Spob *p, int load )
 static int land_gc( void *unused )
 {
    (void)unused;
-   lua_gc( naevL, LUA_GCCOLLECT, 0 );
+   nlua_gcCollect();
    return 0;
 }
 
@@ -8,6 +8,7 @@
  */
 
 /** @cond */
+#include "libxml/xmlreader.h"
 #include "physfs.h"
 
 #include "naev.h"
@@ -49,6 +50,19 @@
 #define BUTTON_WIDTH 120 /**< Button width. */
 #define BUTTON_HEIGHT 30 /**< Button height. */
 
+#define LOAD_META_EXT ".meta"              /**< Save metadata sidecar. */
+#define LOAD_META_MAGIC "NAEV_SAVE_META 1" /**< First line of the sidecar. */
+
+/**
+ * @brief Top level sections of a save that the save listing looks at.
+ */
+typedef enum LoadSection_ {
+   LOAD_SECTION_NONE,    /**< Anything else, skipped. */
+   LOAD_SECTION_VERSION, /**< Naev version and data. */
+   LOAD_SECTION_PLUGINS, /**< Plugins used. */
+   LOAD_SECTION_PLAYER,  /**< Player metadata. */
+} LoadSection;
+
 typedef struct player_saves_s {
    char    *name;
    nsave_t *saves;
@@ -116,97 +130,407 @@ static xmlDocPtr load_xml_parsePhysFS( const char *filename );
 static void      load_freeSave( nsave_t *ns );
 
 /**
- * @brief Loads an individual save.
- * @param[out] save Structure to populate.
- * @return 0 on success.
+ * @brief Gets the path of the metadata sidecar of a save.
  */
-static int load_load( nsave_t *save )
+static void load_metaPath( char *buf, size_t len, const char *path )
 {
-   xmlDocPtr  doc;
-   xmlNodePtr root, parent;
+   snprintf( buf, len, "%s" LOAD_META_EXT, path );
+}
 
-   /* Load the XML. */
-   doc = load_xml_parsePhysFS( save->path );
-   if ( doc == NULL ) {
-      WARN( _( "Unable to parse save path '%s'." ), save->path );
+/**
+ * @brief Gets the next line of a metadata sidecar.
+ *
+ *    @param[in, out] cur Position in the buffer, advanced past the line.
+ *    @return The NUL terminated line or NULL if there are no more lines.
+ */
+static char *load_metaLine( char **cur )
+{
+   char *s = *cur;
+   char *e;
+   if ( s == NULL )
+      return NULL;
+   e = strchr( s, '\n' );
+   if ( e == NULL )
+      return NULL;
+   *e   = '\0';
+   *cur = e + 1;
+   return s;
+}
+
+/**
+ * @brief Duplicates a metadata sidecar string, where empty means NULL.
+ */
+static char *load_metaStrd( const char *s )
+{
+   return ( ( s == NULL ) || ( s[0] == '\0' ) ) ? NULL : strdup( s );
+}
+
+/**
+ * @brief Loads an individual save from its metadata sidecar.
+ *
+ * The sidecar is only used if it was written for the current save file,
+ *  otherwise the save has to be parsed.
+ *
+ *    @param[out] save Structure to populate.
+ *    @return 0 on success.
+ */
+static int load_loadMeta( nsave_t *save )
+{
+   char        path[PATH_MAX];
+   char       *buf, *cur, *l;
+   size_t      bufsize;
+   int         n;
+   PHYSFS_Stat stat, mstat;
+
+   /* See if it is still up to date. */
+   load_metaPath( path, sizeof( path ), save->path );
+   if ( !PHYSFS_stat( path, &mstat ) || !PHYSFS_stat( save->path, &stat ) )
+      return -1;
+   if ( mstat.modtime < stat.modtime )
+      return -1;
+
+   buf = ndata_read( path, &bufsize );
+   if ( buf == NULL )
       return -1;
+   cur = buf;
+
+   /* Check the header. */
+   l = load_metaLine( &cur );
+   if ( ( l == NULL ) || ( strcmp( l, LOAD_META_MAGIC ) != 0 ) )
+      goto err;
+   l = load_metaLine( &cur );
+   if ( ( l == NULL ) || ( strtoll( l, NULL, 10 ) != stat.filesize ) )
+      goto err;
+
+   /* Fixed layout, one field per line. */
+   save->version     = load_metaStrd( load_metaLine( &cur ) );
+   save->data        = load_metaStrd( load_metaLine( &cur ) );
+   save->player_name = load_metaStrd( load_metaLine( &cur ) );
+   save->spob        = load_metaStrd( load_metaLine( &cur ) );
+   l                 = load_metaLine( &cur );
+   save->date        = ( l != NULL ) ? strtoll( l, NULL, 10 ) : 0;
+   l                 = load_metaLine( &cur );
+   save->credits     = ( l != NULL ) ? strtoull( l, NULL, 10 ) : 0;
+   save->chapter     = load_metaStrd( load_metaLine( &cur ) );
+   save->difficulty  = load_metaStrd( load_metaLine( &cur ) );
+   save->shipname    = load_metaStrd( load_metaLine( &cur ) );
+   save->shipmodel   = load_metaStrd( load_metaLine( &cur ) );
+
+   /* Plugins. */
+   l = load_metaLine( &cur );
+   if ( l == NULL )
+      goto err;
+   n = atoi( l );
+   if ( n > 0 )
+      save->plugins = array_create_size( char *, n );
+   for ( int i = 0; i < n; i++ ) {
+      l = load_metaLine( &cur );
+      if ( l == NULL )
+         goto err;
+      array_push_back( &save->plugins, strdup( l ) );
    }
-   root = doc->xmlChildrenNode; /* base node */
-   if ( root == NULL ) {
-      WARN( _( "Unable to get child node of save '%s'." ), save->path );
-      xmlFreeDoc( doc );
+   if ( save->player_name == NULL )
+      goto err;
+
+   free( buf );
+   return 0;
+
+err:
+   /* Leave it clean for the parser. */
+   for ( int i = 0; i < array_size( save->plugins ); i++ )
+      free( save->plugins[i] );
+   array_free( save->plugins );
+   free( save->version );
+   free( save->data );
+   free( save->player_name );
+   free( save->spob );
+   free( save->chapter );
+   free( save->difficulty );
+   free( save->shipname );
+   free( save->shipmodel );
+   save->plugins     = NULL;
+   save->version     = NULL;
+   save->data        = NULL;
+   save->player_name = NULL;
+   save->spob        = NULL;
+   save->chapter     = NULL;
+   save->difficulty  = NULL;
+   save->shipname    = NULL;
+   save->shipmodel   = NULL;
+   free( buf );
+   return -1;
+}
+
+/**
+ * @brief Writes a string line of a metadata sidecar.
+ *
+ *    @return 0 on success.
+ */
+static int load_metaWriteStr( PHYSFS_File *f, const char *s )
+{
+   if ( s == NULL )
+      s = "";
+   /* Can't represent multiline strings, let the parser handle it. */
+   if ( strchr( s, '\n' ) != NULL )
+      return -1;
+   if ( PHYSFS_writeBytes( f, s, strlen( s ) ) < (PHYSFS_sint64)strlen( s ) )
+      return -1;
+   if ( PHYSFS_writeBytes( f, "\n", 1 ) < 1 )
+      return -1;
+   return 0;
+}
+
+/**
+ * @brief Writes the metadata sidecar of a save.
+ *
+ *    @param save Save to write the metadata of, already loaded.
+ *    @return 0 on success.
+ */
+static int load_writeMeta( const nsave_t *save )
+{
+   char         path[PATH_MAX], num[64];
+   PHYSFS_File *f;
+   PHYSFS_Stat  stat;
+   int          ret = 0;
+
+   if ( !PHYSFS_stat( save->path, &stat ) )
+      return -1;
+
+   load_metaPath( path, sizeof( path ), save->path );
+   f = PHYSFS_openWrite( path );
+   if ( f == NULL )
+      return -1;
+
+   ret |= load_metaWriteStr( f, LOAD_META_MAGIC );
+   snprintf( num, sizeof( num ), "%" PRId64, (int64_t)stat.filesize );
+   ret |= load_metaWriteStr( f, num );
+   ret |= load_metaWriteStr( f, save->version );
+   ret |= load_metaWriteStr( f, save->data );
+   ret |= load_metaWriteStr( f, save->player_name );
+   ret |= load_metaWriteStr( f, save->spob );
+   snprintf( num, sizeof( num ), "%" PRId64, (int64_t)save->date );
+   ret |= load_metaWriteStr( f, num );
+   snprintf( num, sizeof( num ), "%" PRIu64, save->credits );
+   ret |= load_metaWriteStr( f, num );
+   ret |= load_metaWriteStr( f, save->chapter );
+   ret |= load_metaWriteStr( f, save->difficulty );
+   ret |= load_metaWriteStr( f, save->shipname );
+   ret |= load_metaWriteStr( f, save->shipmodel );
+   snprintf( num, sizeof( num ), "%d", array_size( save->plugins ) );
+   ret |= load_metaWriteStr( f, num );
+   for ( int i = 0; i < array_size( save->plugins ); i++ )
+      ret |= load_metaWriteStr( f, save->plugins[i] );
+
+   if ( !PHYSFS_close( f ) )
+      ret = -1;
+
+   /* Don't leave half written sidecars around. */
+   if ( ret ) {
+      PHYSFS_delete( path );
+      return -1;
+   }
+   return 0;
+}
+
+/**
+ * @brief Deletes the metadata sidecar of a save if it exists.
+ */
+static void load_deleteMeta( const char *path )
+{
+   char buf[PATH_MAX];
+   load_metaPath( buf, sizeof( buf ), path );
+   if ( PHYSFS_exists( buf ) )
+      PHYSFS_delete( buf );
+}
+
+/**
+ * @brief Gets the text contents of the current node of a reader.
+ */
+static char *load_readerStrd( xmlTextReaderPtr reader )
+{
+   xmlChar *s   = xmlTextReaderReadString( reader );
+   char    *ret = load_metaStrd( (const char *)s );
+   xmlFree( s );
+   return ret;
+}
+
+/**
+ * @brief Gets an attribute of the current node of a reader.
+ */
+static char *load_readerAttrStrd( xmlTextReaderPtr reader, const char *name )
+{
+   xmlChar *s   = xmlTextReaderGetAttribute( reader, (const xmlChar *)name );
+   char    *ret = ( s != NULL ) ? strdup( (const char *)s ) : NULL;
+   xmlFree( s );
+   return ret;
+}
+
+/**
+ * @brief Loads an individual save by streaming through the XML.
+ *
+ * Only the metadata at the start of the save is looked at, parsing stops as
+ *  soon as the player's current ship has been found.
+ *
+ *    @param[out] save Structure to populate.
+ *    @return 0 on success.
+ */
+static int load_loadStream( nsave_t *save )
+{
+   char             buf[PATH_MAX];
+   xmlTextReaderPtr reader;
+   LoadSection      section = LOAD_SECTION_NONE;
+   int              ret, in_time = 0, has_time = 0, has_ship = 0;
+   int              cycles = 0, periods = 0, seconds = 0;
+
+   snprintf( buf, sizeof( buf ), "%s/%s", PHYSFS_getWriteDir(), save->path );
+   reader = xmlReaderForFile( buf, NULL, 0 );
+   if ( reader == NULL ) {
+      WARN( _( "Unable to parse save path '%s'." ), save->path );
       return -1;
    }
 
-   /* Iterate inside the naev_save. */
-   parent = root->xmlChildrenNode;
-   do {
-      xml_onlyNodes( parent );
+   ret = xmlTextReaderRead( reader );
+   while ( ret == 1 ) {
+      int         type  = xmlTextReaderNodeType( reader );
+      int         depth = xmlTextReaderDepth( reader );
+      int         skip  = 0; /* Skip the children of the node. */
+      const char *name  = (const char *)xmlTextReaderConstName( reader );
 
-      /* Info. */
-      if ( xml_isNode( parent, "version" ) ) {
-         xmlNodePtr node = parent->xmlChildrenNode;
-         do {
-            xmlr_strd( node, "naev", save->version );
-            xmlr_strd( node, "data", save->data );
-         } while ( xml_nextNode( node ) );
+      /* End of the player metadata. */
+      if ( ( type == XML_READER_TYPE_END_ELEMENT ) && ( depth == 1 ) &&
+           ( section == LOAD_SECTION_PLAYER ) )
+         break;
+      if ( type != XML_READER_TYPE_ELEMENT ) {
+         ret = xmlTextReaderRead( reader );
          continue;
       }
 
-      else if ( xml_isNode( parent, "player" ) ) {
-         /* Get name. */
-         xmlr_attr_strd( parent, "name", save->player_name );
-         /* Parse rest. */
-         xmlNodePtr node = parent->xmlChildrenNode;
-         do {
-            xml_onlyNodes( node );
-
-            /* Player info. */
-            xmlr_strd( node, "location", save->spob );
-            xmlr_ulong( node, "credits", save->credits );
-            xmlr_strd( node, "chapter", save->chapter );
-            xmlr_strd( node, "difficulty", save->difficulty );
-
-            /* Time. */
-            if ( xml_isNode( node, "time" ) ) {
-               int        cycles, periods, seconds;
-               xmlNodePtr cur = node->xmlChildrenNode;
-               cycles = periods = seconds = 0;
-               do {
-                  xmlr_int( cur, "SCU", cycles );
-                  xmlr_int( cur, "STP", periods );
-                  xmlr_int( cur, "STU", seconds );
-               } while ( xml_nextNode( cur ) );
-               save->date = ntime_create( cycles, periods, seconds );
-               continue;
-            }
-
-            /* Ship info. */
-            if ( xml_isNode( node, "ship" ) ) {
-               xmlr_attr_strd( node, "name", save->shipname );
-               xmlr_attr_strd( node, "model", save->shipmodel );
-               continue;
-            }
-         } while ( xml_nextNode( node ) );
-         continue;
-      } else if ( xml_isNode( parent, "plugins" ) ) {
-         save->plugins = array_create( char * );
-         /* Parse rest. */
-         xmlNodePtr node = parent->xmlChildrenNode;
-         do {
-            xml_onlyNodes( node );
-
-            if ( xml_isNode( node, "plugin" ) ) {
-               const char *name = xml_get( node );
-               if ( name != NULL )
-                  array_push_back( &save->plugins, strdup( name ) );
-               else
-                  WARN( _( "Save '%s' has unnamed plugin node!" ), save->path );
-            }
-         } while ( xml_nextNode( node ) );
-         continue;
+      /* Sections inside the naev_save. */
+      if ( depth == 1 ) {
+         section = LOAD_SECTION_NONE;
+         if ( strcmp( name, "version" ) == 0 )
+            section = LOAD_SECTION_VERSION;
+         else if ( strcmp( name, "plugins" ) == 0 ) {
+            section = LOAD_SECTION_PLUGINS;
+            if ( save->plugins == NULL )
+               save->plugins = array_create( char * );
+         } else if ( strcmp( name, "player" ) == 0 ) {
+            section           = LOAD_SECTION_PLAYER;
+            save->player_name = load_readerAttrStrd( reader, "name" );
+         } else
+            skip = 1;
       }
-   } while ( xml_nextNode( parent ) );
+
+      /* Info. */
+      else if ( ( depth == 2 ) && ( section == LOAD_SECTION_VERSION ) ) {
+         if ( strcmp( name, "naev" ) == 0 ) {
+            free( save->version );
+            save->version = load_readerStrd( reader );
+         } else if ( strcmp( name, "data" ) == 0 ) {
+            free( save->data );
+            save->data = load_readerStrd( reader );
+         }
+         skip = 1;
+      }
+
+      /* Plugins. */
+      else if ( ( depth == 2 ) && ( section == LOAD_SECTION_PLUGINS ) ) {
+         if ( strcmp( name, "plugin" ) == 0 ) {
+            char *plugin = load_readerStrd( reader );
+            if ( plugin != NULL )
+               array_push_back( &save->plugins, plugin );
+            else
+               WARN( _( "Save '%s' has unnamed plugin node!" ), save->path );
+         }
+         skip = 1;
+      }
+
+      /* Player info. */
+      else if ( ( depth == 2 ) && ( section == LOAD_SECTION_PLAYER ) ) {
+         skip    = 1;
+         in_time = 0;
+         if ( strcmp( name, "location" ) == 0 ) {
+            free( save->spob );
+            save->spob = load_readerStrd( reader );
+         } else if ( strcmp( name, "credits" ) == 0 ) {
+            char *s       = load_readerStrd( reader );
+            save->credits = ( s != NULL ) ? strtoull( s, NULL, 10 ) : 0;
+            free( s );
+         } else if ( strcmp( name, "chapter" ) == 0 ) {
+            free( save->chapter );
+            save->chapter = load_readerStrd( reader );
+         } else if ( strcmp( name, "difficulty" ) == 0 ) {
+            free( save->difficulty );
+            save->difficulty = load_readerStrd( reader );
+         } else if ( strcmp( name, "time" ) == 0 ) {
+            in_time = 1;
+            skip    = 0;
+         } else if ( strcmp( name, "ship" ) == 0 ) {
+            free( save->shipname );
+            free( save->shipmodel );
+            save->shipname  = load_readerAttrStrd( reader, "name" );
+            save->shipmodel = load_readerAttrStrd( reader, "model" );
+            has_ship        = 1;
+         }
+      }
+
+      /* Time. */
+      else if ( ( depth == 3 ) && in_time &&
+                ( section == LOAD_SECTION_PLAYER ) ) {
+         char *s = load_readerStrd( reader );
+         int   v = ( s != NULL ) ? atoi( s ) : 0;
+         if ( strcmp( name, "SCU" ) == 0 ) {
+            cycles = v;
+            has_time |= 1 << 0;
+         } else if ( strcmp( name, "STP" ) == 0 ) {
+            periods = v;
+            has_time |= 1 << 1;
+         } else if ( strcmp( name, "STU" ) == 0 ) {
+            seconds = v;
+            has_time |= 1 << 2;
+         }
+         free( s );
+         skip = 1;
+      }
+
+      /* The rest of the player is only needed to actually load the game. */
+      if ( has_ship && ( has_time == 0x7 ) && ( save->spob != NULL ) )
+         break;
+
+      ret = skip ? xmlTextReaderNext( reader ) : xmlTextReaderRead( reader );
+   }
+   xmlFreeTextReader( reader );
+
+   if ( ret < 0 ) {
+      WARN( _( "Unable to parse save path '%s'." ), save->path );
+      return -1;
+   }
+   if ( save->player_name == NULL ) {
+      WARN( _( "Unable to get player of save '%s'." ), save->path );
+      return -1;
+   }
+   if ( has_time )
+      save->date = ntime_create( cycles, periods, seconds );
+
+   return 0;
+}
+
+/**
+ * @brief Loads an individual save.
+ *
+ * Uses the metadata sidecar when possible, otherwise the save is parsed and
+ *  the sidecar written so that next time is fast.
+ *
+ * @param[out] save Structure to populate.
+ * @return 0 on success.
+ */
+static int load_load( nsave_t *save )
+{
+   if ( load_loadMeta( save ) != 0 ) {
+      if ( load_loadStream( save ) != 0 )
+         return -1;
+      load_writeMeta( save );
+   }
 
    /* Defaults. */
    if ( save->chapter == NULL )
@@ -214,12 +538,30 @@ static int load_load( nsave_t *save )
 
    save->compatible = load_compatibility( save );
 
-   /* Clean up. */
-   xmlFreeDoc( doc );
-
    return 0;
 }
 
+/**
+ * @brief Updates the metadata sidecar of a save after it has been written.
+ *
+ *    @param path Path of the save relative to the PhysicsFS write directory.
+ *    @return 0 on success.
+ */
+int load_updateMeta( const char *path )
+{
+   nsave_t ns;
+   int     ret;
+
+   memset( &ns, 0, sizeof( ns ) );
+   ns.path = strdup( path );
+   load_deleteMeta( path );
+   ret = load_loadStream( &ns );
+   if ( ret == 0 )
+      ret = load_writeMeta( &ns );
+   load_freeSave( &ns );
+   return ret;
+}
+
 static int load_loadThread( void *ptr )
 {
    nsave_t *ns = ptr;
@@ -1116,10 +1458,12 @@ static void load_menu_delete( unsigned int wdw, const char *str )
 
    /* Remove it. */
    n = array_size( load_saves[pos].saves );
-   for ( int i = 0; i < n; i++ )
+   for ( int i = 0; i < n; i++ ) {
+      load_deleteMeta( load_saves[pos].saves[i].path );
       if ( !PHYSFS_delete( load_saves[pos].saves[i].path ) )
          dialogue_alert( _( "Unable to delete %s" ),
                          load_saves[pos].saves[i].path );
+   }
    snprintf( path, sizeof( path ), "saves/%s", load_saves[pos].name );
    if ( !PHYSFS_delete( path ) )
       dialogue_alert( _( "Unable to delete '%s' directory" ),
@@ -1154,6 +1498,7 @@ static void load_snapshot_menu_delete( unsigned int wdw, const char *str )
       return;
 
    /* Remove it. */
+   load_deleteMeta( load_player->saves[pos].path );
    if ( !PHYSFS_delete( load_player->saves[pos].path ) )
       dialogue_alert( _( "Unable to delete %s" ),
                       load_player->saves[pos].path );
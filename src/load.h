@@ -59,3 +59,4 @@ int load_game( const nsave_t *ns );
 int            load_refresh( void );
 void           load_free( void );
 const nsave_t *load_getList( const char *name );
+int            load_updateMeta( const char *path );
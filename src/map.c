@@ -163,6 +163,8 @@ static void map_selectCur( void );
 static void map_genModeList( void );
 static void map_update_commod_av_price();
 static void map_onClose( unsigned int wid, const char *str );
+/* Pathfinding. */
+static void A_free( void );
 
 /**
  * @brief Initializes the map subsystem.
@@ -186,6 +188,7 @@ void map_exit( void )
       decorator_stack = NULL;
    }
 
+   A_free();
    ovr_exit();
 }
 
@@ -2777,146 +2780,130 @@ void map_toggleNotes()
  * in reality just Djikstras. I've removed the heurestic bit to make sure I
  * don't try to implement an admissible heuristic when I'm pretty sure there is
  * none.
+ *
+ * Nodes are stored in a flat array indexed by system id, and the open set is a
+ * binary heap with lazy deletion: improving a node just pushes it again and the
+ * stale entry is skipped when popped. Generation stamps let us reuse the node
+ * array between queries without clearing it.
  */
 /**
  * @brief Node structure for A* pathfinding.
  */
 typedef struct SysNode_ {
-   struct SysNode_ *next;  /**< Next node */
-   struct SysNode_ *gnext; /**< Next node in the garbage collector. */
-
-   struct SysNode_ *parent; /**< Parent node. */
-   StarSystem      *sys;    /**< System in node. */
-   int              g;      /**< step */
-   double           d;      /**< the distance to go access the systems. */
-   const vec2      *pos;    /**< position of the entry of the system. */
-} SysNode;                  /**< System Node for use in A* pathfinding. */
-static SysNode *A_gc;
+   int          parent; /**< Parent node (system id) or -1. */
+   int          g;      /**< step */
+   double       d;      /**< the distance to go access the systems. */
+   const vec2  *pos;    /**< position of the entry of the system. */
+   unsigned int open;   /**< Generation the node was last reached in. */
+   unsigned int closed; /**< Generation the node was last closed in. */
+} SysNode;              /**< System Node for use in A* pathfinding. */
+/**
+ * @brief Entry in the A* open set heap.
+ */
+typedef struct SysHeap_ {
+   int    id; /**< System id of the node. */
+   int    g;  /**< step when pushed. */
+   double d;  /**< distance when pushed. */
+} SysHeap;
+static SysNode     *A_nodes = NULL; /**< Nodes indexed by system id. */
+static SysHeap     *A_heap  = NULL; /**< Open set binary heap. */
+static unsigned int A_gen   = 0;    /**< Current search generation. */
+/**
+ * @brief Cached jump distances ignoring whether jumps are known.
+ *
+ * Indexed by whether hidden jumps are used and then by the source system id.
+ * Rows are filled lazily with a breadth-first search.
+ */
+static int **map_jumpDistCache[2] = { NULL, NULL };
 /* prototypes */
-static SysNode *A_newNode( StarSystem *sys );
-static int      A_g( const SysNode *n );
-static double   A_d( const SysNode *n );
-static int      A_less( const SysNode *op1, const SysNode *op2 );
-static SysNode *A_add( SysNode *first, SysNode *cur );
-static SysNode *A_rm( SysNode *first, const StarSystem *cur );
-static SysNode *A_in( SysNode *first, const StarSystem *cur );
-static SysNode *A_lowest( SysNode *first );
-static void     A_freeList( SysNode *first );
-static int      map_decorator_parse( MapDecorator *temp, const char *file );
-/** @brief Creates a new node link to star system. */
-static SysNode *A_newNode( StarSystem *sys )
-{
-   SysNode *n = malloc( sizeof( SysNode ) );
-
-   n->next = NULL;
-   n->sys  = sys;
-
-   n->gnext = A_gc;
-   A_gc     = n;
-
-   return n;
-}
-/** @brief Gets the g from a node. */
-static int A_g( const SysNode *n )
-{
-   return n->g;
-}
-/** @brief Gets the d from a node. */
-static double A_d( const SysNode *n )
-{
-   return n->d;
-}
-/** @brief op1 is less than op2. */
-static int A_less( const SysNode *op1, const SysNode *op2 )
-{
-   return ( A_g( op1 ) < A_g( op2 ) ) ||
-          ( A_g( op1 ) == A_g( op2 ) && A_d( op1 ) < A_d( op2 ) );
+static void A_reset( void );
+static int  A_less( int g1, double d1, int g2, double d2 );
+static void A_push( int id, int g, double d );
+static int  A_pop( SysHeap *out );
+static int  map_decorator_parse( MapDecorator *temp, const char *file );
+/** @brief Prepares the node array for a new search. */
+static void A_reset( void )
+{
+   int n = array_size( systems_stack );
+
+   if ( A_nodes == NULL ) {
+      A_nodes = array_create_size( SysNode, n );
+      A_heap  = array_create_size( SysHeap, n );
+   }
+   array_resize( &A_heap, 0 );
+
+   /* Universe changed size or generations wrapped, start fresh. */
+   A_gen++;
+   if ( ( array_size( A_nodes ) != n ) || ( A_gen == 0 ) ) {
+      array_resize( &A_nodes, n );
+      memset( A_nodes, 0, n * sizeof( SysNode ) );
+      A_gen = 1;
+   }
 }
-/** @brief Adds a node to the linked list. */
-static SysNode *A_add( SysNode *first, SysNode *cur )
+/** @brief Cost (g1,d1) is less than cost (g2,d2). */
+static int A_less( int g1, double d1, int g2, double d2 )
 {
-   SysNode *n;
-
-   if ( first == NULL )
-      return cur;
-
-   n = first;
-   while ( n->next != NULL )
-      n = n->next;
-   n->next = cur;
-
-   return first;
+   return ( g1 < g2 ) || ( g1 == g2 && d1 < d2 );
 }
-/* @brief Removes a node from a linked list. */
-static SysNode *A_rm( SysNode *first, const StarSystem *cur )
+/** @brief Pushes a node onto the open set heap. */
+static void A_push( int id, int g, double d )
 {
-   SysNode *n, *p;
+   const SysHeap e = { .id = id, .g = g, .d = d };
+   int           i = array_size( A_heap );
 
-   if ( first->sys == cur ) {
-      n           = first->next;
-      first->next = NULL;
-      return n;
-   }
-
-   p = first;
-   n = p->next;
-   do {
-      if ( n->sys == cur ) {
-         p->next = n->next;
-         n->next = NULL;
+   /* Sift the new element up from the bottom. */
+   array_push_back( &A_heap, e );
+   while ( i > 0 ) {
+      int p = ( i - 1 ) / 2;
+      if ( !A_less( g, d, A_heap[p].g, A_heap[p].d ) )
          break;
-      }
-      p = n;
-   } while ( ( n = n->next ) != NULL );
-
-   return first;
+      A_heap[i] = A_heap[p];
+      i         = p;
+   }
+   A_heap[i] = e;
 }
-/** @brief Checks to see if node is in linked list. */
-static SysNode *A_in( SysNode *first, const StarSystem *cur )
+/** @brief Pops the lowest ranking entry from the open set heap. */
+static int A_pop( SysHeap *out )
 {
-   SysNode *n;
-
-   if ( first == NULL )
-      return NULL;
+   int     n, i;
+   SysHeap last;
 
-   n = first;
-   do {
-      if ( n->sys == cur )
-         return n;
-   } while ( ( n = n->next ) != NULL );
-   return NULL;
+   n = array_size( A_heap );
+   if ( n <= 0 )
+      return 0;
+   *out = A_heap[0];
+   last = A_heap[n - 1];
+   n--;
+   array_resize( &A_heap, n );
+
+   /* Sift the last element down from the root. */
+   i = 0;
+   while ( 1 ) {
+      int c = 2 * i + 1;
+      if ( c >= n )
+         break;
+      if ( ( c + 1 < n ) &&
+           A_less( A_heap[c + 1].g, A_heap[c + 1].d, A_heap[c].g,
+                   A_heap[c].d ) )
+         c++;
+      if ( !A_less( A_heap[c].g, A_heap[c].d, last.g, last.d ) )
+         break;
+      A_heap[i] = A_heap[c];
+      i         = c;
+   }
+   if ( n > 0 )
+      A_heap[i] = last;
+   return 1;
 }
-/** @brief Returns the lowest ranking node from a linked list of nodes. */
-static SysNode *A_lowest( SysNode *first )
+/** @brief Frees the pathfinding data. */
+static void A_free( void )
 {
-   SysNode *lowest, *n;
-
-   if ( first == NULL )
-      return NULL;
-
-   n      = first;
-   lowest = n;
-   do {
-      if ( A_less( n, lowest ) )
-         lowest = n;
-   } while ( ( n = n->next ) != NULL );
-   return lowest;
-}
-/** @brief Frees a linked list. */
-static void A_freeList( SysNode *first )
-{
-   SysNode *p, *n;
-
-   if ( first == NULL )
-      return;
-
-   p = NULL;
-   n = first;
-   do {
-      free( p );
-      p = n;
-   } while ( ( n = n->gnext ) != NULL );
-   free( p );
+   array_free( A_nodes );
+   array_free( A_heap );
+   A_nodes = NULL;
+   A_heap  = NULL;
+   A_gen   = 0;
+   map_jumpDistInvalidate();
 }
 
 /** @brief Sets map_zoom to zoom and recreates the faction disk texture. */
@@ -2946,14 +2933,11 @@ StarSystem **map_getJumpPath( StarSystem *sysstart, const vec2 *posstart,
                               int show_hidden, StarSystem **old_data,
                               double *o_distance )
 {
-   int         j, ojumps;
+   int         j, ojumps, cur;
    StarSystem *ssys, *esys, **res;
+   SysNode    *node;
+   SysHeap     top;
 
-   SysNode *cur, *neighbour;
-   SysNode *open, *closed;
-   SysNode *ocost, *ccost;
-
-   A_gc   = NULL;
    res    = old_data;
    ojumps = array_size( old_data );
 
@@ -2978,6 +2962,12 @@ StarSystem **map_getJumpPath( StarSystem *sysstart, const vec2 *posstart,
       return NULL;
    }
 
+   /* Cheap rejection of unconnected systems with the cached distances. */
+   if ( ignore_known && ( map_jumpDist( ssys, esys, show_hidden ) < 0 ) ) {
+      array_free( res );
+      return NULL;
+   }
+
    /* initial entry position */
    const vec2 *p_pos_entry = ( ojumps > 0 ) ? NULL : posstart;
    if ( ojumps > 0 ) {
@@ -2991,20 +2981,32 @@ StarSystem **map_getJumpPath( StarSystem *sysstart, const vec2 *posstart,
       }
    }
 
-   /* start the linked lists */
-   open = closed = NULL;
-   cur           = A_newNode( ssys );
-   cur->parent   = NULL;
-   cur->g        = 0;
-   cur->d        = 0.0;
-   cur->pos      = p_pos_entry;
-   open = A_add( open, cur ); /* Initial open node is the start system */
+   /* Initial open node is the start system. */
+   A_reset();
+   node         = &A_nodes[ssys->id];
+   node->parent = -1;
+   node->g      = 0;
+   node->d      = 0.0;
+   node->pos    = p_pos_entry;
+   node->open   = A_gen;
+   A_push( ssys->id, 0, 0.0 );
+
+   j   = 0;
+   cur = ssys->id;
+   while ( A_pop( &top ) ) {
+      int         cost;
+      StarSystem *csys;
+
+      /* Skip stale entries superseded by a better path. */
+      node = &A_nodes[top.id];
+      if ( ( node->closed == A_gen ) || ( node->g != top.g ) ||
+           ( node->d != top.d ) )
+         continue;
+      cur  = top.id;
+      csys = &systems_stack[cur];
 
-   j = 0;
-   while ( ( cur = A_lowest( open ) ) ) {
-      int cost;
       /* End condition. */
-      if ( cur->sys == esys )
+      if ( csys == esys )
          break;
 
       /* Break if infinite loop. */
@@ -3012,14 +3014,14 @@ StarSystem **map_getJumpPath( StarSystem *sysstart, const vec2 *posstart,
       if ( j > MAP_LOOP_PROT )
          break;
 
-      /* Get best from open and toss to closed */
-      open   = A_rm( open, cur->sys );
-      closed = A_add( closed, cur );
-      cost = A_g( cur ) + 1; /* Base unit is jump and always increases by 1. */
+      /* Toss to closed. */
+      node->closed = A_gen;
+      cost = node->g + 1; /* Base unit is jump and always increases by 1. */
 
-      for ( int i = 0; i < array_size( cur->sys->jumps ); i++ ) {
-         JumpPoint  *jp  = &cur->sys->jumps[i];
+      for ( int i = 0; i < array_size( csys->jumps ); i++ ) {
+         JumpPoint  *jp  = &csys->jumps[i];
          StarSystem *sys = jp->target;
+         SysNode    *n   = &A_nodes[sys->id];
 
          /* Make sure it's reachable */
          if ( !ignore_known ) {
@@ -3035,69 +3037,134 @@ StarSystem **map_getJumpPath( StarSystem *sysstart, const vec2 *posstart,
          if ( !show_hidden && jp_isFlag( jp, JP_HIDDEN ) )
             continue;
 
+         /* Costs only ever increase, so closed nodes can't be improved. */
+         if ( n->closed == A_gen )
+            continue;
+
          /* Update cost */
-         const SysNode n_cost = { .g = cost,
-                                  .d = A_d( cur ) +
-                                       ( ( cur->pos != NULL )
-                                            ? vec2_dist( cur->pos, &jp->pos )
-                                            : 0.0 ) };
-
-         /* Check to see if it's already in the closed set. */
-         ccost = A_in( closed, sys );
-         if ( ( ccost != NULL ) && !A_less( &n_cost, ccost ) )
+         double d = node->d + ( ( node->pos != NULL )
+                                   ? vec2_dist( node->pos, &jp->pos )
+                                   : 0.0 );
+
+         /* Ignore if this path is worse than the one already open. */
+         if ( ( n->open == A_gen ) && !A_less( cost, d, n->g, n->d ) )
             continue;
-         // closed = A_rm( closed, sys );
-
-         /* Remove if it exists and current is better. */
-         ocost = A_in( open, sys );
-         if ( ocost != NULL ) {
-            if ( A_less( &n_cost, ocost ) )
-               open = A_rm( open, sys ); /* New path is better */
-            else
-               continue; /* This node is worse, so ignore it. */
-         }
 
-         /* Create the node. */
-         const JumpPoint *jp_entry = jump_getTarget( cur->sys, sys );
-         neighbour                 = A_newNode( sys );
-         neighbour->parent         = cur;
-         neighbour->g              = n_cost.g;
-         neighbour->d              = n_cost.d;
-         neighbour->pos = ( jp_entry != NULL ) ? &jp_entry->pos : NULL;
-         open           = A_add( open, neighbour );
+         /* Open the node with the new best path. */
+         const JumpPoint *jp_entry = jump_getTarget( csys, sys );
+         n->parent                 = cur;
+         n->g                      = cost;
+         n->d                      = d;
+         n->pos  = ( jp_entry != NULL ) ? &jp_entry->pos : NULL;
+         n->open = A_gen;
+         A_push( sys->id, cost, d );
       }
-
-      /* Safety check in case not linked. */
-      if ( open == NULL )
-         break;
    }
 
+   node = &A_nodes[cur];
    if ( o_distance != NULL ) {
-      *o_distance = cur->d;
+      *o_distance = node->d;
    }
 
    /* Build path backwards if not broken from loop. */
-   if ( cur != NULL && esys == cur->sys ) {
-      int njumps = A_g( cur ) + ojumps;
+   if ( esys->id == cur ) {
+      int njumps = node->g + ojumps;
       assert( njumps > ojumps );
       if ( res == NULL )
          res = array_create_size( StarSystem *, njumps );
       array_resize( &res, njumps );
       /* Build path. */
       for ( int i = 0; i < njumps - ojumps; i++ ) {
-         res[njumps - i - 1] = cur->sys;
-         cur                 = cur->parent;
+         res[njumps - i - 1] = &systems_stack[cur];
+         cur                 = A_nodes[cur].parent;
       }
    } else {
       res = NULL;
       array_free( old_data );
    }
 
-   /* free the linked lists */
-   A_freeList( A_gc );
    return res;
 }
 
+/**
+ * @brief Gets the number of jumps between two systems ignoring whether or not
+ * the systems and jump points are known.
+ *
+ * Distances are computed a whole source system at a time and cached until
+ * map_jumpDistInvalidate() is called.
+ *
+ *    @param start System to start from.
+ *    @param goal System to get to.
+ *    @param show_hidden Whether or not to use hidden jump points.
+ *    @return Number of jumps or -1 if goal is not reachable.
+ */
+int map_jumpDist( const StarSystem *start, const StarSystem *goal,
+                  int show_hidden )
+{
+   int   n, h, *row, *queue, qs, qe;
+   int **cache;
+
+   n     = array_size( systems_stack );
+   h     = !!show_hidden;
+   cache = map_jumpDistCache[h];
+   if ( array_size( cache ) != n ) {
+      map_jumpDistInvalidate();
+      cache = array_create_size( int *, n );
+      array_resize( &cache, n );
+      memset( cache, 0, n * sizeof( int * ) );
+      map_jumpDistCache[h] = cache;
+   }
+
+   row = cache[start->id];
+   if ( row != NULL )
+      return row[goal->id];
+
+   /* Breadth-first search from the start system. */
+   row   = malloc( n * sizeof( int ) );
+   queue = malloc( n * sizeof( int ) );
+   for ( int i = 0; i < n; i++ )
+      row[i] = -1;
+   row[start->id] = 0;
+   qs             = 0;
+   qe             = 0;
+   queue[qe++]    = start->id;
+   while ( qs < qe ) {
+      const StarSystem *sys = &systems_stack[queue[qs++]];
+      for ( int i = 0; i < array_size( sys->jumps ); i++ ) {
+         const JumpPoint *jp = &sys->jumps[i];
+         int              t  = jp->target->id;
+         if ( row[t] >= 0 )
+            continue;
+         if ( jp_isFlag( jp, JP_EXITONLY ) )
+            continue;
+         if ( !show_hidden && jp_isFlag( jp, JP_HIDDEN ) )
+            continue;
+         row[t]      = row[sys->id] + 1;
+         queue[qe++] = t;
+      }
+   }
+   free( queue );
+
+   cache[start->id] = row;
+   return row[goal->id];
+}
+
+/**
+ * @brief Invalidates the cached jump distances.
+ *
+ * Must be called whenever jumps are added, removed or have their flags
+ * changed.
+ */
+void map_jumpDistInvalidate( void )
+{
+   for ( int h = 0; h < 2; h++ ) {
+      for ( int i = 0; i < array_size( map_jumpDistCache[h] ); i++ )
+         free( map_jumpDistCache[h][i] );
+      array_free( map_jumpDistCache[h] );
+      map_jumpDistCache[h] = NULL;
+   }
+}
+
 /**
  * @brief Marks maps around a radius of currently system as known.
  *
@@ -57,6 +57,9 @@ StarSystem **map_getJumpPath( StarSystem *sysstart, const vec2 *posstart,
                               StarSystem *sysend, int ignore_known,
                               int show_hidden, StarSystem **old_data,
                               double *o_distance );
+int          map_jumpDist( const StarSystem *start, const StarSystem *goal,
+                           int show_hidden );
+void         map_jumpDistInvalidate( void );
 int          map_map( const Outfit *map );
 int          map_isUseless( const Outfit *map );
 
@@ -35,6 +35,7 @@
 #include "player_fleet.h"
 #include "rng.h"
 #include "space.h"
+#include "threadpool.h"
 
 #define XML_MISSION_TAG "mission" /**< XML mission tag. */
 
@@ -51,6 +52,15 @@ static char       **player_missions_failed =
  */
 static MissionData *mission_stack = NULL; /**< Unmutable after creation */
 
+/**
+ * @brief A mission file that has been read and had its XML header parsed.
+ */
+typedef struct MissionFile_ {
+   const char *file;    /**< Source file path. */
+   char       *filebuf; /**< Contents of the file. */
+   xmlDocPtr   doc;     /**< Parsed XML header, NULL if not a mission. */
+} MissionFile;
+
 /*
  * prototypes
  */
@@ -67,10 +77,13 @@ static int mission_meetReq( const MissionData *misn, int faction,
 static int mission_matchFaction( const MissionData *misn, int faction );
 static int mission_location( const char *loc );
 /* Loading. */
-static int missions_cmp( const void *a, const void *b );
-static int mission_parseFile( const char *file, MissionData *temp );
-static int mission_parseXML( MissionData *temp, const xmlNodePtr parent );
-static int missions_parseActive( xmlNodePtr parent );
+static int  missions_cmp( const void *a, const void *b );
+static int  mission_parseFile( const char *file, MissionData *temp );
+static int  mission_readFile( MissionFile *mf );
+static void mission_readRange( int start, int end, void *data );
+static int  mission_loadFile( MissionFile *mf, MissionData *temp );
+static int  mission_parseXML( MissionData *temp, const xmlNodePtr parent );
+static int  missions_parseActive( xmlNodePtr parent );
 /* Misc. */
 static const char *mission_markerTarget( const MissionMarker *m );
 static int         mission_markerLoad( Mission *misn, xmlNodePtr node );
@@ -1170,16 +1183,25 @@ int missions_load( void )
 #if DEBUGGING
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
-   char **mission_files;
+   char       **mission_files;
+   MissionFile *mfs;
 
-   /* Run over missions. */
+   /* Read and parse the headers in parallel. */
    mission_files = ndata_listRecursive( MISSION_DATA_PATH );
+   mfs           = calloc( array_size( mission_files ), sizeof( MissionFile ) );
+   for ( int i = 0; i < array_size( mission_files ); i++ )
+      mfs[i].file = mission_files[i];
+   job_parallelFor( array_size( mission_files ), 1, mission_readRange, mfs );
+
+   /* Run over missions, Lua has to be done in order. */
    mission_stack =
       array_create_size( MissionData, array_size( mission_files ) );
    for ( int i = 0; i < array_size( mission_files ); i++ ) {
-      mission_parseFile( mission_files[i], NULL );
+      if ( mfs[i].doc != NULL )
+         mission_loadFile( &mfs[i], NULL );
       free( mission_files[i] );
    }
+   free( mfs );
    array_free( mission_files );
    array_shrink( &mission_stack );
 
@@ -1220,61 +1242,104 @@ int missions_load( void )
  */
 static int mission_parseFile( const char *file, MissionData *temp )
 {
-   xmlDocPtr   doc;
-   xmlNodePtr  node;
+   MissionFile mf = { .file = file };
+   if ( mission_readFile( &mf ) )
+      return -1;
+   return mission_loadFile( &mf, temp );
+}
+
+/**
+ * @brief Reads a mission file and parses its XML header.
+ *
+ * Doesn't touch any global state, so it can be run from other threads.
+ *
+ *    @param mf Mission file to read, only file has to be set.
+ *    @return 0 on success.
+ */
+static int mission_readFile( MissionFile *mf )
+{
    size_t      bufsize;
-   char       *filebuf;
    const char *pos, *start_pos;
+   const char *file = mf->file;
 
    /* Load string. */
-   filebuf = ndata_read( file, &bufsize );
-   if ( filebuf == NULL ) {
+   mf->filebuf = ndata_read( file, &bufsize );
+   if ( mf->filebuf == NULL ) {
       WARN( _( "Unable to read data from '%s'" ), file );
       return -1;
    }
-   if ( bufsize == 0 ) {
-      free( filebuf );
-      return -1;
-   }
+   if ( bufsize == 0 )
+      goto err;
 
    /* Skip if no XML. */
-   pos = strnstr( filebuf, "</mission>", bufsize );
+   pos = strnstr( mf->filebuf, "</mission>", bufsize );
    if ( pos == NULL ) {
-      pos = strnstr( filebuf, "function create", bufsize );
+      pos = strnstr( mf->filebuf, "function create", bufsize );
       if ( ( pos != NULL ) && !strncmp( pos, "--common", bufsize ) )
          WARN( _( "Mission '%s' has create function but no XML header!" ),
                file );
-      free( filebuf );
-      return -1;
+      goto err;
    }
 
    /* Separate XML header and Lua. */
-   start_pos = strnstr( filebuf, "<?xml ", bufsize );
-   pos       = strnstr( filebuf, "--]]", bufsize );
+   start_pos = strnstr( mf->filebuf, "<?xml ", bufsize );
+   pos       = strnstr( mf->filebuf, "--]]", bufsize );
    if ( pos == NULL || start_pos == NULL ) {
       WARN( _( "Mission file '%s' has missing XML header!" ), file );
-      return -1;
+      goto err;
    }
 
    /* Parse the header. */
-   doc = xmlParseMemory( start_pos, pos - start_pos );
-   if ( doc == NULL ) {
+   mf->doc = xmlParseMemory( start_pos, pos - start_pos );
+   if ( mf->doc == NULL ) {
       WARN( _( "Unable to parse document XML header for Mission '%s'" ), file );
-      return -1;
+      goto err;
    }
 
-   node = doc->xmlChildrenNode;
+   return 0;
+
+err:
+   free( mf->filebuf );
+   mf->filebuf = NULL;
+   return -1;
+}
+
+/**
+ * @brief Reads a range of mission files for job_parallelFor.
+ */
+static void mission_readRange( int start, int end, void *data )
+{
+   MissionFile *mfs = data;
+   for ( int i = start; i < end; i++ )
+      mission_readFile( &mfs[i] );
+}
+
+/**
+ * @brief Sets up a mission from a read mission file.
+ *
+ *    @param mf Mission file that was read, gets cleaned up.
+ *    @param temp Data to load into, or NULL for initial load.
+ *    @return 0 on success.
+ */
+static int mission_loadFile( MissionFile *mf, MissionData *temp )
+{
+   xmlNodePtr  node;
+   const char *file = mf->file;
+
+   node = mf->doc->xmlChildrenNode;
    if ( !xml_isNode( node, XML_MISSION_TAG ) ) {
       WARN( _( "Malformed XML header for '%s' mission: missing root element "
                "'%s'" ),
             file, XML_MISSION_TAG );
+      xmlFreeDoc( mf->doc );
+      free( mf->filebuf );
       return -1;
    }
 
    if ( temp == NULL )
       temp = &array_grow( &mission_stack );
    mission_parseXML( temp, node );
-   temp->lua        = filebuf;
+   temp->lua        = mf->filebuf;
    temp->sourcefile = strdup( file );
 
    /* Clear chunk if already loaded. */
@@ -1285,7 +1350,7 @@ static int mission_parseFile( const char *file, MissionData *temp )
 
    /* Load the chunk. */
    int ret =
-      luaL_loadbuffer( naevL, temp->lua, strlen( temp->lua ), temp->name );
+      nlua_loadbuffer( naevL, temp->lua, strlen( temp->lua ), temp->name );
    if ( ret == LUA_ERRSYNTAX )
       WARN( _( "Mission Lua '%s' syntax error: %s" ), file,
             lua_tostring( naevL, -1 ) );
@@ -1293,7 +1358,7 @@ static int mission_parseFile( const char *file, MissionData *temp )
       temp->chunk = luaL_ref( naevL, LUA_REGISTRYINDEX );
 
    /* Clean up. */
-   xmlFreeDoc( doc );
+   xmlFreeDoc( mf->doc );
 
    return 0;
 }
@@ -55,9 +55,11 @@
 #include "mission.h"
 #include "music.h"
 #include "ndata.h"
+#include "ndata_bundle.h"
 #include "nebula.h"
 #include "news.h"
 #include "nfile.h"
+#include "nlua.h"
 #include "nlua_colour.h"
 #include "nlua_data.h"
 #include "nlua_file.h"
@@ -121,6 +123,8 @@ static nlua_env load_env =
 static int          load_force_render = 0;
 static unsigned int load_last_render  = 0;
 static SDL_mutex   *load_mutex;
+static char        *load_stage_msg    = NULL; /**< Current loading stage. */
+static Uint64       load_stage_start  = 0;    /**< When the stage started. */
 
 /*
  * prototypes
@@ -139,6 +143,36 @@ static void update_all( int dohooks );
 static void loadscreen_update( double done, const char *msg );
 void        main_loop( int nested ); /* externed in dialogue.c */
 
+/**
+ * @brief Per-stage timings of update_routine, only gathered when benchmarking.
+ *
+ * All times are in performance counter units.
+ */
+typedef struct UpdateStats_ {
+   Uint64 ticks;           /**< Number of update_routine calls. */
+   Uint64 total;           /**< Total time spent in update_routine. */
+   Uint64 pilots_purge;    /**< Time spent in pilots_updatePurge. */
+   Uint64 weapons_purge;   /**< Time spent in weapons_updatePurge. */
+   Uint64 weapons_collide; /**< Time spent in weapons_updateCollide. */
+   Uint64 pilots_update;   /**< Time spent in pilots_update. */
+   Uint64 weapons_update;  /**< Time spent in weapons_update. */
+} UpdateStats;
+static UpdateStats *update_stats = NULL; /**< Set by naevbench to gather
+                                            update_routine timings. */
+/**
+ * @brief Runs an update stage, timing it if update_stats is set.
+ */
+#define UPDATE_STAGE( field, call )                                            \
+   do {                                                                        \
+      if ( update_stats == NULL ) {                                            \
+         call;                                                                 \
+      } else {                                                                 \
+         Uint64 _t = SDL_GetPerformanceCounter();                              \
+         call;                                                                 \
+         update_stats->field += SDL_GetPerformanceCounter() - _t;              \
+      }                                                                        \
+   } while ( 0 )
+
 /**
  * @brief Flags naev to quit.
  */
@@ -547,6 +581,7 @@ int main( int argc, char **argv )
    log_clean();
 
    /* Really turn the lights off. */
+   ndata_bundleClose();
    PHYSFS_deinit();
    gl_fontExit();
    gettext_exit();
@@ -654,6 +689,16 @@ void naev_renderLoadscreen( void )
  */
 void loadscreen_update( double done, const char *msg )
 {
+   /* Report how long the previous stage took. */
+   if ( load_stage_msg != NULL ) {
+      Uint64 t = SDL_GetPerformanceCounter() - load_stage_start;
+      if ( conf.devmode )
+         LOG( _( "%s %.3f s" ), load_stage_msg,
+              (double)t / (double)SDL_GetPerformanceFrequency() );
+      free( load_stage_msg );
+      load_stage_msg = NULL;
+   }
+
    /* Run Lua. */
    nlua_getenv( naevL, load_env, "update" );
    lua_pushnumber( naevL, done );
@@ -666,6 +711,12 @@ void loadscreen_update( double done, const char *msg )
    /* Force rerender. */
    load_force_render = 1;
    naev_renderLoadscreen();
+
+   /* Time the next stage, not counting rendering. */
+   if ( done < 1. ) {
+      load_stage_msg   = strdup( msg );
+      load_stage_start = SDL_GetPerformanceCounter();
+   }
 }
 
 /**
@@ -673,6 +724,8 @@ void loadscreen_update( double done, const char *msg )
  */
 static void loadscreen_unload( void )
 {
+   free( load_stage_msg );
+   load_stage_msg = NULL;
    nlua_freeEnv( load_env );
    SDL_DestroyMutex( load_mutex );
 }
@@ -756,6 +809,8 @@ void load_all( void )
    weapon_init();
    player_init(); /* Initialize player stuff. */
    loadscreen_update( 1., _( "Loading Completed!" ) );
+   if ( conf.devmode )
+      nlua_bytecodeReport();
 
    NTracingFrameMarkEnd( "load_all" );
 }
@@ -837,10 +892,23 @@ void main_loop( int nested )
    if ( !quit ) { /* So if update sets up a nested main loop, we can end up in a
                      state where things are corrupted when trying to exit the
                      game. Avoid rendering when quitting just in case. */
+      double gc_budget;
+
       /* Clear buffer. */
       render_all( game_dt, real_dt );
       /* Draw buffer. */
       SDL_GL_SwapWindow( gl_screen.window );
+      gl_fontEndFrame();
+
+      /* Collect Lua garbage in the idle part of the frame. When the fps is
+       * limited, the time that would be spent sleeping is used too. */
+      gc_budget = NLUA_GC_BUDGET;
+      if ( !conf.vsync && conf.fps_max != 0 ) {
+         double dt = (double)( SDL_GetPerformanceCounter() - last_t ) /
+                     (double)SDL_GetPerformanceFrequency();
+         gc_budget = MAX( gc_budget, 1. / (double)conf.fps_max - dt );
+      }
+      nlua_gcStep( gc_budget );
 
       /* if fps is limited */
       if ( !conf.vsync && conf.fps_max != 0 ) {
@@ -974,6 +1042,15 @@ void fps_display( double dt )
       y -= gl_defFontMono.h + 5.;
    }
 
+   if ( debug_isFlag( DEBUG_LUA_GC ) ) {
+      double heap, pause;
+      nlua_gcStats( &heap, &pause );
+      gl_print( &gl_defFontMono, x, y, &cFontWhite, "Lua %.0f KiB", heap );
+      y -= gl_defFontMono.h + 5.;
+      gl_print( &gl_defFontMono, x, y, &cFontWhite, "GC %.2f ms", pause );
+      y -= gl_defFontMono.h + 5.;
+   }
+
    if ( ( player.p != NULL ) && !player_isFlag( PLAYER_DESTROYED ) &&
         !player_isFlag( PLAYER_CREATING ) ) {
       dt_mod_base = player_dt_default();
@@ -1061,6 +1138,7 @@ void update_routine( double dt, int dohooks )
    NTracingZone( _ctx, 1 );
 
    double real_update = dt / dt_mod;
+   Uint64 t0 = ( update_stats != NULL ) ? SDL_GetPerformanceCounter() : 0;
 
    if ( dohooks ) {
       hook_exclusionStart();
@@ -1070,8 +1148,8 @@ void update_routine( double dt, int dohooks )
    }
 
    /* Clean up dead elements and build quadtrees. */
-   pilots_updatePurge();
-   weapons_updatePurge();
+   UPDATE_STAGE( pilots_purge, pilots_updatePurge() );
+   UPDATE_STAGE( weapons_purge, weapons_updatePurge() );
 
    /* Core stuff independent of collisions. */
    space_update( dt, real_update );
@@ -1079,9 +1157,10 @@ void update_routine( double dt, int dohooks )
 
    if ( dt > 0. ) {
       /* First compute weapon collisions. */
-      weapons_updateCollide( dt );
-      pilots_update( dt );
-      weapons_update( dt ); /* Has weapons think and update positions. */
+      UPDATE_STAGE( weapons_collide, weapons_updateCollide( dt ) );
+      UPDATE_STAGE( pilots_update, pilots_update( dt ) );
+      /* Has weapons think and update positions. */
+      UPDATE_STAGE( weapons_update, weapons_update( dt ) );
 
       /* Update camera. */
       cam_update( dt );
@@ -1108,6 +1187,11 @@ void update_routine( double dt, int dohooks )
    /* Update the elapsed time, should be with all the modifications and such. */
    elapsed_time_mod += dt;
 
+   if ( update_stats != NULL ) {
+      update_stats->ticks++;
+      update_stats->total += SDL_GetPerformanceCounter() - t0;
+   }
+
    NTracingZoneEnd( _ctx );
 }
 
@@ -0,0 +1,446 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file naevbench.c
+ *
+ * @brief Headless deterministic simulation benchmark.
+ *
+ * Loads all the data, enters a system and drives update_routine() at a fixed
+ * delta tick with a fixed random seed, reporting ticks per second and the
+ * time spent in each of the main update stages. Sound is disabled and nothing
+ * is rendered beyond the loading screen of a hidden window.
+ *
+ * Usage: naevbench [OPTIONS] SYSTEM SECONDS [SEED] [DT]
+ *
+ * Lua garbage is also accounted for: the collector only runs between ticks,
+ * so the heap growth of each tick is what the scripts allocated. Busy systems
+ * with large battles are the most interesting here.
+ *
+ * Alternatively, "naevbench threadpool [JOBS]" compares the overhead of the
+ * vpool against the job system on many tiny jobs and exits, while
+ * "naevbench [OPTIONS] safelanes" loads the data and times full and
+ * incremental safe lane recomputations. Finally, "naevbench [OPTIONS] bundle"
+ * writes the ndata bundle to the cache path and compares reading the bundled
+ * files with and without it.
+ */
+#define NOMAIN 1
+#include "naev.c"
+
+#include "array.h"
+
+#define BENCH_SEED_DEFAULT 1337      /**< Default random seed. */
+#define BENCH_DT_DEFAULT ( 1. / 60. ) /**< Default fixed delta tick. */
+#define BENCH_JOBS_DEFAULT 100000     /**< Default jobs for threadpool bench. */
+#define BENCH_LUA_HEAP                                                         \
+   65536. /**< Lua heap growth in KiB before collecting between ticks. */
+
+const char *__asan_default_options()
+{
+   return "detect_leaks=0";
+}
+
+static SDL_atomic_t bench_counter; /**< Work done by the threadpool bench. */
+
+/**
+ * @brief Tiny job for the threadpool benchmark.
+ */
+static int bench_job( void *data )
+{
+   (void)data;
+   SDL_AtomicAdd( &bench_counter, 1 );
+   return 0;
+}
+
+/**
+ * @brief Tiny parallel for body for the threadpool benchmark.
+ */
+static void bench_range( int start, int end, void *data )
+{
+   (void)data;
+   SDL_AtomicAdd( &bench_counter, end - start );
+}
+
+/**
+ * @brief Compares the vpool against the job system.
+ *
+ *    @param n Number of jobs to run with each.
+ */
+static void bench_threadpool( int n )
+{
+   const double freq = (double)SDL_GetPerformanceFrequency();
+   Uint64       t;
+   ThreadQueue *tq;
+   JobGroup    *g;
+
+   LOG( _( "Running %d jobs with %d job workers…" ), n, job_workers() );
+
+   SDL_AtomicSet( &bench_counter, 0 );
+   t  = SDL_GetPerformanceCounter();
+   tq = vpool_create();
+   for ( int i = 0; i < n; i++ )
+      vpool_enqueue( tq, bench_job, NULL );
+   vpool_wait( tq );
+   vpool_cleanup( tq );
+   t = SDL_GetPerformanceCounter() - t;
+   LOG( "   %-16s %10.1f ns/job (%d done)", "vpool", 1e9 * (double)t / freq / n,
+        SDL_AtomicGet( &bench_counter ) );
+
+   SDL_AtomicSet( &bench_counter, 0 );
+   t = SDL_GetPerformanceCounter();
+   g = jobgroup_create();
+   for ( int i = 0; i < n; i++ )
+      job_submit( g, bench_job, NULL );
+   job_wait( g );
+   jobgroup_free( g );
+   t = SDL_GetPerformanceCounter() - t;
+   LOG( "   %-16s %10.1f ns/job (%d done)", "job_submit",
+        1e9 * (double)t / freq / n, SDL_AtomicGet( &bench_counter ) );
+
+   SDL_AtomicSet( &bench_counter, 0 );
+   t = SDL_GetPerformanceCounter();
+   job_parallelFor( n, 1, bench_range, NULL );
+   t = SDL_GetPerformanceCounter() - t;
+   LOG( "   %-16s %10.1f ns/job (%d done)", "job_parallelFor",
+        1e9 * (double)t / freq / n, SDL_AtomicGet( &bench_counter ) );
+}
+
+/**
+ * @brief Times a single safe lane recomputation.
+ */
+static void bench_safelanesOnce( const char *name )
+{
+   const double freq = (double)SDL_GetPerformanceFrequency();
+   Uint64       t    = SDL_GetPerformanceCounter();
+   safelanes_recalculate();
+   t = SDL_GetPerformanceCounter() - t;
+   LOG( "   %-22s %10.3f ms", name, 1e3 * (double)t / freq );
+}
+
+/**
+ * @brief Compares full safe lane recomputations against incremental ones.
+ */
+static void bench_safelanes( void )
+{
+   StarSystem *systems = system_getAll();
+   Spob       *spob    = NULL;
+
+   safelanes_invalidate();
+   bench_safelanesOnce( "full" );
+   bench_safelanesOnce( "unchanged" );
+
+   /* Nudge the presence of a single spob like a unidiff would. */
+   for ( int i = 0; ( i < array_size( systems ) ) && ( spob == NULL ); i++ )
+      for ( int j = 0; j < array_size( systems[i].spobs ); j++ )
+         if ( systems[i].spobs[j]->presence.faction >= 0 ) {
+            spob = systems[i].spobs[j];
+            break;
+         }
+   if ( spob == NULL )
+      return;
+   spob->presence.bonus += 1.;
+   bench_safelanesOnce( "one spob changed" );
+   spob->presence.bonus -= 1.;
+   bench_safelanesOnce( "one spob restored" );
+}
+
+/**
+ * @brief Times reading a list of files through ndata_read().
+ */
+static void bench_bundleRead( const char *name, char **files )
+{
+   const double freq  = (double)SDL_GetPerformanceFrequency();
+   size_t       total = 0;
+   Uint64       t     = SDL_GetPerformanceCounter();
+   for ( int i = 0; i < array_size( files ); i++ ) {
+      size_t size;
+      free( ndata_read( files[i], &size ) );
+      total += size;
+   }
+   t = SDL_GetPerformanceCounter() - t;
+   LOG( "   %-22s %10.3f ms (%.1f MiB)", name, 1e3 * (double)t / freq,
+        (double)total / ( 1024. * 1024. ) );
+}
+
+/**
+ * @brief Builds the ndata bundle and compares reading with and without it.
+ *
+ *    @return 0 on success.
+ */
+static int bench_bundle( void )
+{
+   char  *path;
+   char **files;
+   int    ret;
+
+   nfile_dirMakeExist( nfile_cachePath() );
+   SDL_asprintf( &path, "%s%s", nfile_cachePath(), NDATA_BUNDLE_FILE );
+   ret = ndata_bundleBuild( path );
+   free( path );
+   if ( ret )
+      return ret;
+
+   /* Both passes run on a warm OS file cache. */
+   files = ndata_bundleFiles();
+   bench_bundleRead( "without bundle", files );
+   if ( ndata_bundleOpen() == 0 ) {
+      bench_bundleRead( "with bundle", files );
+      ndata_bundleClose();
+   }
+   for ( int i = 0; i < array_size( files ); i++ )
+      free( files[i] );
+   array_free( files );
+   return 0;
+}
+
+/**
+ * @brief Logs a single stage of the update statistics.
+ */
+static void bench_logStage( const char *name, Uint64 t, Uint64 total,
+                            Uint64 ticks )
+{
+   const double freq = (double)SDL_GetPerformanceFrequency();
+   LOG( "   %-22s %10.3f ms total %8.4f ms/tick %6.2f%%", name,
+        1e3 * (double)t / freq, 1e3 * (double)t / freq / (double)ticks,
+        100. * (double)t / (double)MAX( total, 1 ) );
+}
+
+int main( int argc, char **argv )
+{
+   char        conf_file_path[PATH_MAX], **search_path;
+   const char *sysname;
+   double      seconds, dt;
+   int         lanes, bundle;
+   uint32_t    seed;
+   int         n;
+   UpdateStats stats;
+
+#ifdef DEBUGGING
+   /* Set Debugging flags. */
+   memset( debug_flags, 0, DEBUG_FLAGS_MAX );
+#endif /* DEBUGGING */
+
+   env_detect( argc, argv );
+
+   log_init();
+
+   /* Set up PhysicsFS. */
+   if ( PHYSFS_init( env.argv0 ) == 0 ) {
+      ERR( "PhysicsFS initialization failed: %s",
+           PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) );
+      return -1;
+   }
+   PHYSFS_permitSymbolicLinks( 1 );
+
+   /* Set up locales. */
+   gettext_init();
+   init_linebreak();
+
+   /* Parse version. */
+   if ( semver_parse( naev_version( 0 ), &version_binary ) )
+      WARN( _( "Failed to parse version string '%s'!" ), naev_version( 0 ) );
+
+   /* Print the version */
+   LOG( " %s v%s (%s)", APPNAME, naev_version( 0 ), HOST );
+
+   /* Initializes SDL for possible warnings. */
+   if ( SDL_Init( 0 ) ) {
+      ERR( _( "Unable to initialize SDL: %s" ), SDL_GetError() );
+      return -1;
+   }
+
+   /* Initialize the threadpool */
+   threadpool_init();
+
+   /* Threadpool microbenchmark doesn't need anything else. */
+   if ( ( argc > 1 ) && ( strcmp( argv[1], "threadpool" ) == 0 ) ) {
+      bench_threadpool(
+         MAX( 1, ( argc > 2 ) ? atoi( argv[2] ) : BENCH_JOBS_DEFAULT ) );
+      return 0;
+   }
+
+   /* Set up debug signal handlers. */
+   debug_sigInit();
+
+   /* Must be initialized before input_init is called. */
+   if ( SDL_InitSubSystem( SDL_INIT_VIDEO ) < 0 ) {
+      WARN( _( "Unable to initialize SDL Video: %s" ), SDL_GetError() );
+      return -1;
+   }
+
+   /* We'll be parsing XML. */
+   LIBXML_TEST_VERSION
+   xmlInitParser();
+
+   /* Input must be initialized for config to work. */
+   input_init();
+
+   lua_init(); /* initializes lua */
+   fps_init(); /* Not actually necessary, but removes warning. */
+
+   conf_setDefaults(); /* set the default config values */
+   conf_loadConfigPath();
+
+   /* Set the configuration. */
+   snprintf( conf_file_path, sizeof( conf_file_path ), "%s" CONF_FILE,
+             nfile_configPath() );
+
+   conf_loadConfig( conf_file_path ); /* Lua to parse the configuration file */
+   int opt = conf_parseCLI( argc, argv ); /* parse CLI arguments */
+   lanes  = ( opt < argc ) && ( strcmp( argv[opt], "safelanes" ) == 0 );
+   bundle = ( opt < argc ) && ( strcmp( argv[opt], "bundle" ) == 0 );
+   if ( lanes || bundle ) {
+      sysname = NULL;
+      seconds = 1.;
+      opt++;
+   } else if ( opt + 2 > argc ) {
+      LOG( _( "Usage: %s [OPTIONS] SYSTEM SECONDS [SEED] [DT]" ), argv[0] );
+      return -1;
+   } else {
+      sysname = argv[opt++];
+      seconds = atof( argv[opt++] );
+   }
+   seed    = ( opt < argc ) ? (uint32_t)strtoul( argv[opt++], NULL, 10 )
+                            : BENCH_SEED_DEFAULT;
+   dt      = ( opt < argc ) ? atof( argv[opt++] ) : BENCH_DT_DEFAULT;
+   if ( ( seconds <= 0. ) || ( dt <= 0. ) || ( dt > fps_min ) ) {
+      WARN( _( "Invalid benchmark parameters: %f seconds at dt=%f!" ),
+            seconds, dt );
+      return -1;
+   }
+
+   /* Set up I/O. */
+   ndata_setupWriteDir();
+   log_redirect();
+   ndata_setupReadDirs();
+   gettext_setLanguage( conf.language ); /* now that we can find translations */
+   LOG( _( "Loaded configuration: %s" ), conf_file_path );
+   search_path = PHYSFS_getSearchPath();
+   LOG( "%s", _( "Read locations, searched in order:" ) );
+   for ( char **p = search_path; *p != NULL; p++ )
+      LOG( "    %s", *p );
+   PHYSFS_freeList( search_path );
+
+   /* Bundling only needs the search path. */
+   if ( bundle )
+      return bench_bundle();
+
+   /* Load the start info. */
+   if ( start_load() )
+      ERR( _( "Failed to load module start data." ) );
+
+   /* Deterministic random numbers for loading as well as simulating. */
+   rng_seed( seed );
+
+   /* We still need a context for the data, but never show it. */
+   if ( gl_init( SDL_WINDOW_HIDDEN ) ) {
+      ERR( _( "Initializing video output failed, exiting…" ) );
+      exit( EXIT_FAILURE );
+   }
+
+   /* Have to set up fonts before loading anything. */
+   gl_fontInit( &gl_defFont, _( FONT_DEFAULT_PATH ), conf.font_size_def,
+                FONT_PATH_PREFIX, 0 );
+   gl_fontInit( &gl_smallFont, _( FONT_DEFAULT_PATH ), conf.font_size_small,
+                FONT_PATH_PREFIX, 0 );
+   gl_fontInit( &gl_defFontMono, _( FONT_MONOSPACE_PATH ), conf.font_size_def,
+                FONT_PATH_PREFIX, 0 );
+   naev_resize();
+
+   /* No sound nor music at all. */
+   sound_disabled = 1;
+   music_disabled = 1;
+   if ( sound_init() )
+      WARN( _( "Problem setting up sound!" ) );
+
+   /* Display the load screen. */
+   loadscreen_load();
+   loadscreen_update( 0., _( "Initializing subsystems…" ) );
+   last_t = SDL_GetPerformanceCounter();
+
+   /* Misc graphics init */
+   render_init();
+   nebu_init();       /* Initializes the nebula */
+   gui_init();        /* initializes the GUI graphics */
+   toolkit_init();    /* initializes the toolkit */
+   map_init();        /* initializes the map. */
+   map_system_init(); /* Initialise the solar system map */
+   cond_init();       /* Initialize conditional subsystem. */
+   cli_init();        /* Initialize console. */
+
+   /* Data loading */
+   load_all();
+   loadscreen_unload();
+
+   if ( lanes ) {
+      bench_safelanes();
+      unload_all();
+      return 0;
+   }
+
+   /* Set up the system without the usual pre-simulation, we want to measure
+    * everything from the moment it is entered. */
+   rng_seed( seed );
+   space_init( sysname, 0 );
+   LOG( _( "Simulating '%s' for %.1f seconds at dt=%.4f with seed %u…" ),
+        cur_system->name, seconds, dt, seed );
+
+   memset( &stats, 0, sizeof( stats ) );
+   update_stats          = &stats;
+   n                     = (int)ceil( seconds / dt );
+   unsigned long pairs   = pilot_ewStealthPairs();
+   Uint64        elapsed = 0;
+   double        lua_alloc, lua_base, lua_peak, heap, pause;
+
+   /* Collect before starting, and keep Lua from collecting on its own inside
+    * the timed ticks, which would hide allocations. */
+   nlua_gcCollect();
+   lua_gc( naevL, LUA_GCSTOP, 0 );
+   nlua_gcStats( &lua_base, &pause );
+   lua_alloc = 0.;
+   lua_peak  = 0.;
+   for ( int i = 0; i < n; i++ ) {
+      double before;
+      Uint64 t0;
+      nlua_gcStats( &before, &pause );
+      t0 = SDL_GetPerformanceCounter();
+      update_routine( dt, 0 );
+      elapsed += SDL_GetPerformanceCounter() - t0;
+      nlua_gcStats( &heap, &pause );
+      lua_alloc += MAX( 0., heap - before );
+      lua_peak = MAX( lua_peak, heap - before );
+      /* Collect outside of the timed ticks. */
+      if ( heap - lua_base > BENCH_LUA_HEAP ) {
+         nlua_gcCollect();
+         lua_gc( naevL, LUA_GCSTOP, 0 );
+         nlua_gcStats( &lua_base, &pause );
+      }
+   }
+   lua_gc( naevL, LUA_GCRESTART, 0 );
+   update_stats = NULL;
+
+   /* Report. */
+   const double wall = (double)elapsed / (double)SDL_GetPerformanceFrequency();
+   LOG( _( "Simulated %d ticks in %.3f s: %.1f ticks/s (%.2fx real time)" ),
+        (int)stats.ticks, wall, (double)stats.ticks / wall, seconds / wall );
+   LOG( _( "Pilots remaining: %d" ), array_size( pilot_getAll() ) );
+   LOG( _( "Lua allocations: %.1f KiB per tick (worst %.1f KiB)" ),
+        lua_alloc / (double)MAX( stats.ticks, 1 ), lua_peak );
+   LOG( _( "Stealth pairs tested: %.1f per tick" ),
+        (double)( pilot_ewStealthPairs() - pairs ) /
+           (double)MAX( stats.ticks, 1 ) );
+   bench_logStage( "pilots_updatePurge", stats.pilots_purge, stats.total,
+                   stats.ticks );
+   bench_logStage( "weapons_updatePurge", stats.weapons_purge, stats.total,
+                   stats.ticks );
+   bench_logStage( "weapons_updateCollide", stats.weapons_collide,
+                   stats.total, stats.ticks );
+   bench_logStage( "pilots_update", stats.pilots_update, stats.total,
+                   stats.ticks );
+   bench_logStage( "weapons_update", stats.weapons_update, stats.total,
+                   stats.ticks );
+   bench_logStage( "update_routine", stats.total, stats.total, stats.ticks );
+
+   unload_all();
+   return 0;
+}
@@ -41,7 +41,7 @@ int naevpedia_open( const char *path )
    }
 
    snprintf( buf, sizeof( buf ), "require('naevpedia').open('%s')", path );
-   status = nlua_dobufenv( naevpedia_env, buf, strlen( buf ), buf );
+   status = nlua_dostringenv( naevpedia_env, buf, buf );
    if ( status ) {
       WARN( _( "Naevpedia '%s' Lua error:\n%s" ), path,
             lua_tostring( naevL, -1 ) );
@@ -30,6 +30,7 @@
 #include "glue_macos.h"
 #endif /* __MACOSX__ */
 #include "log.h"
+#include "ndata_bundle.h"
 #include "nfile.h"
 #include "nstring.h"
 #include "plugin.h"
@@ -195,6 +196,9 @@ void ndata_setupReadDirs( void )
    plugin_init();
 
    ndata_testVersion();
+
+   /* Now that the search path is final, see if the bundle still matches. */
+   ndata_bundleOpen();
 }
 
 /**
@@ -207,10 +211,26 @@ void ndata_setupReadDirs( void )
 void *ndata_read( const char *path, size_t *filesize )
 {
    char         *buf;
+   const char   *bundled;
+   size_t        bundled_size;
    PHYSFS_file  *file;
    PHYSFS_sint64 len, n;
    PHYSFS_Stat   path_stat;
 
+   /* Serve it from the bundle, it was validated when opened. */
+   bundled = ndata_bundleGet( path, &bundled_size );
+   if ( bundled != NULL ) {
+      buf = malloc( bundled_size + 1 );
+      if ( buf == NULL ) {
+         WARN( _( "Out of Memory" ) );
+         *filesize = 0;
+         return NULL;
+      }
+      memcpy( buf, bundled, bundled_size + 1 );
+      *filesize = bundled_size;
+      return buf;
+   }
+
    if ( !PHYSFS_stat( path, &path_stat ) ) {
       WARN( _( "Error occurred while opening '%s': %s" ), path,
             _( PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) ) );
@@ -279,13 +299,17 @@ void *ndata_read( const char *path, size_t *filesize )
  * @brief Lists all the visible files in a directory, at any depth.
  *
  * Will sort by path, and (unlike underlying PhysicsFS) make sure to list each
- * file path only once.
+ * file path only once. Bundled directories are listed from the bundle index.
  *
  *    @return Array of (allocated) file paths relative to base_dir.
  */
 char **ndata_listRecursive( const char *path )
 {
-   char **files = array_create( char * );
+   char **files = ndata_bundleList( path );
+   if ( files != NULL )
+      return files;
+
+   files = array_create( char * );
    PHYSFS_enumerate( path, ndata_enumerateCallback, &files );
    /* Ensure unique. PhysicsFS can enumerate a path twice if it's in multiple
     * components of a union. */
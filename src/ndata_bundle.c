@@ -0,0 +1,594 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file ndata_bundle.c
+ *
+ * @brief Memory-mappable bundle of the universe data files.
+ *
+ * Loading the universe reads thousands of small files through PhysicsFS. The
+ * bundle packs the files of ndata_bundle_dirs into a single file in the cache
+ * path, which is mapped at start up so that ndata_read() and
+ * ndata_listRecursive() can serve them without going through PhysicsFS.
+ * Collision polygons are also stored pre-parsed, so they skip the XML.
+ *
+ * The bundle is validated once when opened. It is only used if it was built by
+ * the same version against the same search path, archives and plugins, so
+ * adding or changing plugins, archives or data paths makes it stale. Each
+ * bundled file is also checked against the real one the first time it is
+ * used, and read from the search path if it changed. Adding or removing files
+ * is only caught in developer mode, where every bundled directory is also
+ * checked against the real data when the bundle is opened.
+ *
+ * Bundles are built with "naevbench bundle" or the "ndata-bundle" target.
+ */
+/** @cond */
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "naev.h"
+
+#if HAS_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif /* HAS_POSIX */
+
+#include "physfs.h"
+/** @endcond */
+
+#include "ndata_bundle.h"
+
+#include "array.h"
+#include "collision.h"
+#include "conf.h"
+#include "log.h"
+#include "md5.h"
+#include "ndata.h"
+#include "nfile.h"
+#include "nstring.h"
+#include "plugin.h"
+
+#define NDATA_BUNDLE_MAGIC "NAEVNDB" /**< Magic, including the terminator. */
+#define NDATA_BUNDLE_VERSION 2      /**< Bump when the layout changes. */
+
+/**
+ * @brief Header at the start of a bundle.
+ */
+typedef struct NdataBundleHeader_ {
+   char       magic[8];        /**< NDATA_BUNDLE_MAGIC. */
+   uint32_t   version;         /**< NDATA_BUNDLE_VERSION. */
+   uint32_t   nfiles;          /**< Number of entries in the index. */
+   uint64_t   size;            /**< Total size of the bundle. */
+   md5_byte_t fingerprint[16]; /**< Hash of the version and search path. */
+} NdataBundleHeader;
+
+/**
+ * @brief Index entry of a bundled file, the index is sorted by path.
+ */
+typedef struct NdataBundleEntry_ {
+   uint64_t path;     /**< Offset of the NUL-terminated path. */
+   uint64_t data;     /**< Offset of the NUL-terminated contents. */
+   uint64_t size;     /**< Size of the contents without the terminator. */
+   int64_t  modtime;  /**< Modification time when bundled. */
+   uint64_t poly;     /**< Offset of the packed polygons, 0 if none. */
+   uint64_t polysize; /**< Size of the packed polygons. */
+} NdataBundleEntry;
+
+/**
+ * @brief Directories that get bundled, the data load_all() parses.
+ */
+static const char *ndata_bundle_dirs[] = {
+   SHIP_DATA_PATH,    SHIP_POLYGON_PATH,     SHIP_POLYGON_PATH3D,
+   OUTFIT_DATA_PATH,  OUTFIT_POLYGON_PATH,   ASTEROID_POLYGON_PATH,
+   SPOB_DATA_PATH,    VIRTUALSPOB_DATA_PATH, SYSTEM_DATA_PATH,
+   FACTION_DATA_PATH, TECH_DATA_PATH,        COMMODITY_DATA_PATH };
+
+/**
+ * @brief Bundled directories with collision polygons, stored pre-parsed.
+ */
+static const char *ndata_bundle_polydirs[] = {
+   SHIP_POLYGON_PATH, SHIP_POLYGON_PATH3D, OUTFIT_POLYGON_PATH,
+   ASTEROID_POLYGON_PATH };
+
+static const char             *bundle_data    = NULL; /**< Bundle contents. */
+static size_t                  bundle_size    = 0;    /**< Bundle size. */
+static int                     bundle_mmapped = 0;    /**< Uses mmap. */
+static const NdataBundleEntry *bundle_index   = NULL; /**< Sorted index. */
+static uint32_t                bundle_nfiles  = 0;    /**< Index entries. */
+static int                     bundle_ready   = 0;    /**< Validated. */
+static SDL_atomic_t           *bundle_fresh   = NULL; /**< Checked entries. */
+
+/*
+ * Prototypes.
+ */
+static void ndata_bundleFingerprint( md5_byte_t fingerprint[16] );
+static int  ndata_bundleCheck( void );
+static int  ndata_bundleValidate( void );
+static int  ndata_bundleIsPolygon( const char *path );
+static int  ndata_bundleCmp( const void *key, const void *elem );
+static const NdataBundleEntry *ndata_bundleFind( const char *path );
+static int  ndata_bundleFresh( const NdataBundleEntry *e );
+
+/**
+ * @brief Hashes everything a bundle depends on besides the files themselves.
+ *
+ * That is the version, the mounted search path with the size and modification
+ * time of its archives, and the loaded plugins.
+ */
+static void ndata_bundleFingerprint( md5_byte_t fingerprint[16] )
+{
+   md5_state_t     md5;
+   const char     *version     = naev_version( 0 );
+   char          **search_path = PHYSFS_getSearchPath();
+   const plugin_t *plugins     = plugin_list();
+
+   md5_init( &md5 );
+   md5_append( &md5, (const md5_byte_t *)version, strlen( version ) + 1 );
+   md5_append( &md5, (const md5_byte_t *)HOST, strlen( HOST ) + 1 );
+   for ( char **p = search_path; *p != NULL; p++ ) {
+      struct stat st;
+      md5_append( &md5, (const md5_byte_t *)*p, strlen( *p ) + 1 );
+      /* Directories are checked file by file instead. */
+      if ( ( stat( *p, &st ) == 0 ) && S_ISREG( st.st_mode ) ) {
+         int64_t stamp[2] = { st.st_size, st.st_mtime };
+         md5_append( &md5, (const md5_byte_t *)stamp, sizeof( stamp ) );
+      }
+   }
+   PHYSFS_freeList( search_path );
+   for ( int i = 0; i < array_size( plugins ); i++ ) {
+      const char *name = plugin_name( &plugins[i] );
+      const char *pver = plugins[i].version;
+      md5_append( &md5, (const md5_byte_t *)name, strlen( name ) + 1 );
+      if ( pver != NULL )
+         md5_append( &md5, (const md5_byte_t *)pver, strlen( pver ) + 1 );
+   }
+   md5_finish( &md5, fingerprint );
+}
+
+/**
+ * @brief Checks that the loaded bundle is sane and matches the search path.
+ *
+ *    @return 0 if the bundle can be used.
+ */
+static int ndata_bundleCheck( void )
+{
+   const NdataBundleHeader *header;
+   md5_byte_t               fingerprint[16];
+
+   if ( bundle_size < sizeof( NdataBundleHeader ) )
+      return -1;
+   header = (const NdataBundleHeader *)bundle_data;
+   if ( ( memcmp( header->magic, NDATA_BUNDLE_MAGIC,
+                  sizeof( header->magic ) ) != 0 ) ||
+        ( header->version != NDATA_BUNDLE_VERSION ) ||
+        ( header->size != bundle_size ) ||
+        ( header->nfiles > ( bundle_size - sizeof( NdataBundleHeader ) ) /
+                              sizeof( NdataBundleEntry ) ) )
+      return -1;
+
+   ndata_bundleFingerprint( fingerprint );
+   if ( memcmp( header->fingerprint, fingerprint, sizeof( fingerprint ) ) != 0 )
+      return -1;
+
+   /* Don't trust the offsets blindly, the bundle may be truncated. */
+   bundle_index  = (const NdataBundleEntry *)&bundle_data[sizeof( *header )];
+   bundle_nfiles = header->nfiles;
+   for ( uint32_t i = 0; i < bundle_nfiles; i++ ) {
+      const NdataBundleEntry *e = &bundle_index[i];
+      if ( ( e->path >= bundle_size ) || ( e->data >= bundle_size ) ||
+           ( e->size >= bundle_size - e->data ) ||
+           ( bundle_data[e->data + e->size] != '\0' ) ||
+           ( memchr( &bundle_data[e->path], '\0', bundle_size - e->path ) ==
+             NULL ) ||
+           ( e->poly > bundle_size ) ||
+           ( e->polysize > bundle_size - e->poly ) )
+         return -1;
+   }
+   return 0;
+}
+
+/**
+ * @brief Checks the bundled files against the real data, for developer mode.
+ *
+ *    @return 0 if every bundled file and directory is unchanged.
+ */
+static int ndata_bundleValidate( void )
+{
+   uint32_t n = 0;
+
+   /* Same files in the bundled directories. */
+   for ( size_t i = 0;
+         i < sizeof( ndata_bundle_dirs ) / sizeof( ndata_bundle_dirs[0] );
+         i++ ) {
+      char **dir = ndata_listRecursive( ndata_bundle_dirs[i] );
+      int    ret = 0;
+      for ( int j = 0; j < array_size( dir ); j++ ) {
+         const NdataBundleEntry *e = ndata_bundleFind( dir[j] );
+         PHYSFS_Stat             st;
+         if ( ( e == NULL ) || !PHYSFS_stat( dir[j], &st ) ||
+              ( st.filesize != (PHYSFS_sint64)e->size ) ||
+              ( st.modtime != e->modtime ) )
+            ret = -1;
+         free( dir[j] );
+      }
+      n += array_size( dir );
+      array_free( dir );
+      if ( ret )
+         return ret;
+   }
+
+   /* No files that went away. */
+   return ( n == bundle_nfiles ) ? 0 : -1;
+}
+
+/**
+ * @brief Checks to see if a bundled path is a collision polygon.
+ */
+static int ndata_bundleIsPolygon( const char *path )
+{
+   for ( size_t i = 0; i < sizeof( ndata_bundle_polydirs ) /
+                              sizeof( ndata_bundle_polydirs[0] );
+         i++ )
+      if ( strncmp( path, ndata_bundle_polydirs[i],
+                    strlen( ndata_bundle_polydirs[i] ) ) == 0 )
+         return 1;
+   return 0;
+}
+
+/**
+ * @brief Opens the bundle in the cache path if it exists and is up to date.
+ *
+ * Must be called once the search path is set up.
+ *
+ *    @return 0 if the bundle will be used.
+ */
+int ndata_bundleOpen( void )
+{
+   char *path;
+
+   ndata_bundleClose();
+
+   SDL_asprintf( &path, "%s%s", nfile_cachePath(), NDATA_BUNDLE_FILE );
+   if ( !nfile_fileExists( path ) ) {
+      free( path );
+      return -1;
+   }
+
+#if HAS_POSIX
+   int fd = open( path, O_RDONLY );
+   if ( fd >= 0 ) {
+      struct stat st;
+      if ( ( fstat( fd, &st ) == 0 ) && ( st.st_size > 0 ) ) {
+         void *map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+         if ( map != MAP_FAILED ) {
+            bundle_data    = map;
+            bundle_size    = st.st_size;
+            bundle_mmapped = 1;
+         }
+      }
+      close( fd );
+   }
+#endif /* HAS_POSIX */
+   if ( bundle_data == NULL )
+      bundle_data = nfile_readFile( &bundle_size, path );
+   if ( bundle_data == NULL ) {
+      WARN( _( "Unable to read ndata bundle '%s'." ), path );
+      free( path );
+      return -1;
+   }
+
+   if ( ndata_bundleCheck() ||
+        ( conf.devmode && ndata_bundleValidate() ) ) {
+      DEBUG( _( "Ignoring stale ndata bundle '%s'." ), path );
+      ndata_bundleClose();
+      free( path );
+      return -1;
+   }
+   bundle_fresh = calloc( MAX( bundle_nfiles, 1 ), sizeof( SDL_atomic_t ) );
+   bundle_ready = 1;
+
+   DEBUG( _( "Using ndata bundle '%s' with %u files." ), path, bundle_nfiles );
+   free( path );
+   return 0;
+}
+
+/**
+ * @brief Closes the bundle, ndata_read() goes back to reading everything.
+ */
+void ndata_bundleClose( void )
+{
+   if ( bundle_data == NULL )
+      return;
+
+   if ( bundle_mmapped ) {
+#if HAS_POSIX
+      munmap( (void *)bundle_data, bundle_size );
+#endif /* HAS_POSIX */
+   } else
+      free( (void *)bundle_data );
+
+   bundle_data    = NULL;
+   bundle_size    = 0;
+   bundle_mmapped = 0;
+   bundle_index   = NULL;
+   bundle_nfiles  = 0;
+   bundle_ready   = 0;
+   free( bundle_fresh );
+   bundle_fresh = NULL;
+}
+
+/**
+ * @brief Lists the files that go into a bundle.
+ *
+ *    @return Sorted array of (allocated) file paths.
+ */
+char **ndata_bundleFiles( void )
+{
+   char **files = array_create( char * );
+   for ( size_t i = 0;
+         i < sizeof( ndata_bundle_dirs ) / sizeof( ndata_bundle_dirs[0] );
+         i++ ) {
+      char **dir = ndata_listRecursive( ndata_bundle_dirs[i] );
+      for ( int j = 0; j < array_size( dir ); j++ )
+         array_push_back( &files, dir[j] );
+      array_free( dir );
+   }
+   qsort( files, array_size( files ), sizeof( char * ), strsort );
+   return files;
+}
+
+/**
+ * @brief Builds a bundle of the current data files.
+ *
+ *    @param filename Real path to write the bundle to.
+ *    @return 0 on success.
+ */
+int ndata_bundleBuild( const char *filename )
+{
+   NdataBundleHeader header;
+   NdataBundleEntry *entries;
+   char            **files, **datas, **polys, *buf;
+   size_t            off;
+   int               n, npolys, ret;
+
+   /* Always bundle the real files, not a previous bundle. */
+   ndata_bundleClose();
+
+   files   = ndata_bundleFiles();
+   n       = array_size( files );
+   entries = calloc( n, sizeof( NdataBundleEntry ) );
+   datas   = calloc( n, sizeof( char * ) );
+   polys   = calloc( n, sizeof( char * ) );
+   buf     = NULL;
+   ret     = -1;
+   npolys  = 0;
+
+   /* Read everything and lay out the index followed by the paths, contents
+    * and packed polygons. */
+   off = sizeof( NdataBundleHeader ) + n * sizeof( NdataBundleEntry );
+   for ( int i = 0; i < n; i++ ) {
+      PHYSFS_Stat stat;
+      size_t      size;
+
+      if ( !PHYSFS_stat( files[i], &stat ) ) {
+         WARN( _( "PhysicsFS: Cannot stat %s: %s" ), files[i],
+               _( PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) ) );
+         goto cleanup;
+      }
+      datas[i] = ndata_read( files[i], &size );
+      if ( datas[i] == NULL )
+         goto cleanup;
+      /* The file changed while bundling, it'd just be stale. */
+      if ( (PHYSFS_sint64)size != stat.filesize ) {
+         WARN( _( "'%s' changed while bundling." ), files[i] );
+         goto cleanup;
+      }
+
+      entries[i].path = off;
+      off += strlen( files[i] ) + 1;
+      entries[i].data    = off;
+      entries[i].size    = size;
+      entries[i].modtime = stat.modtime;
+      off += size + 1;
+
+      /* Collision polygons also go in pre-parsed. */
+      if ( ndata_bundleIsPolygon( files[i] ) && ( size > 0 ) ) {
+         xmlDocPtr doc = xmlParseMemory( datas[i], size );
+         if ( doc != NULL ) {
+            CollPoly *polygons = poly_loadDoc( doc, files[i] );
+            polys[i]           = poly_pack( polygons, &entries[i].polysize );
+            for ( int j = 0; j < array_size( polygons ); j++ )
+               poly_free( &polygons[j] );
+            array_free( polygons );
+            xmlFreeDoc( doc );
+            entries[i].poly = off;
+            off += entries[i].polysize;
+            npolys++;
+         }
+      }
+   }
+
+   memset( &header, 0, sizeof( header ) );
+   memcpy( header.magic, NDATA_BUNDLE_MAGIC, sizeof( header.magic ) );
+   header.version = NDATA_BUNDLE_VERSION;
+   header.nfiles  = n;
+   header.size    = off;
+   ndata_bundleFingerprint( header.fingerprint );
+
+   buf = malloc( off );
+   if ( buf == NULL ) {
+      WARN( _( "Out of Memory" ) );
+      goto cleanup;
+   }
+   memcpy( buf, &header, sizeof( header ) );
+   memcpy( &buf[sizeof( header )], entries, n * sizeof( NdataBundleEntry ) );
+   for ( int i = 0; i < n; i++ ) {
+      strcpy( &buf[entries[i].path], files[i] );
+      memcpy( &buf[entries[i].data], datas[i], entries[i].size + 1 );
+      if ( polys[i] != NULL )
+         memcpy( &buf[entries[i].poly], polys[i], entries[i].polysize );
+   }
+
+   ret = nfile_writeFileAtomic( buf, off, filename );
+   if ( ret == 0 )
+      LOG( _( "Bundled %d files (%d collision polygons, %.1f MiB) into "
+              "'%s'." ),
+           n, npolys, (double)off / ( 1024. * 1024. ), filename );
+
+cleanup:
+   for ( int i = 0; i < n; i++ ) {
+      free( files[i] );
+      free( datas[i] );
+      free( polys[i] );
+   }
+   array_free( files );
+   free( entries );
+   free( datas );
+   free( polys );
+   free( buf );
+   return ret;
+}
+
+/**
+ * @brief Compares a path to a bundle entry for bsearch.
+ */
+static int ndata_bundleCmp( const void *key, const void *elem )
+{
+   const NdataBundleEntry *e = elem;
+   return strcmp( key, &bundle_data[e->path] );
+}
+
+/**
+ * @brief Finds the index entry of a bundled file.
+ */
+static const NdataBundleEntry *ndata_bundleFind( const char *path )
+{
+   return bsearch( path, bundle_index, bundle_nfiles,
+                   sizeof( NdataBundleEntry ), ndata_bundleCmp );
+}
+
+/**
+ * @brief Checks that a bundled file matches the real one, once per file.
+ *
+ *    @return 1 if the bundled file can be used.
+ */
+static int ndata_bundleFresh( const NdataBundleEntry *e )
+{
+   SDL_atomic_t *fresh = &bundle_fresh[e - bundle_index];
+   int           state = SDL_AtomicGet( fresh );
+   PHYSFS_Stat   st;
+
+   if ( state == 0 ) {
+      const char *path = &bundle_data[e->path];
+      if ( PHYSFS_stat( path, &st ) &&
+           ( st.filesize == (PHYSFS_sint64)e->size ) &&
+           ( st.modtime == e->modtime ) )
+         state = 1;
+      else {
+         DEBUG( _( "Ignoring stale bundled file '%s'." ), path );
+         state = -1;
+      }
+      SDL_AtomicSet( fresh, state );
+   }
+   return ( state > 0 );
+}
+
+/**
+ * @brief Gets the contents of a file from the bundle.
+ *
+ * Safe to call from any thread while the bundle is open.
+ *
+ *    @param path Path of the file to get.
+ *    @param[out] size Size of the contents, without the NUL terminator.
+ *    @return The NUL-terminated contents, or NULL if not bundled.
+ */
+const char *ndata_bundleGet( const char *path, size_t *size )
+{
+   const NdataBundleEntry *e;
+
+   if ( !bundle_ready )
+      return NULL;
+
+   e = ndata_bundleFind( path );
+   if ( ( e == NULL ) || !ndata_bundleFresh( e ) )
+      return NULL;
+
+   *size = e->size;
+   return &bundle_data[e->data];
+}
+
+/**
+ * @brief Gets the pre-parsed collision polygons of a file from the bundle.
+ *
+ * Safe to call from any thread while the bundle is open.
+ *
+ *    @param path Path of the collision polygon file.
+ *    @param[out] size Size of the packed polygons.
+ *    @return The polygons packed with poly_pack, or NULL if not bundled.
+ */
+const char *ndata_bundlePolygons( const char *path, size_t *size )
+{
+   const NdataBundleEntry *e;
+
+   if ( !bundle_ready )
+      return NULL;
+
+   e = ndata_bundleFind( path );
+   if ( ( e == NULL ) || ( e->poly == 0 ) || !ndata_bundleFresh( e ) )
+      return NULL;
+
+   *size = e->polysize;
+   return &bundle_data[e->poly];
+}
+
+/**
+ * @brief Lists the files of a bundled directory from the bundle index.
+ *
+ *    @param path Directory to list, must be one of the bundled directories.
+ *    @return Sorted array of (allocated) file paths, or NULL if the directory
+ * is not bundled.
+ */
+char **ndata_bundleList( const char *path )
+{
+   char  **files;
+   size_t  len;
+   int64_t lo, hi;
+   int     found = 0;
+
+   if ( !bundle_ready )
+      return NULL;
+
+   /* Only whole directories are bundled. */
+   for ( size_t i = 0;
+         i < sizeof( ndata_bundle_dirs ) / sizeof( ndata_bundle_dirs[0] );
+         i++ )
+      if ( strcmp( path, ndata_bundle_dirs[i] ) == 0 ) {
+         found = 1;
+         break;
+      }
+   if ( !found )
+      return NULL;
+
+   /* Binary search for the first path in the directory. */
+   lo = 0;
+   hi = (int64_t)bundle_nfiles - 1;
+   while ( lo <= hi ) {
+      int64_t mid = ( lo + hi ) / 2;
+      if ( strcmp( &bundle_data[bundle_index[mid].path], path ) < 0 )
+         lo = mid + 1;
+      else
+         hi = mid - 1;
+   }
+
+   len   = strlen( path );
+   files = array_create( char * );
+   for ( uint32_t i = lo; i < bundle_nfiles; i++ ) {
+      const char *name = &bundle_data[bundle_index[i].path];
+      if ( strncmp( name, path, len ) != 0 )
+         break;
+      array_push_back( &files, strdup( name ) );
+   }
+   return files;
+}
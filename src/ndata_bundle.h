@@ -0,0 +1,18 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/** @cond */
+#include <stddef.h>
+/** @endcond */
+
+#define NDATA_BUNDLE_FILE "ndata.bundle" /**< Bundle name in the cache path. */
+
+int         ndata_bundleOpen( void );
+void        ndata_bundleClose( void );
+int         ndata_bundleBuild( const char *filename );
+char      **ndata_bundleFiles( void );
+const char *ndata_bundleGet( const char *path, size_t *size );
+const char *ndata_bundlePolygons( const char *path, size_t *size );
+char      **ndata_bundleList( const char *path );
@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <time.h>
 
 #include "SDL_stdinc.h"
 
@@ -596,6 +597,88 @@ int nfile_writeFile( const char *data, size_t len, const char *path )
    return 0;
 }
 
+/**
+ * @brief Writes a file through a temporary file, so that it is never left
+ * partially written under its name.
+ *
+ *    @param data Pointer to the data to write.
+ *    @param len The size of data.
+ *    @param path Path of the file.
+ *    @return 0 on success, -1 on error.
+ */
+int nfile_writeFileAtomic( const char *data, size_t len, const char *path )
+{
+   char tmp[PATH_MAX];
+
+   if ( path == NULL )
+      return -1;
+
+   snprintf( tmp, sizeof( tmp ), "%s.tmp", path );
+   if ( nfile_writeFile( data, len, tmp ) != 0 )
+      return -1;
+
+   if ( rename( tmp, path ) != 0 ) {
+      /* Windows does not replace existing files. */
+      remove( path );
+      if ( rename( tmp, path ) != 0 ) {
+         WARN( _( "Error occurred while renaming '%s' to '%s': %s" ), tmp,
+               path, strerror( errno ) );
+         remove( tmp );
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+/**
+ * @brief Lists the regular files in a directory.
+ *
+ *    @param path Path of the directory.
+ *    @return Array (array.h) of allocated file names or NULL on error.
+ */
+char **nfile_readDir( const char *path )
+{
+   DIR           *d;
+   struct dirent *e;
+   char         **files;
+
+   if ( path == NULL )
+      return NULL;
+
+   d = opendir( path );
+   if ( d == NULL )
+      return NULL;
+
+   files = array_create( char * );
+   while ( ( e = readdir( d ) ) != NULL ) {
+      char        file[PATH_MAX];
+      struct stat buf;
+      snprintf( file, sizeof( file ), "%s/%s", path, e->d_name );
+      if ( ( stat( file, &buf ) == 0 ) && S_ISREG( buf.st_mode ) )
+         array_push_back( &files, strdup( e->d_name ) );
+   }
+   closedir( d );
+
+   return files;
+}
+
+/**
+ * @brief Gets how long ago a file was last modified.
+ *
+ *    @param path Path of the file.
+ *    @return Seconds since the last modification or -1 on error.
+ */
+double nfile_fileAge( const char *path )
+{
+   struct stat buf;
+
+   if ( ( path == NULL ) || ( stat( path, &buf ) != 0 ) )
+      return -1.;
+
+   return difftime( time( NULL ), buf.st_mtime );
+}
+
 /**
  * @brief Checks to see if a character is used to separate files in a path.
  *
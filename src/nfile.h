@@ -31,16 +31,19 @@ int _nfile_concatPaths( char buf[static 1], int maxLength,
 const char *nfile_configPath( void );
 const char *nfile_cachePath( void );
 
-int   nfile_dirMakeExist( const char *path );
-int   nfile_dirExists( const char *path );
-int   nfile_fileExists( const char *path ); /* Returns 1 on exists */
-int   nfile_backupIfExists( const char *path );
-int   nfile_copyIfExists( const char *path1, const char *path2 );
-char *nfile_readFile( size_t *filesize, const char *path );
-int   nfile_touch( const char *path );
-int   nfile_writeFile( const char *data, size_t len, const char *path );
-int   nfile_isSeparator( uint32_t c );
-int   nfile_simplifyPath( char path[static 1] );
+int    nfile_dirMakeExist( const char *path );
+int    nfile_dirExists( const char *path );
+int    nfile_fileExists( const char *path ); /* Returns 1 on exists */
+int    nfile_backupIfExists( const char *path );
+int    nfile_copyIfExists( const char *path1, const char *path2 );
+char  *nfile_readFile( size_t *filesize, const char *path );
+int    nfile_touch( const char *path );
+int    nfile_writeFile( const char *data, size_t len, const char *path );
+int    nfile_writeFileAtomic( const char *data, size_t len, const char *path );
+char **nfile_readDir( const char *path );
+double nfile_fileAge( const char *path );
+int    nfile_isSeparator( uint32_t c );
+int    nfile_simplifyPath( char path[static 1] );
 
 #if !SDL_VERSION_ATLEAST( 3, 0, 0 )
 typedef struct SDL_DialogFileFilter {
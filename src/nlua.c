@@ -8,6 +8,7 @@
  */
 
 /** @cond */
+#include "SDL_timer.h"
 #include "physfs.h"
 
 #include "naev.h"
@@ -24,7 +25,9 @@
 #include "lua_enet.h"
 #include "lutf8lib.h"
 #include "lyaml.h"
+#include "md5.h"
 #include "ndata.h"
+#include "nfile.h"
 #include "nlua_audio.h"
 #include "nlua_cli.h"
 #include "nlua_commodity.h"
@@ -50,13 +53,23 @@
 #include "nlua_vec2.h"
 #include "nluadef.h"
 #include "nstring.h"
+#include "ntracing.h"
+
+#define NLUA_GC_PAUSE 2. /**< Heap growth since the last cycle to start one. */
+#define NLUA_GC_EMERGENCY                                                      \
+   4. /**< Heap growth at which Lua is let to collect on its own again. */
+#define NLUA_GC_STEPMUL 2. /**< How much faster to collect than allocate. */
+#define NLUA_GC_MINSTEP 16 /**< Minimum step size in KiB. */
+#define NLUA_GC_SMOOTH 0.1 /**< Smoothing of the measured rates. */
+#define NLUA_GC_WINDOW 60  /**< Frames to get the worst pause over. */
+
+#define NLUA_BC_MAXAGE 2592000. /**< Prune unused bytecode after 30 days. */
 
 lua_State *naevL         = NULL;      /**< Global Naev Lua state. */
 nlua_env   __NLUA_CURENV = LUA_NOREF; /**< Current environment. */
-static char
-   *common_script; /**< Common script to run when creating environments. */
-static size_t common_sz; /**< Common script size. */
-static int    nlua_envs = LUA_NOREF;
+static int common_ref = LUA_NOREF; /**< Compiled common script to run when
+                                      creating environments. */
+static int nlua_envs  = LUA_NOREF;
 
 /**
  * @brief Cache structure for loading chunks.
@@ -67,6 +80,32 @@ typedef struct LuaCache_ {
 } LuaCache_t;
 static LuaCache_t *lua_cache = NULL;
 
+/**
+ * @brief Precompiled Lua chunk.
+ */
+typedef struct LuaBytecode_ {
+   char   digest[33]; /**< MD5 of the Lua version, chunk name and source. */
+   char  *data;       /**< Bytecode. */
+   size_t size;       /**< Size of the bytecode. */
+} LuaBytecode_t;
+static LuaBytecode_t *lua_bytecode = NULL; /**< Bytecode cache sorted by
+                                              digest (array.h). */
+static int    lua_bcMemory   = 0; /**< Chunks loaded from memory cache. */
+static int    lua_bcDisk     = 0; /**< Chunks loaded from the disk cache. */
+static int    lua_bcCompiled = 0; /**< Chunks compiled from source. */
+static Uint64 lua_bcTime     = 0; /**< Time spent loading chunks. */
+
+/* Garbage collection scheduler, heap sizes are in KiB. */
+static double lua_gcLive      = 0.; /**< Heap size after the last cycle. */
+static double lua_gcThreshold = 0.; /**< Heap size that starts a cycle. */
+static double lua_gcLast      = 0.; /**< Heap size after the last frame. */
+static double lua_gcRate      = 0.; /**< Allocated KiB per frame. */
+static double lua_gcCost      = 0.; /**< Seconds it takes to step a KiB. */
+static int    lua_gcCycle     = 0;  /**< Whether a cycle is in progress. */
+static double lua_gcPause     = 0.; /**< Worst pause of the last window. */
+static double lua_gcWindowMax = 0.; /**< Worst pause of the current window. */
+static int    lua_gcWindowN   = 0;  /**< Frames in the current window. */
+
 /*
  * prototypes
  */
@@ -79,6 +118,13 @@ static lua_State *nlua_newState( void ); /* creates a new state */
 static int        nlua_loadBasic( lua_State *L );
 static int        luaB_loadstring( lua_State *L );
 static int        lua_cache_cmp( const void *p1, const void *p2 );
+static int        lua_bytecode_cmp( const void *p1, const void *p2 );
+static int        nlua_bytecodeWriter( lua_State *L, const void *p, size_t sz,
+                                       void *ud );
+static void       nlua_bytecodeAdd( const LuaBytecode_t *lb );
+static void       nlua_bytecodePrune( void );
+static int        nlua_dobuf( nlua_env env, const char *buff, size_t sz,
+                              const char *name, int cache );
 static int        nlua_errTraceInternal( lua_State *L, int idx );
 
 /* gettext */
@@ -243,9 +289,19 @@ void lua_exit( void )
    array_free( lua_cache );
    lua_cache = NULL;
 
-   free( common_script );
+   if ( conf.lua_cache )
+      nlua_bytecodePrune();
+   for ( int i = 0; i < array_size( lua_bytecode ); i++ )
+      free( lua_bytecode[i].data );
+   array_free( lua_bytecode );
+   lua_bytecode = NULL;
+
    lua_close( naevL );
-   naevL = NULL;
+   naevL      = NULL;
+   common_ref = LUA_NOREF;
+
+   lua_gcLive  = 0.;
+   lua_gcCycle = 0;
 }
 
 int nlua_warn( lua_State *L, int idx )
@@ -263,6 +319,121 @@ int nlua_warn( lua_State *L, int idx )
    return 0;
 }
 
+/**
+ * @brief Gets the size of the Lua heap in KiB.
+ */
+static double nlua_gcHeap( void )
+{
+   return lua_gc( naevL, LUA_GCCOUNT, 0 ) +
+          lua_gc( naevL, LUA_GCCOUNTB, 0 ) / 1024.;
+}
+
+/**
+ * @brief Marks the end of a garbage collection cycle and stops the automatic
+ * collector until the next one is scheduled.
+ */
+static void nlua_gcCycleEnd( void )
+{
+   lua_gc( naevL, LUA_GCSTOP, 0 );
+   lua_gcCycle     = 0;
+   lua_gcLive      = nlua_gcHeap();
+   lua_gcThreshold = lua_gcLive * NLUA_GC_PAUSE;
+   lua_gcLast      = lua_gcLive;
+}
+
+/**
+ * @brief Runs incremental garbage collection on the global Lua state.
+ *
+ * The automatic collector is stopped, so garbage is only collected here, in a
+ * part of the frame where it can't cause spikes. The step size follows the
+ * allocation rate, so that cycles end, but is limited so that a single step
+ * fits in the budget. If the heap still grows too much, Lua is allowed to
+ * collect on its own until the cycle finishes.
+ *
+ *    @param budget Time that can be spent collecting in seconds.
+ */
+void nlua_gcStep( double budget )
+{
+   double heap, elapsed;
+   Uint64 t0;
+   int    stepkb;
+
+   if ( naevL == NULL )
+      return;
+   if ( lua_gcLive <= 0. )
+      nlua_gcCycleEnd();
+
+   NTracingZone( _ctx, 1 );
+
+   heap = nlua_gcHeap();
+   lua_gcRate += NLUA_GC_SMOOTH * ( MAX( 0., heap - lua_gcLast ) - lua_gcRate );
+   if ( heap >= lua_gcThreshold )
+      lua_gcCycle = 1;
+
+   elapsed = 0.;
+   if ( lua_gcCycle ) {
+      stepkb = MAX( NLUA_GC_MINSTEP, (int)( lua_gcRate * NLUA_GC_STEPMUL ) );
+      if ( lua_gcCost > 0. )
+         stepkb =
+            MAX( NLUA_GC_MINSTEP, (int)MIN( stepkb, budget / lua_gcCost ) );
+      t0 = SDL_GetPerformanceCounter();
+      do {
+         Uint64 t  = SDL_GetPerformanceCounter();
+         int    ok = lua_gc( naevL, LUA_GCSTEP, stepkb );
+         double dt = (double)( SDL_GetPerformanceCounter() - t ) /
+                     (double)SDL_GetPerformanceFrequency();
+         lua_gcCost += NLUA_GC_SMOOTH * ( dt / stepkb - lua_gcCost );
+         elapsed = (double)( SDL_GetPerformanceCounter() - t0 ) /
+                   (double)SDL_GetPerformanceFrequency();
+         if ( ok ) {
+            nlua_gcCycleEnd();
+            break;
+         }
+      } while ( elapsed < budget );
+
+      /* Stepping leaves the automatic collector running mid-cycle. */
+      heap = nlua_gcHeap();
+      if ( lua_gcCycle && ( heap > lua_gcLive * NLUA_GC_EMERGENCY ) )
+         lua_gc( naevL, LUA_GCRESTART, 0 );
+      else if ( lua_gcCycle )
+         lua_gc( naevL, LUA_GCSTOP, 0 );
+   }
+   lua_gcLast = heap;
+
+   /* Statistics. */
+   lua_gcWindowMax = MAX( lua_gcWindowMax, elapsed * 1000. );
+   if ( ++lua_gcWindowN >= NLUA_GC_WINDOW ) {
+      lua_gcPause     = lua_gcWindowMax;
+      lua_gcWindowMax = 0.;
+      lua_gcWindowN   = 0;
+   }
+   NTracingPlotF( "Lua heap [KiB]", heap );
+   NTracingPlotF( "Lua GC [ms]", elapsed * 1000. );
+
+   NTracingZoneEnd( _ctx );
+}
+
+/**
+ * @brief Runs a full garbage collection cycle on the global Lua state.
+ */
+void nlua_gcCollect( void )
+{
+   lua_gc( naevL, LUA_GCCOLLECT, 0 );
+   nlua_gcCycleEnd();
+}
+
+/**
+ * @brief Gets the garbage collection statistics for debugging.
+ *
+ *    @param[out] heap Size of the Lua heap in KiB.
+ *    @param[out] pause Worst time spent collecting in a recent frame in ms.
+ */
+void nlua_gcStats( double *heap, double *pause )
+{
+   *heap  = ( naevL == NULL ) ? 0. : nlua_gcHeap();
+   *pause = lua_gcPause;
+}
+
 /**
  * @brief Clears the cached stuff.
  */
@@ -287,6 +458,38 @@ void lua_clearCache( void )
  *    @return 0 on success.
  */
 int nlua_dobufenv( nlua_env env, const char *buff, size_t sz, const char *name )
+{
+   return nlua_dobuf( env, buff, sz, name, 1 );
+}
+
+/**
+ * @brief Run a one-off string in a Lua environment.
+ *
+ * Unlike nlua_dobufenv, the chunk does not go through the bytecode cache, so
+ * it should be used for generated code that is not loaded from a file.
+ *
+ *    @param env Lua environment.
+ *    @param str String to run.
+ *    @param name Name to use in error messages.
+ *    @return 0 on success.
+ */
+int nlua_dostringenv( nlua_env env, const char *str, const char *name )
+{
+   return nlua_dobuf( env, str, strlen( str ), name, 0 );
+}
+
+/**
+ * @brief Runs a buffer in a Lua environment.
+ *
+ *    @param env Lua environment.
+ *    @param buff Pointer to buffer.
+ *    @param sz Size of buffer.
+ *    @param name Name to use in error messages.
+ *    @param cache Whether to go through the bytecode cache.
+ *    @return 0 on success.
+ */
+static int nlua_dobuf( nlua_env env, const char *buff, size_t sz,
+                       const char *name, int cache )
 {
    int ret;
 #if DEBUGGING
@@ -296,7 +499,10 @@ int nlua_dobufenv( nlua_env env, const char *buff, size_t sz, const char *name )
    if ( conf.fpu_except )
       debug_disableFPUExcept();
 #endif /* DEBUGGING */
-   ret = luaL_loadbuffer( naevL, buff, sz, name );
+   if ( cache )
+      ret = nlua_loadbuffer( naevL, buff, sz, name );
+   else
+      ret = luaL_loadbuffer( naevL, buff, sz, name );
    if ( ret != 0 )
       return ret;
 #if DEBUGGING
@@ -318,7 +524,24 @@ int nlua_dobufenv( nlua_env env, const char *buff, size_t sz, const char *name )
  */
 int nlua_dofileenv( nlua_env env, const char *filename )
 {
-   if ( luaL_loadfile( naevL, filename ) != 0 )
+   char   chunkname[PATH_MAX];
+   char  *buf;
+   size_t sz;
+   int    ret;
+
+   buf = nfile_readFile( &sz, filename );
+   if ( buf == NULL )
+      return -1;
+
+   /* Skip a leading '#' line like luaL_loadfile, keeping the line count. */
+   if ( ( sz > 0 ) && ( buf[0] == '#' ) )
+      for ( size_t i = 0; ( i < sz ) && ( buf[i] != '\n' ); i++ )
+         buf[i] = ' ';
+
+   snprintf( chunkname, sizeof( chunkname ), "@%s", filename );
+   ret = nlua_loadbuffer( naevL, buf, sz, chunkname );
+   free( buf );
+   if ( ret != 0 )
       return -1;
    if ( nlua_pcall( env, 0, LUA_MULTRET ) != 0 )
       return -1;
@@ -425,25 +648,28 @@ nlua_env nlua_newEnv( const char *name )
    lua_newtable( naevL );             /* t, t, n */
    lua_setfield( naevL, -2, "naev" ); /* t, t */
 
-   /* Run common script. */
-   if ( conf.loaded && common_script == NULL ) {
-      common_script = ndata_read( LUA_COMMON_PATH, &common_sz );
-      if ( common_script == NULL )
+   /* Run common script, it only gets compiled once. */
+   if ( conf.loaded && common_ref == LUA_NOREF ) {
+      size_t sz;
+      char  *buf = ndata_read( LUA_COMMON_PATH, &sz );
+      if ( buf == NULL )
          WARN( _( "Unable to load common script '%s'!" ), LUA_COMMON_PATH );
-   }
-   if ( common_script != NULL ) {
-      if ( luaL_loadbuffer( naevL, common_script, common_sz,
-                            LUA_COMMON_PATH ) == 0 ) {
-         if ( nlua_pcall( ref, 0, 0 ) != 0 ) {
-            WARN( _( "Failed to run '%s':\n%s" ), LUA_COMMON_PATH,
-                  lua_tostring( naevL, -1 ) );
-            lua_pop( naevL, 1 );
-         }
-      } else {
+      else if ( nlua_loadbuffer( naevL, buf, sz, LUA_COMMON_PATH ) == 0 )
+         common_ref = luaL_ref( naevL, LUA_REGISTRYINDEX );
+      else {
          WARN( _( "Failed to load '%s':\n%s" ), LUA_COMMON_PATH,
                lua_tostring( naevL, -1 ) );
          lua_pop( naevL, 1 );
       }
+      free( buf );
+   }
+   if ( common_ref != LUA_NOREF ) {
+      lua_rawgeti( naevL, LUA_REGISTRYINDEX, common_ref );
+      if ( nlua_pcall( ref, 0, 0 ) != 0 ) {
+         WARN( _( "Failed to run '%s':\n%s" ), LUA_COMMON_PATH,
+               lua_tostring( naevL, -1 ) );
+         lua_pop( naevL, 1 );
+      }
    }
 
    lua_pop( naevL, 1 ); /* t */
@@ -627,6 +853,206 @@ static int lua_cache_cmp( const void *p1, const void *p2 )
    return strcmp( lc1->path, lc2->path );
 }
 
+/**
+ * @brief Compares two precompiled Lua chunks.
+ */
+static int lua_bytecode_cmp( const void *p1, const void *p2 )
+{
+   const LuaBytecode_t *lb1 = p1;
+   const LuaBytecode_t *lb2 = p2;
+   return strcmp( lb1->digest, lb2->digest );
+}
+
+/**
+ * @brief Adds a precompiled chunk to the cache, keeping it sorted.
+ *
+ *    @param lb Chunk to add, the cache takes ownership of its data.
+ */
+static void nlua_bytecodeAdd( const LuaBytecode_t *lb )
+{
+   int lo, hi;
+
+   /* Binary search for the insertion point. */
+   lo = 0;
+   hi = array_size( lua_bytecode ) - 1;
+   while ( lo <= hi ) {
+      int mid = ( lo + hi ) / 2;
+      int c   = strcmp( lb->digest, lua_bytecode[mid].digest );
+      if ( c > 0 )
+         lo = mid + 1;
+      else
+         hi = mid - 1;
+   }
+
+   array_push_back( &lua_bytecode, *lb );
+   memmove( &lua_bytecode[lo + 1], &lua_bytecode[lo],
+            sizeof( LuaBytecode_t ) * ( array_size( lua_bytecode ) - lo - 1 ) );
+   lua_bytecode[lo] = *lb;
+}
+
+/**
+ * @brief Removes stale entries from the on-disk bytecode cache.
+ *
+ * Entries not used this session are removed once they are older than
+ * NLUA_BC_MAXAGE, so bytecode of edited or removed scripts does not pile up.
+ */
+static void nlua_bytecodePrune( void )
+{
+   char   dirpath[PATH_MAX];
+   char **files;
+
+   snprintf( dirpath, sizeof( dirpath ), "%sluac/", nfile_cachePath() );
+   files = nfile_readDir( dirpath );
+   if ( files == NULL )
+      return;
+
+   for ( int i = 0; i < array_size( files ); i++ ) {
+      char          path[PATH_MAX];
+      LuaBytecode_t lbq;
+      int           stale;
+
+      snprintf( path, sizeof( path ), "%s%s", dirpath, files[i] );
+      if ( strlen( files[i] ) != sizeof( lbq.digest ) - 1 )
+         /* Leftover temporary files or other junk. */
+         stale = 1;
+      else {
+         strcpy( lbq.digest, files[i] );
+         stale = ( bsearch( &lbq, lua_bytecode, array_size( lua_bytecode ),
+                            sizeof( LuaBytecode_t ),
+                            lua_bytecode_cmp ) == NULL ) &&
+                 ( nfile_fileAge( path ) > NLUA_BC_MAXAGE );
+      }
+      if ( stale )
+         remove( path );
+      free( files[i] );
+   }
+   array_free( files );
+}
+
+/**
+ * @brief lua_dump writer that appends to a precompiled chunk.
+ */
+static int nlua_bytecodeWriter( lua_State *L, const void *p, size_t sz,
+                                void *ud )
+{
+   (void)L;
+   LuaBytecode_t *lb   = ud;
+   char          *data = realloc( lb->data, lb->size + sz );
+   if ( data == NULL )
+      return 1;
+   memcpy( &data[lb->size], p, sz );
+   lb->data = data;
+   lb->size += sz;
+   return 0;
+}
+
+/**
+ * @brief Loads a Lua chunk like luaL_loadbuffer, going through the bytecode
+ * cache.
+ *
+ * Chunks are identified by the digest of their name and source, so the same
+ * script is only ever compiled once per session. Cached chunks are kept until
+ * exit, so this should only be used for chunks loaded from files and not for
+ * generated strings. When enabled, the bytecode
+ * is also stored in the cache directory to skip compiling between sessions.
+ *
+ *    @param L Lua state to load into.
+ *    @param buf Source of the chunk.
+ *    @param sz Size of the source.
+ *    @param name Name of the chunk.
+ *    @return 0 on success, otherwise a Lua error code with the error message
+ * on the stack.
+ */
+int nlua_loadbuffer( lua_State *L, const char *buf, size_t sz,
+                     const char *name )
+{
+   md5_state_t    md5;
+   md5_byte_t     md5val[16];
+   LuaBytecode_t  lbq;
+   LuaBytecode_t *lb;
+   char          *cachefile = NULL;
+   Uint64         t         = SDL_GetPerformanceCounter();
+   int            ret;
+
+   /* Anything that changes the bytecode has to be part of the key. */
+   md5_init( &md5 );
+   md5_append( &md5, (const md5_byte_t *)LUA_VERSION, sizeof( LUA_VERSION ) );
+   md5_append( &md5, (const md5_byte_t *)name, strlen( name ) + 1 );
+   md5_append( &md5, (const md5_byte_t *)buf, (int)sz );
+   md5_finish( &md5, md5val );
+   for ( int i = 0; i < 16; i++ )
+      snprintf( &lbq.digest[i * 2], 3, "%02x", md5val[i] );
+
+   /* Already compiled this session. */
+   lb = bsearch( &lbq, lua_bytecode, array_size( lua_bytecode ),
+                 sizeof( LuaBytecode_t ), lua_bytecode_cmp );
+   if ( lb != NULL ) {
+      ret = luaL_loadbuffer( L, lb->data, lb->size, name );
+      lua_bcMemory++;
+      lua_bcTime += SDL_GetPerformanceCounter() - t;
+      return ret;
+   }
+
+   /* Compiled in a previous session. */
+   if ( conf.loaded && conf.lua_cache ) {
+      SDL_asprintf( &cachefile, "%sluac/%s", nfile_cachePath(), lbq.digest );
+      if ( nfile_fileExists( cachefile ) ) {
+         lbq.data = nfile_readFile( &lbq.size, cachefile );
+         if ( lbq.data != NULL ) {
+            if ( luaL_loadbuffer( L, lbq.data, lbq.size, name ) == 0 ) {
+               nlua_bytecodeAdd( &lbq );
+               free( cachefile );
+               lua_bcDisk++;
+               lua_bcTime += SDL_GetPerformanceCounter() - t;
+               return 0;
+            }
+            /* Stale or corrupt, will get overwritten. */
+            lua_pop( L, 1 );
+            free( lbq.data );
+         }
+      }
+   }
+
+   /* Have to compile it. */
+   ret = luaL_loadbuffer( L, buf, sz, name );
+   if ( ret != 0 ) {
+      free( cachefile );
+      return ret;
+   }
+   lua_bcCompiled++;
+
+   /* Store the bytecode. */
+   lbq.data = NULL;
+   lbq.size = 0;
+   if ( ( lua_dump( L, nlua_bytecodeWriter, &lbq ) == 0 ) &&
+        ( lbq.data != NULL ) ) {
+      if ( cachefile != NULL ) {
+         char dirpath[PATH_MAX];
+         snprintf( dirpath, sizeof( dirpath ), "%s/%s", nfile_cachePath(),
+                   "luac/" );
+         nfile_dirMakeExist( dirpath );
+         nfile_writeFileAtomic( lbq.data, lbq.size, cachefile );
+      }
+      nlua_bytecodeAdd( &lbq );
+   } else
+      free( lbq.data );
+   free( cachefile );
+
+   lua_bcTime += SDL_GetPerformanceCounter() - t;
+   return 0;
+}
+
+/**
+ * @brief Logs how the Lua chunks loaded so far were obtained.
+ */
+void nlua_bytecodeReport( void )
+{
+   DEBUG( _( "Lua chunks: %d compiled, %d from memory, %d from disk in "
+             "%.3f s" ),
+          lua_bcCompiled, lua_bcMemory, lua_bcDisk,
+          (double)lua_bcTime / (double)SDL_GetPerformanceFrequency() );
+}
+
 static int nlua_package_preload( lua_State *L )
 {
    const char *name = luaL_checkstring( L, 1 );
@@ -742,7 +1168,7 @@ static int nlua_package_loader_lua( lua_State *L )
 
    /* Try to process the Lua. It will leave a function or message on the stack,
     * as required. */
-   luaL_loadbuffer( L, buf, bufsize, path_filename );
+   nlua_loadbuffer( L, buf, bufsize, path_filename );
    free( buf );
 
    /* Cache the result. */
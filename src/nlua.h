@@ -14,6 +14,8 @@
    "_LOADED" /**< Table to use to store the status of required libraries. */
 
 #define NLUA_DONE "__done__"
+#define NLUA_GC_BUDGET                                                         \
+   1e-3 /**< Minimum time per frame for garbage collection in seconds. */
 #define NLUA_DEPRECATED( L, f )                                                \
    do {                                                                        \
       lua_pushfstring( L, _( "Deprecated function call: %s" ), f );            \
@@ -48,8 +50,12 @@ void     nlua_register( nlua_env env, const char *libname, const luaL_Reg *l,
                         int metatable );
 int      nlua_dobufenv( nlua_env env, const char *buff, size_t sz,
                         const char *name );
+int      nlua_dostringenv( nlua_env env, const char *str, const char *name );
 int      nlua_dofileenv( nlua_env env, const char *filename );
 int      nlua_dochunkenv( nlua_env env, int chunk, const char *name );
+int      nlua_loadbuffer( lua_State *L, const char *buf, size_t sz,
+                          const char *name );
+void     nlua_bytecodeReport( void );
 int      nlua_loadStandard( nlua_env env );
 int      nlua_errTrace( lua_State *L );
 int      nlua_pcall( nlua_env env, int nargs, int nresults );
@@ -57,6 +63,11 @@ int      nlua_refenv( nlua_env env, const char *name );
 int      nlua_refenvtype( nlua_env env, const char *name, int type );
 int      nlua_reffield( int objref, const char *name );
 
+/* Garbage collection. */
+void nlua_gcStep( double budget );
+void nlua_gcCollect( void );
+void nlua_gcStats( double *heap, double *pause );
+
 /* Reference stuff. */
 int  nlua_ref( lua_State *L, int idx );
 void nlua_unref( lua_State *L, int idx );
@@ -455,7 +455,7 @@ static int audio_genSource( ALuint *source )
    case AL_OUT_OF_MEMORY:
       /* Assume that we need to collect audio stuff. */
       soundUnlock();
-      lua_gc( naevL, LUA_GCCOLLECT, 0 );
+      nlua_gcCollect();
       soundLock();
       /* Try to create source again. */
       alGenSources( 1, source );
@@ -79,6 +79,7 @@ static int naevL_difficulty( lua_State *L );
 static int naevL_envs( lua_State *L );
 static int naevL_debugTrails( lua_State *L );
 static int naevL_debugCollisions( lua_State *L );
+static int naevL_debugGC( lua_State *L );
 #endif /* DEBUGGING */
 
 static const luaL_Reg naev_methods[] = {
@@ -123,6 +124,7 @@ static const luaL_Reg naev_methods[] = {
    { "envs", naevL_envs },
    { "debugTrails", naevL_debugTrails },
    { "debugCollisions", naevL_debugCollisions },
+   { "debugGC", naevL_debugGC },
 #endif         /* DEBUGGING */
    { 0, 0 } }; /**< Naev Lua methods. */
 
@@ -1081,4 +1083,23 @@ static int naevL_debugCollisions( lua_State *L )
       debug_rmFlag( DEBUG_MARK_COLLISION );
    return 0;
 }
+
+/**
+ * @brief Toggles the Lua garbage collection overlay.
+ *
+ * Shows the size of the Lua heap and the worst recent garbage collection pause
+ * below the FPS.
+ *
+ *    @luatparam[opt=true] boolean state Whether or not to show the overlay.
+ * @luafunc debugGC
+ */
+static int naevL_debugGC( lua_State *L )
+{
+   int state = ( lua_gettop( L ) > 0 ) ? lua_toboolean( L, 1 ) : 1;
+   if ( state )
+      debug_setFlag( DEBUG_LUA_GC );
+   else
+      debug_rmFlag( DEBUG_LUA_GC );
+   return 0;
+}
 #endif /* DEBUGGING */
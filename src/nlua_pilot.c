@@ -114,6 +114,8 @@ static int pilotL_outfitReady( lua_State *L );
 static int pilotL_rename( lua_State *L );
 static int pilotL_position( lua_State *L );
 static int pilotL_velocity( lua_State *L );
+static int pilotL_positionXY( lua_State *L );
+static int pilotL_velocityXY( lua_State *L );
 static int pilotL_isStopped( lua_State *L );
 static int pilotL_dir( lua_State *L );
 static int pilotL_signature( lua_State *L );
@@ -311,6 +313,8 @@ static const luaL_Reg pilotL_methods[] = {
    { "rename", pilotL_rename },
    { "pos", pilotL_position },
    { "vel", pilotL_velocity },
+   { "posxy", pilotL_positionXY },
+   { "velxy", pilotL_velocityXY },
    { "isStopped", pilotL_isStopped },
    { "dir", pilotL_dir },
    { "signature", pilotL_signature },
@@ -2829,6 +2833,48 @@ static int pilotL_velocity( lua_State *L )
    return 1;
 }
 
+/**
+ * @brief Gets the pilot's position as coordinates.
+ *
+ * Unlike pilot.pos, this doesn't create a new vector, so it is better suited
+ * for code that runs every frame.
+ *
+ * @usage x, y = p:posxy()
+ *
+ *    @luatparam Pilot p Pilot to get the position of.
+ *    @luatreturn number X coordinate of the pilot's position.
+ *    @luatreturn number Y coordinate of the pilot's position.
+ * @luafunc posxy
+ */
+static int pilotL_positionXY( lua_State *L )
+{
+   const Pilot *p = luaL_validpilot( L, 1 );
+   lua_pushnumber( L, p->solid.pos.x );
+   lua_pushnumber( L, p->solid.pos.y );
+   return 2;
+}
+
+/**
+ * @brief Gets the pilot's velocity as coordinates.
+ *
+ * Unlike pilot.vel, this doesn't create a new vector, so it is better suited
+ * for code that runs every frame.
+ *
+ * @usage vx, vy = p:velxy()
+ *
+ *    @luatparam Pilot p Pilot to get the velocity of.
+ *    @luatreturn number X coordinate of the pilot's velocity.
+ *    @luatreturn number Y coordinate of the pilot's velocity.
+ * @luafunc velxy
+ */
+static int pilotL_velocityXY( lua_State *L )
+{
+   const Pilot *p = luaL_validpilot( L, 1 );
+   lua_pushnumber( L, p->solid.vel.x );
+   lua_pushnumber( L, p->solid.vel.y );
+   return 2;
+}
+
 /**
  * @brief Checks to see if a pilot is stopped.
  *
@@ -3072,6 +3118,7 @@ static int pilotL_setPosition( lua_State *L )
 
    /* Warp pilot to new position. */
    p->solid.pos = *vec;
+   pilot_quadtreeInvalidate();
 
    /* Update if necessary. */
    if ( pilot_isPlayer( p ) )
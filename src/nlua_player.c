@@ -1174,6 +1174,7 @@ static int playerL_land( lua_State *L )
       ovr_initAlpha();
    }
    player.p->solid.pos = spob->pos; /* Set position to target. */
+   pilot_quadtreeInvalidate();
 
    /* End autonav. */
    player_autonavEnd();
@@ -2497,6 +2498,7 @@ static int playerL_teleport( lua_State *L )
    /* Move to spob. */
    if ( pnt != NULL )
       player.p->solid.pos = pnt->pos;
+   pilot_quadtreeInvalidate();
 
    /* Move all escorts to new position. */
    Pilot *const *pilot_stack = pilot_getAll();
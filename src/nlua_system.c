@@ -473,6 +473,13 @@ static int systemL_jumpdistance( lua_State *L )
       return 1;
    }
 
+   /* Without knowledge restrictions we can use the cached distances. */
+   if ( k ) {
+      int d = map_jumpDist( start, goal, h );
+      lua_pushnumber( L, ( d < 0 ) ? HUGE_VAL : (double)d );
+      return 1;
+   }
+
    s = map_getJumpPath( start, NULL, goal, k, h, NULL, NULL );
    if ( s == NULL ) {
       lua_pushnumber( L, HUGE_VAL );
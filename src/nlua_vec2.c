@@ -102,6 +102,14 @@ int nlua_loadVector( nlua_env env )
  * my_vec = my_vec - your_vec -- my_vec is now (19,13)
  * @endcode
  *
+ * Every vector is a new object for the garbage collector, so code that runs
+ * every frame should prefer modifying vectors in place:
+ *
+ * @code
+ * my_vec:set( your_vec ) -- my_vec is now (5,2)
+ * my_vec:add( 1, 1 ):mul( 2 ) -- my_vec is now (12,6)
+ * @endcode
+ *
  * To call members of the metatable always use:
  * @code
  * vector:function( param )
@@ -338,7 +346,7 @@ static int vectorL_add__( lua_State *L )
 
    /* Actually add it */
    vec2_cset( v1, v1->x + x, v1->y + y );
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 );
 
    return 1;
 }
@@ -409,7 +417,7 @@ static int vectorL_sub__( lua_State *L )
 
    /* Actually add it */
    vec2_cset( v1, v1->x - x, v1->y - y );
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 );
    return 1;
 }
 
@@ -460,7 +468,7 @@ static int vectorL_mul__( lua_State *L )
    }
 
    /* Actually add it */
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 );
    return 1;
 }
 
@@ -501,7 +509,7 @@ static int vectorL_div__( lua_State *L )
       vec2_cset( v1, v1->x / v2->x, v1->y / v2->y );
    }
 
-   lua_pushvector( L, *v1 );
+   lua_pushvalue( L, 1 );
    return 1;
 }
 static int vectorL_unm( lua_State *L )
@@ -588,9 +596,10 @@ static int vectorL_polar( lua_State *L )
  * @brief Sets the vector by cartesian coordinates.
  *
  * @usage my_vec:set(5, 3) -- my_vec is now (5,3)
+ * @usage my_vec:set(your_vec) -- my_vec is now a copy of your_vec
  *
  *    @luatparam Vec2 v Vector to set coordinates of.
- *    @luatparam number x X coordinate to set.
+ *    @luatparam number|Vec2 x X coordinate or vector to set.
  *    @luatparam number y Y coordinate to set.
  * @luafunc set
  */
@@ -601,8 +610,12 @@ static int vectorL_set( lua_State *L )
 
    /* Get parameters. */
    v1 = luaL_checkvector( L, 1 );
-   x  = luaL_checknumber( L, 2 );
-   y  = luaL_checknumber( L, 3 );
+   if ( lua_isvector( L, 2 ) ) {
+      *v1 = *lua_tovector( L, 2 );
+      return 0;
+   }
+   x = luaL_checknumber( L, 2 );
+   y = luaL_checknumber( L, 3 );
 
    vec2_cset( v1, x, y );
    return 0;
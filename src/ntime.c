@@ -90,6 +90,7 @@ void ntime_update( double dt )
 
    /* Increment. */
    naev_time += inc;
+   economy_update( inc );
    hooks_updateDate( inc );
 }
 
@@ -8,7 +8,17 @@
  */
 #include "nxml.h"
 
+#include "array.h"
 #include "ndata.h"
+#include "threadpool.h"
+
+/**
+ * @brief Arguments of xml_parseRange.
+ */
+typedef struct XmlParseData_ {
+   char *const *filenames; /**< Files to parse. */
+   xmlDocPtr   *docs;      /**< Parsed documents. */
+} XmlParseData;
 
 /**
  * @brief Parses a texture handling the sx and sy elements.
@@ -61,6 +71,52 @@ void xmlw_setParams( xmlTextWriterPtr writer )
    xmlTextWriterSetIndent( writer, 1 );
 }
 
+/**
+ * @brief Parses a range of the files of xml_parsePhysFSAll.
+ */
+static void xml_parseRange( int start, int end, void *data )
+{
+   const XmlParseData *xpd = data;
+   for ( int i = start; i < end; i++ )
+      xpd->docs[i] = ndata_matchExt( xpd->filenames[i], "xml" )
+                        ? xml_parsePhysFS( xpd->filenames[i] )
+                        : NULL;
+}
+
+/**
+ * @brief Parses many files in parallel with xml_parsePhysFS.
+ *
+ * Only the parsing is done in parallel, so the caller can then go over the
+ * documents in order and do anything that isn't thread safe.
+ *
+ *    @param filenames Array (array.h) of PhysFS file names.
+ *    @return Array (array.h) with the document of each file, NULL for the ones
+ *            that aren't ".xml" or failed to parse. Free with xml_freeAll.
+ */
+xmlDocPtr *xml_parsePhysFSAll( char *const *filenames )
+{
+   XmlParseData xpd;
+   int          n = array_size( filenames );
+
+   xpd.filenames = filenames;
+   xpd.docs      = array_create_size( xmlDocPtr, n );
+   array_resize( &xpd.docs, n );
+   job_parallelFor( n, 1, xml_parseRange, &xpd );
+   return xpd.docs;
+}
+
+/**
+ * @brief Frees the documents from xml_parsePhysFSAll.
+ *
+ *    @param docs Array (array.h) of documents to free.
+ */
+void xml_freeAll( xmlDocPtr *docs )
+{
+   for ( int i = 0; i < array_size( docs ); i++ )
+      xmlFreeDoc( docs[i] );
+   array_free( docs );
+}
+
 /**
  * @brief Analogous to xmlParseMemory/xmlParseFile.
  * @param filename PhysFS file name.
@@ -278,6 +278,8 @@ static inline char *nxml_trace_strdup( void *ptr )
  * Functions for generic complex reading.
  */
 xmlDocPtr             xml_parsePhysFS( const char *filename );
+xmlDocPtr            *xml_parsePhysFSAll( char *const *filenames );
+void                  xml_freeAll( xmlDocPtr *docs );
 USE_RESULT glTexture *xml_parseTexture( xmlNodePtr node, const char *path,
                                         int defsx, int defsy,
                                         const unsigned int flags );
@@ -29,12 +29,33 @@
 
 #include "opengl_render.h"
 
+#include "array.h"
 #include "camera.h"
 #include "gui.h"
+#include "ntracing.h"
 #include "opengl.h"
 
 #define OPENGL_RENDER_VBO_SIZE 256 /**< Size of VBO. */
 
+/**
+ * @brief A queued sprite, uploaded as is as instance data.
+ */
+typedef struct SpriteInstance_ {
+   GLfloat pos[4];    /**< Screen position and size. */
+   GLfloat tex[4];    /**< Sprite cell within the texture. */
+   GLfloat colour[4]; /**< Colour to modulate the texture with. */
+   GLfloat params[2]; /**< Rotation angle and interpolation. */
+} SpriteInstance;
+
+/**
+ * @brief State needed to draw a queued sprite.
+ */
+typedef struct SpriteKey_ {
+   GLuint ta;  /**< Texture to draw. */
+   GLuint tb;  /**< Texture to interpolate with, ta if not interpolating. */
+   int    idx; /**< Position in the queue, keeps sorting stable. */
+} SpriteKey;
+
 static gl_vbo *gl_renderVBO          = 0; /**< VBO for rendering stuff. */
 gl_vbo        *gl_squareVBO          = 0;
 static gl_vbo *gl_squareEmptyVBO     = 0;
@@ -44,6 +65,15 @@ static gl_vbo *gl_triangleVBO        = 0;
 static int     gl_renderVBOtexOffset = 0; /**< VBO texture offset. */
 static int     gl_renderVBOcolOffset = 0; /**< VBO colour offset. */
 
+static SpriteInstance *gl_batchData    = NULL; /**< Queued sprites. */
+static SpriteKey      *gl_batchKeys    = NULL; /**< State of queued sprites. */
+static SpriteInstance *gl_batchSorted  = NULL; /**< Sprites in draw order. */
+static gl_vbo         *gl_batchVBO     = NULL; /**< Sprite instance data. */
+static int             gl_batchSprites = 0;    /**< Sprites since last frame. */
+static int             gl_batchDraws   = 0;    /**< Draws since last frame. */
+
+static mat4 gl_batchView; /**< View matrix of the queued sprites. */
+
 void gl_beginSolidProgram( mat4 projection, const glColour *c )
 {
    glUseProgram( shaders.solid.program );
@@ -900,6 +930,306 @@ void gl_renderSpriteInterpolateScale( const glTexture *sa, const glTexture *sb,
                                 sa->srh, c );
 }
 
+/**
+ * @brief Queues a texture blit to be drawn by the sprite batch.
+ *
+ * Parameters are the same as gl_renderTextureRaw, with tb being the texture
+ *  to interpolate with.
+ */
+static void gl_batchQueue( GLuint ta, GLuint tb, double inter, uint8_t flags,
+                           double x, double y, double w, double h, double tx,
+                           double ty, double tw, double th, const glColour *c,
+                           double angle )
+{
+   SpriteInstance *s;
+   SpriteKey      *k;
+
+   /* Queued sprites have to be drawn with the view they were queued with. */
+   if ( ( array_size( gl_batchKeys ) > 0 ) &&
+        ( memcmp( &gl_batchView, &gl_view_matrix, sizeof( mat4 ) ) != 0 ) )
+      gl_batchFlush();
+   if ( array_size( gl_batchKeys ) == 0 )
+      gl_batchView = gl_view_matrix;
+   if ( gl_batchData == NULL ) {
+      gl_batchData = array_create( SpriteInstance );
+      gl_batchKeys = array_create( SpriteKey );
+   }
+
+   /* Must have colour for now. */
+   if ( c == NULL )
+      c = &cWhite;
+
+   /* Same corner cases as gl_renderTextureInterpolateRawH. */
+   if ( inter >= 1. )
+      tb = ta;
+   else if ( inter <= 0. )
+      ta = tb;
+   if ( ta == tb )
+      inter = 1.;
+
+   k      = &array_grow( &gl_batchKeys );
+   k->ta  = ta;
+   k->tb  = tb;
+   k->idx = array_size( gl_batchData );
+
+   s         = &array_grow( &gl_batchData );
+   s->pos[0] = x;
+   s->pos[1] = y;
+   s->pos[2] = w;
+   s->pos[3] = h;
+   /* Same as the texture matrix of gl_renderTextureRaw. */
+   s->tex[0] = tx;
+   s->tex[2] = tw;
+   if ( flags & OPENGL_TEX_VFLIP ) {
+      s->tex[1] = 1. - ty;
+      s->tex[3] = -th;
+   } else {
+      s->tex[1] = ty;
+      s->tex[3] = th;
+   }
+   s->colour[0] = c->r;
+   s->colour[1] = c->g;
+   s->colour[2] = c->b;
+   s->colour[3] = c->a;
+   s->params[0] = angle;
+   s->params[1] = inter;
+
+   gl_batchSprites++;
+}
+
+/**
+ * @brief Queues a sprite to be drawn by the sprite batch, position is relative
+ * to the player.
+ *
+ * Renders the same as gl_renderSpriteScaleRotate, but only once the batch is
+ *  flushed.
+ *
+ *    @param sprite Sprite to blit.
+ *    @param bx X position of the texture relative to the player.
+ *    @param by Y position of the texture relative to the player.
+ *    @param scalew Scaling of width.
+ *    @param scaleh Scaling of height.
+ *    @param angle Angle to rotate when rendering.
+ *    @param sx X position of the sprite to use.
+ *    @param sy Y position of the sprite to use.
+ *    @param c Colour to use (modifies texture colour).
+ */
+void gl_batchSprite( const glTexture *sprite, double bx, double by,
+                     double scalew, double scaleh, double angle, int sx, int sy,
+                     const glColour *c )
+{
+   double x, y, w, h, tx, ty, z;
+
+   /* Translate coords. */
+   z = cam_getZoom();
+   gl_gameToScreenCoords( &x, &y, bx - sprite->sw * 0.5,
+                          by - sprite->sh * 0.5 );
+
+   /* Scaled sprite dimensions. */
+   w = sprite->sw * z * scalew;
+   h = sprite->sh * z * scaleh;
+
+   /* check if inbounds */
+   if ( ( x < -w ) || ( x > SCREEN_W + w ) || ( y < -h ) ||
+        ( y > SCREEN_H + h ) )
+      return;
+
+   /* texture coords */
+   tx = sprite->sw * (double)( sx ) / sprite->w;
+   ty = sprite->sh * ( sprite->sy - (double)sy - 1 ) / sprite->h;
+
+   gl_batchQueue( sprite->texture, sprite->texture, 1., sprite->flags, x, y, w,
+                  h, tx, ty, sprite->srw, sprite->srh, c, angle );
+}
+
+/**
+ * @brief Queues a sprite interpolating to be drawn by the sprite batch,
+ * position is relative to the player.
+ *
+ * Renders the same as gl_renderSpriteInterpolateScale, but only once the batch
+ *  is flushed.
+ *
+ *    @param sa Sprite A to blit.
+ *    @param sb Sprite B to blit, can be NULL.
+ *    @param inter Amount to interpolate.
+ *    @param bx X position of the texture relative to the player.
+ *    @param by Y position of the texture relative to the player.
+ *    @param scalew X scale factor.
+ *    @param scaleh Y scale factor.
+ *    @param sx X position of the sprite to use.
+ *    @param sy Y position of the sprite to use.
+ *    @param c Colour to use (modifies texture colour).
+ */
+void gl_batchSpriteInterpolate( const glTexture *sa, const glTexture *sb,
+                                double inter, double bx, double by,
+                                double scalew, double scaleh, int sx, int sy,
+                                const glColour *c )
+{
+   double x, y, w, h, tx, ty, z;
+
+   /* Translate coords. */
+   gl_gameToScreenCoords( &x, &y, bx - scalew * sa->sw * 0.5,
+                          by - scaleh * sa->sh * 0.5 );
+
+   /* Scaled sprite dimensions. */
+   z = cam_getZoom();
+   w = sa->sw * z * scalew;
+   h = sa->sh * z * scaleh;
+
+   /* check if inbounds */
+   if ( ( x < -w ) || ( x > SCREEN_W + w ) || ( y < -h ) ||
+        ( y > SCREEN_H + h ) )
+      return;
+
+   /* texture coords */
+   tx = sa->sw * (double)( sx ) / sa->w;
+   ty = sa->sh * ( sa->sy - (double)sy - 1 ) / sa->h;
+
+   gl_batchQueue( sa->texture, ( sb != NULL ) ? sb->texture : sa->texture,
+                  ( sb != NULL ) ? inter : 1., sa->flags, x, y, w, h, tx, ty,
+                  sa->srw, sa->srh, c, 0. );
+}
+
+/**
+ * @brief Compares queued sprites by state, then by queue order.
+ */
+static int gl_batchCmp( const void *p1, const void *p2 )
+{
+   const SpriteKey *k1 = p1;
+   const SpriteKey *k2 = p2;
+   if ( k1->ta != k2->ta )
+      return ( k1->ta < k2->ta ) ? -1 : +1;
+   if ( k1->tb != k2->tb )
+      return ( k1->tb < k2->tb ) ? -1 : +1;
+   return k1->idx - k2->idx;
+}
+
+/**
+ * @brief Draws all the queued sprites with one draw call per state change.
+ *
+ *    @param sort Whether to group sprites by state first, which changes the
+ *                order they are drawn in.
+ */
+static void gl_batchDraw( int sort )
+{
+   const SpriteInstance *data;
+   int                   n = array_size( gl_batchKeys );
+
+   if ( n == 0 )
+      return;
+
+   const GLuint attribs[] = {
+      shaders.texture_batch.pos,
+      shaders.texture_batch.tex,
+      shaders.texture_batch.colour,
+      shaders.texture_batch.params,
+   };
+   const GLint sizes[] = { 4, 4, 4, 2 };
+
+   /* Put the sprites in draw order. */
+   if ( sort ) {
+      qsort( gl_batchKeys, n, sizeof( SpriteKey ), gl_batchCmp );
+      if ( gl_batchSorted == NULL )
+         gl_batchSorted = array_create_size( SpriteInstance, n );
+      array_resize( &gl_batchSorted, n );
+      for ( int i = 0; i < n; i++ )
+         gl_batchSorted[i] = gl_batchData[gl_batchKeys[i].idx];
+      data = gl_batchSorted;
+   } else
+      data = gl_batchData;
+
+   /* Upload the sprites. */
+   if ( gl_batchVBO == NULL )
+      gl_batchVBO = gl_vboCreateStream( n * sizeof( SpriteInstance ), data );
+   else
+      gl_vboData( gl_batchVBO, n * sizeof( SpriteInstance ), data );
+
+   glUseProgram( shaders.texture_batch.program );
+   gl_uniformMat4( shaders.texture_batch.projection, &gl_batchView );
+   glUniform1i( shaders.texture_batch.sampler1, 0 );
+   glUniform1i( shaders.texture_batch.sampler2, 1 );
+
+   /* The square is shared, the rest changes per sprite. */
+   glEnableVertexAttribArray( shaders.texture_batch.vertex );
+   gl_vboActivateAttribOffset( gl_squareVBO, shaders.texture_batch.vertex, 0,
+                               2, GL_FLOAT, 0 );
+   for ( size_t j = 0; j < sizeof( attribs ) / sizeof( attribs[0] ); j++ ) {
+      glEnableVertexAttribArray( attribs[j] );
+      glVertexAttribDivisor( attribs[j], 1 );
+   }
+
+   /* One draw per run of sprites with the same textures. */
+   for ( int i = 0; i < n; ) {
+      int e = i + 1;
+      while ( ( e < n ) && ( gl_batchKeys[e].ta == gl_batchKeys[i].ta ) &&
+              ( gl_batchKeys[e].tb == gl_batchKeys[i].tb ) )
+         e++;
+
+      /* Bind the textures. */
+      glActiveTexture( GL_TEXTURE1 );
+      glBindTexture( GL_TEXTURE_2D, gl_batchKeys[i].tb );
+      glActiveTexture( GL_TEXTURE0 );
+      glBindTexture( GL_TEXTURE_2D, gl_batchKeys[i].ta );
+      /* Always end with TEXTURE0 active. */
+
+      for ( size_t j = 0; j < sizeof( attribs ) / sizeof( attribs[0] ); j++ )
+         gl_vboActivateAttribOffset(
+            gl_batchVBO, attribs[j],
+            i * sizeof( SpriteInstance ) + j * 4 * sizeof( GLfloat ), sizes[j],
+            GL_FLOAT, sizeof( SpriteInstance ) );
+
+      /* Draw. */
+      glDrawArraysInstanced( GL_TRIANGLE_STRIP, 0, 4, e - i );
+      gl_batchDraws++;
+      i = e;
+   }
+
+   /* Clear state. */
+   for ( size_t j = 0; j < sizeof( attribs ) / sizeof( attribs[0] ); j++ ) {
+      glVertexAttribDivisor( attribs[j], 0 );
+      glDisableVertexAttribArray( attribs[j] );
+   }
+   glDisableVertexAttribArray( shaders.texture_batch.vertex );
+   array_resize( &gl_batchData, 0 );
+   array_resize( &gl_batchKeys, 0 );
+
+   /* anything failed? */
+   gl_checkErr();
+
+   glUseProgram( 0 );
+}
+
+/**
+ * @brief Draws all the queued sprites in the order they were queued.
+ *
+ * Consecutive sprites using the same textures are drawn together.
+ */
+void gl_batchFlush( void )
+{
+   gl_batchDraw( 0 );
+}
+
+/**
+ * @brief Draws all the queued sprites grouped by texture.
+ *
+ * Only for layers where the order the sprites overlap in does not matter.
+ */
+void gl_batchFlushSorted( void )
+{
+   gl_batchDraw( 1 );
+}
+
+/**
+ * @brief Plots the sprite batch statistics of the frame and resets them.
+ */
+void gl_batchFrame( void )
+{
+   NTracingPlotI( "sprites", gl_batchSprites );
+   NTracingPlotI( "sprite draws", gl_batchDraws );
+   gl_batchSprites = 0;
+   gl_batchDraws   = 0;
+}
+
 /**
  * @brief Blits a sprite, position is in absolute screen coordinates.
  *
@@ -1327,5 +1657,15 @@ void gl_exitRender( void )
    gl_vboDestroy( gl_squareEmptyVBO );
    gl_vboDestroy( gl_lineVBO );
    gl_vboDestroy( gl_triangleVBO );
+   gl_vboDestroy( gl_batchVBO );
    gl_renderVBO = NULL;
+   gl_batchVBO  = NULL;
+
+   /* Clean up the sprite batch. */
+   array_free( gl_batchData );
+   array_free( gl_batchKeys );
+   array_free( gl_batchSorted );
+   gl_batchData   = NULL;
+   gl_batchKeys   = NULL;
+   gl_batchSorted = NULL;
 }
@@ -83,6 +83,17 @@ void gl_renderSpriteInterpolateScale( const glTexture *sa, const glTexture *sb,
                                       double inter, double bx, double by,
                                       double scalew, double scaleh, int sx,
                                       int sy, const glColour *c );
+/* Queues sprites to be drawn together, relative pos. */
+void gl_batchSprite( const glTexture *sprite, double bx, double by,
+                     double scalew, double scaleh, double angle, int sx, int sy,
+                     const glColour *c );
+void gl_batchSpriteInterpolate( const glTexture *sa, const glTexture *sb,
+                                double inter, double bx, double by,
+                                double scalew, double scaleh, int sx, int sy,
+                                const glColour *c );
+void gl_batchFlush( void );
+void gl_batchFlushSorted( void );
+void gl_batchFrame( void );
 /* blits a sprite, absolute pos */
 void gl_renderStaticSprite( const glTexture *sprite, double bx, double by,
                             int sx, int sy, const glColour *c );
@@ -44,6 +44,8 @@ static glTexList   *texture_list = NULL; /**< Texture list. */
 static SDL_threadID tex_mainthread;
 static SDL_mutex   *gl_lock  = NULL; /**< Lock for OpenGL functions. */
 static SDL_mutex   *tex_lock = NULL; /**< Lock for texture list manipulation. */
+static SDL_cond    *tex_cond = NULL; /**< Signals textures finishing loading. */
+static glTexture  **tex_busy = NULL; /**< Textures still being loaded. */
 
 /*
  * prototypes
@@ -68,6 +70,7 @@ static glTexture *gl_texCreate( const char *path, int sx, int sy,
                                 unsigned int flags );
 static int gl_texAdd( glTexture *tex, int sx, int sy, unsigned int flags );
 static int tex_cmp( const void *p1, const void *p2 );
+static int tex_isBusy( const glTexture *tex );
 
 static void tex_ctxSet( void )
 {
@@ -405,13 +408,9 @@ static GLuint gl_loadSurface( SDL_Surface *surface, unsigned int flags,
    const SDL_PixelFormatEnum fmt = SDL_PIXELFORMAT_ABGR8888;
    GLuint                    texture;
    SDL_Surface              *rgba;
+   GLfloat                  *dataf     = NULL;
    int                       has_alpha = surface->format->Amask;
 
-   gl_contextSet();
-
-   /* Get texture. */
-   texture = gl_texParameters( flags );
-
    /* Now load the texture data up
     * It doesn't work with indexed ones, so I guess converting is best bet. */
    if ( surface->format->format != fmt )
@@ -419,12 +418,22 @@ static GLuint gl_loadSurface( SDL_Surface *surface, unsigned int flags,
    else
       rgba = surface;
 
+   /* Conversions are done before grabbing the context so that threads loading
+    * different textures only serialize on the upload itself. */
    SDL_LockSurface( rgba );
    if ( flags & OPENGL_TEX_SDF ) {
-      const float border[] = { 0., 0., 0., 0. };
-      uint8_t    *trans    = SDL_MapAlpha( rgba, 0 );
-      GLfloat    *dataf = make_distance_mapbf( trans, rgba->w, rgba->h, vmax );
+      uint8_t *trans = SDL_MapAlpha( rgba, 0 );
+      dataf          = make_distance_mapbf( trans, rgba->w, rgba->h, vmax );
       free( trans );
+   }
+
+   gl_contextSet();
+
+   /* Get texture. */
+   texture = gl_texParameters( flags );
+
+   if ( flags & OPENGL_TEX_SDF ) {
+      const float border[] = { 0., 0., 0., 0. };
       glTexParameterfv( GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border );
       glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER );
       glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER );
@@ -511,6 +520,7 @@ USE_RESULT glTexture *gl_texExistsOrCreate( const char  *path,
 {
    char        buf[STRMAX];
    const char *realdir;
+   glTexture  *tex;
 
    /* Null does never exist. */
    if ( ( path == NULL ) || ( flags & OPENGL_TEX_SKIPCACHE ) ) {
@@ -523,30 +533,72 @@ USE_RESULT glTexture *gl_texExistsOrCreate( const char  *path,
    snprintf( buf, sizeof( buf ), "%s/%s", realdir ? realdir : "[NULL]", path );
    SDL_mutexP( tex_lock );
 
-   /* Check to see if it already exists */
-   if ( texture_list == NULL ) {
-      glTexture *tex = gl_texCreate( buf, sx, sy, flags );
-      *created       = 1;
-      SDL_mutexV( tex_lock );
-      return tex;
-   }
-
-   /* Do some fancy binary search. */
    const glTexList q = { .path = buf, .sx = sx, .sy = sy, .flags = flags };
-   glTexList      *t = bsearch( &q, texture_list, array_size( texture_list ),
-                                sizeof( glTexList ), tex_cmp );
-   if ( t == NULL ) {
-      glTexture *tex = gl_texCreate( buf, sx, sy, flags );
-      *created       = 1;
-      SDL_mutexV( tex_lock );
-      return tex;
+   while ( 1 ) {
+      /* Do some fancy binary search. */
+      glTexList *t = NULL;
+      if ( texture_list != NULL )
+         t = bsearch( &q, texture_list, array_size( texture_list ),
+                      sizeof( glTexList ), tex_cmp );
+
+      /* Reserve the entry, the caller fills it and calls gl_texReady. */
+      if ( t == NULL ) {
+         tex = gl_texCreate( buf, sx, sy, flags );
+         if ( tex_busy == NULL )
+            tex_busy = array_create( glTexture * );
+         array_push_back( &tex_busy, tex );
+         *created = 1;
+         break;
+      }
+
+      /* Use new texture. */
+      if ( !tex_isBusy( t->tex ) ) {
+         t->used++;
+         tex      = t->tex;
+         *created = 0;
+         break;
+      }
+
+      /* Another thread is still loading it, wait for it instead. */
+      SDL_CondWait( tex_cond, tex_lock );
    }
 
-   /* Use new texture. */
-   t->used++;
-   *created = 0;
    SDL_mutexV( tex_lock );
-   return t->tex;
+   return tex;
+}
+
+/**
+ * @brief Checks to see if a texture is still being loaded.
+ *
+ * Must be called with tex_lock held.
+ */
+static int tex_isBusy( const glTexture *tex )
+{
+   for ( int i = 0; i < array_size( tex_busy ); i++ )
+      if ( tex_busy[i] == tex )
+         return 1;
+   return 0;
+}
+
+/**
+ * @brief Marks a texture created by gl_texExistsOrCreate as loaded.
+ *
+ * Wakes up any thread waiting for the same texture. Safe to call on textures
+ * that were not reserved.
+ *
+ *    @param tex Texture that finished loading.
+ */
+void gl_texReady( const glTexture *tex )
+{
+   SDL_mutexP( tex_lock );
+   for ( int i = 0; i < array_size( tex_busy ); i++ ) {
+      if ( tex_busy[i] != tex )
+         continue;
+      array_erase( &tex_busy, &tex_busy[i], &tex_busy[i + 1] );
+      SDL_CondBroadcast( tex_cond );
+      break;
+   }
+   SDL_mutexV( tex_lock );
 }
 
 /**
@@ -554,24 +606,34 @@ USE_RESULT glTexture *gl_texExistsOrCreate( const char  *path,
  */
 static int gl_texAdd( glTexture *tex, int sx, int sy, unsigned int flags )
 {
-   glTexList *new;
+   int             lo, hi;
+   const glTexList new = { .used  = 1,
+                           .tex   = tex,
+                           .sx    = sx,
+                           .sy    = sy,
+                           .flags = flags,
+                           .path  = tex->name };
 
    /* Get the new list element. */
    if ( texture_list == NULL )
       texture_list = array_create( glTexList );
 
-   /* Create the new node */
-   new        = &array_grow( &texture_list );
-   new->used  = 1;
-   new->tex   = tex;
-   new->sx    = sx;
-   new->sy    = sy;
-   new->flags = flags;
-   new->path  = tex->name;
-
-   /* Sort the list. */
-   qsort( texture_list, array_size( texture_list ), sizeof( glTexList ),
-          tex_cmp );
+   /* Find where it goes to keep the list sorted. */
+   lo = 0;
+   hi = array_size( texture_list );
+   while ( lo < hi ) {
+      int mid = ( lo + hi ) / 2;
+      if ( tex_cmp( &texture_list[mid], &new ) < 0 )
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   /* Insert the new node. */
+   array_push_back( &texture_list, new );
+   memmove( &texture_list[lo + 1], &texture_list[lo],
+            ( array_size( texture_list ) - lo - 1 ) * sizeof( glTexList ) );
+   texture_list[lo] = new;
    return 0;
 }
 
@@ -593,6 +655,7 @@ glTexture *gl_newImage( const char *path, const unsigned int flags )
 
    /* Load the image */
    gl_loadNewImage( t, path, 1, 1, flags );
+   gl_texReady( t );
    return t;
 }
 
@@ -618,6 +681,7 @@ glTexture *gl_newImageRWops( const char *path, SDL_RWops *rw,
 
    /* Load the image */
    gl_loadNewImageRWops( t, path, rw, 1, 1, flags );
+   gl_texReady( t );
    return t;
 }
 
@@ -792,6 +856,7 @@ glTexture *gl_newSprite( const char *path, const int sx, const int sy,
 
    /* Create new image. */
    gl_loadNewImage( t, path, sx, sy, flags );
+   gl_texReady( t );
    return t;
 }
 
@@ -824,6 +889,7 @@ glTexture *gl_newSpriteRWops( const char *path, SDL_RWops *rw, const int sx,
    t->sh  = t->h / t->sy;
    t->srw = t->sw / t->w;
    t->srh = t->sh / t->h;
+   gl_texReady( t );
    return t;
 }
 
@@ -837,7 +903,7 @@ void gl_freeTexture( glTexture *texture )
    if ( texture == NULL )
       return;
 
-   SDL_mutexP( gl_lock );
+   SDL_mutexP( tex_lock );
 
    /* see if we can find it in stack */
    for ( int i = 0; i < array_size( texture_list ); i++ ) {
@@ -848,19 +914,25 @@ void gl_freeTexture( glTexture *texture )
 
       /* found it */
       cur->used--;
-      if ( cur->used <= 0 ) { /* not used anymore */
-         /* free the texture */
-         glDeleteTextures( 1, &texture->texture );
-         free( texture->trans );
-         free( texture->name );
-         free( texture );
-
-         /* free the list node */
-         array_erase( &texture_list, &texture_list[i], &texture_list[i + 1] );
+      if ( cur->used > 0 ) {
+         SDL_mutexV( tex_lock );
+         return; /* still in use */
       }
-      SDL_mutexV( gl_lock );
+
+      /* free the list node, the texture is only ours now */
+      array_erase( &texture_list, &texture_list[i], &texture_list[i + 1] );
+      SDL_mutexV( tex_lock );
+
+      /* free the texture */
+      gl_contextSet();
+      glDeleteTextures( 1, &texture->texture );
+      gl_contextUnset();
+      free( texture->trans );
+      free( texture->name );
+      free( texture );
       return; /* we already found it so we can exit */
    }
+   SDL_mutexV( tex_lock );
 
    /* Not found */
    if ( texture->name != NULL ) /* Surfaces will have NULL names */
@@ -868,7 +940,7 @@ void gl_freeTexture( glTexture *texture )
             texture->name );
 
    /* Have to set context. */
-   tex_ctxSet();
+   gl_contextSet();
 
    /* Free anyways */
    glDeleteTextures( 1, &texture->texture );
@@ -878,8 +950,7 @@ void gl_freeTexture( glTexture *texture )
 
    gl_checkErr();
 
-   tex_ctxUnset();
-   SDL_mutexV( gl_lock );
+   gl_contextUnset();
 }
 
 /**
@@ -895,16 +966,16 @@ glTexture *gl_dupTexture( const glTexture *texture )
       return NULL;
 
    /* check to see if it already exists */
-   SDL_mutexP( gl_lock );
+   SDL_mutexP( tex_lock );
    for ( int i = 0; i < array_size( texture_list ); i++ ) {
       glTexList *cur = &texture_list[i];
       if ( texture == cur->tex ) {
          cur->used++;
-         SDL_mutexV( gl_lock );
+         SDL_mutexV( tex_lock );
          return cur->tex;
       }
    }
-   SDL_mutexV( gl_lock );
+   SDL_mutexV( tex_lock );
 
    /* Invalid texture. */
    WARN( _( "Unable to duplicate texture '%s'." ), texture->name );
@@ -1013,6 +1084,7 @@ int gl_initTextures( void )
 {
    gl_lock        = SDL_CreateMutex();
    tex_lock       = SDL_CreateMutex();
+   tex_cond       = SDL_CreateCond();
    tex_mainthread = SDL_ThreadID();
    return 0;
 }
@@ -1022,8 +1094,11 @@ int gl_initTextures( void )
  */
 void gl_exitTextures( void )
 {
+   SDL_DestroyCond( tex_cond );
    SDL_DestroyMutex( tex_lock );
    SDL_DestroyMutex( gl_lock );
+   array_free( tex_busy );
+   tex_busy = NULL;
 
    if ( array_size( texture_list ) <= 0 ) {
       array_free( texture_list );
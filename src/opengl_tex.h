@@ -76,6 +76,7 @@ void gl_exitTextures( void );
 USE_RESULT glTexture *gl_texExistsOrCreate( const char  *path,
                                             unsigned int flags, int sx, int sy,
                                             int *created );
+void                  gl_texReady( const glTexture *tex );
 USE_RESULT glTexture *gl_loadImageData( float *data, int w, int h, int sx,
                                         int sy, const char *name );
 USE_RESULT glTexture *gl_newImage( const char *path, const unsigned int flags );
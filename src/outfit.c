@@ -177,6 +177,10 @@ int outfit_gfxStoreLoaded( const Outfit *o )
 
 int outfit_gfxStoreLoadNeeded( void )
 {
+   int n = 0;
+#if DEBUGGING
+   Uint32 time = SDL_GetTicks();
+#endif /* DEBUGGING */
    ThreadQueue *tq = vpool_create();
    SDL_GL_MakeCurrent( gl_screen.window, NULL );
    for ( int i = 0; i < array_size( outfit_stack ); i++ ) {
@@ -185,10 +189,15 @@ int outfit_gfxStoreLoadNeeded( void )
          continue;
       vpool_enqueue( tq, (int ( * )( void * ))outfit_gfxStoreLoad, o );
       outfit_rmProp( o, OUTFIT_PROP_NEEDSGFX );
+      n++;
    }
    vpool_wait( tq );
    vpool_cleanup( tq );
    SDL_GL_MakeCurrent( gl_screen.window, gl_screen.context );
+   if ( conf.devmode && ( n > 0 ) )
+      DEBUG( n_( "Loaded graphics for %d Outfit in %.3f s",
+                 "Loaded graphics for %d Outfits in %.3f s", n ),
+             n, ( SDL_GetTicks() - time ) / 1000. );
    return 0;
 }
 
@@ -1009,6 +1018,25 @@ int outfit_soundHit( const Outfit *o )
       return o->u.lau.sound_hit;
    return -1.;
 }
+/**
+ * @brief Starts decoding all the sounds an outfit can play in the background.
+ *    @param o Outfit to prefetch sounds of.
+ */
+void outfit_prefetchSounds( const Outfit *o )
+{
+   if ( outfit_isBeam( o ) ) {
+      sound_prefetch( o->u.bem.sound_warmup );
+      sound_prefetch( o->u.bem.sound );
+      sound_prefetch( o->u.bem.sound_off );
+   } else if ( outfit_isAfterburner( o ) ) {
+      sound_prefetch( o->u.afb.sound_on );
+      sound_prefetch( o->u.afb.sound );
+      sound_prefetch( o->u.afb.sound_off );
+   } else {
+      sound_prefetch( outfit_sound( o ) );
+      sound_prefetch( outfit_soundHit( o ) );
+   }
+}
 /**
  * @brief Gets the outfit's ammunition mass.
  *    @param o Outfit to get ammunition mass from.
@@ -1355,8 +1383,7 @@ static int outfit_loadPLG( Outfit *temp, const char *buf )
 {
    char       file[PATH_MAX];
    OutfitGFX *gfx;
-   xmlDocPtr  doc;
-   xmlNodePtr node;
+   CollPoly  *polygons;
 
    if ( outfit_isLauncher( temp ) )
       gfx = &temp->u.lau.gfx;
@@ -1371,7 +1398,7 @@ static int outfit_loadPLG( Outfit *temp, const char *buf )
    snprintf( file, sizeof( file ), "%s%s.xml", OUTFIT_POLYGON_PATH, buf );
 
    /* See if the file does exist. */
-   if ( !PHYSFS_exists( file ) ) {
+   if ( poly_loadFile( &polygons, file ) ) {
       WARN( _( "%s xml collision polygon does not exist!\n \
                Please use the script 'polygon_from_sprite.py' \
 that can be found in Naev's artwork repo." ),
@@ -1379,25 +1406,12 @@ that can be found in Naev's artwork repo." ),
       return 0;
    }
 
-   /* Load the XML. */
-   doc = xml_parsePhysFS( file );
-
-   if ( doc == NULL )
-      return 0;
-
-   node = doc->xmlChildrenNode; /* First polygon node */
-   if ( node == NULL ) {
-      xmlFreeDoc( doc );
-      WARN( _( "Malformed %s file: does not contain elements" ), file );
-      return 0;
-   }
-
-   do { /* load the polygon data */
-      if ( xml_isNode( node, "polygons" ) )
-         poly_load( &gfx->polygon, node, file );
-   } while ( xml_nextNode( node ) );
-
-   xmlFreeDoc( doc );
+   /* The last polygon is the one used. */
+   for ( int i = 0; i < array_size( polygons ) - 1; i++ )
+      poly_free( &polygons[i] );
+   if ( array_size( polygons ) > 0 )
+      gfx->polygon = array_back( polygons );
+   array_free( polygons );
    return 0;
 }
 
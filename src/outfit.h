@@ -547,6 +547,7 @@ double           outfit_trackmax( const Outfit *o );
 int              outfit_miningRarity( const Outfit *o );
 int              outfit_sound( const Outfit *o );
 int              outfit_soundHit( const Outfit *o );
+void             outfit_prefetchSounds( const Outfit *o );
 double           outfit_ammoMass( const Outfit *o );
 /* Active outfits. */
 double outfit_duration( const Outfit *o );
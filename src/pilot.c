@@ -7,6 +7,7 @@
  * @brief Handles the pilot stuff.
  */
 /** @cond */
+#include <limits.h>
 #include <math.h>
 #include <stdlib.h>
 
@@ -40,12 +41,30 @@
 #include "quadtree.h"
 #include "rng.h"
 #include "sound.h"
+#include "threadpool.h"
 
 #define PILOT_SIZE_MIN 128 /**< Minimum chunks to increment pilot_stack by */
+#define PILOT_THINK_BATCH                                                      \
+   32 /**< Pilots per job when prefetching the think phase. */
 
-/* ID Generators. */
-static unsigned int pilot_id =
-   PLAYER_ID; /**< Stack of pilot ids to assure uniqueness */
+#define PILOT_SLOT_BITS 12                       /**< Slot bits of the IDs. */
+#define PILOT_SLOT_MAX ( 1u << PILOT_SLOT_BITS ) /**< Number of slots. */
+#define PILOT_SLOT_MASK ( PILOT_SLOT_MAX - 1 )   /**< Slot of an ID. */
+#define PILOT_SLOT_NONE 0                        /**< Not in the table. */
+#define PILOT_SLOT_PLAYER                                                      \
+   ( PLAYER_ID & PILOT_SLOT_MASK ) /**< Slot reserved for the player. */
+
+/* ID Generators.
+ *
+ * Pilot IDs are made of a serial in the upper bits and the slot of the pilot
+ * in the slot table in the lower bits. The serial always grows, so the IDs
+ * still are unique and sorted by creation order, while the slot allows
+ * pilot_get to find the pilot directly. */
+static unsigned int pilot_id        = 0; /**< Serial of the last pilot ID. */
+static int          pilot_idWrapped = 0; /**< Whether the serial wrapped. */
+static Pilot      **pilot_slots =
+   NULL; /**< Pilots in the stack indexed by slot (array.h). */
+static int *pilot_slotsFree = NULL; /**< Unused slots (array.h). */
 
 /* stack of pilots */
 static Pilot **pilot_stack =
@@ -54,11 +73,25 @@ static Pilot **pilot_stack =
 static Quadtree pilot_quadtree; /**< Quadtree for the pilots. */
 static IntList  pilot_qtquery;  /**< Quadtree query. */
 static int      qt_init = 0;
+/* Nearest neighbour queries. */
+static int    pilot_qtValid   = 0;    /**< Quadtree matches the stack. */
+static int    pilot_qtCount   = 0;    /**< Stack size the tree was built at. */
+static double pilot_qtSlack   = 0.;   /**< How far pilots may have moved. */
+static int   *pilot_qtMissing = NULL; /**< Stack positions not in the tree
+                                         (array.h). */
 /* A simple grid search procedure was used to determine the following
  * parameters. */
 static int qt_max_elem = 2;
 static int qt_depth    = 5;
 
+/* Think phase prefetching. */
+static Pilot **pilot_thinkers = NULL; /**< Pilots about to run their control
+                                         tick, reused every frame. */
+
+static unsigned int pilot_scanGen =
+   1; /**< Snapshot of the current think phase, the prefetched scans are only
+         used while it matches theirs. */
+
 /* misc */
 static const double pilot_commTimeout =
    15.; /**< Time for text above pilot to time out. */
@@ -77,8 +110,6 @@ static void pilot_init( Pilot *dest, const Ship *ship, const char *name,
 static void pilot_hyperspace( Pilot *pilot, double dt );
 static void pilot_refuel( Pilot *p, double dt );
 static void pilot_updateSolid( Pilot *p, double dt );
-/* Clean up. */
-static void pilot_erase( Pilot *p );
 /* Misc. */
 static void pilot_renderFramebufferBase( Pilot *p, GLuint fbo, double fw,
                                          double fh, const Lighting *L );
@@ -86,6 +117,12 @@ static int  pilot_getStackPos( unsigned int id );
 static void pilot_init_trails( Pilot *p );
 static int  pilot_trail_generated( Pilot *p, int generator );
 static void pilot_addQuadtree( const Pilot *p, int i );
+static void pilots_thinkPrefetch( void );
+static void pilot_scanNext( void );
+/* IDs. */
+static unsigned int pilot_genID( Pilot *p );
+static void         pilot_releaseID( const Pilot *p );
+static void         pilot_clearSlots( void );
 
 /**
  * @brief Gets the pilot stack.
@@ -119,10 +156,82 @@ static int pilot_getStackPos( unsigned int id )
    /* binary search */
    Pilot **pp = bsearch( &pidptr, pilot_stack, array_size( pilot_stack ),
                          sizeof( Pilot * ), pilot_cmp );
-   if ( pp == NULL )
-      return -1;
-   else
+   if ( pp != NULL )
       return pp - pilot_stack;
+
+   /* The stack is no longer sorted if the IDs wrapped around. */
+   if ( pilot_idWrapped ) {
+      for ( int i = 0; i < array_size( pilot_stack ); i++ )
+         if ( pilot_stack[i]->id == id )
+            return i;
+   }
+   return -1;
+}
+
+/**
+ * @brief Generates a new ID for a pilot and puts it in the slot table.
+ *
+ *    @param p Pilot to generate ID for.
+ *    @return The new ID.
+ */
+static unsigned int pilot_genID( Pilot *p )
+{
+   unsigned int slot;
+
+   /* Should take a very long time to happen. */
+   if ( ++pilot_id > ( UINT_MAX >> PILOT_SLOT_BITS ) ) {
+      WARN( _( "Ran out of pilot IDs, wrapping around!" ) );
+      pilot_id        = 1;
+      pilot_idWrapped = 1;
+   }
+
+   /* Get a free slot, or fall back to not being in the table when full. */
+   if ( array_size( pilot_slotsFree ) > 0 ) {
+      slot = array_back( pilot_slotsFree );
+      array_resize( &pilot_slotsFree, array_size( pilot_slotsFree ) - 1 );
+   } else if ( array_size( pilot_slots ) < (int)PILOT_SLOT_MAX ) {
+      slot = array_size( pilot_slots );
+      array_push_back( &pilot_slots, NULL );
+   } else
+      slot = PILOT_SLOT_NONE;
+
+   if ( slot != PILOT_SLOT_NONE )
+      pilot_slots[slot] = p;
+   return ( pilot_id << PILOT_SLOT_BITS ) | slot;
+}
+
+/**
+ * @brief Removes a pilot from the slot table, freeing the slot of its ID.
+ *
+ *    @param p Pilot to remove.
+ */
+static void pilot_releaseID( const Pilot *p )
+{
+   unsigned int slot = p->id & PILOT_SLOT_MASK;
+
+   /* Not in the table, or the slot was already taken over. */
+   if ( ( slot == PILOT_SLOT_NONE ) ||
+        ( (int)slot >= array_size( pilot_slots ) ) ||
+        ( pilot_slots[slot] != p ) )
+      return;
+
+   pilot_slots[slot] = NULL;
+   if ( slot != PILOT_SLOT_PLAYER )
+      array_push_back( &pilot_slotsFree, slot );
+}
+
+/**
+ * @brief Empties the slot table.
+ */
+static void pilot_clearSlots( void )
+{
+   array_erase( &pilot_slots, array_begin( pilot_slots ),
+                array_end( pilot_slots ) );
+   array_erase( &pilot_slotsFree, array_begin( pilot_slotsFree ),
+                array_end( pilot_slotsFree ) );
+   /* Slot 0 is for pilots not in the table, and the player has its own. */
+   for ( unsigned int i = 0; i <= PILOT_SLOT_PLAYER; i++ )
+      array_push_back( &pilot_slots, NULL );
 }
 
 /**
@@ -322,6 +431,136 @@ int pilot_validEnemy( const Pilot *p, const Pilot *target )
    return 1;
 }
 
+/**
+ * @brief Cost function for nearest pilot searches.
+ *
+ * Has to return a value no smaller than the squared distance to the target or
+ * a negative value if the target is not to be considered.
+ */
+typedef double PilotCostFunc( const Pilot *target, void *data );
+
+/**
+ * @brief Nearest pilot search passed through the quadtree.
+ */
+typedef struct PilotNearest_ {
+   PilotCostFunc *cost; /**< Cost function. */
+   void          *data; /**< Data passed to the cost function. */
+} PilotNearest;
+
+/**
+ * @brief Data for the nearest enemy searches.
+ */
+typedef struct PilotNearestEnemy_ {
+   const Pilot *p;             /**< Pilot looking for an enemy. */
+   double       mass_lb;       /**< Minimum mass of the enemy. */
+   double       mass_ub;       /**< Maximum mass of the enemy. */
+   double       mass_factor;   /**< Heuristic mass weight. */
+   double       health_factor; /**< Heuristic health weight. */
+   double       damage_factor; /**< Heuristic damage weight. */
+   double       range_factor;  /**< Heuristic range weight. */
+} PilotNearestEnemy;
+
+/**
+ * @brief Adapts a pilot cost function to the quadtree.
+ */
+static double pilot_nearestDist( void *user_data, int id )
+{
+   const PilotNearest *n = user_data;
+   return n->cost( pilot_stack[id], n->data );
+}
+
+/**
+ * @brief Checks a single pilot of the stack against the best candidate.
+ */
+static void pilot_nearestCheck( const PilotNearest *n, int i, int *best,
+                                double *best_cost )
+{
+   double c = n->cost( pilot_stack[i], n->data );
+   if ( ( c < 0. ) || ( c > *best_cost ) )
+      return;
+   if ( ( *best >= 0 ) && ( c == *best_cost ) && ( i > *best ) )
+      return;
+   *best      = i;
+   *best_cost = c;
+}
+
+/**
+ * @brief Finds the pilot with the lowest cost around a position.
+ *
+ * Uses the pilot quadtree when it is up to date with the stack and only
+ * checks the pilots that are not in it by hand. Ties are broken by the
+ * position in the stack, so the result is the same as a linear search.
+ *
+ *    @param x X position to search from.
+ *    @param y Y position to search from.
+ *    @param max_cost Maximum cost to consider.
+ *    @param cost Cost function.
+ *    @param data Data to pass to the cost function.
+ *    @param[out] out Cost of the found pilot (can be NULL).
+ *    @return The pilot with the lowest cost or NULL if none was found.
+ */
+static Pilot *pilot_nearest( double x, double y, double max_cost,
+                             PilotCostFunc *cost, void *data, double *out )
+{
+   PilotNearest n         = { .cost = cost, .data = data };
+   int          best      = -1;
+   int          start     = 0;
+   double       best_cost = max_cost;
+
+   if ( pilot_qtValid ) {
+      best  = qt_nearest( &pilot_quadtree, x, y, pilot_qtSlack, max_cost,
+                          pilot_nearestDist, &n, &best_cost );
+      start = pilot_qtCount;
+      for ( int i = 0; i < array_size( pilot_qtMissing ); i++ )
+         pilot_nearestCheck( &n, pilot_qtMissing[i], &best, &best_cost );
+   }
+
+   /* Pilots not in the quadtree. */
+   for ( int i = start; i < array_size( pilot_stack ); i++ )
+      pilot_nearestCheck( &n, i, &best, &best_cost );
+
+   if ( out != NULL )
+      *out = best_cost;
+   return ( best >= 0 ) ? pilot_stack[best] : NULL;
+}
+
+/**
+ * @brief Cost of an enemy for the nearest enemy searches.
+ */
+static double pilot_nearestEnemyCost( const Pilot *target, void *data )
+{
+   const PilotNearestEnemy *e = data;
+
+   if ( ( target->solid.mass < e->mass_lb ) ||
+        ( target->solid.mass > e->mass_ub ) )
+      return -1.;
+
+   if ( !pilot_validEnemy( e->p, target ) )
+      return -1.;
+
+   return vec2_dist2( &target->solid.pos, &e->p->solid.pos );
+}
+
+/**
+ * @brief Cost of an enemy for the heuristic nearest enemy search.
+ */
+static double pilot_nearestEnemyHeuristic( const Pilot *target, void *data )
+{
+   const PilotNearestEnemy *e = data;
+   double                   h;
+
+   if ( !pilot_validEnemy( e->p, target ) )
+      return -1.;
+
+   h = FABS( pilot_relsize( e->p, target ) - e->mass_factor ) +
+       FABS( pilot_relhp( e->p, target ) - e->health_factor ) +
+       FABS( pilot_reldps( e->p, target ) - e->damage_factor );
+
+   /* Scaled down by the range factor so it stays bounded by the distance. */
+   return vec2_dist2( &target->solid.pos, &e->p->solid.pos ) +
+          h / e->range_factor;
+}
+
 /**
  * @brief Gets the nearest enemy to the pilot.
  *
@@ -330,23 +569,8 @@ int pilot_validEnemy( const Pilot *p, const Pilot *target )
  */
 unsigned int pilot_getNearestEnemy( const Pilot *p )
 {
-   unsigned int tp = 0;
-   double       d  = 0.;
-
-   for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
-      double td;
-
-      if ( !pilot_validEnemy( p, pilot_stack[i] ) )
-         continue;
-
-      /* Check distance. */
-      td = vec2_dist2( &pilot_stack[i]->solid.pos, &p->solid.pos );
-      if ( !tp || ( td < d ) ) {
-         d  = td;
-         tp = pilot_stack[i]->id;
-      }
-   }
-   return tp;
+   const Pilot *t = pilot_getNearestFilter( p, -1., pilot_validEnemy, NULL );
+   return ( t != NULL ) ? t->id : 0;
 }
 
 /**
@@ -361,28 +585,15 @@ unsigned int pilot_getNearestEnemy( const Pilot *p )
 unsigned int pilot_getNearestEnemy_size( const Pilot *p, double target_mass_LB,
                                          double target_mass_UB )
 {
-   unsigned int tp = 0;
-   double       d  = 0.;
-
-   for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
-      double td;
-
-      if ( !pilot_validEnemy( p, pilot_stack[i] ) )
-         continue;
-
-      if ( pilot_stack[i]->solid.mass < target_mass_LB ||
-           pilot_stack[i]->solid.mass > target_mass_UB )
-         continue;
-
-      /* Check distance. */
-      td = vec2_dist2( &pilot_stack[i]->solid.pos, &p->solid.pos );
-      if ( !tp || ( td < d ) ) {
-         d  = td;
-         tp = pilot_stack[i]->id;
-      }
-   }
-
-   return tp;
+   PilotNearestEnemy e = {
+      .p       = p,
+      .mass_lb = target_mass_LB,
+      .mass_ub = target_mass_UB,
+   };
+   const Pilot      *t = pilot_nearest( p->solid.pos.x, p->solid.pos.y,
+                                        HUGE_VAL, pilot_nearestEnemyCost, &e,
+                                        NULL );
+   return ( t != NULL ) ? t->id : 0;
 }
 
 /**
@@ -403,9 +614,26 @@ unsigned int pilot_getNearestEnemy_heuristic( const Pilot *p,
                                               double       damage_factor,
                                               double       range_factor )
 {
-   unsigned int tp                      = 0;
-   double       current_heuristic_value = 10e3;
+   PilotNearestEnemy e = {
+      .p             = p,
+      .mass_factor   = mass_factor,
+      .health_factor = health_factor,
+      .damage_factor = damage_factor,
+      .range_factor  = range_factor,
+   };
+   const Pilot      *t;
+   unsigned int      tp;
+   double            current_heuristic_value;
+
+   /* Usual case where the heuristic can be bounded by the distance. */
+   if ( range_factor > 0. ) {
+      t = pilot_nearest( p->solid.pos.x, p->solid.pos.y, HUGE_VAL,
+                         pilot_nearestEnemyHeuristic, &e, NULL );
+      return ( t != NULL ) ? t->id : 0;
+   }
 
+   tp                      = 0;
+   current_heuristic_value = 10e3;
    for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
       double temp;
       Pilot *target = pilot_stack[i];
@@ -441,6 +669,111 @@ unsigned int pilot_getNearestPilot( const Pilot *p )
    return t;
 }
 
+/**
+ * @brief Data for the filtered nearest pilot search.
+ */
+typedef struct PilotNearestFilter_ {
+   const Pilot     *p;      /**< Pilot searching. */
+   PilotFilterFunc *filter; /**< Filter to apply, can be NULL. */
+} PilotNearestFilter;
+
+/**
+ * @brief Cost of a pilot for the filtered nearest pilot search.
+ */
+static double pilot_nearestFilterCost( const Pilot *target, void *data )
+{
+   const PilotNearestFilter *f = data;
+
+   /* Must not be self. */
+   if ( target == f->p )
+      return -1.;
+
+   if ( ( f->filter != NULL ) && !f->filter( f->p, target ) )
+      return -1.;
+
+   return vec2_dist2( &target->solid.pos, &f->p->solid.pos );
+}
+
+/**
+ * @brief Gets the nearest pilot to a pilot that passes a filter.
+ *
+ *    @param p Pilot to get the nearest pilot of.
+ *    @param range Maximum distance to look at or negative for no limit.
+ *    @param filter Filter the pilots have to pass (NULL for any pilot).
+ *    @param[out] d2 Squared distance to the nearest pilot (can be NULL).
+ *    @return The nearest pilot or NULL if none was found.
+ */
+Pilot *pilot_getNearestFilter( const Pilot *p, double range,
+                               PilotFilterFunc *filter, double *d2 )
+{
+   PilotNearestFilter f = { .p = p, .filter = filter };
+   return pilot_nearest( p->solid.pos.x, p->solid.pos.y,
+                         ( range < 0. ) ? HUGE_VAL : pow2( range ),
+                         pilot_nearestFilterCost, &f, d2 );
+}
+
+/**
+ * @brief Starts or ends a think phase snapshot.
+ *
+ * Results prefetched for a previous snapshot are no longer used.
+ */
+static void pilot_scanNext( void )
+{
+   /* 0 is used for pilots without prefetched results. */
+   if ( ++pilot_scanGen == 0 )
+      pilot_scanGen = 1;
+}
+
+/**
+ * @brief Gets the nearest enemy of a thinking pilot.
+ *
+ * During the think phase, this is the nearest enemy in the snapshot taken
+ * when the phase started, so every pilot sees the same state no matter in
+ * which order they think. Otherwise the live stack is scanned.
+ *
+ *    @param p Pilot to get the nearest enemy of.
+ *    @param range Maximum distance to look at or negative for no limit.
+ *    @return ID of the nearest enemy or 0 if none.
+ */
+unsigned int pilot_thinkNearestEnemy( const Pilot *p, double range )
+{
+   const Pilot *t;
+
+   if ( p->ai_scan == pilot_scanGen ) {
+      if ( ( p->ai_enemy != 0 ) &&
+           ( ( range < 0. ) || ( p->ai_enemy_d2 <= pow2( range ) ) ) )
+         return p->ai_enemy;
+      return 0;
+   }
+
+   t = pilot_getNearestFilter( p, range, pilot_validEnemy, NULL );
+   return ( t != NULL ) ? t->id : 0;
+}
+
+/**
+ * @brief Gets the nearest pilot to a thinking pilot.
+ *
+ * Like pilot_thinkNearestEnemy() but for any pilot.
+ *
+ *    @param p Pilot to get the nearest pilot of.
+ *    @param range Maximum distance to look at or negative for no limit.
+ *    @return ID of the nearest pilot or 0 if none.
+ */
+unsigned int pilot_thinkNearestPilot( const Pilot *p, double range )
+{
+   const Pilot *t;
+
+   if ( p->ai_scan == pilot_scanGen ) {
+      if ( ( p->ai_nearest != 0 ) &&
+           ( ( range < 0. ) || ( p->ai_nearest_d2 <= pow2( range ) ) ) )
+         return p->ai_nearest;
+      return 0;
+   }
+
+   t = pilot_getNearestFilter( p, range, NULL, NULL );
+   return ( t != NULL ) ? t->id : 0;
+}
+
 /**
  * @brief Get the strongest ally in a given range.
  *
@@ -505,6 +838,43 @@ unsigned int pilot_getBoss( const Pilot *p )
    return t;
 }
 
+/**
+ * @brief Data for the nearest pilot to a position search.
+ */
+typedef struct PilotNearestPos_ {
+   const Pilot *p;        /**< Pilot searching. */
+   double       x;        /**< X position to search from. */
+   double       y;        /**< Y position to search from. */
+   int          disabled; /**< Whether to consider disabled pilots. */
+} PilotNearestPos;
+
+/**
+ * @brief Cost of a pilot for the nearest pilot to a position search.
+ */
+static double pilot_nearestPosCost( const Pilot *target, void *data )
+{
+   const PilotNearestPos *n = data;
+
+   /* Must not be self. */
+   if ( target == n->p )
+      return -1.;
+
+   /* Player doesn't select escorts (unless disabled is active). */
+   if ( !n->disabled && pilot_isPlayer( n->p ) && pilot_isWithPlayer( target ) )
+      return -1.;
+
+   /* Shouldn't be disabled. */
+   if ( !n->disabled && pilot_isDisabled( target ) )
+      return -1.;
+
+   /* Must be a valid target. */
+   if ( !pilot_validTarget( n->p, target ) )
+      return -1.;
+
+   return pow2( n->x - target->solid.pos.x ) +
+          pow2( n->y - target->solid.pos.y );
+}
+
 /**
  * @brief Get the nearest pilot to a pilot from a certain position.
  *
@@ -518,37 +888,10 @@ unsigned int pilot_getBoss( const Pilot *p )
 double pilot_getNearestPosPilot( const Pilot *p, Pilot **tp, double x, double y,
                                  int disabled )
 {
-   double d = 0.;
-   *tp      = NULL;
-   for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
-      double td;
-
-      /* Must not be self. */
-      if ( pilot_stack[i] == p )
-         continue;
-
-      /* Player doesn't select escorts (unless disabled is active). */
-      if ( !disabled && pilot_isPlayer( p ) &&
-           pilot_isWithPlayer( pilot_stack[i] ) )
-         continue;
-
-      /* Shouldn't be disabled. */
-      if ( !disabled && pilot_isDisabled( pilot_stack[i] ) )
-         continue;
-
-      /* Must be a valid target. */
-      if ( !pilot_validTarget( p, pilot_stack[i] ) )
-         continue;
-
-      /* Minimum distance. */
-      td = pow2( x - pilot_stack[i]->solid.pos.x ) +
-           pow2( y - pilot_stack[i]->solid.pos.y );
-      if ( ( ( *tp == NULL ) || ( td < d ) ) ) {
-         d   = td;
-         *tp = pilot_stack[i];
-      }
-   }
-   return d;
+   PilotNearestPos n = { .p = p, .x = x, .y = y, .disabled = disabled };
+   double          d;
+   *tp = pilot_nearest( x, y, HUGE_VAL, pilot_nearestPosCost, &n, &d );
+   return ( *tp != NULL ) ? d : 0.;
 }
 
 /**
@@ -639,14 +982,27 @@ double pilot_getNearestAng( const Pilot *p, unsigned int *tp, double ang,
  */
 Pilot *pilot_get( unsigned int id )
 {
-   const Pilot  pid    = { .id = id };
-   const Pilot *pidptr = &pid;
-   /* binary search */
-   Pilot **pp = bsearch( &pidptr, pilot_stack, array_size( pilot_stack ),
-                         sizeof( Pilot * ), pilot_cmp );
-   if ( ( pp == NULL ) || ( pilot_isFlag( *pp, PILOT_DELETE ) ) )
+   unsigned int slot = id & PILOT_SLOT_MASK;
+   Pilot       *p;
+
+   /* Pilots that didn't fit in the slot table have to be searched for. */
+   if ( slot == PILOT_SLOT_NONE ) {
+      int i = pilot_getStackPos( id );
+      if ( ( i < 0 ) || ( id == 0 ) )
+         return NULL;
+      p = pilot_stack[i];
+   } else {
+      if ( (int)slot >= array_size( pilot_slots ) )
+         return NULL;
+      p = pilot_slots[slot];
+      /* Slot may have been reused by another pilot. */
+      if ( ( p == NULL ) || ( p->id != id ) )
+         return NULL;
+   }
+
+   if ( pilot_isFlag( p, PILOT_DELETE ) )
       return NULL;
-   return *pp;
+   return p;
 }
 
 /**
@@ -813,6 +1169,46 @@ void pilot_collideQueryIL( IntList *il, int x1, int y1, int x2, int y2 )
    qt_query( &pilot_quadtree, il, x1, y1, x2, y2 );
 }
 
+/**
+ * @brief Like pilot_collideQueryIL, but safe to run from multiple threads.
+ */
+void pilot_collideQueryConstIL( IntList *il, int x1, int y1, int x2, int y2 )
+{
+   qt_queryConst( &pilot_quadtree, il, x1, y1, x2, y2 );
+}
+
+/**
+ * @brief Gets the stack positions of all the pilots that can be within a
+ * distance of a position.
+ *
+ * Unlike pilot_collideQueryIL, this accounts for pilots that moved since the
+ * quadtree was built, including those with a time speedup, and those that are
+ * not in it, so it is suitable for queries done while pilots are updating. Not
+ * thread safe.
+ *
+ *    @param il List to fill with the stack positions.
+ *    @param x X position to query around.
+ *    @param y Y position to query around.
+ *    @param r Radius to query.
+ */
+void pilot_queryRadiusIL( IntList *il, double x, double y, double r )
+{
+   if ( !pilot_qtValid ) {
+      il_clear( il );
+      for ( int i = 0; i < array_size( pilot_stack ); i++ )
+         il_set( il, il_push_back( il ), 0, i );
+      return;
+   }
+
+   r += pilot_qtSlack;
+   qt_query( &pilot_quadtree, il, floor( x - r ), floor( y - r ),
+             ceil( x + r ), ceil( y + r ) );
+   for ( int i = 0; i < array_size( pilot_qtMissing ); i++ )
+      il_set( il, il_push_back( il ), 0, pilot_qtMissing[i] );
+   for ( int i = pilot_qtCount; i < array_size( pilot_stack ); i++ )
+      il_set( il, il_push_back( il ), 0, i );
+}
+
 /**
  * @brief Tries to turn the pilot to face dir.
  *
@@ -1953,6 +2349,9 @@ void pilot_renderFramebuffer( Pilot *p, GLuint fbo, double fw, double fh,
 /**
  * @brief Renders the pilot.
  *
+ * 2D ships are only queued in the sprite batch, so gl_batchFlush() has to be
+ *  called before drawing anything that should go over them.
+ *
  *    @param p Pilot to render.
  */
 void pilot_render( Pilot *p )
@@ -1960,6 +2359,7 @@ void pilot_render( Pilot *p )
    double   scale, x, y, w, h, z;
    double   timeleft, elapsed;
    int      inbounds = 1;
+   int      ontop    = 0;
    Effect  *e        = NULL;
    glColour c        = { .r = 1., .g = 1., .b = 1., .a = 1. };
 
@@ -2012,6 +2412,9 @@ void pilot_render( Pilot *p )
       /* Render normally. */
       if ( e == NULL ) {
          if ( p->ship->gfx_3d != NULL ) {
+            /* Earlier pilots have to be drawn first. */
+            gl_batchFlush();
+
             /* Render to framebuffer first. */
             pilot_renderFramebufferBase( p, gl_screen.fbo[2], gl_screen.nw,
                                          gl_screen.nh, NULL );
@@ -2024,7 +2427,7 @@ void pilot_render( Pilot *p )
                0, 0, w / (double)gl_screen.nw, h / (double)gl_screen.nh, NULL,
                0. ); /* Colour should already be applied. */
          } else {
-            gl_renderSpriteInterpolateScale(
+            gl_batchSpriteInterpolate(
                p->ship->gfx_space, p->ship->gfx_engine, 1. - p->engine_glow,
                p->solid.pos.x, p->solid.pos.y, scale, scale, p->tsx, p->tsy,
                &c );
@@ -2035,6 +2438,9 @@ void pilot_render( Pilot *p )
          mat4              projection, tex_mat;
          const EffectData *ed = e->data;
 
+         /* Earlier pilots have to be drawn first. */
+         gl_batchFlush();
+
          /* Have to scissors a bit more in case of custom vertex effects. */
          if ( ed->flags & EFFECT_VERTEX ) {
             double s = ceil( 2.0 * p->ship->size / gl_screen.scale );
@@ -2107,20 +2513,27 @@ void pilot_render( Pilot *p )
    }
 
    /* Re-draw backwards trails. */
-   if ( inbounds ) {
-      glEnable( GL_DEPTH_TEST );
-      glDepthMask( GL_FALSE ); /* Don't overwrite depth. */
-   }
    for ( int i = 0, g = 0; g < array_size( p->ship->trail_emitters ); g++ ) {
       if ( pilot_trail_generated( p, g ) ) {
-         if ( p->trail[i]->ontop )
-            spfx_trail_draw( p->trail[i] );
+         if ( p->trail[i]->ontop ) {
+            spfx_trail_batch( p->trail[i] );
+            ontop = 1;
+         }
          i++;
       }
    }
-   if ( inbounds ) {
-      glDepthMask( GL_TRUE );
-      glDisable( GL_DEPTH_TEST );
+   if ( ontop ) {
+      /* Have to go over the pilot. */
+      gl_batchFlush();
+      if ( inbounds ) {
+         glEnable( GL_DEPTH_TEST );
+         glDepthMask( GL_FALSE ); /* Don't overwrite depth. */
+      }
+      spfx_trail_flush();
+      if ( inbounds ) {
+         glDepthMask( GL_TRUE );
+         glDisable( GL_DEPTH_TEST );
+      }
    }
 
    /* Erase the depth so it doesn't affect trails of other pilots. */
@@ -2134,6 +2547,9 @@ void pilot_render( Pilot *p )
 
    /* Useful debug stuff below. */
 #ifdef DEBUGGING
+   if ( inbounds && ( debug_isFlag( DEBUG_MARK_COLLISION ) ||
+                      debug_isFlag( DEBUG_MARK_EMITTER ) ) )
+      gl_batchFlush();
    if ( inbounds && debug_isFlag( DEBUG_MARK_COLLISION ) ) {
       static gl_vbo      *poly_vbo = NULL;
       GLfloat             data[1024];
@@ -3580,17 +3996,21 @@ Pilot *pilot_create( const Ship *ship, const char *name, int faction,
    if ( pilot_isFlagRaw(
            flags, PILOT_PLAYER ) ) { /* Set player ID. TODO should probably be
                                         fixed to something better someday. */
-      p->id = PLAYER_ID;
+      p->id                          = PLAYER_ID;
+      pilot_slots[PILOT_SLOT_PLAYER] = p;
       qsort( pilot_stack, array_size( pilot_stack ), sizeof( Pilot * ),
              pilot_cmp );
+      pilot_quadtreeInvalidate();
    } else
-      p->id =
-         ++pilot_id; /* new unique pilot id based on pilot_id, can't be 0 */
+      p->id = pilot_genID( p ); /* new unique pilot id, can't be 0 */
 
    /* Initialize the pilot. */
    pilot_init( p, ship, name, faction, dir, pos, vel, flags, dockpilot,
                dockslot );
 
+   /* Start decoding the engine sound, outfits do it when added. */
+   sound_prefetch( p->ship->sound );
+
    /* Initialize AI if applicable. */
    if ( ai == NULL )
       ai = faction_default_ai( faction );
@@ -3662,7 +4082,7 @@ unsigned int pilot_clone( const Pilot *ref )
    p  = &array_grow( &pilot_stack );
    *p = dyn;
    memset( dyn, 0, sizeof( Pilot ) );
-   dyn->id = ++pilot_id; /* new unique pilot id. */
+   dyn->id = pilot_genID( dyn ); /* new unique pilot id. */
 
    /* Initialize the pilot. */
    pilot_init( dyn, ref->ship, ref->name, ref->faction, ref->solid.dir,
@@ -3689,7 +4109,7 @@ unsigned int pilot_clone( const Pilot *ref )
  */
 unsigned int pilot_addStack( Pilot *p )
 {
-   p->id = ++pilot_id; /* new unique pilot id based on pilot_id, can't be 0 */
+   p->id = pilot_genID( p ); /* new unique pilot id, can't be 0 */
    pilot_setFlag( p, PILOT_NOFREE );
 
    array_push_back( &pilot_stack, p );
@@ -3747,9 +4167,12 @@ Pilot *pilot_setPlayer( Pilot *after )
       else
          pilot_stack[i] = after; /* after overwrites player. */
    }
-   after->id = PLAYER_ID;
+   pilot_releaseID( after );
+   after->id                      = PLAYER_ID;
+   pilot_slots[PILOT_SLOT_PLAYER] = after;
    qsort( pilot_stack, array_size( pilot_stack ), sizeof( Pilot * ),
           pilot_cmp );
+   pilot_quadtreeInvalidate();
 
    /* Load graphics if necessary. */
    ship_gfxLoad( (Ship *)after->ship );
@@ -3903,6 +4326,9 @@ void pilot_free( Pilot *p )
 {
    NTracingZone( _ctx, 1 );
 
+   /* No longer reachable from the ID. */
+   pilot_releaseID( p );
+
    /* Clear some useful things. */
    pilot_clearHooks( p );
    effect_cleanup( p->effects );
@@ -3974,18 +4400,6 @@ void pilot_free( Pilot *p )
    NTracingZoneEnd( _ctx );
 }
 
-/**
- * @brief Destroys pilot from stack
- *
- *    @param p Pilot to destroy.
- */
-static void pilot_erase( Pilot *p )
-{
-   int i = pilot_getStackPos( p->id );
-   pilot_free( p );
-   array_erase( &pilot_stack, &pilot_stack[i], &pilot_stack[i + 1] );
-}
-
 /**
  * @brief Tries to remove a pilot from the stack.
  */
@@ -4000,8 +4414,10 @@ void pilot_stackRemove( Pilot *p )
       return;
    }
 #endif /* DEBUGGING */
+   pilot_releaseID( p );
    p->id = 0;
    array_erase( &pilot_stack, &pilot_stack[i], &pilot_stack[i + 1] );
+   pilot_quadtreeInvalidate();
 }
 
 /**
@@ -4009,8 +4425,12 @@ void pilot_stackRemove( Pilot *p )
  */
 void pilots_init( void )
 {
-   pilot_stack = array_create_size( Pilot *, PILOT_SIZE_MIN );
+   pilot_stack     = array_create_size( Pilot *, PILOT_SIZE_MIN );
+   pilot_slots     = array_create_size( Pilot *, PILOT_SIZE_MIN );
+   pilot_slotsFree = array_create( int );
+   pilot_clearSlots();
    il_create( &pilot_qtquery, 1 );
+   pilot_ewInit();
 }
 
 /**
@@ -4035,13 +4455,24 @@ void pilots_free( void )
       pilot_free( pilot_stack[i] );
    array_free( pilot_stack );
    pilot_stack = NULL;
-   player.p    = NULL;
+   array_free( pilot_slots );
+   pilot_slots = NULL;
+   array_free( pilot_slotsFree );
+   pilot_slotsFree = NULL;
+   player.p        = NULL;
    free( player.ps.acquired );
    memset( &player.ps, 0, sizeof( PlayerShip_t ) );
 
    /* Clean up quadtree. */
    qt_destroy( &pilot_quadtree );
    il_destroy( &pilot_qtquery );
+   array_free( pilot_qtMissing );
+   pilot_qtMissing = NULL;
+   pilot_qtValid   = 0;
+   pilot_ewFree();
+
+   array_free( pilot_thinkers );
+   pilot_thinkers = NULL;
 }
 
 /**
@@ -4093,6 +4524,7 @@ void pilots_clean( int persist )
    }
    array_erase( &pilot_stack, &pilot_stack[persist_count],
                 array_end( pilot_stack ) );
+   pilot_quadtreeInvalidate();
 
    /* Init AI on the remaining pilots, has to be done here so the pilot_stack is
     * consistent. */
@@ -4126,7 +4558,8 @@ void pilots_newSystem( void )
    if ( qt_init )
       qt_destroy( &pilot_quadtree );
    qt_create( &pilot_quadtree, -r, -r, r, r, qt_max_elem, qt_depth );
-   qt_init = 1;
+   qt_init       = 1;
+   pilot_qtValid = 0;
 
    NTracingZoneEnd( _ctx );
 }
@@ -4155,6 +4588,8 @@ void pilots_cleanAll( void )
    }
    array_erase( &pilot_stack, array_begin( pilot_stack ),
                 array_end( pilot_stack ) );
+   pilot_clearSlots();
+   pilot_quadtreeInvalidate();
 }
 
 static void pilot_addQuadtree( const Pilot *p, int i )
@@ -4175,39 +4610,148 @@ static void pilot_addQuadtree( const Pilot *p, int i )
  */
 void pilots_updatePurge( void )
 {
+   int n;
+
    NTracingZone( _ctx, 1 );
 
-   /* Delete loop - this should be atomic or we get hook fuckery! */
-   for ( int i = array_size( pilot_stack ) - 1; i >= 0; i-- ) {
+   /* Delete loop - this should be atomic or we get hook fuckery!
+    * The stack is compacted in a single pass keeping the order, as pilot_get
+    * relies on it being sorted. */
+   n = 0;
+   for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
       Pilot *p = pilot_stack[i];
 
       /* Clear target. */
       p->ptarget = NULL;
 
       /* Destroy pilot and go on. */
-      if ( pilot_isFlag( p, PILOT_DELETE ) )
-         pilot_erase( p );
+      if ( pilot_isFlag( p, PILOT_DELETE ) ) {
+         pilot_free( p );
+         continue;
+      }
+      pilot_stack[n++] = p;
    }
+   array_resize( &pilot_stack, n );
 
    /* Second loop sets up quadtrees. */
    qt_clear( &pilot_quadtree ); /* Empty it. */
+   if ( pilot_qtMissing == NULL )
+      pilot_qtMissing = array_create( int );
+   array_erase( &pilot_qtMissing, array_begin( pilot_qtMissing ),
+                array_end( pilot_qtMissing ) );
+   pilot_qtSlack = 0.;
    for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
       const Pilot *p = pilot_stack[i];
+      double       move, dt;
 
       /* Ignore pilots being deleted. */
       if ( pilot_isFlag( p, PILOT_DELETE ) )
          continue;
 
-      /* Ignore hidden pilots. */
-      if ( pilot_isFlag( p, PILOT_HIDE ) )
+      /* Ignore hidden pilots, but remember them for nearest searches. */
+      if ( pilot_isFlag( p, PILOT_HIDE ) ) {
+         array_push_back( &pilot_qtMissing, i );
          continue;
+      }
 
       pilot_addQuadtree( p, i );
+
+      /* Pilots can move up to a tick before the next rebuild, with some
+       * margin for velocity changes. Their ticks are scaled by their time
+       * speedup. */
+      dt            = fps_min * p->stats.time_speedup;
+      move          = ( VMOD( p->solid.vel ) + p->accel * dt ) * dt;
+      pilot_qtSlack = MAX( pilot_qtSlack, 2. * move );
    }
+   pilot_qtSlack += 1.; /* Rounding of the boxes. */
+   pilot_qtCount = array_size( pilot_stack );
+   pilot_qtValid = 1;
 
    NTracingZoneEnd( _ctx );
 }
 
+/**
+ * @brief Computes the total DPS of a range of pilots of the stack.
+ */
+static void pilot_thinkPrefetchDPS( int start, int end, void *data )
+{
+   (void)data;
+   for ( int i = start; i < end; i++ ) {
+      Pilot *p = pilot_stack[i];
+      pilot_dpseps( p, &p->dps, NULL );
+      p->dps_scan = pilot_scanGen;
+   }
+}
+
+/**
+ * @brief Runs the read-only target scans of a range of pilots about to think.
+ */
+static void pilot_thinkPrefetchRange( int start, int end, void *data )
+{
+   (void)data;
+   for ( int i = start; i < end; i++ ) {
+      Pilot       *p = pilot_thinkers[i];
+      const Pilot *t;
+
+      t           = pilot_getNearestFilter( p, -1., pilot_validEnemy,
+                                            &p->ai_enemy_d2 );
+      p->ai_enemy = ( t != NULL ) ? t->id : 0;
+
+      t             = pilot_getNearestFilter( p, -1., NULL, &p->ai_nearest_d2 );
+      p->ai_nearest = ( t != NULL ) ? t->id : 0;
+
+      p->ai_scan = pilot_scanGen;
+   }
+}
+
+/**
+ * @brief Computes the expensive read-only scans of the pilots about to run
+ * their control tick in parallel.
+ *
+ * The scans only read the stack, which is not modified until all the jobs are
+ * done. The results form a snapshot of the state at the start of the think
+ * phase, which the AI uses for the whole phase even if pilots change in the
+ * meantime, so they don't depend on how many pilots there are, how the work
+ * is split or the order in which pilots think.
+ */
+static void pilots_thinkPrefetch( void )
+{
+   if ( pilot_thinkers == NULL )
+      pilot_thinkers = array_create( Pilot * );
+   array_erase( &pilot_thinkers, array_begin( pilot_thinkers ),
+                array_end( pilot_thinkers ) );
+
+   /* Nothing from the previous frame is valid anymore. */
+   pilot_scanNext();
+
+   for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
+      Pilot *p = pilot_stack[i];
+
+      /* Same criteria as the think loop, but only for the control tick. */
+      if ( ( p->ai == NULL ) || pilot_isFlag( p, PILOT_PLAYER ) ||
+           pilot_isFlag( p, PILOT_HIDE ) || pilot_isDisabled( p ) ||
+           pilot_isFlag( p, PILOT_DEAD ) || pilot_isFlag( p, PILOT_DELETE ) )
+         continue;
+      if ( space_isSimulation() && pilot_isFlag( p, PILOT_PERSIST ) )
+         continue;
+      if ( pilot_isFlag( p, PILOT_HYPERSPACE ) ||
+           pilot_isFlag( p, PILOT_HYP_END ) ||
+           pilot_isFlag( p, PILOT_BOARDING ) ||
+           pilot_isFlag( p, PILOT_REFUELBOARDING ) ||
+           pilot_isFlag( p, PILOT_LANDING ) ||
+           pilot_isFlag( p, PILOT_TAKEOFF ) )
+         continue;
+      if ( ( p->tcontrol >= 0. ) && ( ai_curTask( p ) != NULL ) )
+         continue;
+      array_push_back( &pilot_thinkers, p );
+   }
+
+   job_parallelFor( array_size( pilot_stack ), PILOT_THINK_BATCH,
+                    pilot_thinkPrefetchDPS, NULL );
+   job_parallelFor( array_size( pilot_thinkers ), PILOT_THINK_BATCH,
+                    pilot_thinkPrefetchRange, NULL );
+}
+
 /**
  * @brief Updates all the pilots.
  *
@@ -4218,6 +4762,12 @@ void pilots_update( double dt )
    NTracingZone( _ctx, 1 );
    NTracingPlotI( "pilots", array_size( pilot_stack ) );
 
+   /* Refresh the stealth detection cache. */
+   pilot_ewStealthFrame();
+
+   /* Do the read-only part of thinking in parallel. */
+   pilots_thinkPrefetch();
+
    /* Have all the pilots think. */
    for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
       Pilot *p = pilot_stack[i];
@@ -4265,6 +4815,9 @@ void pilots_update( double dt )
       }
    }
 
+   /* Prefetched data is only valid for the think phase. */
+   pilot_scanNext();
+
    /* Now update all the pilots. */
    for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
       Pilot *p = pilot_stack[i];
@@ -4304,6 +4857,7 @@ void pilots_render( void )
       if ( !pilot_isFlag( p, PILOT_PLAYER ) )
          pilot_render( p );
    }
+   gl_batchFlush();
 
    NTracingZoneEnd( _ctx );
 }
@@ -4446,8 +5000,15 @@ double pilot_reldps( const Pilot *cur_pilot, const Pilot *p )
 {
    double DPSaccum_target, DPSaccum_pilot;
 
-   pilot_dpseps( p, &DPSaccum_target, NULL );
-   pilot_dpseps( cur_pilot, &DPSaccum_pilot, NULL );
+   /* Use the think phase snapshot if there is one. */
+   if ( p->dps_scan == pilot_scanGen )
+      DPSaccum_target = p->dps;
+   else
+      pilot_dpseps( p, &DPSaccum_target, NULL );
+   if ( cur_pilot->dps_scan == pilot_scanGen )
+      DPSaccum_pilot = cur_pilot->dps;
+   else
+      pilot_dpseps( cur_pilot, &DPSaccum_pilot, NULL );
 
    if ( ( DPSaccum_target > DOUBLE_TOL ) && ( DPSaccum_pilot > DOUBLE_TOL ) )
       return DPSaccum_pilot / ( DPSaccum_target + DPSaccum_pilot );
@@ -4594,3 +5155,15 @@ void pilot_quadtreeParams( int max_elem, int depth )
    qt_max_elem = max_elem;
    qt_depth    = depth;
 }
+
+/**
+ * @brief Stops using the quadtree for nearest pilot searches until it is
+ * rebuilt.
+ *
+ * Has to be called when pilots are moved by other means than physics, such as
+ * being teleported.
+ */
+void pilot_quadtreeInvalidate( void )
+{
+   pilot_qtValid = 0;
+}
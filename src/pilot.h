@@ -412,6 +412,14 @@ typedef struct Pilot_ {
    Task        *task;                 /**< current action */
    unsigned int shoot_indicator; /**< Indicator to inform the AI if a seeker has
                                     been shot recently. */
+   unsigned int ai_scan;       /**< Think phase snapshot the prefetched targets
+                                  belong to, 0 if none. */
+   unsigned int ai_enemy;      /**< Nearest enemy prefetched before thinking. */
+   double       ai_enemy_d2;   /**< Squared distance to ai_enemy. */
+   unsigned int ai_nearest;    /**< Nearest pilot prefetched before thinking. */
+   double       ai_nearest_d2; /**< Squared distance to ai_nearest. */
+   double       dps;           /**< Prefetched total DPS. */
+   unsigned int dps_scan; /**< Think phase snapshot of dps, 0 if none. */
 
    /* Ship Lua. */
    int    lua_ship_mem;   /**< Ship memory. */
@@ -445,6 +453,11 @@ typedef struct Pilot_ {
    lvar  *shipvar;       /**< Per-ship version of lua mission variables. */
 } Pilot;
 
+/**
+ * @brief Filter for pilot searches, returns 1 if target should be considered.
+ */
+typedef int PilotFilterFunc( const Pilot *p, const Pilot *target );
+
 /* These depend on Pilot being defined first. */
 #include "pilot_cargo.h"  // IWYU pragma: export
 #include "pilot_ew.h"     // IWYU pragma: export
@@ -469,6 +482,10 @@ unsigned int  pilot_getNearestEnemy_heuristic( const Pilot *p,
                                                double       range_factor );
 unsigned int  pilot_getNearestHostile( void ); /* only for the player */
 unsigned int  pilot_getNearestPilot( const Pilot *p );
+Pilot        *pilot_getNearestFilter( const Pilot *p, double range,
+                                      PilotFilterFunc *filter, double *d2 );
+unsigned int  pilot_thinkNearestEnemy( const Pilot *p, double range );
+unsigned int  pilot_thinkNearestPilot( const Pilot *p, double range );
 unsigned int  pilot_getBoss( const Pilot *p );
 double pilot_getNearestPosPilot( const Pilot *p, Pilot **tp, double x, double y,
                                  int disabled );
@@ -588,4 +605,7 @@ void    pilot_untargetAsteroid( int anchor, int asteroid );
 PilotOutfitSlot *pilot_getDockSlot( Pilot *p );
 const IntList   *pilot_collideQuery( int x1, int y1, int x2, int y2 );
 void pilot_collideQueryIL( IntList *il, int x1, int y1, int x2, int y2 );
+void pilot_collideQueryConstIL( IntList *il, int x1, int y1, int x2, int y2 );
+void pilot_queryRadiusIL( IntList *il, double x, double y, double r );
 void pilot_quadtreeParams( int max_elem, int depth );
+void pilot_quadtreeInvalidate( void );
@@ -14,6 +14,7 @@
 
 #include "array.h"
 #include "hook.h"
+#include "ntracing.h"
 #include "pilot.h"
 #include "player.h"
 #include "player_autonav.h"
@@ -21,6 +22,12 @@
 
 static double ew_interference = 1.; /**< Interference factor. */
 
+/* Stealth detection. */
+static IntList       ew_qtquery;         /**< Quadtree query. */
+static double        ew_detectMax  = 0.; /**< Highest ew_detect this tick. */
+static int           ew_pairsFrame = 0;  /**< Stealth pairs tested this tick. */
+static unsigned long ew_pairsTotal = 0;  /**< Stealth pairs tested in total. */
+
 /*
  * Prototypes.
  */
@@ -102,6 +109,9 @@ void pilot_ewUpdateStatic( Pilot *p )
 {
    p->ew_mass = pilot_ewMass( p->solid.mass );
    pilot_ewUpdate( p );
+
+   /* Stats may have changed mid-tick, keep the stealth query big enough. */
+   ew_detectMax = MAX( ew_detectMax, p->stats.ew_detect );
 }
 
 /**
@@ -418,6 +428,47 @@ double pilot_ewWeaponTrack( const Pilot *p, const Pilot *t, double trackmin,
               DOUBLE_TOL ) ); /* Avoid divide by zero if trackmax==trackmin. */
 }
 
+/**
+ * @brief Initializes the electronic warfare subsystem.
+ */
+void pilot_ewInit( void )
+{
+   il_create( &ew_qtquery, 1 );
+}
+
+/**
+ * @brief Frees the electronic warfare subsystem.
+ */
+void pilot_ewFree( void )
+{
+   il_destroy( &ew_qtquery );
+}
+
+/**
+ * @brief Refreshes the stealth detection cache, has to be run every tick
+ * before the pilots update.
+ */
+void pilot_ewStealthFrame( void )
+{
+   Pilot *const *ps = pilot_getAll();
+
+   NTracingPlotI( "stealth_pairs", ew_pairsFrame );
+   ew_pairsFrame = 0;
+
+   /* The largest detection bounds how far stealth can be broken from. */
+   ew_detectMax = 0.;
+   for ( int i = 0; i < array_size( ps ); i++ )
+      ew_detectMax = MAX( ew_detectMax, ps[i]->stats.ew_detect );
+}
+
+/**
+ * @brief Gets the number of pilot pairs tested for breaking stealth so far.
+ */
+unsigned long pilot_ewStealthPairs( void )
+{
+   return ew_pairsTotal;
+}
+
 /**
  * @brief Checks to see if there are pilots nearby to a stealthed pilot that
  * could break stealth.
@@ -433,6 +484,7 @@ static int pilot_ewStealthGetNearby( const Pilot *p, double *mod, int *close,
 {
    Pilot *const *ps;
    int           n;
+   double        r;
 
    /* Check nearby non-allies. */
    if ( mod != NULL )
@@ -443,9 +495,19 @@ static int pilot_ewStealthGetNearby( const Pilot *p, double *mod, int *close,
       *isplayer = 0;
    n  = 0;
    ps = pilot_getAll();
-   for ( int i = 0; i < array_size( ps ); i++ ) {
+
+   /* Only pilots within the largest detection range can matter. */
+   r = MAX( 0., p->ew_stealth * ew_detectMax );
+   if ( close != NULL )
+      r *= 1.5;
+   pilot_queryRadiusIL( &ew_qtquery, p->solid.pos.x, p->solid.pos.y, r );
+
+   for ( int j = 0; j < il_size( &ew_qtquery ); j++ ) {
       double dist;
-      Pilot *t = ps[i];
+      Pilot *t = ps[il_get( &ew_qtquery, j, 0 )];
+
+      ew_pairsFrame++;
+      ew_pairsTotal++;
 
       /* Quick checks first. */
       if ( pilot_isDisabled( t ) )
@@ -458,6 +520,11 @@ static int pilot_ewStealthGetNearby( const Pilot *p, double *mod, int *close,
            pilot_isFlag( t, PILOT_TAKEOFF ) )
          continue;
 
+      /* Compute distance. */
+      dist = vec2_dist2( &p->solid.pos, &t->solid.pos );
+      if ( dist > pow2( r ) )
+         continue;
+
       /* Allies are ignored. */
       if ( pilot_areAllies( p, t ) )
          continue;
@@ -466,8 +533,6 @@ static int pilot_ewStealthGetNearby( const Pilot *p, double *mod, int *close,
       // if (pilot_isFlag(t, PILOT_STEALTH))
       //    continue;
 
-      /* Compute distance. */
-      dist = vec2_dist2( &p->solid.pos, &t->solid.pos );
       /* TODO maybe not hardcode the close value. */
       if ( ( close != NULL ) && !pilot_isFlag( t, PILOT_STEALTH ) &&
            ( dist <
@@ -40,6 +40,10 @@ void   pilot_ewUpdateDynamic( Pilot *p, double dt );
 /*
  * Stealth.
  */
-void pilot_ewUpdateStealth( Pilot *p, double dt );
-int  pilot_stealth( Pilot *p );
-void pilot_destealth( Pilot *p );
+void          pilot_ewInit( void );
+void          pilot_ewFree( void );
+void          pilot_ewStealthFrame( void );
+unsigned long pilot_ewStealthPairs( void );
+void          pilot_ewUpdateStealth( Pilot *p, double dt );
+int           pilot_stealth( Pilot *p );
+void          pilot_destealth( Pilot *p );
@@ -286,6 +286,7 @@ int pilot_addOutfitRaw( Pilot *pilot, const Outfit *outfit, PilotOutfitSlot *s )
    s->flags  = 0;
    s->state  = PILOT_OUTFIT_OFF;
    s->outfit = outfit;
+   outfit_prefetchSounds( outfit );
 
    /* Set some default parameters. */
    s->timer = 0.;
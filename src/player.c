@@ -689,6 +689,7 @@ void player_swapShip( const char *shipname, int move_cargo )
    /* Copy position back. */
    player.p->solid.pos = v;
    player.p->solid.dir = dir;
+   pilot_quadtreeInvalidate();
 
    /* Fill the tank. */
    if ( landed && ( land_spob != NULL ) )
@@ -937,6 +938,23 @@ static void player_initSound( void )
    snd_hypJump      = sound_get( "hyperspace_jump" );
 }
 
+/**
+ * @brief Starts decoding the player's GUI and hyperspace sounds in the
+ * background, so that checking or playing them doesn't block later.
+ */
+void player_prefetchSounds( void )
+{
+   sound_prefetch( snd_target );
+   sound_prefetch( snd_jump );
+   sound_prefetch( snd_nav );
+   sound_prefetch( snd_hail );
+   sound_prefetch( snd_hypPowUp );
+   sound_prefetch( snd_hypEng );
+   sound_prefetch( snd_hypPowDown );
+   sound_prefetch( snd_hypPowUpJump );
+   sound_prefetch( snd_hypJump );
+}
+
 /**
  * @brief Plays a GUI sound (unaffected by time accel).
  *
@@ -1007,6 +1025,7 @@ void player_warp( double x, double y )
 {
    unsigned int target = cam_getTarget();
    vec2_cset( &player.p->solid.pos, x, y );
+   pilot_quadtreeInvalidate();
    /* Have to move camera over to avoid moving stars when loading. */
    if ( target == player.p->id )
       cam_setTargetPilot( target, 0 );
@@ -1086,6 +1105,7 @@ void player_render( double dt )
 
    /* Render the player's pilot. */
    pilot_render( player.p );
+   gl_batchFlush();
 
    /* Render the player's overlay. */
    pilot_renderOverlay( player.p );
@@ -13,6 +13,7 @@
  * BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0/
  */
 #include "quadtree.h"
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -384,6 +385,54 @@ void qt_query( Quadtree *qt, IntList *out, int qlft, int qtop, int qrgt,
    }
 }
 
+void qt_queryConst( const Quadtree *qt, IntList *out, int qlft, int qtop,
+                    int qrgt, int qbtm )
+{
+   // Same as qt_query, but without using the shared temporary buffer so that
+   // multiple threads can query at once. Duplicates are removed by searching
+   // the output instead, which keeps the same order as qt_query.
+   IntList leaves = { 0 };
+
+   il_create( &leaves, nd_num );
+   find_leaves( &leaves, qt, 0, 0, qt->root_mx, qt->root_my, qt->root_sx,
+                qt->root_sy, qlft, qtop, qrgt, qbtm );
+
+   il_clear( out );
+   for ( int j = 0; j < il_size( &leaves ); ++j ) {
+      const int nd_index = il_get( &leaves, j, nd_idx_index );
+
+      // Walk the list and add elements that intersect.
+      int elt_node_index = il_get( &qt->nodes, nd_index, node_idx_fc );
+      while ( elt_node_index != -1 ) {
+         const int element =
+            il_get( &qt->enodes, elt_node_index, enode_idx_elt );
+         const int lft = il_get( &qt->elts, element, elt_idx_lft );
+         const int top = il_get( &qt->elts, element, elt_idx_top );
+         const int rgt = il_get( &qt->elts, element, elt_idx_rgt );
+         const int btm = il_get( &qt->elts, element, elt_idx_btm );
+         elt_node_index = il_get( &qt->enodes, elt_node_index, enode_idx_next );
+         if ( !intersect( qlft, qtop, qrgt, qbtm, lft, top, rgt, btm ) )
+            continue;
+         int found = 0;
+         for ( int k = 0; k < il_size( out ); ++k ) {
+            if ( il_get( out, k, 0 ) == element ) {
+               found = 1;
+               break;
+            }
+         }
+         if ( !found )
+            il_set( out, il_push_back( out ), 0, element );
+      }
+   }
+   il_destroy( &leaves );
+
+   // Convert to IDs.
+   for ( int j = 0; j < il_size( out ); ++j ) {
+      const int element = il_get( out, j, 0 );
+      il_set( out, j, 0, il_get( &qt->elts, element, elt_idx_id ) );
+   }
+}
+
 void qt_cleanup( Quadtree *qt )
 {
    IntList to_process = { 0 };
@@ -472,3 +521,190 @@ void qt_traverse( Quadtree *qt, void *user_data, QtNodeFunc *branch,
    }
    il_destroy( &to_process );
 }
+
+// Node pending to be visited by a nearest query.
+typedef struct QtNearestNode {
+   double lb;     // Lower bound of the distance to the elements in the node.
+   int    index;  // Index of the node.
+   int    depth;  // Depth of the node.
+   int    mx, my; // Center of the node.
+   int    sx, sy; // Half-size of the node.
+   int    border; // Sides of the node on the border of the root.
+} QtNearestNode;
+
+// Sides of a node, nodes on the border of the root can also hold elements
+// that are outside of the root.
+enum {
+   qt_side_lft = 1 << 0,
+   qt_side_top = 1 << 1,
+   qt_side_rgt = 1 << 2,
+   qt_side_btm = 1 << 3,
+};
+
+// Heap of nodes ordered by lower bound, with a fixed buffer like IntList.
+typedef struct QtNearestHeap {
+   QtNearestNode  fixed[64];
+   QtNearestNode *data;
+   int            num;
+   int            cap;
+} QtNearestHeap;
+
+static double rect_dist( double x, double y, double lft, double top,
+                         double rgt, double btm )
+{
+   const double dx = ( x < lft ) ? lft - x : ( x > rgt ) ? x - rgt : 0.;
+   const double dy = ( y < top ) ? top - y : ( y > btm ) ? y - btm : 0.;
+   return sqrt( dx * dx + dy * dy );
+}
+
+static void heap_push( QtNearestHeap *h, const QtNearestNode *n )
+{
+   int i = h->num++;
+   if ( h->num > h->cap ) {
+      h->cap *= 2;
+      if ( h->data == h->fixed ) {
+         h->data = malloc( h->cap * sizeof( *h->data ) );
+         memcpy( h->data, h->fixed, sizeof( h->fixed ) );
+      } else
+         h->data = realloc( h->data, h->cap * sizeof( *h->data ) );
+   }
+
+   // Sift up.
+   while ( i > 0 ) {
+      const int p = ( i - 1 ) / 2;
+      if ( h->data[p].lb <= n->lb )
+         break;
+      h->data[i] = h->data[p];
+      i          = p;
+   }
+   h->data[i] = *n;
+}
+
+static void heap_pop( QtNearestHeap *h, QtNearestNode *out )
+{
+   const QtNearestNode last = h->data[--h->num];
+   int                 i    = 0;
+   *out                     = h->data[0];
+
+   // Sift the last node down from the root.
+   for ( ;; ) {
+      int c = 2 * i + 1;
+      if ( c >= h->num )
+         break;
+      if ( c + 1 < h->num && h->data[c + 1].lb < h->data[c].lb )
+         ++c;
+      if ( last.lb <= h->data[c].lb )
+         break;
+      h->data[i] = h->data[c];
+      i          = c;
+   }
+   if ( h->num > 0 )
+      h->data[i] = last;
+}
+
+static void heap_push_node( QtNearestHeap *h, double x, double y, int index,
+                            int depth, int mx, int my, int sx, int sy,
+                            int border )
+{
+   // Child extents are rounded down, so pad them a bit for each level. Sides
+   // on the border of the root are unbounded.
+   const double  pad = depth + 1;
+   QtNearestNode n;
+   n.index  = index;
+   n.depth  = depth;
+   n.mx     = mx;
+   n.my     = my;
+   n.sx     = sx;
+   n.sy     = sy;
+   n.border = border;
+   n.lb     = rect_dist( x, y,
+                         ( border & qt_side_lft ) ? -HUGE_VAL : mx - sx - pad,
+                         ( border & qt_side_top ) ? -HUGE_VAL : my - sy - pad,
+                         ( border & qt_side_rgt ) ? HUGE_VAL : mx + sx + pad,
+                         ( border & qt_side_btm ) ? HUGE_VAL : my + sy + pad );
+   heap_push( h, &n );
+}
+
+// Checks whether anything at a lower bound distance can beat the best cost.
+static int can_improve( double lb, double slack, double best )
+{
+   const double d = lb - slack;
+   return ( d <= 0. ) || ( d * d <= best );
+}
+
+int qt_nearest( const Quadtree *qt, double x, double y, double slack,
+                double max_cost, QtDistFunc *dist, void *user_data,
+                double *cost )
+{
+   QtNearestHeap heap;
+   QtNearestNode cur;
+   int           best_id = -1;
+   double        best    = max_cost;
+
+   heap.data = heap.fixed;
+   heap.num  = 0;
+   heap.cap  = sizeof( heap.fixed ) / sizeof( heap.fixed[0] );
+   heap_push_node( &heap, x, y, 0, 0, qt->root_mx, qt->root_my, qt->root_sx,
+                   qt->root_sy,
+                   qt_side_lft | qt_side_top | qt_side_rgt | qt_side_btm );
+
+   while ( heap.num > 0 ) {
+      heap_pop( &heap, &cur );
+
+      // Everything left is further away than what we have.
+      if ( !can_improve( cur.lb, slack, best ) )
+         break;
+
+      if ( il_get( &qt->nodes, cur.index, node_idx_num ) == -1 ) {
+         // Push the children of the branch.
+         const int fc = il_get( &qt->nodes, cur.index, node_idx_fc );
+         const int hx = cur.sx >> 1, hy = cur.sy >> 1;
+         const int l = cur.mx - hx, t = cur.my - hy, r = cur.mx + hx,
+                   b = cur.my + hy;
+         const int d = cur.depth + 1;
+         heap_push_node( &heap, x, y, fc + 0, d, l, t, hx, hy,
+                         cur.border & ( qt_side_lft | qt_side_top ) );
+         heap_push_node( &heap, x, y, fc + 1, d, r, t, hx, hy,
+                         cur.border & ( qt_side_rgt | qt_side_top ) );
+         heap_push_node( &heap, x, y, fc + 2, d, l, b, hx, hy,
+                         cur.border & ( qt_side_lft | qt_side_btm ) );
+         heap_push_node( &heap, x, y, fc + 3, d, r, b, hx, hy,
+                         cur.border & ( qt_side_rgt | qt_side_btm ) );
+         continue;
+      }
+
+      // Check the elements of the leaf. Elements in several leaves may be
+      // checked more than once, which doesn't change the result.
+      int elt_node_index = il_get( &qt->nodes, cur.index, node_idx_fc );
+      while ( elt_node_index != -1 ) {
+         const int element =
+            il_get( &qt->enodes, elt_node_index, enode_idx_elt );
+         const int id = il_get( &qt->elts, element, elt_idx_id );
+         elt_node_index = il_get( &qt->enodes, elt_node_index, enode_idx_next );
+
+         const int lft = il_get( &qt->elts, element, elt_idx_lft );
+         const int top = il_get( &qt->elts, element, elt_idx_top );
+         const int rgt = il_get( &qt->elts, element, elt_idx_rgt );
+         const int btm = il_get( &qt->elts, element, elt_idx_btm );
+         if ( !can_improve( rect_dist( x, y, lft, top, rgt, btm ), slack,
+                            best ) )
+            continue;
+
+         const double c = dist( user_data, id );
+         if ( c < 0. )
+            continue;
+         if ( c > best )
+            continue;
+         if ( best_id >= 0 && c == best && id > best_id )
+            continue;
+         best    = c;
+         best_id = id;
+      }
+   }
+
+   if ( heap.data != heap.fixed )
+      free( heap.data );
+   if ( cost != NULL )
+      *cost = best;
+   return best_id;
+}
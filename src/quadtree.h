@@ -51,6 +51,11 @@ struct Quadtree {
 typedef void QtNodeFunc( Quadtree *qt, void *user_data, int node, int depth,
                          int mx, int my, int sx, int sy );
 
+// Function signature used for nearest queries. Returns the cost of the element
+// with the specified ID, which must not be less than its squared distance to
+// the query point, or a negative value to skip the element.
+typedef double QtDistFunc( void *user_data, int id );
+
 // Creates a quadtree with the requested extents, maximum elements per leaf, and
 // maximum tree depth.
 void qt_create( Quadtree *qt, int x1, int y1, int x2, int y2, int max_elements,
@@ -75,6 +80,21 @@ void qt_cleanup( Quadtree *qt );
 // Outputs a list of elements found in the specified rectangle.
 void qt_query( Quadtree *qt, IntList *out, int x1, int y1, int x2, int y2 );
 
+// Same as qt_query, but doesn't modify the tree so it is safe to call from
+// multiple threads at once as long as nothing is being inserted or removed.
+void qt_queryConst( const Quadtree *qt, IntList *out, int x1, int y1, int x2,
+                    int y2 );
+
+// Finds the element with the lowest cost as returned by 'dist', visiting the
+// tree best-first from the point (x,y). Elements may have moved up to 'slack'
+// away from their rectangles since being inserted, and only elements with a
+// cost up to 'max_cost' are considered. Ties are broken by the lowest ID. Does
+// not modify the tree, so it is safe to call from multiple threads at once.
+// Returns the ID of the element or -1 if none was found.
+int qt_nearest( const Quadtree *qt, double x, double y, double slack,
+                double max_cost, QtDistFunc *dist, void *user_data,
+                double *cost );
+
 // Traverses all the nodes in the tree, calling 'branch' for branch nodes and
 // 'leaf' for leaf nodes.
 void qt_traverse( Quadtree *qt, void *user_data, QtNodeFunc *branch,
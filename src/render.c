@@ -290,6 +290,8 @@ void render_all( double game_dt, double real_dt )
    /* check error every loop */
    gl_checkErr();
 
+   gl_batchFrame();
+
    NTracingZoneEnd( _ctx );
 }
 
@@ -80,6 +80,20 @@ void rng_init( void )
       mt_genArray();
 }
 
+/**
+ * @brief Reinitializes the random subsystem with a fixed seed.
+ *
+ * Used to make simulations reproducible, e.g., for benchmarking.
+ *
+ *    @param seed Seed to use.
+ */
+void rng_seed( uint32_t seed )
+{
+   mt_initArray( seed );
+   for ( int j = 0; j < 10; j++ )
+      mt_genArray();
+}
+
 /**
  * @fn static uint32_t rng_timeEntropy (void)
  *
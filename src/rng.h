@@ -3,6 +3,10 @@
  */
 #pragma once
 
+/** @cond */
+#include <stdint.h>
+/** @endcond */
+
 /**
  * @brief Gets a random number between L and H (L <= RNG <= H).
  *
@@ -46,6 +50,7 @@
 
 /* Init */
 void rng_init( void );
+void rng_seed( uint32_t seed );
 
 /* Random functions */
 unsigned int randint( void );
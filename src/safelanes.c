@@ -115,6 +115,11 @@ static Edge
    *edge_stack; /**< Array (array.h): Everything eligible to be a lane. */
 static int *sys_to_first_edge; /**< Array (array.h): For each system index, the
                                   id of its first edge, + sentinel. */
+static int *sys_component; /**< Array (array.h): For each system index, the
+                              representative of its connected component. */
+static uint64_t *sys_signature; /**< Array (array.h): For each system index, a
+                                   hash of everything its lanes depend on. */
+static uint64_t faction_signature; /**< Hash of the lane-building factions. */
 static Faction *
    faction_stack; /**< Array (array.h): The faction IDs that can build lanes. */
 static int *lane_faction; /**< Array (array.h): Per edge, ID of faction that
@@ -140,6 +145,9 @@ static UnionFind
 static cholmod_triplet
    *stiff; /**< K matrix, UT triplets: internal edges (E*3), implicit jump
               connections, anchor conditions. */
+static cholmod_factor
+   *stiff_f; /**< Factorization of "stiff". Only the values change between
+                turns, so the symbolic analysis is reused. */
 static cholmod_sparse *QtQ; /**< (Q*)Q where Q is the ExV difference matrix. */
 static cholmod_dense
    *ftilde; /**< Fluxes (bunch of F columns in the KU=F problem). */
@@ -158,10 +166,14 @@ static int safelanes_calculated_once =
 static int    safelanes_buildOneTurn( int iters_done );
 static int    safelanes_activateByGradient( const cholmod_dense *Lambda_tilde,
                                             int                  iters_done );
-static void   safelanes_initStacks( void );
+static void   safelanes_optimize( void );
+static int    safelanes_initDirty( const uint64_t *old_sig,
+                                   uint64_t old_fsig, int **dirty );
+static void   safelanes_initSignatures( void );
+static void   safelanes_initStacks( const int *sys_mask );
 static void   safelanes_initStacks_edge( void );
 static void   safelanes_initStacks_faction( void );
-static void   safelanes_initStacks_vertex( void );
+static void   safelanes_initStacks_vertex( const int *sys_mask );
 static void   safelanes_initStacks_anchor( void );
 static void   safelanes_initOptimizer( void );
 static void   safelanes_destroyOptimizer( void );
@@ -183,6 +195,7 @@ static inline FactionMask MASK_ONE_FACTION( int id );
 static inline FactionMask MASK_COMPROMISE( int id1, int id2 );
 static int                cmp_key( const void *p1, const void *p2 );
 static inline void triplet_entry( cholmod_triplet *m, int i, int j, double v );
+static inline uint64_t hash_bytes( uint64_t h, const void *data, size_t len );
 static cholmod_dense *safelanes_sliceByPresence( const cholmod_dense *m,
                                                  const double *sysPresence );
 static cholmod_dense *ncholmod_ddmult( cholmod_dense *A, int transA,
@@ -219,6 +232,7 @@ void safelanes_destroy( void )
 {
    safelanes_destroyOptimizer();
    safelanes_destroyStacks();
+   safelanes_invalidate();
    cholmod_finish( &C );
 }
 
@@ -292,9 +306,15 @@ SafeLane *safelanes_get( int faction, int standing, const StarSystem *system )
 /**
  * @brief Update the safe lane locations in response to the universe changing
  * (e.g., diff applied).
+ *
+ * Connected components of the universe are independent problems, so only the
+ * ones where something relevant to the lanes changed are optimized again. The
+ * lanes of the rest are carried over from the previous calculation.
  */
 void safelanes_recalculate( void )
 {
+   int      *old_lanes, *old_first_edge, *dirty, ndirty, nsys;
+   uint64_t *old_sig, old_fsig;
 #if DEBUGGING
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
@@ -303,24 +323,74 @@ void safelanes_recalculate( void )
    if ( naev_isQuit() )
       return;
 
-   safelanes_initStacks();
-   safelanes_initOptimizer();
-   for ( int iters_done = 0; safelanes_buildOneTurn( iters_done ) > 0;
-         iters_done++ )
-      ;
-   safelanes_destroyOptimizer();
+   /* Keep the previous results around to reuse them. */
+   old_lanes         = lane_faction;
+   old_first_edge    = sys_to_first_edge;
+   old_sig           = sys_signature;
+   old_fsig          = faction_signature;
+   lane_faction      = NULL;
+   sys_to_first_edge = NULL;
+   sys_signature     = NULL;
+
+   /* See what changed. */
+   safelanes_initStacks( NULL );
+   safelanes_initSignatures();
+   ndirty = safelanes_initDirty( old_sig, old_fsig, &dirty );
+   nsys   = array_size( sys_to_first_vertex ) - 1;
+
+   if ( ndirty == nsys )
+      safelanes_optimize();
+   else {
+      int *new_lanes = NULL, *new_first_edge = NULL;
+
+      /* Optimize only the changed components, then go back to the full stacks
+       * and merge. */
+      if ( ndirty > 0 ) {
+         safelanes_initStacks( dirty );
+         safelanes_optimize();
+         new_lanes         = lane_faction;
+         new_first_edge    = sys_to_first_edge;
+         lane_faction      = NULL;
+         sys_to_first_edge = NULL;
+         safelanes_initStacks( NULL );
+      }
+      for ( int si = 0; si < nsys; si++ ) {
+         const int *lanes = dirty[si] ? new_lanes : old_lanes;
+         const int *first = dirty[si] ? new_first_edge : old_first_edge;
+         memcpy( &lane_faction[sys_to_first_edge[si]], &lanes[first[si]],
+                 ( sys_to_first_edge[1 + si] - sys_to_first_edge[si] ) *
+                    sizeof( int ) );
+      }
+      array_free( new_lanes );
+      array_free( new_first_edge );
+   }
    /* Stacks remain available for queries. */
+   free( dirty );
+   array_free( old_lanes );
+   array_free( old_first_edge );
+   array_free( old_sig );
 #if DEBUGGING
    if ( conf.devmode )
-      DEBUG( n_( "Charted safe lanes for %d object in %.3f s",
-                 "Charted safe lanes for %d objects in %.3f s",
+      DEBUG( n_( "Charted safe lanes for %d object in %.3f s (%d/%d systems)",
+                 "Charted safe lanes for %d objects in %.3f s (%d/%d systems)",
                  array_size( vertex_stack ) ),
-             array_size( vertex_stack ), ( SDL_GetTicks() - time ) / 1000. );
+             array_size( vertex_stack ), ( SDL_GetTicks() - time ) / 1000.,
+             ndirty, nsys );
 #endif /* DEBUGGING */
 
    safelanes_calculated_once = 1;
 }
 
+/**
+ * @brief Forgets the previous lanes, so the next recalculation optimizes the
+ * whole universe.
+ */
+void safelanes_invalidate( void )
+{
+   array_free( sys_signature );
+   sys_signature = NULL;
+}
+
 /**
  * @brief Whether or not the safe lanes have been calculated at least once.
  */
@@ -329,6 +399,110 @@ int safelanes_calculated( void )
    return safelanes_calculated_once;
 }
 
+/**
+ * @brief Runs the lane optimization to convergence on the current stacks.
+ */
+static void safelanes_optimize( void )
+{
+   safelanes_initOptimizer();
+   for ( int iters_done = 0; safelanes_buildOneTurn( iters_done ) > 0;
+         iters_done++ )
+      ;
+   safelanes_destroyOptimizer();
+}
+
+/**
+ * @brief Computes the signature of every system from the full stacks.
+ *
+ * Includes everything the lanes of a system depend on: its vertices, their
+ * positions and presence, the jumps connecting them to other systems, and the
+ * presence of the lane-building factions.
+ */
+static void safelanes_initSignatures( void )
+{
+   const StarSystem *systems_stack = system_getAll();
+   int               nsys          = array_size( sys_to_first_vertex ) - 1;
+
+   faction_signature = 0;
+   for ( int fi = 0; fi < array_size( faction_stack ); fi++ ) {
+      const Faction *f = &faction_stack[fi];
+      faction_signature =
+         hash_bytes( faction_signature, &f->id, sizeof( f->id ) );
+      faction_signature =
+         hash_bytes( faction_signature, &f->lane_length_per_presence,
+                     sizeof( f->lane_length_per_presence ) );
+      faction_signature = hash_bytes( faction_signature, &f->lane_base_cost,
+                                      sizeof( f->lane_base_cost ) );
+   }
+
+   array_free( sys_signature );
+   sys_signature = array_create_size( uint64_t, nsys );
+   array_resize( &sys_signature, nsys );
+   for ( int si = 0; si < nsys; si++ ) {
+      uint64_t h = 0;
+      for ( int vi = sys_to_first_vertex[si]; vi < sys_to_first_vertex[1 + si];
+            vi++ ) {
+         const Vertex *v = &vertex_stack[vi];
+         h               = hash_bytes( h, &v->type, sizeof( v->type ) );
+         h               = hash_bytes( h, &v->index, sizeof( v->index ) );
+         h = hash_bytes( h, vertex_pos( vi ), sizeof( vec2 ) );
+         if ( v->type == VERTEX_SPOB ) {
+            const SpobPresence *sp =
+               &systems_stack[si].spobs[v->index]->presence;
+            h = hash_bytes( h, &sp->faction, sizeof( sp->faction ) );
+            h = hash_bytes( h, &sp->base, sizeof( sp->base ) );
+            h = hash_bytes( h, &sp->bonus, sizeof( sp->bonus ) );
+         }
+      }
+      for ( int fi = 0; fi < array_size( faction_stack ); fi++ ) {
+         double p = system_getPresence( &systems_stack[si],
+                                        faction_stack[fi].id );
+         h        = hash_bytes( h, &p, sizeof( p ) );
+      }
+      sys_signature[si] = h;
+   }
+
+   /* Jumps are only connected if both ends are vertices. */
+   for ( int i = 0; i < array_size( tmp_jump_edges ); i++ )
+      for ( int j = 0; j < 2; j++ ) {
+         const Vertex *v     = &vertex_stack[tmp_jump_edges[i][j]];
+         const Vertex *other = &vertex_stack[tmp_jump_edges[i][1 - j]];
+         sys_signature[v->system] =
+            hash_bytes( sys_signature[v->system], other, sizeof( Vertex ) );
+      }
+}
+
+/**
+ * @brief Finds the systems whose lanes have to be optimized again.
+ *
+ *    @param old_sig Signatures of the previous calculation, or NULL.
+ *    @param old_fsig Faction signature of the previous calculation.
+ *    @param[out] dirty Malloced: per system, whether it has to be optimized.
+ *    @return Number of systems to optimize.
+ */
+static int safelanes_initDirty( const uint64_t *old_sig, uint64_t old_fsig,
+                                int **dirty )
+{
+   int  nsys = array_size( sys_to_first_vertex ) - 1;
+   int  all  = ( old_sig == NULL ) || ( array_size( old_sig ) != nsys ) ||
+             ( old_fsig != faction_signature );
+   int *comp_dirty = calloc( nsys, sizeof( int ) );
+   int  n          = 0;
+
+   /* A change anywhere in a component can move all of its lanes. */
+   for ( int si = 0; si < nsys; si++ )
+      if ( all || ( old_sig[si] != sys_signature[si] ) )
+         comp_dirty[sys_component[si]] = 1;
+
+   *dirty = calloc( nsys, sizeof( int ) );
+   for ( int si = 0; si < nsys; si++ ) {
+      ( *dirty )[si] = comp_dirty[sys_component[si]];
+      n += ( *dirty )[si];
+   }
+   free( comp_dirty );
+   return n;
+}
+
 /**
  * @brief Initializes resources used by lane optimization.
  */
@@ -355,6 +529,7 @@ static void safelanes_destroyOptimizer( void )
                                 updated after the final activateByGradient. */
    cholmod_free_dense( &ftilde, &C );
    cholmod_free_sparse( &QtQ, &C );
+   cholmod_free_factor( &stiff_f, &C );
    cholmod_free_triplet( &stiff, &C );
 }
 
@@ -365,14 +540,14 @@ static void safelanes_destroyOptimizer( void )
 static int safelanes_buildOneTurn( int iters_done )
 {
    cholmod_sparse *stiff_s;
-   cholmod_factor *stiff_f;
    cholmod_dense  *_QtQutilde, *Lambda_tilde, *Y_workspace, *E_workspace;
    int             turns_next_time;
    double          zero[] = { 0, 0 }, neg_1[] = { -1, 0 };
 
    Y_workspace = E_workspace = Lambda_tilde = NULL;
    stiff_s = cholmod_triplet_to_sparse( stiff, 0, &C );
-   stiff_f = cholmod_analyze( stiff_s, &C );
+   if ( stiff_f == NULL ) /* Same pattern every turn. */
+      stiff_f = cholmod_analyze( stiff_s, &C );
    cholmod_factorize( stiff_s, stiff_f, &C );
    cholmod_solve2( CHOLMOD_A, stiff_f, ftilde, NULL, &utilde, NULL,
                    &Y_workspace, &E_workspace, &C );
@@ -383,7 +558,6 @@ static int safelanes_buildOneTurn( int iters_done )
    cholmod_free_dense( &_QtQutilde, &C );
    cholmod_free_dense( &Y_workspace, &C );
    cholmod_free_dense( &E_workspace, &C );
-   cholmod_free_factor( &stiff_f, &C );
    cholmod_free_sparse( &stiff_s, &C );
    turns_next_time = safelanes_activateByGradient( Lambda_tilde, iters_done );
    cholmod_free_dense( &Lambda_tilde, &C );
@@ -393,20 +567,24 @@ static int safelanes_buildOneTurn( int iters_done )
 
 /**
  * @brief Sets up the local faction/object stacks.
+ *
+ *    @param sys_mask Per system, whether to include it, or NULL for all.
  */
-static void safelanes_initStacks( void )
+static void safelanes_initStacks( const int *sys_mask )
 {
    safelanes_destroyStacks();
-   safelanes_initStacks_faction(); /* Dependency for vertex. */
-   safelanes_initStacks_vertex();  /* Dependency for edge. */
+   safelanes_initStacks_faction();         /* Dependency for vertex. */
+   safelanes_initStacks_vertex( sys_mask ); /* Dependency for edge. */
    safelanes_initStacks_edge();
    safelanes_initStacks_anchor();
 }
 
 /**
  * @brief Sets up the local stacks with entry per vertex (or per jump).
+ *
+ *    @param sys_mask Per system, whether to include it, or NULL for all.
  */
-static void safelanes_initStacks_vertex( void )
+static void safelanes_initStacks_vertex( const int *sys_mask )
 {
    const StarSystem *systems_stack = system_getAll();
 
@@ -417,7 +595,8 @@ static void safelanes_initStacks_vertex( void )
    tmp_jump_edges   = array_create( Edge );
    for ( int system = 0; system < array_size( systems_stack ); system++ ) {
       const StarSystem *sys = &systems_stack[system];
-      if ( sys_isFlag( sys, SYSTEM_NOLANES ) ) {
+      if ( sys_isFlag( sys, SYSTEM_NOLANES ) ||
+           ( ( sys_mask != NULL ) && !sys_mask[system] ) ) {
          array_push_back( &sys_to_first_vertex, array_size( vertex_stack ) );
          continue;
       }
@@ -563,6 +742,9 @@ static void safelanes_initStacks_anchor( void )
                        vertex_stack[tmp_jump_edges[i][1]].system );
    anchor_systems      = unionfind_findall( &tmp_sys_uf );
    tmp_anchor_vertices = array_create_size( int, array_size( anchor_systems ) );
+   sys_component       = array_create_size( int, nsys );
+   for ( int i = 0; i < nsys; i++ )
+      array_push_back( &sys_component, unionfind_find( &tmp_sys_uf, i ) );
 
    /* Add an anchor vertex per system, but only if there actually is a vertex in
     * the system. */
@@ -590,6 +772,8 @@ static void safelanes_destroyStacks( void )
    edge_stack = NULL;
    array_free( sys_to_first_edge );
    sys_to_first_edge = NULL;
+   array_free( sys_component );
+   sys_component = NULL;
    for ( int i = 0; i < array_size( presence_budget ); i++ )
       array_free( presence_budget[i] );
    array_free( presence_budget );
@@ -805,7 +989,7 @@ static void safelanes_initPPl( void )
 static int safelanes_activateByGradient( const cholmod_dense *Lambda_tilde,
                                          int                  iters_done )
 {
-   int            *facind_opts, *edgeind_opts, turns_next_time;
+   int            *facind_opts, *edgeind_opts, *comp_turns, turns_next_time;
    double         *facind_vals, Linv;
    cholmod_dense **lal; /**< Per faction index, the Lambda_tilde[myDofs,:] @
                            PPl[fi] matrices. Calloced and lazily populated. */
@@ -821,6 +1005,7 @@ static int safelanes_activateByGradient( const cholmod_dense *Lambda_tilde,
       array_push_back( &facind_opts, fi );
       array_push_back( &facind_vals, 0 );
    }
+   comp_turns = calloc( array_size( sys_component ), sizeof( int ) );
    turns_next_time = 0;
 
    for ( int si = 0; si < array_size( sys_to_first_vertex ) - 1; si++ ) {
@@ -938,9 +1123,10 @@ static int safelanes_activateByGradient( const cholmod_dense *Lambda_tilde,
 
          /* Add the lane. */
          presence_budget[fi][si] -= cost_best;
-         if ( presence_budget[fi][si] >= cost_cheapest_other )
+         if ( presence_budget[fi][si] >= cost_cheapest_other ) {
             turns_next_time++;
-         else {
+            comp_turns[sys_component[si]]++;
+         } else {
             presence_budget[fi][si] =
                0.; /* Nothing more to do here; tell ourselves. */
             if ( lal[fi] == NULL )
@@ -962,8 +1148,17 @@ static int safelanes_activateByGradient( const cholmod_dense *Lambda_tilde,
                  lal[fi]->nrow == lal_bases[fi] );
 #endif /* DEBUGGING */
 
+   /* Components are independent problems, so each one stops as soon as it
+    * converges. This makes the lanes of a component the same whether or not
+    * the others are optimized along with it. */
+   for ( int si = 0; si < array_size( sys_component ); si++ )
+      if ( comp_turns[sys_component[si]] == 0 )
+         for ( int fi = 0; fi < array_size( faction_stack ); fi++ )
+            presence_budget[fi][si] = 0.;
+
    for ( int fi = 0; fi < array_size( faction_stack ); fi++ )
       cholmod_free_dense( &lal[fi], &C );
+   free( comp_turns );
    free( lal );
    free( lal_bases );
    array_free( edgeind_opts );
@@ -1073,6 +1268,21 @@ static inline FactionMask MASK_COMPROMISE( int id1, int id2 )
                  m2 ); /* Any/Any -> any, Any/f -> just f, f1/f2 -> either. */
 }
 
+/**
+ * @brief Hashes some bytes into a running FNV-1a hash.
+ */
+static inline uint64_t hash_bytes( uint64_t h, const void *data, size_t len )
+{
+   const unsigned char *p = data;
+   if ( h == 0 )
+      h = 14695981039346656037ULL;
+   for ( size_t i = 0; i < len; i++ ) {
+      h ^= p[i];
+      h *= 1099511628211ULL;
+   }
+   return h;
+}
+
 static inline void triplet_entry( cholmod_triplet *m, int i, int j, double x )
 {
    ( (int *)m->i )[m->nnz]    = i;
@@ -195,6 +195,11 @@ int save_all_with_name( const char *name )
    }
    xmlFreeDoc( doc );
 
+   /* Metadata for listing the saves quickly, the save is fine without. */
+   snprintf( file, sizeof( file ), "saves/%s/%s.ns", player.name, name );
+   if ( load_updateMeta( file ) )
+      WARN( _( "Unable to write metadata of saved game '%s'!" ), file );
+
    return 0;
 
 err_writer:
@@ -113,6 +113,13 @@ SHADERS = [
       attributes = ["vertex"],
       uniforms = ["projection", "colour", "tex_mat", "sampler1", "sampler2", "inter"],
    ),
+   Shader(
+      name = "texture_batch",
+      vs_path = "texture_batch.vert",
+      fs_path = "texture_batch.frag",
+      attributes = ["vertex", "pos", "tex", "colour", "params"],
+      uniforms = ["projection", "sampler1", "sampler2"],
+   ),
    Shader(
       name = "texturesdf",
       vs_path = "texturesdf.vert",
@@ -180,8 +187,8 @@ SHADERS = [
       name = "font",
       vs_path = "font.vert",
       fs_path = "font.frag",
-      attributes = ["vertex", "tex_coord"],
-      uniforms = ["projection", "m", "colour", "outline_colour"],
+      attributes = ["vertex", "tex_coord", "m", "glyph_colour"],
+      uniforms = ["projection", "colour", "outline_colour"],
    ),
    Shader(
       name = "beam",
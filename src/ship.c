@@ -602,6 +602,10 @@ int ship_gfxLoaded( const Ship *s )
  */
 int ship_gfxLoadNeeded( void )
 {
+   int n = 0;
+#if DEBUGGING
+   Uint32 time = SDL_GetTicks();
+#endif /* DEBUGGING */
    ThreadQueue *tq = vpool_create();
    SDL_GL_MakeCurrent( gl_screen.window, NULL );
 
@@ -611,12 +615,19 @@ int ship_gfxLoadNeeded( void )
          continue;
       vpool_enqueue( tq, (int ( * )( void * ))ship_gfxLoad, s );
       ship_rmFlag( s, SHIP_NEEDSGFX );
+      n++;
    }
 
    vpool_wait( tq );
    vpool_cleanup( tq );
 
    SDL_GL_MakeCurrent( gl_screen.window, gl_screen.context );
+
+   /* Debugging timings. */
+   if ( conf.devmode && ( n > 0 ) )
+      DEBUG( n_( "Loaded graphics for %d Ship in %.3f s",
+                 "Loaded graphics for %d Ships in %.3f s", n ),
+             n, ( SDL_GetTicks() - time ) / 1000. );
    return 0;
 }
 
@@ -753,9 +764,8 @@ int ship_gfxLoad( Ship *s )
  */
 static int ship_loadPLG( Ship *temp, const char *buf )
 {
-   char       file[PATH_MAX];
-   xmlDocPtr  doc;
-   xmlNodePtr node;
+   char      file[PATH_MAX];
+   CollPoly *polygons;
 
    if ( temp->gfx_3d != NULL )
       snprintf( file, sizeof( file ), "%s%s.xml", SHIP_POLYGON_PATH3D, buf );
@@ -763,31 +773,19 @@ static int ship_loadPLG( Ship *temp, const char *buf )
       snprintf( file, sizeof( file ), "%s%s.xml", SHIP_POLYGON_PATH, buf );
 
    /* See if the file does exist. */
-   if ( !PHYSFS_exists( file ) ) {
+   if ( poly_loadFile( &polygons, file ) ) {
       WARN( _( "%s xml collision polygon does not exist! Please use the "
                "script '%s' found in Naev's main repository." ),
             file, "utils/polygonize.py" );
       return 0;
    }
 
-   /* Load the XML. */
-   doc = xml_parsePhysFS( file );
-   if ( doc == NULL )
-      return 0;
-
-   node = doc->xmlChildrenNode; /* First polygon node */
-   if ( node == NULL ) {
-      xmlFreeDoc( doc );
-      WARN( _( "Malformed %s file: does not contain elements" ), file );
-      return 0;
-   }
-
-   do { /* load the polygon data */
-      if ( xml_isNode( node, "polygons" ) )
-         poly_load( &temp->polygon, node, file );
-   } while ( xml_nextNode( node ) );
-
-   xmlFreeDoc( doc );
+   /* The last polygon is the one used. */
+   for ( int i = 0; i < array_size( polygons ) - 1; i++ )
+      poly_free( &polygons[i] );
+   if ( array_size( polygons ) > 0 )
+      temp->polygon = array_back( polygons );
+   array_free( polygons );
    return 0;
 }
 
@@ -13,8 +13,9 @@
  *    source - openal object that plays sound
  *    voice - virtual object that wants to play sound
  *
- * 1) First we allocate all the buffers based on what we find inside the
- * datafile.
+ * 1) First we register all the sounds we find inside the datafile. They only
+ * get decoded into buffers on the threadpool when prefetched or first played,
+ * and the least recently used ones are freed when over the memory budget.
  * 2) Then we allocate all the possible sources (giving the music system
  * what it needs).
  * 3) Now we allow the user to dynamically create voices, these voices will
@@ -51,6 +52,7 @@
 #include "nlua_spfx.h"
 #include "nopenal.h"
 #include "pilot.h"
+#include "threadpool.h"
 
 #define SOUND_FADEOUT 100
 #define SOUND_VOICES                                                           \
@@ -60,20 +62,53 @@
 #define SOUND_SUFFIX_WAV ".wav" /**< Suffix of sounds. */
 #define SOUND_SUFFIX_OGG ".ogg" /**< Suffix of sounds. */
 
+#define SOUND_LUT_SIZE 1024 /**< Size of the sound name look up table. */
+#define SOUND_MEMORY_BUDGET                                                    \
+   ( 64 << 20 ) /**< Bytes of decoded sounds to keep around at most. */
+#define SOUND_EVICT_DELAY                                                      \
+   5. /**< Seconds a sound has to be unused past its end to be evicted. */
+
 #define voiceLock() SDL_LockMutex( voice_mutex )
 #define voiceUnlock() SDL_UnlockMutex( voice_mutex )
 
+/**
+ * @brief Decoded sound samples, ready to be put into an OpenAL buffer.
+ */
+typedef struct SoundPCM_s {
+   void   *data;   /**< Sample data. */
+   size_t  len;    /**< Size of the data in bytes. */
+   ALenum  format; /**< OpenAL format of the samples. */
+   ALsizei freq;   /**< Sampling frequency. */
+   int     wav;    /**< Whether the data is freed with SDL_FreeWAV. */
+} SoundPCM;
+
+/**
+ * @brief A sound being decoded on the threadpool.
+ */
+typedef struct SoundDecode_s {
+   char        *filename; /**< File to decode. */
+   JobGroup    *group;    /**< Job group to wait on. */
+   SDL_atomic_t done;     /**< Set by the job when finished. */
+   int          ret;      /**< Result of decoding. */
+   SoundPCM     pcm;      /**< Decoded samples. */
+} SoundDecode;
+
 /**
  * @struct alSound
  *
  * @brief Contains a sound buffer.
  */
 typedef struct alSound_ {
-   char  *filename; /**< Name of the file loaded from. */
-   char  *name;     /**< Buffer's name. */
-   double length;   /**< Length of the buffer. */
-   int    channels; /**< Number of channels of the buffer. */
-   ALuint buf;      /**< Buffer data. */
+   char        *filename; /**< Name of the file loaded from. */
+   char        *name;     /**< Buffer's name. */
+   double       length;   /**< Length of the buffer. */
+   int          channels; /**< Number of channels of the buffer. */
+   ALuint       buf;      /**< Buffer data, 0 if not decoded. */
+   int          next;     /**< Next sound in the look up table. */
+   int          failed;   /**< Decoding the file failed. */
+   size_t       size;     /**< Size of the buffer data in bytes. */
+   double       lastused; /**< Last time the sound was played. */
+   SoundDecode *decode;   /**< Decoding in progress, NULL otherwise. */
 } alSound;
 
 /**
@@ -134,6 +169,10 @@ static int sound_initialized = 0; /**< Whether or not sound is initialized. */
  * Sound list.
  */
 static alSound *sound_list = NULL; /**< List of available sounds. */
+static int      sound_lut[SOUND_LUT_SIZE]; /**< Sound look up table. */
+static int     *sound_pending  = NULL; /**< Sounds being decoded. */
+static size_t   sound_resident = 0;    /**< Bytes of decoded sounds. */
+static double   sound_time     = 0.;   /**< Time used to track sound use. */
 
 /*
  * Voices.
@@ -156,6 +195,13 @@ static double snd_compression_gain = 0.; /**< Current compression gain. */
 /* General. */
 static int  sound_makeList( void );
 static void sound_free( alSound *snd );
+/* Sound bank. */
+static unsigned int sound_hash( const char *name );
+static int          sound_register( const char *name, const char *filename );
+static int          sound_decodeJob( void *data );
+static void         sound_finishDecode( alSound *snd );
+static alSound     *sound_acquire( int sound );
+static void         sound_evict( void );
 /* Voices. */
 
 /*
@@ -219,9 +265,13 @@ static int         al_enableEFX( void );
  */
 static int al_playVoice( alVoice *v, alSound *s, ALfloat px, ALfloat py,
                          ALfloat vx, ALfloat vy, ALint relative );
-static int al_load( alSound *snd, SDL_RWops *rw, const char *name );
-static int al_loadWav( ALuint *buf, SDL_RWops *rw );
-static int al_loadOgg( ALuint *buf, OggVorbis_File *vf );
+static int  al_load( alSound *snd, SDL_RWops *rw, const char *name );
+static void al_bufferInfo( alSound *snd, const char *name );
+static int  al_decode( SoundPCM *pcm, SDL_RWops *rw );
+static int  al_decodeWav( SoundPCM *pcm, SDL_RWops *rw );
+static int  al_decodeOgg( SoundPCM *pcm, OggVorbis_File *vf );
+static int  al_bufferPCM( ALuint *buf, const SoundPCM *pcm );
+static void al_freePCM( SoundPCM *pcm );
 /*
  * Pausing.
  */
@@ -722,10 +772,19 @@ void sound_exit( void )
    source_nstack = 0;
    source_mstack = 0;
 
-   /* free the sounds */
+   /* Wait for the decoding sounds, then free them all. */
+   for ( int i = array_size( sound_pending ) - 1; i >= 0; i-- ) {
+      alSound *snd = &sound_list[sound_pending[i]];
+      job_wait( snd->decode->group );
+      sound_finishDecode( snd );
+   }
+   array_free( sound_pending );
+   sound_pending = NULL;
    for ( int i = 0; i < array_size( sound_list ); i++ )
       sound_free( &sound_list[i] );
    array_free( sound_list );
+   sound_list     = NULL;
+   sound_resident = 0;
 
    /* Clean up EFX stuff. */
    if ( al_info.efx == AL_TRUE ) {
@@ -763,14 +822,50 @@ int sound_get( const char *name )
    if ( sound_disabled )
       return 0;
 
-   for ( int i = 0; i < array_size( sound_list ); i++ )
+   for ( int i = sound_lut[sound_hash( name )]; i != -1; ) {
       if ( strcmp( name, sound_list[i].name ) == 0 )
          return i;
+      i = sound_list[i].next;
+   }
 
    WARN( _( "Sound '%s' not found in sound list" ), name );
    return -1;
 }
 
+/**
+ * @brief Starts decoding a sound in the background, so that it is ready by the
+ * time it gets played.
+ *
+ *    @param sound ID of the sound to decode.
+ */
+void sound_prefetch( int sound )
+{
+   alSound     *snd;
+   SoundDecode *dec;
+
+   if ( sound_disabled )
+      return;
+   if ( ( sound < 0 ) || ( sound >= array_size( sound_list ) ) )
+      return;
+
+   snd = &sound_list[sound];
+   if ( snd->buf != 0 ) {
+      snd->lastused = sound_time; /* Don't evict what is about to be used. */
+      return;
+   }
+   if ( ( snd->decode != NULL ) || snd->failed || ( snd->filename == NULL ) )
+      return;
+
+   dec           = calloc( 1, sizeof( SoundDecode ) );
+   dec->filename = strdup( snd->filename );
+   dec->group    = jobgroup_create();
+   snd->decode   = dec;
+   if ( sound_pending == NULL )
+      sound_pending = array_create( int );
+   array_push_back( &sound_pending, sound );
+   job_submit( dec->group, sound_decodeJob, dec );
+}
+
 /**
  * @brief Gets the length of the sound buffer.
  *
@@ -779,10 +874,20 @@ int sound_get( const char *name )
  */
 double sound_getLength( int sound )
 {
+   const alSound *snd;
+
    if ( sound_disabled )
       return 0.;
+   if ( ( sound < 0 ) || ( sound >= array_size( sound_list ) ) )
+      return 0.;
 
-   return sound_list[sound].length;
+   /* The length is kept when the buffer is evicted. */
+   snd = &sound_list[sound];
+   if ( snd->length > 0. )
+      return snd->length;
+
+   snd = sound_acquire( sound );
+   return ( snd == NULL ) ? 0. : snd->length;
 }
 
 /**
@@ -799,15 +904,14 @@ int sound_play( int sound )
    if ( sound_disabled )
       return 0;
 
-   if ( ( sound < 0 ) || ( sound >= array_size( sound_list ) ) )
+   /* Get the sound. */
+   s = sound_acquire( sound );
+   if ( s == NULL )
       return -1;
 
    /* Gets a new voice. */
    v = voice_new();
 
-   /* Get the sound. */
-   s = &sound_list[sound];
-
    /* Try to play the sound. */
    if ( al_playVoice( v, s, 0., 0., 0., 0., AL_TRUE ) )
       return -1;
@@ -860,12 +964,14 @@ int sound_playPos( int sound, double px, double py, double vx, double vy )
          return 0;
    }
 
+   /* Get the sound. */
+   s = sound_acquire( sound );
+   if ( s == NULL )
+      return -1;
+
    /* Gets a new voice. */
    v = voice_new();
 
-   /* Get the sound. */
-   s = &sound_list[sound];
-
    /* Try to play the sound. */
    if ( al_playVoice( v, s, px, py, vx, vy, AL_FALSE ) )
       return -1;
@@ -921,6 +1027,16 @@ int sound_update( double dt )
    if ( sound_disabled )
       return 0;
 
+   /* Finish the sounds decoded in the background. */
+   sound_time += dt;
+   for ( int i = array_size( sound_pending ) - 1; i >= 0; i-- ) {
+      alSound *snd = &sound_list[sound_pending[i]];
+      if ( SDL_AtomicGet( &snd->decode->done ) )
+         sound_finishDecode( snd );
+   }
+   if ( sound_resident > SOUND_MEMORY_BUDGET )
+      sound_evict();
+
    /* System update. */
    for ( int i = 0; i < al_ngroups; i++ ) {
       unsigned int f;
@@ -1218,14 +1334,14 @@ static int sound_makeList( void )
 
    /* Create the list. */
    sound_list = array_create( alSound );
+   for ( int i = 0; i < SOUND_LUT_SIZE; i++ )
+      sound_lut[i] = -1;
 
    /* load the profiles */
    suflen = strlen( SOUND_SUFFIX_WAV );
    for ( size_t i = 0; files[i] != NULL; i++ ) {
-      int        len;
-      char       path[PATH_MAX];
-      SDL_RWops *rw;
-      int        flen = strlen( files[i] );
+      char path[PATH_MAX];
+      int  flen = strlen( files[i] );
 
       /* Must be longer than suffix. */
       if ( flen < suflen )
@@ -1238,19 +1354,14 @@ static int sound_makeList( void )
              0 ) )
          continue;
 
-      /* Load the sound. */
+      /* Register the sound, it gets decoded when needed. */
       snprintf( path, sizeof( path ), SOUND_PATH "%s", files[i] );
-      rw = PHYSFSRWOPS_openRead( path );
-
-      /* remove the suffix */
-      len           = flen - suflen;
-      files[i][len] = '\0';
-
-      source_newRW( rw, files[i], 0 );
-      SDL_RWclose( rw );
+      files[i][flen - suflen] = '\0'; /* Remove the suffix. */
+      sound_register( files[i], path );
    }
 
-   DEBUG( n_( "Loaded %d Sound", "Loaded %d Sounds", array_size( sound_list ) ),
+   DEBUG( n_( "Registered %d Sound", "Registered %d Sounds",
+              array_size( sound_list ) ),
           array_size( sound_list ) );
 
    /* Clean up. */
@@ -1321,6 +1432,8 @@ static void sound_free( alSound *snd )
    free( snd->filename );
 
    /* Free internals. */
+   if ( snd->buf == 0 )
+      return;
    soundLock();
 
    alDeleteBuffers( 1, &snd->buf );
@@ -1329,6 +1442,180 @@ static void sound_free( alSound *snd )
    soundUnlock();
 }
 
+/**
+ * @brief Hashes a sound name (FNV-1a) into the look up table.
+ */
+static unsigned int sound_hash( const char *name )
+{
+   uint32_t h = 2166136261u;
+   for ( const char *c = name; *c != '\0'; c++ ) {
+      h ^= (unsigned char)*c;
+      h *= 16777619u;
+   }
+   return h & ( SOUND_LUT_SIZE - 1 );
+}
+
+/**
+ * @brief Adds a sound to the list without loading it.
+ *
+ * Sounds with the same name are kept in the order they were registered, so the
+ * first one is the one that gets found.
+ *
+ *    @param name Name of the sound.
+ *    @param filename File to decode the sound from, NULL if loaded elsewhere.
+ *    @return ID of the new sound.
+ */
+static int sound_register( const char *name, const char *filename )
+{
+   unsigned int h   = sound_hash( name );
+   alSound     *snd = &array_grow( &sound_list );
+   int          id  = snd - sound_list;
+
+   memset( snd, 0, sizeof( alSound ) );
+   snd->name     = strdup( name );
+   snd->filename = ( filename == NULL ) ? NULL : strdup( filename );
+   snd->next     = -1;
+
+   /* Insert in linked list. */
+   if ( sound_lut[h] == -1 )
+      sound_lut[h] = id;
+   else {
+      int i = sound_lut[h];
+      while ( sound_list[i].next != -1 )
+         i = sound_list[i].next;
+      sound_list[i].next = id;
+   }
+   return id;
+}
+
+/**
+ * @brief Decodes a sound file on the threadpool.
+ *
+ * Only touches the SoundDecode, buffers are created from the main thread.
+ */
+static int sound_decodeJob( void *data )
+{
+   SoundDecode *dec = data;
+   SDL_RWops   *rw  = PHYSFSRWOPS_openRead( dec->filename );
+   if ( rw == NULL )
+      dec->ret = -1;
+   else {
+      dec->ret = al_decode( &dec->pcm, rw );
+      SDL_RWclose( rw );
+   }
+   SDL_AtomicSet( &dec->done, 1 );
+   return 0;
+}
+
+/**
+ * @brief Puts a decoded sound into its buffer. The decoding must be done.
+ */
+static void sound_finishDecode( alSound *snd )
+{
+   SoundDecode *dec = snd->decode;
+   int          id  = snd - sound_list;
+
+   if ( ( dec->ret == 0 ) && ( al_bufferPCM( &snd->buf, &dec->pcm ) == 0 ) ) {
+      al_bufferInfo( snd, snd->name );
+      snd->size     = dec->pcm.len;
+      snd->lastused = sound_time;
+      sound_resident += snd->size;
+   } else {
+      WARN( _( "Failed to load sound file '%s'." ), dec->filename );
+      snd->failed = 1;
+   }
+
+   al_freePCM( &dec->pcm );
+   jobgroup_free( dec->group );
+   free( dec->filename );
+   free( dec );
+   snd->decode = NULL;
+
+   for ( int i = 0; i < array_size( sound_pending ); i++ )
+      if ( sound_pending[i] == id ) {
+         array_erase( &sound_pending, &sound_pending[i],
+                      &sound_pending[i + 1] );
+         break;
+      }
+}
+
+/**
+ * @brief Gets a sound ready to be played.
+ *
+ * Sounds that were not prefetched are decoded right away, blocking until done.
+ *
+ *    @param sound ID of the sound.
+ *    @return The sound or NULL if it can't be played.
+ */
+static alSound *sound_acquire( int sound )
+{
+   alSound *snd;
+
+   if ( ( sound < 0 ) || ( sound >= array_size( sound_list ) ) )
+      return NULL;
+
+   snd = &sound_list[sound];
+   if ( snd->buf == 0 ) {
+      sound_prefetch( sound );
+      if ( snd->decode != NULL ) {
+         job_wait( snd->decode->group );
+         sound_finishDecode( snd );
+      }
+      if ( snd->buf == 0 )
+         return NULL;
+   }
+   snd->lastused = sound_time;
+   return snd;
+}
+
+/**
+ * @brief Compares sounds by when they were last used.
+ */
+static int sound_cmpLastUsed( const void *p1, const void *p2 )
+{
+   const alSound *s1 = &sound_list[*(const int *)p1];
+   const alSound *s2 = &sound_list[*(const int *)p2];
+   return ( s1->lastused > s2->lastused ) - ( s1->lastused < s2->lastused );
+}
+
+/**
+ * @brief Frees the least recently used sounds until under the memory budget.
+ *
+ * Sounds that may still be playing are kept, OpenAL also refuses to delete
+ * buffers that are attached to a source.
+ */
+static void sound_evict( void )
+{
+   int *lru = array_create( int );
+   for ( int i = 0; i < array_size( sound_list ); i++ ) {
+      const alSound *snd = &sound_list[i];
+      if ( ( snd->buf != 0 ) && ( snd->filename != NULL ) &&
+           ( snd->lastused + snd->length + SOUND_EVICT_DELAY < sound_time ) )
+         array_push_back( &lru, i );
+   }
+   qsort( lru, array_size( lru ), sizeof( int ), sound_cmpLastUsed );
+
+   soundLock();
+   alGetError(); /* Clear errors. */
+   for ( int i = 0; i < array_size( lru ); i++ ) {
+      alSound *snd;
+      if ( sound_resident <= SOUND_MEMORY_BUDGET )
+         break;
+      snd = &sound_list[lru[i]];
+      alDeleteBuffers( 1, &snd->buf );
+      if ( alGetError() != AL_NO_ERROR ) {
+         snd->lastused = sound_time; /* Still in use. */
+         continue;
+      }
+      snd->buf = 0;
+      sound_resident -= snd->size;
+      snd->size = 0;
+   }
+   soundUnlock();
+
+   array_free( lru );
+}
+
 /**
  * @brief Creates a sound group.
  *
@@ -1414,10 +1701,10 @@ int sound_playGroup( int group, int sound, int once )
    if ( sound_disabled )
       return 0;
 
-   if ( ( sound < 0 ) || ( sound >= array_size( sound_list ) ) )
+   s = sound_acquire( sound );
+   if ( s == NULL )
       return -1;
 
-   s = &sound_list[sound];
    for ( int i = 0; i < al_ngroups; i++ ) {
       alGroup_t *g;
 
@@ -1794,7 +2081,7 @@ alVoice *voice_get( int id )
  */
 int source_newRW( SDL_RWops *rw, const char *name, unsigned int flags )
 {
-   int     ret;
+   int     ret, id;
    alSound snd, *sndl;
    (void)flags;
 
@@ -1806,11 +2093,14 @@ int source_newRW( SDL_RWops *rw, const char *name, unsigned int flags )
    if ( ret )
       return -1;
 
-   sndl = &array_grow( &sound_list );
-   memcpy( sndl, &snd, sizeof( alSound ) );
-   sndl->name = strdup( name );
+   /* Already loaded, so it can't be evicted. */
+   id             = sound_register( name, NULL );
+   sndl           = &sound_list[id];
+   sndl->buf      = snd.buf;
+   sndl->length   = snd.length;
+   sndl->channels = snd.channels;
 
-   return sndl - sound_list;
+   return id;
 }
 
 /**
@@ -1865,14 +2155,12 @@ static alGroup_t *al_getGroup( int group )
 }
 
 /**
- * @brief Loads a wav file from the rw if possible.
- *
- * @note Closes the rw.
+ * @brief Decodes a wav file from the rw if possible.
  *
- *    @param buf Buffer to load wav into.
+ *    @param pcm Samples to decode into.
  *    @param rw Data for the wave.
  */
-static int al_loadWav( ALuint *buf, SDL_RWops *rw )
+static int al_decodeWav( SoundPCM *pcm, SDL_RWops *rw )
 {
    SDL_AudioSpec wav_spec;
    Uint32        wav_length;
@@ -1901,23 +2189,19 @@ static int al_loadWav( ALuint *buf, SDL_RWops *rw )
    case AUDIO_U16MSB:
    case AUDIO_S16MSB:
       WARN( _( "Big endian WAVs unsupported!" ) );
+      SDL_FreeWAV( wav_buffer );
       return -1;
    default:
       WARN( _( "Invalid WAV format!" ) );
+      SDL_FreeWAV( wav_buffer );
       return -1;
    }
 
-   /* Load into openal. */
-   soundLock();
-   /* Create new buffer. */
-   alGenBuffers( 1, buf );
-   /* Put into the buffer. */
-   alBufferData( *buf, format, wav_buffer, wav_length, wav_spec.freq );
-   al_checkErr();
-   soundUnlock();
-
-   /* Clean up. */
-   SDL_FreeWAV( wav_buffer );
+   pcm->data   = wav_buffer;
+   pcm->len    = wav_length;
+   pcm->format = format;
+   pcm->freq   = wav_spec.freq;
+   pcm->wav    = 1;
    return 0;
 }
 
@@ -1995,12 +2279,12 @@ void rg_filter( float **pcm, long channels, long samples, void *filter_param )
 }
 
 /**
- * @brief Loads an ogg file from a tested format if possible.
+ * @brief Decodes an ogg file from a tested format if possible.
  *
- *    @param buf Buffer to load ogg into.
+ *    @param pcm Samples to decode into.
  *    @param vf Vorbisfile containing the song.
  */
-static int al_loadOgg( ALuint *buf, OggVorbis_File *vf )
+static int al_decodeOgg( SoundPCM *pcm, OggVorbis_File *vf )
 {
    int               ret;
    long              i;
@@ -2058,45 +2342,88 @@ static int al_loadOgg( ALuint *buf, OggVorbis_File *vf )
       i += bytes_read;
    }
 
-   soundLock();
-   /* Create new buffer. */
-   alGenBuffers( 1, buf );
-   /* Put into buffer. */
-   alBufferData( *buf, format, data, len, info->rate );
-   al_checkErr();
-   soundUnlock();
+   pcm->data   = data;
+   pcm->len    = len;
+   pcm->format = format;
+   pcm->freq   = info->rate;
+   pcm->wav    = 0;
 
    /* Clean up. */
-   free( data );
    ov_clear( vf );
 
    return 0;
 }
 
 /**
- * @brief Loads the sound.
+ * @brief Decodes a sound file. Doesn't use OpenAL, so it is thread safe.
  *
- *    @param buf Buffer to load.
- *    @param rw File to load from.
- *    @param name Name for debugging purposes.
+ *    @param pcm Samples to decode into.
+ *    @param rw File to decode.
+ *    @return 0 on success.
  */
-int sound_al_buffer( ALuint *buf, SDL_RWops *rw, const char *name )
+static int al_decode( SoundPCM *pcm, SDL_RWops *rw )
 {
-   int            ret;
    OggVorbis_File vf;
 
+   memset( pcm, 0, sizeof( SoundPCM ) );
+
    /* Check to see if it's an Ogg. */
    if ( ov_test_callbacks( rw, &vf, NULL, 0, sound_al_ovcall_noclose ) == 0 )
-      ret = al_loadOgg( buf, &vf );
+      return al_decodeOgg( pcm, &vf );
 
    /* Otherwise try WAV. */
-   else {
-      /* Destroy the partially loaded vorbisfile. */
-      ov_clear( &vf );
+   /* Destroy the partially loaded vorbisfile. */
+   ov_clear( &vf );
+   return al_decodeWav( pcm, rw );
+}
 
-      /* Try to load Wav. */
-      ret = al_loadWav( buf, rw );
+/**
+ * @brief Creates an OpenAL buffer from decoded samples.
+ */
+static int al_bufferPCM( ALuint *buf, const SoundPCM *pcm )
+{
+   ALenum err;
+   soundLock();
+   alGetError(); /* Clear errors. */
+   /* Create new buffer. */
+   alGenBuffers( 1, buf );
+   /* Put into buffer. */
+   alBufferData( *buf, pcm->format, pcm->data, pcm->len, pcm->freq );
+   err = alGetError();
+   if ( err != AL_NO_ERROR ) {
+      alDeleteBuffers( 1, buf );
+      *buf = 0;
    }
+   soundUnlock();
+   return ( err == AL_NO_ERROR ) ? 0 : -1;
+}
+
+/**
+ * @brief Frees decoded samples.
+ */
+static void al_freePCM( SoundPCM *pcm )
+{
+   if ( pcm->wav )
+      SDL_FreeWAV( pcm->data );
+   else
+      free( pcm->data );
+   memset( pcm, 0, sizeof( SoundPCM ) );
+}
+
+/**
+ * @brief Loads the sound.
+ *
+ *    @param buf Buffer to load.
+ *    @param rw File to load from.
+ *    @param name Name for debugging purposes.
+ */
+int sound_al_buffer( ALuint *buf, SDL_RWops *rw, const char *name )
+{
+   SoundPCM pcm;
+   int      ret = al_decode( &pcm, rw );
+   if ( ret == 0 )
+      ret = al_bufferPCM( buf, &pcm );
+   al_freePCM( &pcm );
 
    /* Failed to load. */
    if ( ret != 0 ) {
@@ -2104,13 +2431,6 @@ int sound_al_buffer( ALuint *buf, SDL_RWops *rw, const char *name )
       return ret;
    }
 
-   soundLock();
-
-   /* Check for errors. */
-   al_checkErr();
-
-   soundUnlock();
-
    return 0;
 }
 
@@ -2123,12 +2443,24 @@ int sound_al_buffer( ALuint *buf, SDL_RWops *rw, const char *name )
  */
 int al_load( alSound *snd, SDL_RWops *rw, const char *name )
 {
-   ALint freq, bits, channels, size;
-   int   ret = sound_al_buffer( &snd->buf, rw, name );
+   int ret = sound_al_buffer( &snd->buf, rw, name );
    if ( ret != 0 ) {
       WARN( _( "Failed to load sound file '%s'." ), name );
       return ret;
    }
+   al_bufferInfo( snd, name );
+   return 0;
+}
+
+/**
+ * @brief Gets the length and channels of a loaded sound from its buffer.
+ *
+ *    @param snd Sound to update.
+ *    @param name Name for debugging purposes.
+ */
+static void al_bufferInfo( alSound *snd, const char *name )
+{
+   ALint freq, bits, channels, size;
 
    soundLock();
 
@@ -2148,8 +2480,6 @@ int al_load( alSound *snd, SDL_RWops *rw, const char *name )
    al_checkErr();
 
    soundUnlock();
-
-   return 0;
 }
 
 /**
@@ -126,21 +126,24 @@ int space_spawn = 1; /**< Spawn enabled by default. */
  */
 /* spob load */
 static void spob_initDefaults( Spob *spob );
-static int  spob_parse( Spob *spob, const char *filename, Commodity **stdList );
+static int  spob_parse( Spob *spob, const char *filename, xmlDocPtr doc,
+                        Commodity **stdList );
 static int  space_parseSaveNodes( xmlNodePtr parent, StarSystem *sys );
 static int  spob_parsePresence( xmlNodePtr node, SpobPresence *ap );
 /* system load */
 static void system_init( StarSystem *sys );
 static int  systems_load( void );
-static int  system_parse( StarSystem *system, const char *filename );
+static int  system_parse( StarSystem *system, const char *filename,
+                          xmlDocPtr doc );
 static int  system_parseJumpPoint( const xmlNodePtr node, StarSystem *sys );
-static int  system_parseJumps( StarSystem *sys );
+static int  system_parseJumps( StarSystem *sys, xmlDocPtr doc );
 static int  system_parseAsteroidField( const xmlNodePtr node, StarSystem *sys );
 static int  system_parseAsteroidExclusion( const xmlNodePtr node,
                                            StarSystem      *sys );
 /* misc */
 static int             spob_cmp( const void *p1, const void *p2 );
 static void            system_scheduler( double dt, int init );
+static int             system_schedulerSettled( double left );
 static SystemPresence *system_getFactionPresenceGrow( StarSystem *sys,
                                                       int         faction );
 /* Markers. */
@@ -1454,6 +1457,30 @@ static void system_scheduler( double dt, int init )
    NTracingZoneEnd( _ctx );
 }
 
+/**
+ * @brief Checks to see if the fleet spawner has reached a steady state.
+ *
+ * The spawner is settled when no faction can spawn anything more within the
+ * given time, either because it is at its presence limit or because its timer
+ * won't run out.
+ *
+ *    @param left Time left to check.
+ *    @return 1 if no more fleets can spawn within left seconds.
+ */
+static int system_schedulerSettled( double left )
+{
+   for ( int i = 0; i < array_size( cur_system->presence ); i++ ) {
+      const SystemPresence *p = &cur_system->presence[i];
+      if ( ( p->value <= 0. ) || p->disabled )
+         continue;
+      if ( faction_getScheduler( p->faction ) == LUA_NOREF )
+         continue;
+      if ( ( p->curUsed < p->value ) && ( p->timer < left ) )
+         return 0;
+   }
+   return 1;
+}
+
 /**
  * @brief Mark when a faction changes.
  */
@@ -1740,20 +1767,38 @@ void space_init( const char *sysname, int do_simulate )
    }
    player_messageToggle( 0 );
    if ( do_simulate ) {
-      int n, s;
-      /* Uint32 time = SDL_GetTicks(); */
+      int    n, s, i;
+      Uint64 t = SDL_GetPerformanceCounter();
+
       s              = sound_disabled;
       sound_disabled = 1;
       ntime_allowUpdate( 0 );
+      /* Fast-forward without effects, stopping early once no more fleets
+       * would spawn before the player arrives. */
       n = SYSTEM_SIMULATE_TIME_PRE / fps_min_simulation;
-      for ( int i = 0; i < n; i++ )
+      for ( i = 0; i < n; i++ ) {
+         double simulated = i * fps_min_simulation;
+         if ( ( simulated >= SYSTEM_SIMULATE_TIME_MIN ) &&
+              system_schedulerSettled( SYSTEM_SIMULATE_TIME_PRE - simulated ) )
+            break;
          update_routine( fps_min_simulation, 0 );
+      }
+      NTracingPlotI( "space_init[pre]", i );
       space_simulating_effects = 1;
       n                        = SYSTEM_SIMULATE_TIME_POST / fps_min_simulation;
-      for ( int i = 0; i < n; i++ )
+      for ( int j = 0; j < n; j++ )
          update_routine( fps_min_simulation, 0 );
       ntime_allowUpdate( 1 );
       sound_disabled = s;
+
+      /* Report the stall. */
+      t = SDL_GetPerformanceCounter() - t;
+      NTracingPlotF( "space_init[ms]",
+                     1e3 * (double)t / (double)SDL_GetPerformanceFrequency() );
+      if ( conf.devmode )
+         DEBUG( _( "Simulated '%s' for %.1f s in %.3f s" ), cur_system->name,
+                i * fps_min_simulation + SYSTEM_SIMULATE_TIME_POST,
+                (double)t / (double)SDL_GetPerformanceFrequency() );
    }
    player_messageToggle( 1 );
    if ( player.p != NULL ) {
@@ -1793,6 +1838,7 @@ void space_init( const char *sysname, int do_simulate )
       /* Set up sound. */
       sound_env( SOUND_ENV_NORMAL, 0. );
    }
+   player_prefetchSounds();
 
    NTracingZoneEnd( _ctx );
    NTracingFrameMarkEnd( "space_init" );
@@ -1846,6 +1892,7 @@ const char *spob_name( const Spob *p )
 static int spobs_load( void )
 {
    char      **spob_files;
+   xmlDocPtr  *spob_docs;
    Commodity **stdList;
 
    /* Initialize stack if needed. */
@@ -1855,12 +1902,13 @@ static int spobs_load( void )
    /* Extract the list of standard commodities. */
    stdList = standard_commodities();
 
-   /* Load XML stuff. */
+   /* Load XML stuff, parsing in parallel but setting up in order. */
    spob_files = ndata_listRecursive( SPOB_DATA_PATH );
+   spob_docs  = xml_parsePhysFSAll( spob_files );
    for ( int i = 0; i < array_size( spob_files ); i++ ) {
       if ( ndata_matchExt( spob_files[i], "xml" ) ) {
          Spob s;
-         int  ret = spob_parse( &s, spob_files[i], stdList );
+         int  ret = spob_parse( &s, spob_files[i], spob_docs[i], stdList );
          if ( ret == 0 ) {
             s.id = array_size( spob_stack );
             array_push_back( &spob_stack, s );
@@ -1878,6 +1926,7 @@ static int spobs_load( void )
       spob_stack[j].id = j;
 
    /* Clean up. */
+   xml_freeAll( spob_docs );
    array_free( spob_files );
    array_free( stdList );
 
@@ -1891,7 +1940,8 @@ static int spobs_load( void )
  */
 static int virtualspobs_load( void )
 {
-   char **spob_files;
+   char     **spob_files;
+   xmlDocPtr *spob_docs;
 
    /* Initialize stack if needed. */
    if ( vspob_stack == NULL )
@@ -1899,16 +1949,11 @@ static int virtualspobs_load( void )
 
    /* Load XML stuff. */
    spob_files = ndata_listRecursive( VIRTUALSPOB_DATA_PATH );
+   spob_docs  = xml_parsePhysFSAll( spob_files );
    for ( int i = 0; i < array_size( spob_files ); i++ ) {
-      xmlDocPtr  doc;
+      xmlDocPtr  doc = spob_docs[i];
       xmlNodePtr node;
 
-      if ( !ndata_matchExt( spob_files[i], "xml" ) ) {
-         free( spob_files[i] );
-         continue;
-      }
-
-      doc = xml_parsePhysFS( spob_files[i] );
       if ( doc == NULL ) {
          free( spob_files[i] );
          continue;
@@ -1919,7 +1964,6 @@ static int virtualspobs_load( void )
          WARN( _( "Malformed %s file: does not contain elements" ),
                spob_files[i] );
          free( spob_files[i] );
-         xmlFreeDoc( doc );
          continue;
       }
 
@@ -1949,12 +1993,12 @@ static int virtualspobs_load( void )
 
       /* Clean up. */
       free( spob_files[i] );
-      xmlFreeDoc( doc );
    }
    qsort( vspob_stack, array_size( vspob_stack ), sizeof( VirtualSpob ),
           virtualspob_cmp );
 
    /* Clean up. */
+   xml_freeAll( spob_docs );
    array_free( spob_files );
 
    return 0;
@@ -2359,24 +2403,23 @@ static void spob_initDefaults( Spob *spob )
  *
  *    @param spob Spob to fill up.
  *    @param filename Name of the file to parse.
+ *    @param doc Parsed document of the file.
  *    @param[in] stdList The array of standard commodities.
  *    @return 0 on success.
  */
-static int spob_parse( Spob *spob, const char *filename, Commodity **stdList )
+static int spob_parse( Spob *spob, const char *filename, xmlDocPtr doc,
+                       Commodity **stdList )
 {
-   xmlDocPtr    doc;
    xmlNodePtr   node, parent;
    unsigned int flags;
    Commodity  **comms;
 
-   doc = xml_parsePhysFS( filename );
    if ( doc == NULL )
       return -1;
 
    parent = doc->xmlChildrenNode; /* first spob node */
    if ( parent == NULL ) {
       WARN( _( "Malformed %s file: does not contain elements" ), filename );
-      xmlFreeDoc( doc );
       return -1;
    }
 
@@ -2652,8 +2695,6 @@ static int spob_parse( Spob *spob, const char *filename, Commodity **stdList )
    /* Free temporary comms list. */
    array_free( comms );
 
-   xmlFreeDoc( doc );
-
    return 0;
 }
 
@@ -2853,6 +2894,8 @@ int system_addJump( StarSystem *sys, StarSystem *target )
    j->hide     = HIDE_DEFAULT_JUMP;
    jp_setFlag( j, JP_AUTOPOS );
 
+   economy_addQueuedUpdate();
+
    return 0;
 }
 
@@ -2883,6 +2926,9 @@ int system_rmJump( StarSystem *sys, StarSystem *target )
 
    /* Remove the jump. */
    array_erase( &sys->jumps, &sys->jumps[i], &sys->jumps[i + 1] );
+
+   economy_addQueuedUpdate();
+
    return 0;
 }
 
@@ -2991,6 +3037,9 @@ void systems_reconstructJumps( void )
 {
    NTracingZone( _ctx, 1 );
 
+   /* Jumps may have changed. */
+   map_jumpDistInvalidate();
+
    /* So we need to calculate the shortest jump. */
    for ( int i = 0; i < array_size( systems_stack ); i++ ) {
       StarSystem *sys = &systems_stack[i];
@@ -3158,23 +3207,20 @@ static int system_parseAsteroidExclusion( const xmlNodePtr node,
  *
  *    @param sys System to set up.
  *    @param filename Name of the file to parse.
+ *    @param doc Parsed document of the file.
  *    @return 0 on success.
  */
-static int system_parse( StarSystem *sys, const char *filename )
+static int system_parse( StarSystem *sys, const char *filename, xmlDocPtr doc )
 {
    xmlNodePtr node, parent;
-   xmlDocPtr  doc;
    uint32_t   flags;
 
-   /* Load the file. */
-   doc = xml_parsePhysFS( filename );
    if ( doc == NULL )
       return -1;
 
    parent = doc->xmlChildrenNode; /* first spob node */
    if ( parent == NULL ) {
       WARN( _( "Malformed %s file: does not contain elements" ), filename );
-      xmlFreeDoc( doc );
       return -1;
    }
 
@@ -3339,8 +3385,6 @@ static int system_parse( StarSystem *sys, const char *filename )
    MELEMENT( ( flags & FLAG_INTERFERENCESET ) == 0, "inteference" );
 #undef MELEMENT
 
-   xmlFreeDoc( doc );
-
    return 0;
 }
 
@@ -3490,22 +3534,19 @@ static int system_parseJumpPoint( const xmlNodePtr node, StarSystem *sys )
  * @brief Loads the jumps into a system.
  *
  *    @param sys Star system to load jumps of.
+ *    @param doc Parsed document of the system's file.
  *    @return 0 on success.
  */
-static int system_parseJumps( StarSystem *sys )
+static int system_parseJumps( StarSystem *sys, xmlDocPtr doc )
 {
    xmlNodePtr parent, node;
-   xmlDocPtr  doc;
 
-   doc = xml_parsePhysFS( sys->filename );
    if ( doc == NULL )
       return -1;
 
    parent = doc->xmlChildrenNode; /* first spob node */
-   if ( parent == NULL ) {
-      xmlFreeDoc( doc );
+   if ( parent == NULL )
       return -1;
-   }
 
    node = parent->xmlChildrenNode;
    do { /* load all the data */
@@ -3520,7 +3561,6 @@ static int system_parseJumps( StarSystem *sys )
 
    array_shrink( &sys->jumps );
 
-   xmlFreeDoc( doc );
    return 0;
 }
 
@@ -3577,7 +3617,8 @@ int space_loadLua( void )
 /**
  * @brief Loads the entire systems, needs to be called after spobs_load.
  *
- * Does multiple passes to load:
+ * The files are all parsed in parallel first, then does multiple passes over
+ * the documents to load:
  *
  *  - First loads the star systems.
  *  - Next sets the jump routes.
@@ -3589,13 +3630,16 @@ static int systems_load( void )
 #if DEBUGGING
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
-   char **system_files;
+   char     **system_files;
+   xmlDocPtr *system_docs, *loaded_docs, *sorted_docs;
 
    /* Allocate if needed. */
    if ( systems_stack == NULL )
       systems_stack = array_create( StarSystem );
 
    system_files = ndata_listRecursive( SYSTEM_DATA_PATH );
+   system_docs  = xml_parsePhysFSAll( system_files );
+   loaded_docs  = array_create_size( xmlDocPtr, array_size( system_files ) );
 
    /*
     * First pass - loads all the star systems_stack.
@@ -3606,7 +3650,7 @@ static int systems_load( void )
       if ( !ndata_matchExt( system_files[i], "xml" ) )
          continue;
 
-      int ret = system_parse( &sys, system_files[i] );
+      int ret = system_parse( &sys, system_files[i], system_docs[i] );
       if ( ret == 0 ) {
          sys.filename = system_files[i];
          sys.id       = array_size( systems_stack );
@@ -3615,6 +3659,7 @@ static int systems_load( void )
          system_updateAsteroids( &sys );
 
          array_push_back( &systems_stack, sys );
+         array_push_back( &loaded_docs, system_docs[i] );
 
          /* Render if necessary. */
          naev_renderLoadscreen();
@@ -3622,7 +3667,11 @@ static int systems_load( void )
    }
    qsort( systems_stack, array_size( systems_stack ), sizeof( StarSystem ),
           system_cmp );
+   /* The ids still have the loading order, use them to keep track of the
+    * documents. */
+   sorted_docs = array_create_size( xmlDocPtr, array_size( systems_stack ) );
    for ( int j = 0; j < array_size( systems_stack ); j++ ) {
+      array_push_back( &sorted_docs, loaded_docs[systems_stack[j].id] );
       systems_stack[j].id   = j;
       systems_stack[j].note = NULL; /* just to be sure */
    }
@@ -3631,9 +3680,12 @@ static int systems_load( void )
     * Second pass - loads all the jump routes.
     */
    for ( int i = 0; i < array_size( systems_stack ); i++ )
-      system_parseJumps( &systems_stack[i] );
+      system_parseJumps( &systems_stack[i], sorted_docs[i] );
 
    /* Clean up. */
+   array_free( sorted_docs );
+   array_free( loaded_docs );
+   xml_freeAll( system_docs );
    array_free( system_files );
 
 #if DEBUGGING
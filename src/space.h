@@ -20,6 +20,9 @@
 #define SYSTEM_SIMULATE_TIME_POST                                              \
    5. /**< Time to simulate the system before the player is added, however,    \
          effects are added. */
+#define SYSTEM_SIMULATE_TIME_MIN                                               \
+   10. /**< Minimum time to simulate without effects, after which it stops     \
+          early if no more fleets can spawn. */
 #define MAX_HYPERSPACE_VEL 25. /**< Speed to brake to before jumping. */
 
 /*
@@ -29,6 +29,7 @@
 #include "perlin.h"
 #include "render.h"
 #include "rng.h"
+#include "space.h"
 #include "vec2.h"
 
 #define SPFX_XML_ID "spfx" /**< SPFX XML node tag. */
@@ -50,6 +51,24 @@
 static TrailSpec   *trail_spec_stack; /**< Trail specifications. */
 static Trail_spfx **trail_spfx_stack; /**< Active trail effects. */
 
+/**
+ * @brief Trail segment as uploaded to the GPU, one per instance.
+ */
+typedef struct TrailSegment_ {
+   GLfloat segment[4]; /**< Start and end position in screen coordinates. */
+   GLfloat c1[4];      /**< Start colour. */
+   GLfloat c2[4];      /**< End colour. */
+   GLfloat times[4];   /**< Start and end time followed by start and end
+                          depth. */
+   GLfloat lengths[4]; /**< Start and end position along the trail with the
+                          thicknesses. */
+   GLfloat params[4];  /**< Width, unique value and current time. */
+} TrailSegment;
+static TrailSegment **trail_batch =
+   NULL; /**< Queued trail segments for each trail specification. */
+static gl_vbo *trail_vbo   = NULL; /**< Trail segment stream buffer. */
+static int     trail_draws = 0;    /**< Trail draw calls since last update. */
+
 /*
  * Special hard-coded special effects
  */
@@ -80,7 +99,8 @@ static double damage_strength = 0.; /**< Damage shader strength intensity. */
  * Trail colours handling.
  */
 static int trailSpec_load( void );
-static int trailSpec_parse( TrailSpec *tc, const char *file, int firstpass );
+static int trailSpec_parse( TrailSpec *tc, const char *file, xmlDocPtr doc,
+                            int firstpass );
 static TrailSpec *trailSpec_getRaw( const char *name );
 
 /*
@@ -144,7 +164,8 @@ static SPFX *spfx_stack_back   = NULL; /**< Back special effect layer. */
  */
 /* General. */
 static int  spfx_base_cmp( const void *p1, const void *p2 );
-static int  spfx_base_parse( SPFX_Base *temp, const char *filename );
+static int  spfx_base_parse( SPFX_Base *temp, const char *filename,
+                             xmlDocPtr doc );
 static void spfx_base_free( SPFX_Base *effect );
 static void spfx_update_layer( SPFX *layer, const double dt );
 /* Haptic. */
@@ -170,16 +191,15 @@ static int spfx_base_cmp( const void *p1, const void *p2 )
  *
  *    @param temp Address to load SPFX into.
  *    @param filename Name of the file to parse.
+ *    @param doc Parsed document of the file.
  *    @return 0 on success.
  */
-static int spfx_base_parse( SPFX_Base *temp, const char *filename )
+static int spfx_base_parse( SPFX_Base *temp, const char *filename,
+                            xmlDocPtr doc )
 {
    xmlNodePtr node, cur, uniforms;
    char      *shadervert, *shaderfrag;
-   xmlDocPtr  doc;
 
-   /* Load and read the data. */
-   doc = xml_parsePhysFS( filename );
    if ( doc == NULL )
       return -1;
 
@@ -329,9 +349,6 @@ static int spfx_base_parse( SPFX_Base *temp, const char *filename )
    free( shadervert );
    free( shaderfrag );
 
-   /* Clean up. */
-   xmlFreeDoc( doc );
-
    return 0;
 }
 
@@ -377,20 +394,23 @@ int spfx_load( void )
 #if DEBUGGING
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
-   char **spfx_files;
+   char     **spfx_files;
+   xmlDocPtr *spfx_docs;
 
    spfx_effects = array_create( SPFX_Base );
 
    spfx_files = ndata_listRecursive( SPFX_DATA_PATH );
+   spfx_docs  = xml_parsePhysFSAll( spfx_files );
    for ( int i = 0; i < array_size( spfx_files ); i++ ) {
       if ( ndata_matchExt( spfx_files[i], "xml" ) ) {
          SPFX_Base spfx;
-         int       ret = spfx_base_parse( &spfx, spfx_files[i] );
+         int       ret = spfx_base_parse( &spfx, spfx_files[i], spfx_docs[i] );
          if ( ret == 0 )
             array_push_back( &spfx_effects, spfx );
       }
       free( spfx_files[i] );
    }
+   xml_freeAll( spfx_docs );
    array_free( spfx_files );
 
    /* Reduce size. */
@@ -474,6 +494,14 @@ void spfx_free( void )
    array_free( trail_spfx_stack );
    trail_spfx_stack = NULL;
 
+   /* Free the trail batches. */
+   for ( int i = 0; i < array_size( trail_batch ); i++ )
+      array_free( trail_batch[i] );
+   array_free( trail_batch );
+   trail_batch = NULL;
+   gl_vboDestroy( trail_vbo );
+   trail_vbo = NULL;
+
    /* Free the trail styles. */
    for ( int i = 0; i < array_size( trail_spec_stack ); i++ ) {
       TrailSpec *ts = &trail_spec_stack[i];
@@ -512,6 +540,10 @@ void spfx_add( int effect, const double px, const double py, const double vx,
       return;
    }
 
+   /* Nobody will see them while fast-forwarding. */
+   if ( !space_needsEffects() )
+      return;
+
    /*
     * Select the Layer
     */
@@ -586,6 +618,8 @@ void spfx_update( const double dt, const double real_dt )
                              array_size( spfx_stack_middle ) +
                              array_size( spfx_stack_back ) );
    NTracingPlotI( "trails", array_size( trail_spfx_stack ) );
+   NTracingPlotI( "trail draws", trail_draws );
+   trail_draws = 0;
 
    spfx_update_layer( spfx_stack_front, dt );
    spfx_update_layer( spfx_stack_middle, dt );
@@ -871,14 +905,27 @@ static void spfx_trail_free( Trail_spfx *trail )
 }
 
 /**
- * @brief Draws a trail on screen.
+ * @brief Sets a colour in a trail segment.
+ */
+static void trail_setColour( GLfloat *c, const glColour *col )
+{
+   c[0] = col->r;
+   c[1] = col->g;
+   c[2] = col->b;
+   c[3] = col->a;
+}
+
+/**
+ * @brief Queues a trail to be drawn with the next spfx_trail_flush().
  *
- * Assumes depth testing is enabled.
+ * Segments are batched per trail specification, so that all the trails of a
+ * specification are drawn with a single call.
  */
-void spfx_trail_draw( const Trail_spfx *trail )
+void spfx_trail_batch( const Trail_spfx *trail )
 {
    const TrailSpec  *spec;
    const TrailStyle *styles;
+   TrailSegment    **batch;
    GLfloat           len;
    double            z;
 
@@ -888,20 +935,21 @@ void spfx_trail_draw( const Trail_spfx *trail )
    spec   = trail->spec;
    styles = spec->style;
 
-   /* Stuff that doesn't change for the entire trail. */
-   glUseProgram( spec->shader.program );
-   glEnableVertexAttribArray( spec->shader.vertex );
-   gl_vboActivateAttribOffset( gl_squareVBO, spec->shader.vertex, 0, 2,
-                               GL_FLOAT, 0 );
-   glUniform1f( spec->shader.dt, trail->dt );
-   glUniform1f( spec->shader.r, trail->r );
+   /* Get the batch of the specification. */
+   if ( trail_batch == NULL ) {
+      trail_batch = array_create_size( TrailSegment *,
+                                       array_size( trail_spec_stack ) );
+      for ( int i = 0; i < array_size( trail_spec_stack ); i++ )
+         array_push_back( &trail_batch, array_create( TrailSegment ) );
+   }
+   batch = &trail_batch[spec - trail_spec_stack];
 
    /* Start drawing from head to tail. */
    z   = cam_getZoom();
    len = 0.;
    for ( size_t i = trail->iread + 1; i < trail->iwrite; i++ ) {
-      mat4              projection;
       const TrailStyle *sp, *spp;
+      TrailSegment     *seg;
       double            x1, y1, x2, y2, s;
       TrailPoint       *tp  = &trail_at( trail, i );
       TrailPoint       *tpp = &trail_at( trail, i - 1 );
@@ -927,35 +975,105 @@ void spfx_trail_draw( const Trail_spfx *trail )
       sp  = &styles[tp->mode];
       spp = &styles[tpp->mode];
 
-      /* Set vertex. */
-      projection = gl_view_matrix;
-      mat4_translate_xy( &projection, x1, y1 );
-      mat4_rotate2dv( &projection, ( x2 - x1 ) / s, ( y2 - y1 ) / s );
-      mat4_scale_xy( &projection, s, z * ( sp->thick + spp->thick ) );
-      mat4_translate_xy( &projection, 0., -0.5 );
-
-      /* Set uniforms. */
-      gl_uniformMat4( spec->shader.projection, &projection );
-      gl_uniformColour( spec->shader.c1, &sp->col );
-      gl_uniformColour( spec->shader.c2, &spp->col );
-      glUniform2f( spec->shader.t, tp->t, tpp->t );
-      glUniform2f( spec->shader.z, tp->z, tpp->z );
-      glUniform2f( spec->shader.pos2, len, sp->thick );
+      /* Set up the instance. */
+      seg             = &array_grow( batch );
+      seg->segment[0] = x1;
+      seg->segment[1] = y1;
+      seg->segment[2] = x2;
+      seg->segment[3] = y2;
+      trail_setColour( seg->c1, &sp->col );
+      trail_setColour( seg->c2, &spp->col );
+      seg->times[0]   = tp->t;
+      seg->times[1]   = tpp->t;
+      seg->times[2]   = tp->z;
+      seg->times[3]   = tpp->z;
+      seg->lengths[2] = len;
+      seg->lengths[3] = sp->thick;
       len += s;
-      glUniform2f( spec->shader.pos1, len, spp->thick );
+      seg->lengths[0] = len;
+      seg->lengths[1] = spp->thick;
+      seg->params[0]  = z * ( sp->thick + spp->thick );
+      seg->params[1]  = trail->r;
+      seg->params[2]  = trail->dt;
+      seg->params[3]  = 0.;
+   }
+}
+
+/**
+ * @brief Draws all the trails queued with spfx_trail_batch().
+ *
+ * Assumes depth testing is enabled.
+ */
+void spfx_trail_flush( void )
+{
+   for ( int i = 0; i < array_size( trail_batch ); i++ ) {
+      const TrailSpec *spec  = &trail_spec_stack[i];
+      TrailSegment    *batch = trail_batch[i];
+      GLsizei          n     = array_size( batch );
+      if ( n == 0 )
+         continue;
+
+      const GLint attribs[] = {
+         spec->shader.segment, spec->shader.c1,      spec->shader.c2,
+         spec->shader.times,   spec->shader.lengths, spec->shader.params,
+      };
+      const GLint sizes[] = { 4, 4, 4, 4, 4, 3 };
+
+      /* Upload the segments. */
+      if ( trail_vbo == NULL )
+         trail_vbo = gl_vboCreateStream( n * sizeof( TrailSegment ), batch );
+      else
+         gl_vboData( trail_vbo, n * sizeof( TrailSegment ), batch );
+
+      glUseProgram( spec->shader.program );
+      gl_uniformMat4( spec->shader.projection, &gl_view_matrix );
+
+      /* The square is shared, the rest changes per segment. */
+      glEnableVertexAttribArray( spec->shader.vertex );
+      gl_vboActivateAttribOffset( gl_squareVBO, spec->shader.vertex, 0, 2,
+                                  GL_FLOAT, 0 );
+      for ( size_t j = 0; j < sizeof( attribs ) / sizeof( attribs[0] ); j++ ) {
+         /* Unused attributes get optimized out of the shader. */
+         if ( attribs[j] < 0 )
+            continue;
+         glEnableVertexAttribArray( attribs[j] );
+         gl_vboActivateAttribOffset( trail_vbo, attribs[j],
+                                     j * 4 * sizeof( GLfloat ), sizes[j],
+                                     GL_FLOAT, sizeof( TrailSegment ) );
+         glVertexAttribDivisor( attribs[j], 1 );
+      }
 
       /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
-   }
+      glDrawArraysInstanced( GL_TRIANGLE_STRIP, 0, 4, n );
+      trail_draws++;
 
-   /* Clear state. */
-   glDisableVertexAttribArray( spec->shader.vertex );
+      /* Clear state. */
+      for ( size_t j = 0; j < sizeof( attribs ) / sizeof( attribs[0] ); j++ ) {
+         if ( attribs[j] < 0 )
+            continue;
+         glVertexAttribDivisor( attribs[j], 0 );
+         glDisableVertexAttribArray( attribs[j] );
+      }
+      glDisableVertexAttribArray( spec->shader.vertex );
+      array_erase( &trail_batch[i], array_begin( batch ), array_end( batch ) );
+   }
    glUseProgram( 0 );
 
    /* Check errors. */
    gl_checkErr();
 }
 
+/**
+ * @brief Draws a trail on screen.
+ *
+ * Assumes depth testing is enabled.
+ */
+void spfx_trail_draw( const Trail_spfx *trail )
+{
+   spfx_trail_batch( trail );
+   spfx_trail_flush();
+}
+
 /**
  * @brief Increases the current rumble level.
  *
@@ -1200,8 +1318,9 @@ void spfx_render( int layer, double dt )
       for ( int i = 0; i < array_size( trail_spfx_stack ); i++ ) {
          const Trail_spfx *trail = trail_spfx_stack[i];
          if ( !trail->ontop )
-            spfx_trail_draw( trail );
+            spfx_trail_batch( trail );
       }
+      spfx_trail_flush();
       NTracingZoneEnd( _ctx_trails );
       break;
 
@@ -1217,15 +1336,13 @@ void spfx_render( int layer, double dt )
  * @brief Parses raw values out of a "trail" element.
  * \warning This means values like idle->thick aren't ready to use.
  */
-static int trailSpec_parse( TrailSpec *tc, const char *file, int firstpass )
+static int trailSpec_parse( TrailSpec *tc, const char *file, xmlDocPtr doc,
+                            int firstpass )
 {
    static const char *mode_tags[] = MODE_TAGS;
    char              *inherits;
    xmlNodePtr         parent, node;
-   xmlDocPtr          doc;
 
-   /* Load the data. */
-   doc = xml_parsePhysFS( file );
    if ( doc == NULL )
       return -1;
 
@@ -1248,14 +1365,12 @@ static int trailSpec_parse( TrailSpec *tc, const char *file, int firstpass )
       if ( inherits != NULL ) {
          /* Skip this pass. */
          free( inherits );
-         xmlFreeDoc( doc );
          return 0;
       }
    } else {
       if ( inherits == NULL ) {
          /* Already done here. */
          free( inherits );
-         xmlFreeDoc( doc );
          return 0;
       } else {
          const TrailSpec *tsparent = trailSpec_getRaw( inherits );
@@ -1311,16 +1426,16 @@ static int trailSpec_parse( TrailSpec *tc, const char *file, int firstpass )
       tc->shader.program =
          gl_program_vert_frag( "trail.vert", tc->shader_path );
       tc->shader.vertex = glGetAttribLocation( tc->shader.program, "vertex" );
+      tc->shader.segment =
+         glGetAttribLocation( tc->shader.program, "segment" );
+      tc->shader.c1    = glGetAttribLocation( tc->shader.program, "col1" );
+      tc->shader.c2    = glGetAttribLocation( tc->shader.program, "col2" );
+      tc->shader.times = glGetAttribLocation( tc->shader.program, "times" );
+      tc->shader.lengths =
+         glGetAttribLocation( tc->shader.program, "lengths" );
+      tc->shader.params = glGetAttribLocation( tc->shader.program, "params" );
       tc->shader.projection =
          glGetUniformLocation( tc->shader.program, "projection" );
-      tc->shader.r    = glGetUniformLocation( tc->shader.program, "r" );
-      tc->shader.dt   = glGetUniformLocation( tc->shader.program, "dt" );
-      tc->shader.c1   = glGetUniformLocation( tc->shader.program, "c1" );
-      tc->shader.c2   = glGetUniformLocation( tc->shader.program, "c2" );
-      tc->shader.t    = glGetUniformLocation( tc->shader.program, "t" );
-      tc->shader.z    = glGetUniformLocation( tc->shader.program, "z" );
-      tc->shader.pos1 = glGetUniformLocation( tc->shader.program, "pos1" );
-      tc->shader.pos2 = glGetUniformLocation( tc->shader.program, "pos2" );
       tc->shader.nebu_col =
          glGetUniformLocation( tc->shader.program, "nebu_col" );
       gl_checkErr();
@@ -1336,7 +1451,6 @@ static int trailSpec_parse( TrailSpec *tc, const char *file, int firstpass )
 
    /* Clean up. */
    free( inherits );
-   xmlFreeDoc( doc );
    return 0;
 }
 
@@ -1347,24 +1461,30 @@ static int trailSpec_parse( TrailSpec *tc, const char *file, int firstpass )
  */
 static int trailSpec_load( void )
 {
-   char **ts_files = ndata_listRecursive( TRAIL_DATA_PATH );
+   char     **ts_files = ndata_listRecursive( TRAIL_DATA_PATH );
+   xmlDocPtr *ts_docs  = xml_parsePhysFSAll( ts_files );
+   xmlDocPtr *docs     = array_create_size( xmlDocPtr, array_size( ts_files ) );
 
    trail_spec_stack = array_create( TrailSpec );
 
    /* First pass sets up and prepares inheritance. */
    for ( int i = 0; i < array_size( ts_files ); i++ ) {
       TrailSpec tc;
-      int       ret = trailSpec_parse( &tc, ts_files[i], 1 );
+      int       ret = trailSpec_parse( &tc, ts_files[i], ts_docs[i], 1 );
       if ( ret == 0 ) {
          tc.filename = ts_files[i];
          array_push_back( &trail_spec_stack, tc );
+         array_push_back( &docs, ts_docs[i] );
       } else
          free( ts_files[i] );
    }
 
    /* Second pass to complete inheritance. */
    for ( int i = 0; i < array_size( trail_spec_stack ); i++ )
-      trailSpec_parse( &trail_spec_stack[i], trail_spec_stack[i].filename, 0 );
+      trailSpec_parse( &trail_spec_stack[i], trail_spec_stack[i].filename,
+                       docs[i], 0 );
+   array_free( docs );
+   xml_freeAll( ts_docs );
    array_free( ts_files );
 
    /* Set up thickness. */
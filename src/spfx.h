@@ -63,16 +63,15 @@ typedef struct TrailSpec_ {
    char *shader_path; /**< Shader path. */
    struct {
       GLuint program;
-      GLuint vertex;
+      /* Attribute locations, -1 if optimized out of the shader. */
+      GLint  vertex;
+      GLint  segment;
+      GLint  c1;
+      GLint  c2;
+      GLint  times;
+      GLint  lengths;
+      GLint  params;
       GLuint projection;
-      GLuint r;
-      GLuint dt;
-      GLuint c1;
-      GLuint c2;
-      GLuint t;
-      GLuint z;
-      GLuint pos1;
-      GLuint pos2;
       GLuint nebu_col;
    } shader;
 } TrailSpec;
@@ -132,6 +131,8 @@ Trail_spfx *spfx_trail_create( const TrailSpec *spec );
 void        spfx_trail_sample( Trail_spfx *trail, double x, double y, double z,
                                double dx, double dy, TrailMode mode, int force );
 void        spfx_trail_remove( Trail_spfx *trail );
+void        spfx_trail_batch( const Trail_spfx *trail );
+void        spfx_trail_flush( void );
 void        spfx_trail_draw( const Trail_spfx *trail );
 
 /*
@@ -64,6 +64,14 @@ struct tech_group_s {
    tech_item_t *items;    /**< Items in the tech group. */
 };
 
+/**
+ * @brief Tech group being loaded along with its parsed document.
+ */
+typedef struct TechLoad_ {
+   tech_group_t tech; /**< Tech group, first so tech_cmp works on it. */
+   xmlDocPtr    doc;  /**< Parsed document of the tech group's file. */
+} TechLoad;
+
 /*
  * Group list.
  */
@@ -78,8 +86,9 @@ static void  tech_freeGroup( tech_group_t *grp );
 static char *tech_getItemName( tech_item_t *item );
 /* Loading. */
 static tech_item_t *tech_itemGrow( tech_group_t *grp );
-static int          tech_parseFile( tech_group_t *tech, const char *file );
-static int          tech_parseFileData( tech_group_t *tech );
+static int          tech_parseFile( tech_group_t *tech, const char *file,
+                                    xmlDocPtr doc );
+static int          tech_parseFileData( tech_group_t *tech, xmlDocPtr doc );
 static int          tech_parseXMLData( tech_group_t *tech, xmlNodePtr parent );
 static tech_item_t *tech_addItemOutfit( tech_group_t *grp, const char *name );
 static tech_item_t *tech_addItemShip( tech_group_t *grp, const char *name );
@@ -113,39 +122,42 @@ int tech_load( void )
 #if DEBUGGING
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
-   int    s;
-   char **tech_files = ndata_listRecursive( TECH_DATA_PATH );
-
-   /* Create the array. */
-   tech_groups = array_create( tech_group_t );
+   int        s;
+   char     **tech_files = ndata_listRecursive( TECH_DATA_PATH );
+   xmlDocPtr *tech_docs  = xml_parsePhysFSAll( tech_files );
+   TechLoad  *loads = array_create_size( TechLoad, array_size( tech_files ) );
 
    /* First pass create the groups - needed to reference them later. */
    for ( int i = 0; i < array_size( tech_files ); i++ ) {
-      tech_group_t tech;
-      int          ret;
+      TechLoad tl;
+      int      ret;
 
       if ( !ndata_matchExt( tech_files[i], "xml" ) )
          continue;
 
-      ret = tech_parseFile( &tech, tech_files[i] );
+      ret = tech_parseFile( &tl.tech, tech_files[i], tech_docs[i] );
       if ( ret == 0 ) {
-         tech.filename = strdup( tech_files[i] );
-         array_push_back( &tech_groups, tech );
+         tl.tech.filename = strdup( tech_files[i] );
+         tl.doc           = tech_docs[i];
+         array_push_back( &loads, tl );
       }
 
       free( tech_files[i] );
    }
    array_free( tech_files );
-   array_shrink( &tech_groups );
 
-   /* Sort. */
-   qsort( tech_groups, array_size( tech_groups ), sizeof( tech_group_t ),
-          tech_cmp );
+   /* Sort, keeping the documents along. */
+   qsort( loads, array_size( loads ), sizeof( TechLoad ), tech_cmp );
+   s           = array_size( loads );
+   tech_groups = array_create_size( tech_group_t, s );
+   for ( int i = 0; i < s; i++ )
+      array_push_back( &tech_groups, loads[i].tech );
 
    /* Now we load the data. */
-   s = array_size( tech_groups );
    for ( int i = 0; i < s; i++ )
-      tech_parseFileData( &tech_groups[i] );
+      tech_parseFileData( &tech_groups[i], loads[i].doc );
+   array_free( loads );
+   xml_freeAll( tech_docs );
 
    /* Info. */
 #if DEBUGGING
@@ -270,10 +282,9 @@ int tech_groupWrite( xmlTextWriterPtr writer, tech_group_t *grp )
 /**
  * @brief Parses an XML tech node.
  */
-static int tech_parseFile( tech_group_t *tech, const char *file )
+static int tech_parseFile( tech_group_t *tech, const char *file, xmlDocPtr doc )
 {
    xmlNodePtr parent;
-   xmlDocPtr  doc = xml_parsePhysFS( file );
    if ( doc == NULL )
       return -1;
 
@@ -293,8 +304,6 @@ static int tech_parseFile( tech_group_t *tech, const char *file )
       return 1;
    }
 
-   xmlFreeDoc( doc );
-
    return 0;
 }
 
@@ -361,11 +370,10 @@ static int tech_parseXMLData( tech_group_t *tech, xmlNodePtr parent )
 /**
  * @brief Parses an XML tech node.
  */
-static int tech_parseFileData( tech_group_t *tech )
+static int tech_parseFileData( tech_group_t *tech, xmlDocPtr doc )
 {
    xmlNodePtr  parent;
    const char *file = tech->filename;
-   xmlDocPtr   doc  = xml_parsePhysFS( file );
    if ( doc == NULL )
       return -1;
 
@@ -378,8 +386,6 @@ static int tech_parseFileData( tech_group_t *tech )
    /* Parse the data. */
    tech_parseXMLData( tech, parent );
 
-   xmlFreeDoc( doc );
-
    return 0;
 }
 
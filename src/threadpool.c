@@ -22,11 +22,20 @@
  * @note The algorithm/strategy for killing idle workers should be moved into
  *       the threadhandler and it should also be improved (the current strategy
  *       is probably not very good).
+ *
+ * There is also a separate work-stealing job system. Each worker thread owns
+ *  a deque where it pushes and pops jobs at the bottom, while idle workers
+ *  steal the oldest jobs from the top of the other deques. Threads that are
+ *  not workers submit to a shared injection deque. Waiting on a group of jobs
+ *  runs pending jobs instead of blocking, so jobs can submit and wait on other
+ *  jobs without deadlocking.
  */
 
 /** @cond */
+#include <limits.h>
 #include <stdlib.h>
 
+#include "SDL_atomic.h"
 #include "SDL_cpuinfo.h"
 #include "SDL_thread.h"
 /** @endcond */
@@ -35,6 +44,7 @@
 
 #include "array.h"
 #include "log.h"
+#include "naev.h"
 
 #define THREADPOOL_TIMEOUT                                                     \
    ( 5 * 100 )               /* The time a worker thread waits in ms. */
@@ -47,6 +57,12 @@
  */
 static int MAXTHREADS = 8; /* Bit overkill, but oh well. */
 
+#define JOB_DEQUE_SIZE 64 /* Initial size of the job deques. */
+#define JOB_TIMEOUT                                                            \
+   ( 5 * 100 ) /* The time an idle job worker sleeps in ms. */
+#define JOB_WAIT_TIMEOUT                                                       \
+   ( 1 ) /* The time a thread waiting on a group sleeps in ms. */
+
 /**
  * @brief Node in the thread queue.
  */
@@ -113,6 +129,47 @@ typedef struct vpoolThreadData_ vpoolThreadData;
 /* The global threadpool queue */
 static ThreadQueue *global_queue = NULL;
 
+/**
+ * @brief A single job of the job system.
+ */
+typedef struct Job_ {
+   int ( *function )( void * ); /**< The function to be called. */
+   void     *data;              /**< Arguments to the function. */
+   JobGroup *group;             /**< Group the job belongs to. */
+} Job;
+
+/**
+ * @brief Double ended queue of jobs.
+ *
+ * The owner pushes and pops at the bottom, thieves steal from the top. top and
+ * bottom are taken modulo the capacity. So that they can't overflow, they are
+ * reset to 0 whenever the deque drains, and rebased if it never does. They are
+ * only modified with the lock held, but are atomic so thieves can check for
+ * jobs without locking.
+ */
+typedef struct JobDeque_ {
+   SDL_mutex   *lock;   /**< Protects the deque. */
+   Job         *jobs;   /**< Ring buffer of jobs. */
+   int          size;   /**< Capacity of the ring buffer, power of two. */
+   SDL_atomic_t top;    /**< Index of the oldest job. */
+   SDL_atomic_t bottom; /**< Index past the newest job. */
+} JobDeque;
+
+/**
+ * @brief Group of jobs that can be waited on.
+ */
+struct JobGroup_ {
+   SDL_atomic_t pending; /**< Jobs not yet done, including continuations. */
+   SDL_mutex   *lock;    /**< Protects the continuations and the condition. */
+   SDL_cond    *cond;    /**< Signalled when no jobs are pending. */
+   Job         *then;    /**< Continuations to submit when done (array.h). */
+};
+
+static JobDeque *job_deques   = NULL; /* Workers' deques and injection. */
+static int       job_nworkers = 0;    /* Number of workers. */
+static SDL_sem  *job_sem      = NULL; /* Wakes up idle workers. */
+static _Thread_local int job_id = -1; /* Deque of the current thread. */
+
 /*
  * Prototypes.
  */
@@ -123,6 +180,10 @@ static void         tq_destroy( ThreadQueue *q );
 static int          threadpool_worker( void *data );
 static int          threadpool_handler( void *data );
 static int          vpool_worker( void *data );
+static void         job_push( const Job *job );
+static int          job_acquire( Job *job );
+static void         job_run( const Job *job );
+static int          job_worker( void *data );
 
 /**
  * @brief Creates a concurrent queue.
@@ -491,6 +552,23 @@ int threadpool_init( void )
       return -1;
    }
 
+   /* Set up the job system, the thread waiting also runs jobs so we leave a
+    * core for it. The last deque is for threads that aren't workers. */
+   job_nworkers = MAX( 1, SDL_GetCPUCount() - 1 );
+   job_sem      = SDL_CreateSemaphore( 0 );
+   job_deques   = calloc( job_nworkers + 1, sizeof( JobDeque ) );
+   for ( int i = 0; i < job_nworkers + 1; i++ ) {
+      job_deques[i].lock = SDL_CreateMutex();
+      job_deques[i].size = JOB_DEQUE_SIZE;
+      job_deques[i].jobs = calloc( JOB_DEQUE_SIZE, sizeof( Job ) );
+   }
+   for ( intptr_t i = 0; i < job_nworkers; i++ ) {
+      if ( SDL_CreateThread( job_worker, "job_worker", (void *)i ) == NULL ) {
+         ERR( _( "Threadpool init failed: %s" ), SDL_GetError() );
+         return -1;
+      }
+   }
+
    return 0;
 }
 
@@ -619,3 +697,321 @@ void vpool_cleanup( ThreadQueue *queue )
    /* Clean up */
    tq_destroy( queue );
 }
+
+/**
+ * @brief Sets the range of jobs in a deque, resetting it when empty.
+ *
+ * Must be called with the lock of the deque held.
+ */
+static void job_setRange( JobDeque *d, int top, int bottom )
+{
+   if ( top >= bottom )
+      top = bottom = 0;
+   SDL_AtomicSet( &d->top, top );
+   SDL_AtomicSet( &d->bottom, bottom );
+}
+
+/**
+ * @brief Pushes a job to the bottom of the current thread's deque.
+ */
+static void job_push( const Job *job )
+{
+   JobDeque *d = &job_deques[( job_id >= 0 ) ? job_id : job_nworkers];
+   int       top, bottom;
+
+   SDL_mutexP( d->lock );
+   top    = SDL_AtomicGet( &d->top );
+   bottom = SDL_AtomicGet( &d->bottom );
+   /* Rebase if it never drains, keeping the jobs in their slots. */
+   if ( bottom >= INT_MAX / 2 ) {
+      int base = top & ~( d->size - 1 );
+      top -= base;
+      bottom -= base;
+      job_setRange( d, top, bottom );
+   }
+   /* Grow as necessary, keeping the jobs in order. */
+   if ( bottom - top >= d->size ) {
+      Job *jobs = malloc( 2 * d->size * sizeof( Job ) );
+      for ( int i = top; i < bottom; i++ )
+         jobs[i & ( 2 * d->size - 1 )] = d->jobs[i & ( d->size - 1 )];
+      free( d->jobs );
+      d->jobs = jobs;
+      d->size *= 2;
+   }
+   d->jobs[bottom & ( d->size - 1 )] = *job;
+   SDL_AtomicSet( &d->bottom, bottom + 1 );
+   SDL_mutexV( d->lock );
+
+   /* Wake up a worker. */
+   SDL_SemPost( job_sem );
+}
+
+/**
+ * @brief Gets a job to run.
+ *
+ * Tries to pop the newest job of the own deque first, and otherwise steals
+ * the oldest job of another deque.
+ *
+ *    @param[out] job Job that was acquired.
+ *    @return 1 if a job was acquired, 0 otherwise.
+ */
+static int job_acquire( Job *job )
+{
+   int n = job_nworkers + 1;
+   int self = ( job_id >= 0 ) ? job_id : job_nworkers;
+
+   /* Own deque, newest first. */
+   if ( job_id >= 0 ) {
+      JobDeque *d = &job_deques[self];
+      SDL_mutexP( d->lock );
+      int bottom = SDL_AtomicGet( &d->bottom );
+      if ( bottom > SDL_AtomicGet( &d->top ) ) {
+         bottom--;
+         *job = d->jobs[bottom & ( d->size - 1 )];
+         job_setRange( d, SDL_AtomicGet( &d->top ), bottom );
+         SDL_mutexV( d->lock );
+         return 1;
+      }
+      SDL_mutexV( d->lock );
+   }
+
+   /* Steal from the others, oldest first. */
+   for ( int i = 0; i < n; i++ ) {
+      JobDeque *d = &job_deques[( self + 1 + i ) % n];
+      int       top;
+      /* Cheap check before locking. */
+      if ( SDL_AtomicGet( &d->bottom ) <= SDL_AtomicGet( &d->top ) )
+         continue;
+      SDL_mutexP( d->lock );
+      top = SDL_AtomicGet( &d->top );
+      if ( SDL_AtomicGet( &d->bottom ) > top ) {
+         *job = d->jobs[top & ( d->size - 1 )];
+         job_setRange( d, top + 1, SDL_AtomicGet( &d->bottom ) );
+         SDL_mutexV( d->lock );
+         return 1;
+      }
+      SDL_mutexV( d->lock );
+   }
+   return 0;
+}
+
+/**
+ * @brief Runs a job and marks it as done in its group.
+ */
+static void job_run( const Job *job )
+{
+   JobGroup *g    = job->group;
+   Job      *then = NULL;
+
+   job->function( job->data );
+
+   /* Not the last job, so no need to lock. */
+   while ( 1 ) {
+      int v = SDL_AtomicGet( &g->pending );
+      if ( v <= 1 )
+         break;
+      if ( SDL_AtomicCAS( &g->pending, v, v - 1 ) )
+         return;
+   }
+
+   /* Possibly the last job. The count only reaches zero with the lock held so
+    * that waiting threads can't free the group while we're still using it.
+    * Signal them and submit the continuations. */
+   SDL_mutexP( g->lock );
+   if ( SDL_AtomicAdd( &g->pending, -1 ) == 1 ) {
+      then    = g->then;
+      g->then = NULL;
+      SDL_CondBroadcast( g->cond );
+   }
+   SDL_mutexV( g->lock );
+   for ( int i = 0; i < array_size( then ); i++ )
+      job_push( &then[i] );
+   array_free( then );
+}
+
+/**
+ * @brief Work loop of the job workers.
+ *
+ *    @param data Index of the worker.
+ */
+static int job_worker( void *data )
+{
+   job_id = (intptr_t)data;
+   while ( 1 ) {
+      Job job;
+      if ( job_acquire( &job ) )
+         job_run( &job );
+      else
+         SDL_SemWaitTimeout( job_sem, JOB_TIMEOUT );
+   }
+   return 0;
+}
+
+/**
+ * @brief Creates a group of jobs.
+ *
+ *    @return The new group, free with jobgroup_free.
+ */
+JobGroup *jobgroup_create( void )
+{
+   JobGroup *g = calloc( 1, sizeof( JobGroup ) );
+   SDL_AtomicSet( &g->pending, 0 );
+   g->lock = SDL_CreateMutex();
+   g->cond = SDL_CreateCond();
+   return g;
+}
+
+/**
+ * @brief Frees a group of jobs.
+ *
+ * @note All the jobs should be done, i.e., it should have been waited on.
+ */
+void jobgroup_free( JobGroup *group )
+{
+   if ( group == NULL )
+      return;
+#if DEBUGGING
+   if ( SDL_AtomicGet( &group->pending ) > 0 )
+      WARN( _( "Freeing job group with pending jobs!" ) );
+#endif /* DEBUGGING */
+   SDL_DestroyMutex( group->lock );
+   SDL_DestroyCond( group->cond );
+   array_free( group->then );
+   free( group );
+}
+
+/**
+ * @brief Submits a job to a group.
+ *
+ * Can be called from jobs, in which case the job goes to the worker's own
+ * deque.
+ */
+void job_submit( JobGroup *group, int ( *function )( void * ), void *data )
+{
+   Job job = { .function = function, .data = data, .group = group };
+   SDL_AtomicAdd( &group->pending, 1 );
+   job_push( &job );
+}
+
+/**
+ * @brief Submits a job to a group that only runs once another group is done.
+ *
+ *    @param after Group that has to be done first.
+ *    @param group Group the job belongs to.
+ *    @param function Function to run.
+ *    @param data Data to pass to the function.
+ */
+void job_then( JobGroup *after, JobGroup *group, int ( *function )( void * ),
+               void *data )
+{
+   Job job = { .function = function, .data = data, .group = group };
+   SDL_AtomicAdd( &group->pending, 1 );
+
+   SDL_mutexP( after->lock );
+   if ( SDL_AtomicGet( &after->pending ) > 0 ) {
+      if ( after->then == NULL )
+         after->then = array_create( Job );
+      array_push_back( &after->then, job );
+      SDL_mutexV( after->lock );
+      return;
+   }
+   SDL_mutexV( after->lock );
+
+   /* Already done. */
+   job_push( &job );
+}
+
+/**
+ * @brief Waits for all the jobs of a group to be done.
+ *
+ * Instead of just blocking, the thread runs pending jobs while waiting.
+ */
+void job_wait( JobGroup *group )
+{
+   while ( SDL_AtomicGet( &group->pending ) > 0 ) {
+      Job job;
+      if ( job_acquire( &job ) ) {
+         job_run( &job );
+         continue;
+      }
+
+      /* Nothing to do, remaining jobs are being run by other threads. */
+      SDL_mutexP( group->lock );
+      if ( SDL_AtomicGet( &group->pending ) > 0 )
+         SDL_CondWaitTimeout( group->cond, group->lock, JOB_WAIT_TIMEOUT );
+      SDL_mutexV( group->lock );
+   }
+
+   /* Make sure the last job is done with the group. */
+   SDL_mutexP( group->lock );
+   SDL_mutexV( group->lock );
+}
+
+/**
+ * @brief Range of indices for job_parallelFor.
+ */
+typedef struct JobRange_ {
+   void ( *func )( int start, int end, void *data ); /**< Function to run. */
+   void *data;                                       /**< Data to pass. */
+   int   start;                                      /**< First index. */
+   int   end;                                        /**< Past last index. */
+} JobRange;
+
+static int job_parallelForRange( void *data )
+{
+   const JobRange *r = data;
+   r->func( r->start, r->end, r->data );
+   return 0;
+}
+
+/**
+ * @brief Runs a function over a range of indices in parallel and waits.
+ *
+ *    @param n Number of indices, the range is [0,n).
+ *    @param grain Indices per job, or 0 or less to choose automatically.
+ *    @param func Function to run for each chunk of indices.
+ *    @param data Data to pass to the function.
+ */
+void job_parallelFor( int n, int grain,
+                      void ( *func )( int start, int end, void *data ),
+                      void *data )
+{
+   JobGroup *g;
+   JobRange *ranges;
+   int       nr;
+
+   if ( n <= 0 )
+      return;
+
+   /* A few chunks per thread to balance the load. */
+   if ( grain <= 0 )
+      grain = MAX( 1, n / ( 4 * ( job_nworkers + 1 ) ) );
+   nr = ( n + grain - 1 ) / grain;
+
+   /* Not worth it. */
+   if ( nr == 1 ) {
+      func( 0, n, data );
+      return;
+   }
+
+   g      = jobgroup_create();
+   ranges = malloc( nr * sizeof( JobRange ) );
+   for ( int i = 0; i < nr; i++ ) {
+      ranges[i].func  = func;
+      ranges[i].data  = data;
+      ranges[i].start = i * grain;
+      ranges[i].end   = MIN( n, ( i + 1 ) * grain );
+      job_submit( g, job_parallelForRange, &ranges[i] );
+   }
+   job_wait( g );
+   jobgroup_free( g );
+   free( ranges );
+}
+
+/**
+ * @brief Gets the number of job worker threads.
+ */
+int job_workers( void )
+{
+   return job_nworkers;
+}
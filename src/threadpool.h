@@ -35,3 +35,40 @@ void vpool_wait( ThreadQueue *queue );
 
 /* Clean up. */
 void vpool_cleanup( ThreadQueue *queue );
+
+/*
+ * Job system.
+ *
+ * Each worker has its own deque of jobs and steals from the others when it
+ * runs out. Unlike vpools, jobs may submit more jobs and wait on them, as
+ * waiting threads help run jobs instead of blocking.
+ */
+struct JobGroup_;
+typedef struct JobGroup_ JobGroup;
+
+/* Creates a group of jobs that can be waited on. */
+JobGroup *jobgroup_create( void );
+
+/* Frees a group of jobs. All the jobs must be done. */
+void jobgroup_free( JobGroup *group );
+
+/* Submits a job to the group. Can be called from jobs. */
+void job_submit( JobGroup *group, int ( *function )( void * ), void *data );
+
+/* Submits a job to the group to run once all the jobs of another group are
+ * done. */
+void job_then( JobGroup *after, JobGroup *group, int ( *function )( void * ),
+               void *data );
+
+/* Waits for all the jobs of the group to be done, helping run jobs meanwhile.
+ */
+void job_wait( JobGroup *group );
+
+/* Runs func over [0,n) split into chunks of grain elements, and waits. A grain
+ * of 0 or less chooses one automatically. */
+void job_parallelFor( int n, int grain,
+                      void ( *func )( int start, int end, void *data ),
+                      void *data );
+
+/* Number of threads that run jobs, not counting the waiting threads. */
+int job_workers( void );
@@ -54,6 +54,7 @@ void window_addText( const unsigned int wid, const int x, const int y,
    wgt->dat.txt.colour   = ( colour == NULL ) ? cFontWhite : *colour;
    wgt->dat.txt.centered = centered;
    wgt->dat.txt.text     = ( string == NULL ) ? NULL : strdup( string );
+   gl_fontPrefetch( wgt->dat.txt.font, wgt->dat.txt.text );
 
    /* position/size */
    wgt->w = (double)w;
@@ -121,6 +122,7 @@ void window_modifyText( const unsigned int wid, const char *name,
    if ( wgt->dat.txt.text )
       free( wgt->dat.txt.text );
    wgt->dat.txt.text = ( newstring ) ? strdup( newstring ) : NULL;
+   gl_fontPrefetch( wgt->dat.txt.font, wgt->dat.txt.text );
 }
 
 /**
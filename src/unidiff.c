@@ -20,6 +20,7 @@
 #include "conf.h"
 #include "economy.h"
 #include "log.h"
+#include "map.h"
 #include "map_overlay.h"
 #include "ndata.h"
 #include "nxml.h"
@@ -507,17 +508,22 @@ int diff_init( void )
    }
 #endif /* DEBUGGING */
 
-   char **diff_files = ndata_listRecursive( UNIDIFF_DATA_PATH );
+   char     **diff_files = ndata_listRecursive( UNIDIFF_DATA_PATH );
+   xmlDocPtr *diff_docs  = xml_parsePhysFSAll( diff_files );
    diff_available =
       array_create_size( UniDiffData_t, array_size( diff_files ) );
    for ( int i = 0; i < array_size( diff_files ); i++ ) {
       UniDiffData_t diff;
 
       memset( &diff, 0, sizeof( diff ) );
-      if ( diff_parsePhysFS( &diff, diff_files[i] ) == 0 )
+      diff.filename = diff_files[i];
+      /* diff_parseDoc takes ownership of the document. */
+      if ( ( diff_docs[i] != NULL ) &&
+           ( diff_parseDoc( &diff, diff_docs[i] ) == 0 ) )
          array_push_back( &diff_available, diff );
       // xmlr_attr_strd( node, "name", diff.name );
    }
+   array_free( diff_docs );
    array_free( diff_files );
    array_shrink( &diff_available );
 
@@ -594,6 +600,7 @@ static int diff_parseDoc( UniDiffData_t *diff, xmlDocPtr doc )
    xmlNodePtr node;
    if ( strcmp( (char *)parent->name, "unidiff" ) ) {
       WARN( _( "Malformed unidiff file: missing root element 'unidiff'" ) );
+      xmlFreeDoc( doc );
       return -1;
    }
 
@@ -1170,6 +1177,7 @@ int diff_patchHunk( UniHunk_t *hunk )
       if ( ssys2 == NULL )
          return -1;
       diff_universe_changed = 1;
+      map_jumpDistInvalidate();
       if ( system_addJump( ssys, ssys2 ) )
          return -1;
       if ( system_addJump( ssys2, ssys ) )
@@ -1181,6 +1189,7 @@ int diff_patchHunk( UniHunk_t *hunk )
       if ( ssys2 == NULL )
          return -1;
       diff_universe_changed = 1;
+      map_jumpDistInvalidate();
       if ( system_rmJump( ssys, ssys2 ) )
          return -1;
       if ( system_rmJump( ssys2, ssys ) )
@@ -38,6 +38,10 @@
 #include "rng.h"
 #include "sound.h"
 #include "spfx.h"
+#include "threadpool.h"
+
+#define WEAPON_COLLIDE_BATCH                                                   \
+   64 /**< Weapons per job when detecting collisions. */
 
 /**
  * @brief Struct useful for generalization of weapno collisions.
@@ -68,6 +72,28 @@ typedef struct WeaponHit_ {
       *pos; /* Location of the hit, can be 2d array in the case of beams. */
 } WeaponHit;
 
+/**
+ * @brief A hit found by the collision detection, to be applied later.
+ */
+typedef struct WeaponHitRecord_ {
+   int        weapon; /**< Index of the weapon in the weapon stack. */
+   TargetType type;   /**< Class of object hit. */
+   union {
+      Pilot    *plt; /**< Hit a pilot. */
+      Asteroid *ast; /**< Hit an asteroid. */
+      int       wpn; /**< Hit a weapon, as an index in the weapon stack. */
+   } u;
+   vec2 crash[2]; /**< Location of the hit. */
+} WeaponHitRecord;
+
+/**
+ * @brief Hits found by a batch of weapons when detecting collisions.
+ */
+typedef struct WeaponCollideBatch_ {
+   IntList          query; /**< For querying collisions. */
+   WeaponHitRecord *hits;  /**< Hits found in the batch (array.h). */
+} WeaponCollideBatch;
+
 /* Weapon layers. */
 static Weapon *weapon_stack =
    NULL; /**< All the weapon munitions are piled up here. */
@@ -83,6 +109,10 @@ static int      qt_init = 0; /**< Whether or not the quadtree was created. */
 static Quadtree weapon_quadtree; /**< Quadtree for weapons. */
 static IntList  weapon_qtquery;  /**< For querying collisions. */
 static IntList  weapon_qtexp; /**< For querying collisions from explosions. */
+static WeaponCollideBatch *weapon_collideBatches =
+   NULL; /**< Per batch collision results (array.h). */
+static WeaponHitRecord *weapon_collideHits =
+   NULL; /**< Serial collision results (array.h). */
 
 /*
  * Prototypes
@@ -112,7 +142,13 @@ static double weapon_computeTimes( double rdir, double rx, double ry,
                                    double vmin, double acc, double *tt );
 /* Updating. */
 static void weapon_render( Weapon *w, double dt );
-static void weapon_updateCollide( Weapon *w, double dt );
+static void weapon_updateTimer( Weapon *w, double dt );
+static void weapon_collideFind( const Weapon *w, int idx, IntList *il,
+                                WeaponHitRecord **hits );
+static void weapon_collideFindRange( int start, int end, void *data );
+static void weapon_collideApply( const WeaponHitRecord *hits, int n,
+                                 int fallback, double dt );
+static void weapon_updateCollide( int idx, double dt );
 static void weapon_update( Weapon *w, double dt );
 static void weapon_sample_trail( Weapon *w );
 /* Destruction. */
@@ -608,19 +644,27 @@ static void think_beam( Weapon *w, double dt )
  */
 void weapons_updatePurge( void )
 {
+   int n;
+
    NTracingZone( _ctx, 1 );
 
    /* Clear quadtree. */
    qt_clear( &weapon_quadtree );
 
-   /* Actually purge and remove weapons. */
-   for ( int i = array_size( weapon_stack ) - 1; i >= 0; i-- ) {
+   /* Actually purge and remove weapons. The stack is compacted in a single
+    * pass keeping the order, as weapon_getID relies on it being sorted. */
+   n = 0;
+   for ( int i = 0; i < array_size( weapon_stack ); i++ ) {
       Weapon *w = &weapon_stack[i];
-      if ( !weapon_isFlag( w, WEAPON_FLAG_DESTROYED ) )
+      if ( weapon_isFlag( w, WEAPON_FLAG_DESTROYED ) ) {
+         weapon_free( w );
          continue;
-      weapon_free( w );
-      array_erase( &weapon_stack, &weapon_stack[i], &weapon_stack[i + 1] );
+      }
+      if ( n != i )
+         weapon_stack[n] = *w;
+      n++;
    }
+   array_resize( &weapon_stack, n );
 
    /* Do a second pass to add the quadtree elements. */
    for ( int i = 0; i < array_size( weapon_stack ); i++ ) {
@@ -654,12 +698,20 @@ void weapons_updatePurge( void )
 
 /**
  * @brief Handles weapon collisions.
+ *
+ * First all the timers are updated serially. Then the hits are found in
+ * parallel without modifying anything, and finally they are applied serially
+ * in the order of the weapon stack, so the results don't depend on how the
+ * work was split up.
  */
 void weapons_updateCollide( double dt )
 {
+   int n, nb;
+
    NTracingZone( _ctx, 1 );
    NTracingPlotI( "weapons", array_size( weapon_stack ) );
 
+   /* Update the timers, which may destroy weapons. */
    for ( int i = 0; i < array_size( weapon_stack ); i++ ) {
       Weapon *w = &weapon_stack[i];
 
@@ -667,73 +719,129 @@ void weapons_updateCollide( double dt )
       if ( weapon_isFlag( w, WEAPON_FLAG_DESTROYED ) )
          continue;
 
-      /* Handle types. */
-      switch ( w->outfit->type ) {
-
-      /* most missiles behave the same */
-      case OUTFIT_TYPE_LAUNCHER:
-      case OUTFIT_TYPE_TURRET_LAUNCHER:
-         w->timer -= dt;
-         if ( w->timer < 0. )
-            weapon_miss( w );
-         break;
+      weapon_updateTimer( w, dt );
+   }
 
-      case OUTFIT_TYPE_BOLT:
-      case OUTFIT_TYPE_TURRET_BOLT:
-         w->timer -= dt;
-         if ( w->timer < 0. ) {
-            weapon_miss( w );
-            break;
-         } else if ( w->timer < w->falloff )
-            w->strength = w->timer / w->falloff * w->strength_base;
-         break;
+   /* Set up the batches. */
+   n  = array_size( weapon_stack );
+   nb = ( n + WEAPON_COLLIDE_BATCH - 1 ) / WEAPON_COLLIDE_BATCH;
+   if ( weapon_collideBatches == NULL )
+      weapon_collideBatches = array_create( WeaponCollideBatch );
+   while ( array_size( weapon_collideBatches ) < nb ) {
+      WeaponCollideBatch *b = &array_grow( &weapon_collideBatches );
+      il_create( &b->query, 1 );
+      b->hits = array_create( WeaponHitRecord );
+   }
 
-      /* Beam weapons handled a part. */
-      case OUTFIT_TYPE_BEAM:
-      case OUTFIT_TYPE_TURRET_BEAM: {
-         double       rate, beamdt;
-         const Pilot *p = pilot_get( w->parent );
-         if ( p == NULL ) {
-            weapon_miss( w );
-            break;
-         }
-         if ( w->mount->outfit->type == OUTFIT_TYPE_BEAM )
-            rate = p->stats.fwd_firerate;
-         else
-            rate = p->stats.tur_firerate;
-         beamdt =
-            dt * p->stats.time_speedup * rate *
-            p->stats.weapon_firerate; /* Have to consider time speedup here. */
-         /* Beams don't have inherent accuracy, so we use the
-          * heatAccuracyMod to modulate duration. */
-         w->timer -=
-            beamdt / ( 1. - pilot_heatAccuracyMod( w->mount->heat_T ) );
-         if ( w->timer < 0. ) {
-            if ( p != NULL )
-               pilot_stopBeam( p, w->mount );
-            weapon_miss( w );
-            break;
-         }
-         /* We use the explosion timer to tell when we have to create
-          * explosions. */
-         w->timer2 -= dt;
-         if ( w->timer2 < -1. )
-            w->timer2 = 0.100;
-      } break;
-      default:
-         WARN( _( "Weapon of type '%s' has no update implemented yet!" ),
-               w->outfit->name );
-         break;
+   /* Find the hits in parallel. */
+   job_parallelFor( n, WEAPON_COLLIDE_BATCH, weapon_collideFindRange, NULL );
+
+   /* Apply them in order. Records of the same weapon are consecutive. */
+   for ( int i = 0; i < nb; i++ ) {
+      const WeaponHitRecord *hits = weapon_collideBatches[i].hits;
+      int                    j    = 0;
+      while ( j < array_size( hits ) ) {
+         int k = j + 1;
+         while ( ( k < array_size( hits ) ) &&
+                 ( hits[k].weapon == hits[j].weapon ) )
+            k++;
+         weapon_collideApply( &hits[j], k - j, 1, dt );
+         j = k;
       }
+   }
 
-      /* Only increment if weapon wasn't destroyed. */
+   /* Weapons created while handling hits still have to be handled. */
+   for ( int i = n; i < array_size( weapon_stack ); i++ ) {
+      Weapon *w = &weapon_stack[i];
+      if ( weapon_isFlag( w, WEAPON_FLAG_DESTROYED ) )
+         continue;
+      weapon_updateTimer( w, dt );
       if ( !weapon_isFlag( w, WEAPON_FLAG_DESTROYED ) )
-         weapon_updateCollide( w, dt );
+         weapon_updateCollide( i, dt );
    }
 
    NTracingZoneEnd( _ctx );
 }
 
+/**
+ * @brief Updates the timers of a weapon.
+ *
+ *    @param w Weapon to update.
+ *    @param dt Current delta tick.
+ */
+static void weapon_updateTimer( Weapon *w, double dt )
+{
+   /* Handle types. */
+   switch ( w->outfit->type ) {
+
+   /* most missiles behave the same */
+   case OUTFIT_TYPE_LAUNCHER:
+   case OUTFIT_TYPE_TURRET_LAUNCHER:
+      w->timer -= dt;
+      if ( w->timer < 0. )
+         weapon_miss( w );
+      break;
+
+   case OUTFIT_TYPE_BOLT:
+   case OUTFIT_TYPE_TURRET_BOLT:
+      w->timer -= dt;
+      if ( w->timer < 0. ) {
+         weapon_miss( w );
+         break;
+      } else if ( w->timer < w->falloff )
+         w->strength = w->timer / w->falloff * w->strength_base;
+      break;
+
+   /* Beam weapons handled a part. */
+   case OUTFIT_TYPE_BEAM:
+   case OUTFIT_TYPE_TURRET_BEAM: {
+      double       rate, beamdt;
+      const Pilot *p = pilot_get( w->parent );
+      if ( p == NULL ) {
+         weapon_miss( w );
+         break;
+      }
+      if ( w->mount->outfit->type == OUTFIT_TYPE_BEAM )
+         rate = p->stats.fwd_firerate;
+      else
+         rate = p->stats.tur_firerate;
+      beamdt =
+         dt * p->stats.time_speedup * rate *
+         p->stats.weapon_firerate; /* Have to consider time speedup here. */
+      /* Beams don't have inherent accuracy, so we use the
+       * heatAccuracyMod to modulate duration. */
+      w->timer -= beamdt / ( 1. - pilot_heatAccuracyMod( w->mount->heat_T ) );
+      if ( w->timer < 0. ) {
+         if ( p != NULL )
+            pilot_stopBeam( p, w->mount );
+         weapon_miss( w );
+         break;
+      }
+      /* We use the explosion timer to tell when we have to create
+       * explosions. */
+      w->timer2 -= dt;
+      if ( w->timer2 < -1. )
+         w->timer2 = 0.100;
+
+      /* Beams need to update their properties online. */
+      if ( w->outfit->type == OUTFIT_TYPE_BEAM ) {
+         w->dam_mod        = p->stats.fwd_damage * p->stats.weapon_damage;
+         w->dam_as_dis_mod = p->stats.fwd_dam_as_dis - 1.;
+         w->range_mod      = p->stats.fwd_range * p->stats.weapon_range;
+      } else {
+         w->dam_mod        = p->stats.tur_damage * p->stats.weapon_damage;
+         w->dam_as_dis_mod = p->stats.tur_dam_as_dis - 1.;
+         w->range_mod      = p->stats.tur_range * p->stats.weapon_range;
+      }
+      w->dam_as_dis_mod = CLAMP( 0., 1., w->dam_as_dis_mod );
+   } break;
+   default:
+      WARN( _( "Weapon of type '%s' has no update implemented yet!" ),
+            w->outfit->name );
+      break;
+   }
+}
+
 /**
  * @brief Updates all the weapons.
  *
@@ -769,6 +877,9 @@ void weapons_render( const WeaponLayer layer, double dt )
          weapon_render( w, dt );
    }
 
+   /* Projectiles don't care about the order they overlap in. */
+   gl_batchFlushSorted();
+
    NTracingZoneEnd( _ctx );
 }
 
@@ -870,12 +981,12 @@ static void weapon_render( Weapon *w, double dt )
       if ( gfx->tex != NULL ) {
          const glTexture *tex = gfx->tex;
          if ( gfx->tex_end != NULL )
-            gl_renderSpriteInterpolate( tex, gfx->tex_end, w->timer / w->life,
-                                        w->solid.pos.x, w->solid.pos.y, w->sx,
-                                        w->sy, &c );
+            gl_batchSpriteInterpolate( tex, gfx->tex_end, w->timer / w->life,
+                                       w->solid.pos.x, w->solid.pos.y, 1., 1.,
+                                       w->sx, w->sy, &c );
          else
-            gl_renderSprite( tex, w->solid.pos.x, w->solid.pos.y, w->sx, w->sy,
-                             &c );
+            gl_batchSprite( tex, w->solid.pos.x, w->solid.pos.y, 1., 1., 0.,
+                            w->sx, w->sy, &c );
       } else {
          double r, z;
 
@@ -1179,12 +1290,18 @@ static int weapon_testCollision( const WeaponCollision *wc,
 }
 
 /**
- * @brief Updates an individual weapon.
+ * @brief Finds what a weapon collides with.
  *
- *    @param w Weapon to update.
- *    @param dt Current delta tick.
+ * Doesn't modify anything, so it can be run in parallel for different weapons.
+ * Bolts and ammo only record the first hit, while beams record all of them.
+ *
+ *    @param w Weapon to find collisions of.
+ *    @param idx Index of the weapon in the weapon stack.
+ *    @param il List to use for querying.
+ *    @param[out] hits Array to append the hits to.
  */
-static void weapon_updateCollide( Weapon *w, double dt )
+static void weapon_collideFind( const Weapon *w, int idx, IntList *il,
+                                WeaponHitRecord **hits )
 {
    vec2            crash[2];
    WeaponCollision wc;
@@ -1234,21 +1351,7 @@ static void weapon_updateCollide( Weapon *w, double dt )
       x2 = MAX( x, px ) + w2;
       y2 = MAX( y, py ) + h2;
    } else {
-      Pilot *p = pilot_get( w->parent );
-      /* Beams have to update properties as necessary. */
-      if ( p != NULL ) {
-         /* Beams need to update their properties online. */
-         if ( w->outfit->type == OUTFIT_TYPE_BEAM ) {
-            w->dam_mod        = p->stats.fwd_damage * p->stats.weapon_damage;
-            w->dam_as_dis_mod = p->stats.fwd_dam_as_dis - 1.;
-            w->range_mod      = p->stats.fwd_range * p->stats.weapon_range;
-         } else {
-            w->dam_mod        = p->stats.tur_damage * p->stats.weapon_damage;
-            w->dam_as_dis_mod = p->stats.tur_dam_as_dis - 1.;
-            w->range_mod      = p->stats.tur_range * p->stats.weapon_range;
-         }
-         w->dam_as_dis_mod = CLAMP( 0., 1., w->dam_as_dis_mod );
-      }
+      /* Beam properties are updated with the timers. */
       wc.gfx     = NULL;
       wc.polygon = NULL;
       wc.range   = w->outfit->u.bem.width * 0.5; /* Set beam width. */
@@ -1274,10 +1377,10 @@ static void weapon_updateCollide( Weapon *w, double dt )
 
    /* Get colliding pilots. */
    if ( !outfit_isProp( w->outfit, OUTFIT_PROP_WEAP_MISS_SHIPS ) ) {
-      pilot_collideQueryIL( &weapon_qtquery, x1, y1, x2, y2 );
-      for ( int i = 0; i < il_size( &weapon_qtquery ); i++ ) {
-         Pilot    *p = pilot_stack[il_get( &weapon_qtquery, i, 0 )];
-         WeaponHit hit;
+      pilot_collideQueryConstIL( il, x1, y1, x2, y2 );
+      for ( int i = 0; i < il_size( il ); i++ ) {
+         Pilot           *p = pilot_stack[il_get( il, i, 0 )];
+         WeaponHitRecord *hit;
 
          /* Ignore pilots being deleted. */
          if ( pilot_isFlag( p, PILOT_DELETE ) )
@@ -1313,25 +1416,23 @@ static void weapon_updateCollide( Weapon *w, double dt )
                  poly_view( &p->ship->polygon, p->solid.dir ), 0., crash ) )
             continue;
 
-         /* Handle the hit. */
-         hit.type  = TARGET_PILOT;
-         hit.u.plt = p;
-         hit.pos   = crash;
-         if ( wc.beam )
-            weapon_hitBeam( w, &hit, dt );
-         /* No return because beam can still think, it's not
-          * destroyed like the other weapons.*/
-         else {
-            weapon_hit( w, &hit );
-            return; /* Weapon is destroyed. */
-         }
+         /* Record the hit. */
+         hit           = &array_grow( hits );
+         hit->weapon   = idx;
+         hit->type     = TARGET_PILOT;
+         hit->u.plt    = p;
+         hit->crash[0] = crash[0];
+         hit->crash[1] = crash[1];
+         /* Beams can hit many things, the rest are destroyed. */
+         if ( !wc.beam )
+            return;
       }
    }
 
    /* Collide with asteroids. */
    if ( !outfit_isProp( w->outfit, OUTFIT_PROP_WEAP_MISS_ASTEROIDS ) ) {
       for ( int i = 0; i < array_size( cur_system->asteroids ); i++ ) {
-         AsteroidAnchor *ast = &cur_system->asteroids[i];
+         const AsteroidAnchor *ast = &cur_system->asteroids[i];
 
          /* Early in-range check with the asteroid field.
           * Since range for beam weapons is set to width, we have to use the
@@ -1342,11 +1443,11 @@ static void weapon_updateCollide( Weapon *w, double dt )
             continue;
 
          /* Quadtree collisions. */
-         asteroid_collideQueryIL( ast, &weapon_qtquery, x1, y1, x2, y2 );
-         for ( int j = 0; j < il_size( &weapon_qtquery ); j++ ) {
-            Asteroid *a = &ast->asteroids[il_get( &weapon_qtquery, j, 0 )];
-            int       coll;
-            WeaponHit hit;
+         asteroid_collideQueryConstIL( ast, il, x1, y1, x2, y2 );
+         for ( int j = 0; j < il_size( il ); j++ ) {
+            Asteroid        *a = &ast->asteroids[il_get( il, j, 0 )];
+            int              coll;
+            WeaponHitRecord *hit;
 
             if ( a->state != ASTEROID_FG )
                continue;
@@ -1366,28 +1467,32 @@ static void weapon_updateCollide( Weapon *w, double dt )
             if ( !coll )
                continue;
 
-            /* Handle the hit. */
-            hit.type  = TARGET_ASTEROID;
-            hit.u.ast = a;
-            hit.pos   = crash;
-            if ( wc.beam )
-               weapon_hitBeam( w, &hit, dt );
-            else {
-               weapon_hit( w, &hit );
-               return; /* Weapon is destroyed. */
-            }
+            /* Record the hit. */
+            hit           = &array_grow( hits );
+            hit->weapon   = idx;
+            hit->type     = TARGET_ASTEROID;
+            hit->u.ast    = a;
+            hit->crash[0] = crash[0];
+            hit->crash[1] = crash[1];
+            if ( !wc.beam )
+               return;
          }
       }
    }
 
    /* Finally do a point defense test. */
    if ( outfit_isProp( w->outfit, OUTFIT_PROP_WEAP_POINTDEFENSE ) ) {
-      qt_query( &weapon_quadtree, &weapon_qtquery, x1, y1, x2, y2 );
-      for ( int i = 0; i < il_size( &weapon_qtquery ); i++ ) {
-         Weapon         *whit = &weapon_stack[il_get( &weapon_qtquery, i, 0 )];
-         WeaponCollision wchit;
-         int             coll;
-         WeaponHit       hit;
+      qt_queryConst( &weapon_quadtree, il, x1, y1, x2, y2 );
+      for ( int i = 0; i < il_size( il ); i++ ) {
+         int              widx = il_get( il, i, 0 );
+         const Weapon    *whit = &weapon_stack[widx];
+         WeaponCollision  wchit;
+         int              coll;
+         WeaponHitRecord *hit;
+
+         /* Weapons destroyed by their timers can't be hit. */
+         if ( weapon_isFlag( whit, WEAPON_FLAG_DESTROYED ) )
+            continue;
 
          /* We can only hit ammo weapons, so no beams. */
          wchit.w         = whit;
@@ -1412,20 +1517,124 @@ static void weapon_updateCollide( Weapon *w, double dt )
          if ( !coll )
             continue;
 
-         /* Handle the hit. */
-         hit.type  = TARGET_WEAPON;
-         hit.u.wpn = whit;
-         hit.pos   = crash;
-         if ( wc.beam )
-            weapon_hitBeam( w, &hit, dt );
-         else {
-            weapon_hit( w, &hit );
-            return; /* Weapon is destroyed. */
-         }
+         /* Record the hit. */
+         hit           = &array_grow( hits );
+         hit->weapon   = idx;
+         hit->type     = TARGET_WEAPON;
+         hit->u.wpn    = widx;
+         hit->crash[0] = crash[0];
+         hit->crash[1] = crash[1];
+         if ( !wc.beam )
+            return;
+      }
+   }
+}
+
+/**
+ * @brief Finds the collisions of a batch of weapons for job_parallelFor.
+ */
+static void weapon_collideFindRange( int start, int end, void *data )
+{
+   WeaponCollideBatch *b = &weapon_collideBatches[start / WEAPON_COLLIDE_BATCH];
+   (void)data;
+   array_resize( &b->hits, 0 );
+   for ( int i = start; i < end; i++ ) {
+      const Weapon *w = &weapon_stack[i];
+      if ( !weapon_isFlag( w, WEAPON_FLAG_DESTROYED ) )
+         weapon_collideFind( w, i, &b->query, &b->hits );
+   }
+}
+
+/**
+ * @brief Checks to see if a hit that was found is still valid.
+ *
+ * Hits applied before may have destroyed or killed the target since they were
+ * found.
+ */
+static int weapon_collideValid( const Weapon *w, const WeaponHitRecord *hit )
+{
+   switch ( hit->type ) {
+   case TARGET_PILOT:
+      return !pilot_isFlag( hit->u.plt, PILOT_DELETE ) &&
+             weapon_checkCanHit( w, hit->u.plt );
+   case TARGET_ASTEROID:
+      return ( hit->u.ast->state == ASTEROID_FG );
+   case TARGET_WEAPON:
+      return !weapon_isFlag( &weapon_stack[hit->u.wpn],
+                             WEAPON_FLAG_DESTROYED );
+   default:
+      return 0;
+   }
+}
+
+/**
+ * @brief Applies the hits found for a weapon.
+ *
+ *    @param hits Hits of the weapon.
+ *    @param n Number of hits.
+ *    @param fallback Whether or not to look for collisions again if the hit of
+ *           a bolt or ammo is no longer valid.
+ *    @param dt Current delta tick.
+ */
+static void weapon_collideApply( const WeaponHitRecord *hits, int n,
+                                 int fallback, double dt )
+{
+   for ( int i = 0; i < n; i++ ) {
+      /* Have to get the weapon each time as the stack may grow on hits. */
+      const WeaponHitRecord *rec = &hits[i];
+      Weapon                *w   = &weapon_stack[rec->weapon];
+      WeaponHit              hit;
+
+      /* May have been destroyed by a previous hit. */
+      if ( weapon_isFlag( w, WEAPON_FLAG_DESTROYED ) )
+         return;
+
+      /* Target is gone, but bolts and ammo may still hit something else. */
+      if ( !weapon_collideValid( w, rec ) ) {
+         if ( outfit_isBeam( w->outfit ) )
+            continue;
+         if ( fallback )
+            weapon_updateCollide( rec->weapon, dt );
+         return;
+      }
+
+      /* Handle the hit. */
+      hit.type = rec->type;
+      if ( rec->type == TARGET_PILOT )
+         hit.u.plt = rec->u.plt;
+      else if ( rec->type == TARGET_ASTEROID )
+         hit.u.ast = rec->u.ast;
+      else
+         hit.u.wpn = &weapon_stack[rec->u.wpn];
+      hit.pos = rec->crash;
+      if ( outfit_isBeam( w->outfit ) )
+         weapon_hitBeam( w, &hit, dt );
+      /* No return because beam can still think, it's not
+       * destroyed like the other weapons.*/
+      else {
+         weapon_hit( w, &hit );
+         return; /* Weapon is destroyed. */
       }
    }
 }
 
+/**
+ * @brief Finds and applies the collisions of a single weapon serially.
+ *
+ *    @param idx Index of the weapon in the weapon stack.
+ *    @param dt Current delta tick.
+ */
+static void weapon_updateCollide( int idx, double dt )
+{
+   if ( weapon_collideHits == NULL )
+      weapon_collideHits = array_create( WeaponHitRecord );
+   array_resize( &weapon_collideHits, 0 );
+   weapon_collideFind( &weapon_stack[idx], idx, &weapon_qtquery,
+                       &weapon_collideHits );
+   weapon_collideApply( weapon_collideHits, array_size( weapon_collideHits ),
+                        0, dt );
+}
+
 /**
  * @brief Updates an individual weapon.
  *
@@ -2882,6 +3091,14 @@ void weapon_exit( void )
    qt_destroy( &weapon_quadtree );
    il_destroy( &weapon_qtquery );
    il_destroy( &weapon_qtexp );
+   for ( int i = 0; i < array_size( weapon_collideBatches ); i++ ) {
+      il_destroy( &weapon_collideBatches[i].query );
+      array_free( weapon_collideBatches[i].hits );
+   }
+   array_free( weapon_collideBatches );
+   weapon_collideBatches = NULL;
+   array_free( weapon_collideHits );
+   weapon_collideHits = NULL;
 }
 
 const IntList *weapon_collideQuery( int x1, int y1, int x2, int y2 )